@@ -0,0 +1,83 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_clist.c
+ * @brief: microbenchmark of client list add, lookup and remove
+*/
+
+
+#include"shell_clist.h"
+#include<time.h>
+
+#define OPS_PER_SIZE	2000000		// operations measured for each list size
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// measures operations on a list holding cnt clients
+static void bench_size(int cnt){
+
+	struct client_list clist;
+	struct client_info *infos = calloc(cnt, sizeof(struct client_info));
+	int *slots = malloc(cnt * sizeof(int));
+	int rounds = OPS_PER_SIZE / cnt > 0 ? OPS_PER_SIZE / cnt : 1;
+	double t_add = 0, t_pid = 0, t_topic = 0, t_rm = 0, t;
+	volatile int sink = 0;
+
+	for(int i = 0; i < cnt; i++){
+		infos[i].id = i;
+		infos[i].pid = 1000 + i;
+		snprintf(infos[i].topic, CLIENT_TOPIC_LEN, "sensor/%d", i);
+	}
+
+	shell_clist_init(&clist, CLIENTS_INIT_CNT);
+
+	for(int r = 0; r < rounds; r++){
+
+		t = now_ns();
+		for(int i = 0; i < cnt; i++){
+			slots[i] = shell_clist_add(&clist, &infos[i]);
+		}
+		t_add += now_ns() - t;
+
+		t = now_ns();
+		for(int i = 0; i < cnt; i++){
+			sink += shell_clist_find_pid(&clist, infos[i].pid);
+		}
+		t_pid += now_ns() - t;
+
+		t = now_ns();
+		for(int i = 0; i < cnt; i++){
+			sink += shell_clist_find_topic(&clist, infos[i].topic);
+		}
+		t_topic += now_ns() - t;
+
+		t = now_ns();
+		for(int i = 0; i < cnt; i++){
+			shell_clist_rm_slot(&clist, slots[i]);
+		}
+		t_rm += now_ns() - t;
+	}
+
+	double ops = (double)rounds * cnt;
+	fprintf(stdout, "%7d clients: add %6.1f ns  find pid %6.1f ns  find topic %6.1f ns  remove %6.1f ns\n",
+		cnt, t_add / ops, t_pid / ops, t_topic / ops, t_rm / ops);
+
+	shell_clist_free(&clist);
+	free(infos);
+	free(slots);
+}
+
+int main(void){
+
+	bench_size(10);
+	bench_size(1000);
+	bench_size(100000);
+
+	return EXIT_SUCCESS;
+}
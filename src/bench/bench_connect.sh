@@ -0,0 +1,139 @@
+#!/bin/sh
+
+# file: bench_connect.sh
+# measures time from connect request to subscription of a topic against a local broker
+# topics of one broker address share a connection, so every topic goes to its own loopback address
+# to measure new connections: their client is either spawned(-w 0) or taken from the pool of idle
+# clients, last run subscribes all topics of one address on its live shared connection
+# the shell logs the time of every timed connect: "subscribed to topic ... in X ms"
+# log file is read because it is flushed every few ms while shell output is buffered
+#
+# usage: ./bench_connect.sh [-n connects] [-w idle clients] [-g gap ms between connects]
+# needs mosquitto and built shell and shell client
+
+CONNECTS=50
+WORKERS=4
+GAP_MS=200
+
+while getopts "n:w:g:" opt; do
+	case $opt in
+		n) CONNECTS=$OPTARG ;;
+		w) WORKERS=$OPTARG ;;
+		g) GAP_MS=$OPTARG ;;
+		*) sed -n '9p' "$0"; exit 2 ;;
+	esac
+done
+
+SRC=$(cd "$(dirname "$0")/.." && pwd)
+SHELL_BIN=$SRC/shell/shell
+BROKER=127.0.0.1
+PORT=1883			# compiled into the clients
+
+for bin in "$SHELL_BIN" "$SRC/client_shell/shell_client"; do
+	if [ ! -x "$bin" ]; then
+		echo "error: $bin is not built" >&2
+		exit 2
+	fi
+done
+if ! command -v mosquitto >/dev/null; then
+	echo "error: mosquitto broker is not installed" >&2
+	exit 2
+fi
+
+# shell runs in its own directory, it finds shell client through ../client_shell
+WORK=$(mktemp -d)
+mkdir "$WORK/run"
+ln -s "$SRC/client_shell" "$WORK/client_shell"
+
+BROKER_PID=
+SHELL_PID=
+
+cleanup(){
+	# clients are children of the shell, they are found before it is gone
+	[ -n "$SHELL_PID" ] && pkill -USR1 -P $SHELL_PID 2>/dev/null
+	[ -n "$SHELL_PID" ] && kill -9 $SHELL_PID 2>/dev/null
+	[ -n "$BROKER_PID" ] && kill $BROKER_PID 2>/dev/null
+	wait 2>/dev/null
+	rm -rf "$WORK"
+}
+trap cleanup EXIT
+trap 'exit 2' INT TERM
+
+# opens the shell menu and enters lines
+menu(){
+	kill -INT $SHELL_PID
+	sleep 0.2
+	for line in "$@"; do
+		echo "$line" >&4
+		sleep 0.05
+	done
+}
+
+# broker address of connect i, 127.0.0.1 for every connect when they share a connection
+addr(){
+	if [ "$2" = shared ]; then echo $BROKER; else echo 127.0.$(($1 / 250)).$(($1 % 250 + 1)); fi
+}
+
+# local broker on loopback only, listening on the address of every connect
+i=0
+while [ $i -lt $CONNECTS ]; do
+	echo "listener $PORT $(addr $i)"
+	i=$((i + 1))
+done > "$WORK/mosquitto.conf"
+echo "allow_anonymous true" >> "$WORK/mosquitto.conf"
+mosquitto -c "$WORK/mosquitto.conf" >"$WORK/broker.out" 2>&1 &
+BROKER_PID=$!
+sleep 0.5
+if ! kill -0 $BROKER_PID 2>/dev/null; then
+	echo "error: broker did not start, is port $PORT in use?" >&2
+	cat "$WORK/broker.out" >&2
+	exit 2
+fi
+
+# connects topics one by one with the pool of given size, to new or to one shared connection
+# writes connect times(ms) to a file named by the mode
+run(){
+	rm -f "$WORK/in" "$WORK/run/log.txt"
+	mkfifo "$WORK/in"
+	(cd "$WORK/run" && exec "$SHELL_BIN" -w $1 -f 10 -s "$WORK/tsdb" <"$WORK/in" >"$WORK/shell.out" 2>&1) &
+	SHELL_PID=$!
+	exec 4>"$WORK/in"
+	sleep 1
+
+	i=0
+	while [ $i -lt $CONNECTS ]; do
+		menu 2 $(addr $i $2) bench/connect/$i
+		tries=0
+		while ! grep -q "subscribed to topic bench/connect/$i in" "$WORK/run/log.txt" 2>/dev/null; do
+			tries=$((tries + 1))
+			if [ $tries -gt 100 ]; then
+				echo "error: connect $i did not subscribe" >&2
+				exit 2
+			fi
+			sleep 0.05
+		done
+		sleep $(awk -v g=$GAP_MS 'BEGIN {print g / 1000}')
+		i=$((i + 1))
+	done
+
+	menu 1
+	wait $SHELL_PID 2>/dev/null
+	exec 4>&-
+	SHELL_PID=
+	awk '/subscribed to topic bench\/connect\// {print $(NF - 1)}' "$WORK/run/log.txt" > "$WORK/times_$3"
+}
+
+# prints mean and percentiles of times of a run
+summary(){
+	sort -n "$WORK/times_$2" | awk -v name="$1" '{ t[NR] = $1; s += $1 }
+		END { printf "%-12s %6d %10.2f %10.2f %10.2f %10.2f\n", name, NR, s / NR,
+			t[int(NR * 0.5 + 0.5)], t[int(NR * 0.9 + 0.5)], t[NR] }'
+}
+
+printf "%-12s %6s %10s %10s %10s %10s\n" "mode" "conn" "mean(ms)" "p50(ms)" "p90(ms)" "max(ms)"
+run 0 new spawn
+run $WORKERS new pool
+run $WORKERS shared shared
+summary "spawn" spawn
+summary "pool($WORKERS)" pool
+summary "shared" shared
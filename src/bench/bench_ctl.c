@@ -0,0 +1,187 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_ctl.c
+ * @brief: measures time to bring many subscriptions online through the control socket of the shell
+ * @note: usage: bench_ctl socket [topics] [batch] [ip], needs a shell started with -c socket and a broker at ip,
+ *	  topics bench/ctl/<n> are sent in batches that wait for their subscriptions(connect -w) and are
+ *	  disconnected afterwards
+*/
+
+
+#include"shell_ctl.h"
+#include<time.h>
+#include<sys/time.h>
+
+#define BENCH_TOPICS	1000		// default subscriptions
+#define BENCH_BATCH	200		// default topics of one connect command
+#define BENCH_IP	"127.0.0.1"
+#define BENCH_WAIT_SEC	(CTL_WAIT_TICKS + 5)	// shell answers every waiting request before this
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// writes whole buffer to the socket
+static void send_all(int fd, const char *buf, size_t len){
+
+	while(len > 0){
+
+		ssize_t ret = write(fd, buf, len);
+		if(ret == -1){
+			fprintf(stderr, "error: writing to shell failed(%d) --- %s\n", errno, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		buf += ret;
+		len -= ret;
+	}
+}
+
+// reads one reply line from the socket into line, buffered bytes are kept in buf
+static void read_line(int fd, char *buf, size_t *len, char *line, size_t sz){
+
+	char *nl;
+
+	while((nl = memchr(buf, '\n', *len)) == NULL){
+
+		ssize_t ret = read(fd, buf + *len, CTL_LINE_LEN - *len);
+		if(ret <= 0){
+			fprintf(stderr, "error: shell closed the control socket\n");
+			exit(EXIT_FAILURE);
+		}
+		*len += ret;
+	}
+
+	size_t n = nl - buf;
+	snprintf(line, sz, "%.*s", (int)n, buf);
+	*len -= n + 1;
+	memmove(buf, nl + 1, *len);
+}
+
+// reads reply lines until the one ending the reply, returns it in line
+static void read_reply(int fd, char *buf, size_t *len, char *line, size_t sz){
+
+	do{
+		read_line(fd, buf, len, line, sz);
+	}while(strncmp(line, "ok", 2) != 0 && strncmp(line, "error", 5) != 0);
+}
+
+int main(int argc, char *argv[]){
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	char line[CTL_REPLY_LEN];
+	size_t len = 0;
+
+	int topics = argc > 2 ? atoi(argv[2]) : BENCH_TOPICS;
+	int batch = argc > 3 ? atoi(argv[3]) : BENCH_BATCH;
+	const char *ip = argc > 4 ? argv[4] : BENCH_IP;
+
+	if(argc < 2 || topics <= 0 || batch <= 0 || batch > CTL_TOPICS_MAX || strlen(argv[1]) >= sizeof(addr.sun_path)){
+		fprintf(stderr, "usage: %s socket [topics] [batch] [ip]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	strcpy(addr.sun_path, argv[1]);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd == -1 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1){
+		fprintf(stderr, "error: connecting to shell at %s failed(%d) --- %s\n", argv[1], errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	// replies of many batches can not outrun the timeout
+	struct timeval tv = { BENCH_WAIT_SEC, 0 };
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	char *buf = malloc(CTL_LINE_LEN);
+	char *cmd = malloc(CTL_LINE_LEN);
+	int batches = (topics + batch - 1) / batch;
+	int *cids = malloc(batches * sizeof(int));
+	int *cnts = malloc(batches * sizeof(int));
+
+	// every batch is sent before any reply is read, the shell subscribes them side by side
+	double start = now_ns();
+	for(int b = 0; b < batches; b++){
+
+		int n = snprintf(cmd, CTL_LINE_LEN, "connect -w %s", ip);
+		for(int t = b * batch; t < topics && t < (b + 1) * batch; t++){
+			n += snprintf(cmd + n, CTL_LINE_LEN - n, " bench/ctl/%d", t);
+		}
+		n += snprintf(cmd + n, CTL_LINE_LEN - n, "\n");
+		send_all(fd, cmd, n);
+	}
+
+	int ok = 0, failed = 0, timeouts = 0;
+	double first_ms = 0, sum_ms = 0;
+
+	for(int b = 0; b < batches; b++){
+
+		int cid, cnt, s = 0, f = 0;
+		double ms = 0;
+
+		read_reply(fd, buf, &len, line, sizeof(line));
+		if(b == 0) first_ms = (now_ns() - start) / 1e6;
+
+		if(sscanf(line, "ok %d %d subscribed %d failed %d %lf ms", &cid, &cnt, &s, &f, &ms) == 5){
+			cids[b] = cid;
+			cnts[b] = cnt;
+		}
+		else if(sscanf(line, "error %d %d timed out subscribed %d failed %d %lf ms", &cid, &cnt, &s, &f, &ms) == 5){
+			cids[b] = cid;
+			cnts[b] = cnt;
+			timeouts++;
+		}
+		else{
+			fprintf(stderr, "error: shell replied: %s\n", line);
+			cids[b] = cnts[b] = 0;
+		}
+		ok += s;
+		failed += f;
+		sum_ms += ms;
+	}
+	double total_ms = (now_ns() - start) / 1e6;
+
+	fprintf(stdout, "%d topics in %d batches of %d on %s\n", topics, batches, batch, ip);
+	fprintf(stdout, "subscribed %d, failed %d, batches timed out %d\n", ok, failed, timeouts);
+	fprintf(stdout, "all subscriptions online   %9.1f ms  %8.0f subscriptions/s\n", total_ms, ok / total_ms * 1e3);
+	fprintf(stdout, "first batch answered       %9.1f ms\n", first_ms);
+	fprintf(stdout, "mean batch in the shell    %9.1f ms\n", sum_ms / batches);
+
+	// clients are listed the way scripts check them
+	double t0 = now_ns();
+	send_all(fd, "list\n", 5);
+	read_reply(fd, buf, &len, line, sizeof(line));
+	fprintf(stdout, "list                       %9.1f ms  %s\n", (now_ns() - t0) / 1e6, line);
+
+	// subscriptions are removed in batches too, unknown ids of failed topics are only reported
+	t0 = now_ns();
+	for(int b = 0; b < batches; b++){
+
+		int n = snprintf(cmd, CTL_LINE_LEN, "disconnect");
+		for(int c = 0; c < cnts[b]; c++){
+			n += snprintf(cmd + n, CTL_LINE_LEN - n, " %d", cids[b] + c);
+		}
+		n += snprintf(cmd + n, CTL_LINE_LEN - n, "\n");
+		send_all(fd, cmd, n);
+	}
+	int gone = 0;
+	for(int b = 0; b < batches; b++){
+
+		int cnt = 0;
+		read_reply(fd, buf, &len, line, sizeof(line));
+		sscanf(line, "ok %d", &cnt);
+		gone += cnt;
+	}
+	fprintf(stdout, "disconnect requests        %9.1f ms  %d clients\n", (now_ns() - t0) / 1e6, gone);
+
+	free(cnts);
+	free(cids);
+	free(cmd);
+	free(buf);
+	close(fd);
+
+	return failed == 0 && timeouts == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
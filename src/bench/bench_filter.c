@@ -0,0 +1,117 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_filter.c
+ * @brief: measures publish reduction and cpu cost per reading of sensor filter chains
+ * @note: readings of two signals: a slowly drifting noisy temperature quantized like a real sensor,
+ *	  and uniform random values like sensor simulator, which no filter should cut much
+*/
+
+
+#include"sensor_filter.h"
+#include<time.h>
+
+#define CHANNELS	100		// channels of the sensor, readings are "channel:value"
+#define READINGS	200000		// readings of one signal
+#define ROUNDS		5		// passes over the readings
+#define PERIOD_NS	100000000LL	// time between readings of one channel(ns)
+#define DATA_LEN	48		// reading written by the sensor
+
+static char s_data[READINGS][DATA_LEN];
+
+static const char *s_chains[] = {
+	"",
+	"deadband:0.2",
+	"deadband:1%",
+	"deadband:0.2,heartbeat:10",
+	"decim:10",
+	"avg:8,deadband:0.2",
+	"median:5,deadband:0.2",
+	"median:5,avg:8,deadband:0.1,heartbeat:30",
+};
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// returns uniform random number in [0, 1)
+static double uniform(void){
+
+	return rand() / (RAND_MAX + 1.0);
+}
+
+// writes readings of the drifting temperature, or of uniform integers when simulated is set
+static void make_readings(int simulated){
+
+	srand(1);
+	for(int n = 0; n < READINGS; n++){
+
+		int c = n % CHANNELS;
+		double t = (double)(n / CHANNELS) * PERIOD_NS / 1e9;
+
+		memset(s_data[n], 0, DATA_LEN);
+		if(simulated){
+			snprintf(s_data[n], DATA_LEN, "%d:%d", c, 10 + rand() % 21);
+			continue;
+		}
+
+		// sum of uniforms is close enough to gaussian noise of sd 0.05
+		double noise = (uniform() + uniform() + uniform() - 1.5) * 0.1;
+		double v = 20 + c * 0.1 + 2 * sin(t / 600 + c) + noise;
+		snprintf(s_data[n], DATA_LEN, "%d:%.1f", c, v);
+	}
+}
+
+// runs readings through chain and prints its publish reduction and ns per reading
+static void run(const char *signal, const char *chain){
+
+	struct sensor_filter f;
+	char data[DATA_LEN];
+	double spent = 0;
+
+	if(sensor_filter_init(&f, chain) == -1){
+		exit(EXIT_FAILURE);
+	}
+
+	for(int r = 0; r < ROUNDS; r++){
+
+		// every round starts with fresh channels so reduction is the same each round
+		sensor_filter_free(&f);
+		sensor_filter_init(&f, chain);
+
+		double t0 = now_ns();
+		for(int n = 0; n < READINGS; n++){
+
+			memcpy(data, s_data[n], DATA_LEN);
+			sensor_filter_apply(&f, data, DATA_LEN, (int64_t)(n / CHANNELS) * PERIOD_NS);
+		}
+		spent += now_ns() - t0;
+	}
+
+	fprintf(stdout, "%-8s %-42s %6.1f%% %7.1f ns\n", signal, chain[0] ? chain : "(parse only)",
+			100.0 * (f.seen - f.passed) / f.seen, spent / ((double)ROUNDS * READINGS));
+	sensor_filter_free(&f);
+}
+
+int main(void){
+
+	int chains = sizeof(s_chains) / sizeof(s_chains[0]);
+
+	fprintf(stdout, "%d readings on %d channels, one per channel every %lld ms\n",
+			READINGS, CHANNELS, PERIOD_NS / 1000000);
+	fprintf(stdout, "%-8s %-42s %7s %10s\n", "SIGNAL", "CHAIN", "CUT", "PER READ");
+
+	make_readings(0);
+	for(int i = 0; i < chains; i++){
+		run("drift", s_chains[i]);
+	}
+	make_readings(1);
+	for(int i = 0; i < chains; i++){
+		run("uniform", s_chains[i]);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_log.c
+ * @brief: compares direct log writes with the asynchronous log writer
+ * @note: usage: bench_log [msgs/s] [path], log files are removed afterwards
+*/
+
+
+#include"shell_log.h"
+
+#define BENCH_SECONDS	2		// duration of one run
+#define BENCH_RATE	100000		// default messages per second
+#define BENCH_PATH	"bench_log.txt"
+#define BENCH_ROTATE	(1 << 20)	// rotation size used by the benchmark
+#define LAT_MAX		(1 << 24)	// maximum amount of measured messages
+#define LOG_MSG_LEN	80		// same as the shell
+
+static double *s_lat;
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b){
+
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+// removes log file and its rotated copies
+static void remove_logs(const char *path){
+
+	char name[PATH_MAX];
+
+	unlink(path);
+	for(int i = 1; i <= LOG_KEEP; i++){
+		snprintf(name, sizeof(name), "%s.%d", path, i);
+		unlink(name);
+	}
+}
+
+// prints results of one run
+static void report(const char *name, long n, long bytes, long dropped, double secs){
+
+	long m = n < LAT_MAX ? n : LAT_MAX;
+	qsort(s_lat, m, sizeof(double), cmp_double);
+
+	fprintf(stdout, "%-14s %8ld msgs  %7.1f MB/s  dropped %-6ld producer p50 %.2f us  p99 %.2f us  max %.1f us\n",
+		name, n, bytes / secs / 1e6, dropped, s_lat[m / 2], s_lat[m * 99 / 100], s_lat[m - 1]);
+}
+
+// sends messages at rate through fn, returns amount of sent messages
+static long produce(long rate, void (*fn)(void*, const char*), void *arg, double *secs){
+
+	char msg[LOG_MSG_LEN];
+	double start = now_ns();
+	long n = 0;
+
+	while(now_ns() - start < BENCH_SECONDS * 1e9){
+
+		// pace without entering the kernel
+		if(rate > 0){
+			while(now_ns() < start + n * (1e9 / rate));
+		}
+
+		snprintf(msg, sizeof(msg), "client %ld(%d) data received: %ld\n", n % 1000, 4000 + (int)(n % 1000), n);
+
+		double t = now_ns();
+		fn(arg, msg);
+		if(n < LAT_MAX){
+			s_lat[n] = (now_ns() - t) / 1000.0;
+		}
+		n++;
+	}
+	*secs = (now_ns() - start) / 1e9;
+	return n;
+}
+
+// old logging: one write per message
+static long s_direct_bytes;
+static int s_direct_sync;
+
+static void direct_write(void *arg, const char *msg){
+
+	int fd = *(int*)arg;
+	int len = strlen(msg);
+
+	if(write(fd, msg, len) == len){
+		s_direct_bytes += len;
+	}
+	if(s_direct_sync){
+		fdatasync(fd);
+	}
+}
+
+static void async_write(void *arg, const char *msg){
+
+	shell_log_write(arg, msg);
+}
+
+// runs direct logging
+static void run_direct(const char *name, const char *path, long rate, int sync){
+
+	double secs;
+
+	int fd = open(path, O_CREAT | O_APPEND | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR);
+	if(fd < 0){
+		fprintf(stderr, "error: opening log file failed(%d) --- %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	s_direct_bytes = 0;
+	s_direct_sync = sync;
+	long n = produce(rate, direct_write, &fd, &secs);
+	close(fd);
+
+	report(name, n, s_direct_bytes, 0, secs);
+	remove_logs(path);
+}
+
+// runs asynchronous logging, bytes are counted after the writer has finished
+static void run_async(const char *name, const char *path, long rate, enum log_sync sync){
+
+	struct shell_log log;
+	struct shell_log_cfg cfg = { path, LOG_FLUSH_MS, sync, BENCH_ROTATE, 0 };
+	double secs;
+
+	remove_logs(path);
+	shell_log_open(&log, &cfg);
+	long n = produce(rate, async_write, &log, &secs);
+
+	double start = now_ns();
+	shell_log_close(&log);
+	secs += (now_ns() - start) / 1e9;
+
+	report(name, n, log.bytes, log.drops, secs);
+	remove_logs(path);
+}
+
+int main(int argc, char *argv[]){
+
+	long rate = argc > 1 ? atol(argv[1]) : BENCH_RATE;
+	const char *path = argc > 2 ? argv[2] : BENCH_PATH;
+
+	s_lat = malloc(LAT_MAX * sizeof(double));
+	if(s_lat == NULL){
+		fprintf(stderr, "error: allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(stdout, "%ld msgs/s for %d s, rotating every %d bytes\n", rate, BENCH_SECONDS, BENCH_ROTATE);
+
+	run_direct("direct", path, rate, 0);
+	run_async("async", path, rate, LOG_SYNC_NONE);
+	run_direct("direct+sync", path, rate, 1);
+	run_async("async+sync", path, rate, LOG_SYNC_DATA);
+
+	free(s_lat);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_loop.c
+ * @brief: measures ingest throughput and command latency of the shell event loop under a message flood
+*/
+
+
+#include"shell.h"
+#include<pthread.h>
+#include<time.h>
+
+#define BENCH_SECONDS	3		// duration of the benchmark
+#define CMD_INTERVAL_US	5000		// interval of simulated user commands
+#define CMD_MAX		4096		// maximum amount of measured commands
+
+static volatile int s_running = 1;
+static long s_records = 0;
+static double s_cmd_lat[CMD_MAX];
+static int s_cmd_cnt = 0;
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// floods the pipe with client records like many clients would
+static void *flood_writer(void *arg){
+
+	int fd = *(int*)arg;
+	char rec[PROTO_RECORD_MAX];
+	struct client_value value = { VALUE_INT, 25, 25 };
+	int len = proto_put_data(rec, 7, &value, "25", 2);
+
+	while(s_running){
+		if(write(fd, rec, len) == -1) break;
+	}
+	return NULL;
+}
+
+// writes a command line holding its send time at fixed intervals
+static void *cmd_writer(void *arg){
+
+	int fd = *(int*)arg;
+	char line[32];
+
+	while(s_running){
+
+		int len = snprintf(line, sizeof(line), "%.0f\n", now_ns());
+		if(write(fd, line, len) == -1) break;
+		usleep(CMD_INTERVAL_US);
+	}
+	return NULL;
+}
+
+static void count_record(const struct proto_hdr *hdr, const char *body, void *arg){
+
+	(void)hdr;
+	(void)body;
+	(void)arg;
+	s_records++;
+}
+
+// drains records like shell_ingest does but without printing and logging
+static void on_pipe(int fd, uint32_t events, void *arg){
+
+	static struct proto_reader rd;
+
+	(void)events;
+	(void)arg;
+	shell_proto_read(fd, &rd, SHELL_INGEST_BUDGET, count_record, NULL);
+}
+
+// measures time from command write to its handling
+static void on_cmd(int fd, uint32_t events, void *arg){
+
+	char buf[256];
+	double now = now_ns();
+
+	(void)events;
+	(void)arg;
+
+	int ret = read(fd, buf, sizeof(buf) - 1);
+	if(ret <= 0) return;
+	buf[ret] = '\0';
+
+	for(char *line = strtok(buf, "\n"); line != NULL; line = strtok(NULL, "\n")){
+		if(s_cmd_cnt < CMD_MAX){
+			s_cmd_lat[s_cmd_cnt++] = (now - strtod(line, NULL)) / 1000.0;
+		}
+	}
+}
+
+static int cmp_double(const void *a, const void *b){
+
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+int main(void){
+
+	struct shell_loop loop;
+	int data[2], cmd[2];
+
+	if(pipe(data) == -1 || pipe(cmd) == -1){
+		fprintf(stderr, "error: pipe creation failed(%d) --- %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	shell_set_nonblock(data[0]);
+
+	shell_loop_init(&loop);
+	struct shell_loop_handler data_h = { data[0], on_pipe, NULL };
+	struct shell_loop_handler cmd_h = { cmd[0], on_cmd, NULL };
+	shell_loop_add(&loop, &data_h, EPOLLIN);
+	shell_loop_add(&loop, &cmd_h, EPOLLIN);
+
+	pthread_t flood, user;
+	pthread_create(&flood, NULL, flood_writer, &data[1]);
+	pthread_create(&user, NULL, cmd_writer, &cmd[1]);
+
+	double start = now_ns();
+	while(now_ns() - start < BENCH_SECONDS * 1e9){
+		shell_loop_run_once(&loop, 100);
+	}
+	double secs = (now_ns() - start) / 1e9;
+
+	s_running = 0;
+	close(data[0]);
+	close(cmd[0]);
+	pthread_join(flood, NULL);
+	pthread_join(user, NULL);
+
+	qsort(s_cmd_lat, s_cmd_cnt, sizeof(double), cmp_double);
+
+	fprintf(stdout, "ingest: %.0f records/s\n", s_records / secs);
+	if(s_cmd_cnt > 0){
+		fprintf(stdout, "command latency under flood: p50 %.1f us  p99 %.1f us  max %.1f us (%d commands)\n",
+			s_cmd_lat[s_cmd_cnt / 2], s_cmd_lat[s_cmd_cnt * 99 / 100], s_cmd_lat[s_cmd_cnt - 1], s_cmd_cnt);
+	}
+
+	shell_loop_close(&loop);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,302 @@
+#!/bin/sh
+
+# file: bench_pipeline.sh
+# runs sensor clients through a local broker into the shell and measures the whole pipeline:
+# readings/s, latency percentiles of traced readings, cpu and rss of every kind of process,
+# mqtt connections the broker serves: every sensor client has one, the shell one per broker
+# results are written as a flat json object, a previous result can be given as baseline
+#
+# usage: ./bench_pipeline.sh [-n sensors] [-m topics per sensor] [-r readings/s per sensor]
+#                            [-d seconds] [-w warmup seconds] [-o result.json]
+#                            [-b baseline.json] [-t tolerance %] [-f sensor filter]
+#                            [-a shell aggregation window] [-q qos] [-i in-flight window]
+# needs mosquitto and built shell, shell client, sensor client and sensor simulator
+# exits with 1 when a metric is worse than baseline by more than the tolerance
+# readings dropped by the sensor filter(-f, e.g. "deadband:2") are counted as lost by the shell
+# qos(-q) is used by sensors and shell subscriptions alike, run once per qos and compare them with -b
+
+SENSORS=4
+TOPICS_PER=8
+RATE=1000
+DURATION=10
+WARMUP=2
+OUT=bench_pipeline.json
+BASELINE=
+TOLERANCE=10
+FILTER=
+WINDOW=
+QOS=0
+INFLIGHT=20
+
+while getopts "n:m:r:d:w:o:b:t:f:a:q:i:" opt; do
+	case $opt in
+		n) SENSORS=$OPTARG ;;
+		m) TOPICS_PER=$OPTARG ;;
+		r) RATE=$OPTARG ;;
+		d) DURATION=$OPTARG ;;
+		w) WARMUP=$OPTARG ;;
+		o) OUT=$OPTARG ;;
+		b) BASELINE=$OPTARG ;;
+		t) TOLERANCE=$OPTARG ;;
+		f) FILTER=$OPTARG ;;
+		a) WINDOW=$OPTARG ;;
+		q) QOS=$OPTARG ;;
+		i) INFLIGHT=$OPTARG ;;
+		*) sed -n '9,12p' "$0"; exit 2 ;;
+	esac
+done
+
+SRC=$(cd "$(dirname "$0")/.." && pwd)
+SHELL_BIN=$SRC/shell/shell
+SENSOR=$SRC/client_sensor/sensor_client
+SIMULATOR=$SRC/client_sensor/sensors/sensor_simulator
+BROKER=127.0.0.1
+PORT=1883			# compiled into the clients
+TOPICS=$((SENSORS * TOPICS_PER))
+TOPICS_PER_CLIENT=200		# topics of one connect request, keeps menu line short
+HZ=$(getconf CLK_TCK)
+
+for bin in "$SHELL_BIN" "$SRC/client_shell/shell_client" "$SENSOR" "$SIMULATOR"; do
+	if [ ! -x "$bin" ]; then
+		echo "error: $bin is not built" >&2
+		exit 2
+	fi
+done
+if ! command -v mosquitto >/dev/null; then
+	echo "error: mosquitto broker is not installed" >&2
+	exit 2
+fi
+
+# shell runs in its own directory, it finds shell client through ../client_shell
+WORK=$(mktemp -d)
+mkdir "$WORK/run"
+ln -s "$SRC/client_shell" "$WORK/client_shell"
+
+BROKER_PID=
+SHELL_PID=
+SENSOR_PIDS=
+
+cleanup(){
+	kill $SENSOR_PIDS 2>/dev/null
+	# clients are children of the shell, they are found before it is gone
+	[ -n "$SHELL_PID" ] && pkill -USR1 -P $SHELL_PID 2>/dev/null
+	[ -n "$SHELL_PID" ] && kill -9 $SHELL_PID 2>/dev/null
+	[ -n "$BROKER_PID" ] && kill $BROKER_PID 2>/dev/null
+	wait 2>/dev/null
+	rm -rf "$WORK"
+}
+trap cleanup EXIT
+trap 'exit 2' INT TERM
+
+# returns monotonic seconds
+now(){
+	awk '{print $1}' /proc/uptime
+}
+
+# prints cpu time(ticks) of processes
+proc_cpu(){
+	for pid in "$@"; do
+		awk '{print $14 + $15}' /proc/$pid/stat 2>/dev/null
+	done | awk '{s += $1} END {print s + 0}'
+}
+
+# prints peak rss(kB) of processes
+proc_rss(){
+	for pid in "$@"; do
+		awk '/VmHWM/ {print $2}' /proc/$pid/status 2>/dev/null
+	done | awk '{s += $1} END {print s + 0}'
+}
+
+# prints established tcp connections to the broker port, counted on the broker side
+broker_conns(){
+	port=$(printf '%04X' $PORT)
+	cat /proc/net/tcp /proc/net/tcp6 2>/dev/null |
+		awk -v p=":$port" '$4 == "01" && substr($2, length($2) - 4) == p {n++} END {print n + 0}'
+}
+
+# opens the shell menu and enters lines
+menu(){
+	kill -INT $SHELL_PID
+	sleep 0.2
+	for line in "$@"; do
+		echo "$line" >&4
+		sleep 0.1
+	done
+}
+
+# asks shell for latencies and prints the all topics block: received lost reordered, then hops
+latency_snapshot(){
+	menu 8
+	# opening the menu again flushes shell output
+	menu 5
+	awk '/^all topics: received/ { blk = $4 " " $6 " " $8 "\n"; want = 6; next }
+	     want > 0 { want--; if($1 != "HOP") blk = blk $0 "\n" }
+	     END { printf "%s", blk }' "$WORK/shell.out"
+}
+
+# processes of every kind, sensor simulators are children of sensor clients
+pids_of(){
+	case $1 in
+		shell) echo $SHELL_PID ;;
+		shell_client) pgrep -x shell_client ;;
+		sensor_client) echo $SENSOR_PIDS ;;
+		sensor_simulator) for p in $SENSOR_PIDS; do pgrep -P $p; done ;;
+		broker) echo $BROKER_PID ;;
+	esac
+}
+KINDS="shell shell_client sensor_client sensor_simulator broker"
+
+# local broker on loopback only
+cat > "$WORK/mosquitto.conf" <<EOF
+listener $PORT $BROKER
+allow_anonymous true
+EOF
+mosquitto -c "$WORK/mosquitto.conf" >"$WORK/broker.out" 2>&1 &
+BROKER_PID=$!
+sleep 0.5
+if ! kill -0 $BROKER_PID 2>/dev/null; then
+	echo "error: broker did not start, is port $PORT in use?" >&2
+	cat "$WORK/broker.out" >&2
+	exit 2
+fi
+
+# shell reads the menu from a fifo
+mkfifo "$WORK/in"
+(cd "$WORK/run" && exec "$SHELL_BIN" -s "$WORK/tsdb" ${WINDOW:+-a $WINDOW} <"$WORK/in" >"$WORK/shell.out" 2>&1) &
+SHELL_PID=$!
+exec 4>"$WORK/in"
+sleep 0.3
+
+# subscribe every topic: sensor i publishes bench/i, or bench/i/channel with many topics
+SUFFIX=
+[ "$QOS" -gt 0 ] && SUFFIX=",qos:$QOS"
+topics=""
+cnt=0
+i=0
+while [ $i -lt $SENSORS ]; do
+	c=0
+	while [ $c -lt $TOPICS_PER ]; do
+		if [ $TOPICS_PER -eq 1 ]; then topics="$topics bench/$i$SUFFIX"; else topics="$topics bench/$i/$c$SUFFIX"; fi
+		cnt=$((cnt + 1))
+		if [ $cnt -eq $TOPICS_PER_CLIENT ]; then
+			menu 6 $BROKER "$topics"
+			topics=""
+			cnt=0
+		fi
+		c=$((c + 1))
+	done
+	i=$((i + 1))
+done
+[ -n "$topics" ] && menu 6 $BROKER "$topics"
+
+tries=0
+while [ "$(grep -c 'subscribed to topic' "$WORK/shell.out")" -lt $TOPICS ]; do
+	tries=$((tries + 1))
+	if [ $tries -gt 100 ]; then
+		echo "error: shell did not subscribe all $TOPICS topics" >&2
+		exit 2
+	fi
+	sleep 0.1
+done
+
+# sensors run past the measurement so they are still alive at the last sample
+i=0
+while [ $i -lt $SENSORS ]; do
+	"$SENSOR" ${FILTER:+-f "$FILTER"} -q $QOS -i $INFLIGHT "$SIMULATOR" $BROKER bench/$i -r $RATE -c $TOPICS_PER -t -s $i -d $((WARMUP + DURATION + 2)) \
+		>/dev/null 2>"$WORK/sensor_$i.err" &
+	SENSOR_PIDS="$SENSOR_PIDS $!"
+	i=$((i + 1))
+done
+
+sleep $WARMUP
+t0=$(now)
+recv0=$(latency_snapshot | awk 'NR == 1 {print $1}')
+for kind in $KINDS; do
+	eval "cpu0_$kind=$(proc_cpu $(pids_of $kind))"
+done
+
+sleep $DURATION
+
+t1=$(now)
+latency_snapshot > "$WORK/latency"
+for kind in $KINDS; do
+	pids=$(pids_of $kind)
+	eval "cpu1_$kind=$(proc_cpu $pids)"
+	eval "rss_$kind=$(proc_rss $pids)"
+	eval "cnt_$kind=$(echo $pids | wc -w)"
+done
+conns=$(broker_conns)
+
+wait $SENSOR_PIDS 2>/dev/null
+SENSOR_PIDS=
+offered=$(cat "$WORK"/sensor_*.err | awk '/achieved/ { for(i = 1; i < NF; i++) if($i == "achieved") s += $(i + 1) } END {print s + 0}')
+dropped=$(cat "$WORK"/sensor_*.err | awk '/dropped/ {s += $2} END {print s + 0}')
+filtered=$(cat "$WORK"/sensor_*.err | awk '/filter passed/ {p += $4; n += $6} END {printf "%.1f", n ? 100 * (n - p) / n : 0}')
+
+# terminate the shell, it waits for its clients
+menu 1
+wait $SHELL_PID 2>/dev/null
+SHELL_PID=
+
+# flat json, one metric per line
+{
+	echo "{"
+	echo "  \"sensors\": $SENSORS,"
+	echo "  \"topics\": $TOPICS,"
+	echo "  \"rate_per_sensor\": $RATE,"
+	echo "  \"duration_s\": $DURATION,"
+	echo "  \"qos\": $QOS,"
+	echo "  \"inflight_window\": $INFLIGHT,"
+	echo "  \"offered_msgs_per_s\": $offered,"
+	echo "  \"sensor_dropped\": $dropped,"
+	echo "  \"sensor_filtered_pct\": $filtered,"
+	echo "  \"broker_connections\": $conns,"
+	echo "  \"shell_connections\": $((conns - SENSORS)),"
+	awk -v t0=$t0 -v t1=$t1 -v r0=${recv0:-0} 'NR == 1 {
+		printf "  \"received_msgs_per_s\": %.1f,\n", ($1 - r0) / (t1 - t0)
+		printf "  \"received\": %d,\n  \"lost\": %d,\n  \"reordered\": %d,\n", $1, $2, $3
+	}
+	NR > 1 {
+		printf "  \"latency_%s_p50_us\": %s,\n  \"latency_%s_p90_us\": %s,\n", $1, $2, $1, $3
+		printf "  \"latency_%s_p99_us\": %s,\n  \"latency_%s_p999_us\": %s,\n", $1, $4, $1, $5
+		printf "  \"latency_%s_max_us\": %s,\n", $1, $6
+	}' "$WORK/latency"
+	for kind in $KINDS; do
+		eval "c0=\$cpu0_$kind c1=\$cpu1_$kind rss=\$rss_$kind n=\$cnt_$kind"
+		echo "  \"${kind}_processes\": $n,"
+		awk -v k=$kind -v c=$((c1 - c0)) -v hz=$HZ -v t0=$t0 -v t1=$t1 \
+			'BEGIN { printf "  \"%s_cpu_pct\": %.1f,\n", k, 100 * c / hz / (t1 - t0) }'
+		echo "  \"${kind}_rss_kb\": $rss,"
+	done
+	echo "  \"ok\": 1"
+	echo "}"
+} > "$OUT"
+
+cat "$OUT"
+
+[ -z "$BASELINE" ] && exit 0
+
+# compares metrics with baseline: throughput should not drop, latency and cpu should not grow
+# maximum and p99.9 latencies are shown but not judged, they are single outliers
+awk -v tol=$TOLERANCE '
+	function value(line){ sub(/^[^:]*: */, "", line); sub(/,$/, "", line); return line + 0 }
+	function key(line){ sub(/^ *"/, "", line); sub(/".*/, "", line); return line }
+	FNR == NR && /": / { base[key($0)] = value($0); next }
+	/": / { k = key($0); cur[k] = value($0); order[n++] = k }
+	END {
+		bad = 0
+		printf "\n%-32s %12s %12s %8s\n", "metric", "baseline", "current", "change"
+		for(i = 0; i < n; i++){
+			k = order[i]
+			if(!(k in base) || base[k] == 0) continue
+			if(k ~ /msgs_per_s$/) worse = -1
+			else if(k ~ /(_us|_cpu_pct|_rss_kb|_connections)$/) worse = 1
+			else continue
+			change = 100 * (cur[k] - base[k]) / base[k]
+			judged = k !~ /_(max|p999)_us$/ && !(k ~ /_cpu_pct$/ && base[k] < 1 && cur[k] < 1)
+			flag = judged && change * worse > tol ? "  REGRESSION" : ""
+			if(flag != "") bad = 1
+			printf "%-32s %12g %12g %7.1f%%%s\n", k, base[k], cur[k], change, flag
+		}
+		exit bad
+	}' "$BASELINE" "$OUT"
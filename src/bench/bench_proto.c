@@ -0,0 +1,125 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_proto.c
+ * @brief: compares bytes and messages per second over a pipe for whole client_info structs and data records
+*/
+
+
+#include"shell_proto.h"
+#include<pthread.h>
+#include<time.h>
+
+#define BENCH_MSGS	5000000		// messages sent in each mode
+#define STRUCT_BATCH	64		// structs read at once in struct mode
+
+static int s_mode_records = 0;		// writer sends records instead of structs
+static long s_handled = 0;
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// sends messages like a shell client does, one write per message
+static void *writer(void *arg){
+
+	int fd = *(int*)arg;
+	struct client_info info = {0};
+	char rec[PROTO_RECORD_MAX];
+	struct client_value value = { VALUE_INT, 25, 25 };
+
+	info.id = 7;
+	info.pid = 1234;
+	info.status = CLIENT_DATA_READY;
+	strcpy(info.ip, "127.0.0.1");
+	strcpy(info.topic, "site/room/temp");
+	strcpy(info.data, "25");
+
+	for(long i = 0; i < BENCH_MSGS; i++){
+
+		int ret;
+		if(s_mode_records){
+			int len = proto_put_data(rec, info.id, &value, info.data, strlen(info.data));
+			ret = write(fd, rec, len);
+		}
+		else{
+			ret = write(fd, &info, sizeof(info));
+		}
+		if(ret == -1) break;
+	}
+	close(fd);
+	return NULL;
+}
+
+static void count_record(const struct proto_hdr *hdr, const char *body, void *arg){
+
+	(void)hdr;
+	(void)body;
+	(void)arg;
+	s_handled++;
+}
+
+// runs one mode and prints its figures
+static void bench_mode(int records){
+
+	int fds[2];
+	pthread_t th;
+	long bytes = 0;
+
+	if(pipe(fds) == -1){
+		fprintf(stderr, "error: pipe creation failed(%d) --- %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	s_mode_records = records;
+	s_handled = 0;
+
+	double start = now_ns();
+	pthread_create(&th, NULL, writer, &fds[1]);
+
+	if(records){
+
+		static struct proto_reader rd;
+		shell_proto_init(&rd);
+
+		// blocking fd: every read returns some data until writer closes
+		while(1){
+			int ret = read(fds[0], rd.buf + rd.len, PROTO_READER_LEN - rd.len);
+			if(ret <= 0) break;
+			bytes += ret;
+			rd.len += ret;
+			shell_proto_parse(&rd, count_record, NULL);
+		}
+	}
+	else{
+
+		static struct client_info infos[STRUCT_BATCH];
+
+		while(1){
+			int ret = read(fds[0], infos, sizeof(infos));
+			if(ret <= 0) break;
+			bytes += ret;
+			s_handled += ret / sizeof(struct client_info);
+		}
+	}
+
+	double secs = (now_ns() - start) / 1e9;
+	pthread_join(th, NULL);
+	close(fds[0]);
+
+	fprintf(stdout, "%-16s %5.1f bytes/msg  %10.0f msgs/s  %7.1f MB/s  (%ld msgs)\n",
+		records ? "data records" : "client_info", (double)bytes / s_handled,
+		s_handled / secs, bytes / secs / 1e6, s_handled);
+}
+
+int main(void){
+
+	bench_mode(0);
+	bench_mode(1);
+
+	return EXIT_SUCCESS;
+}
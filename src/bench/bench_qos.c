@@ -0,0 +1,233 @@
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_qos.c
+ * @brief: compares throughput and latency of qos 0, 1 and 2 for in-flight windows of sensor client
+ * @note: sensor thread writes readings through the publish path of sensor client, a subscriber of the
+ *	  same qos on its own connection counts them. throughput run writes readings as fast as the pipe
+ *	  takes them and ends once every message in flight is acknowledged, latency run writes traced
+ *	  readings at a steady rate and takes publish to receive time of each one
+ *	  usage: bench_qos [broker ip] [readings/s of latency run], needs a running broker
+*/
+
+
+#include"sensor_client.h"
+#include<time.h>
+
+#define BENCH_TOPIC		"bench/qos"
+#define THROUGHPUT_READINGS	200000		// readings of a throughput run
+#define LATENCY_SECONDS		3		// length of a latency run
+#define LATENCY_RATE		2000		// default readings/s of a latency run
+#define RECEIVE_WAIT_MS		3000		// longest wait for the subscriber to get every reading
+
+static const int s_windows[] = { 1, 20, 100, 1000 };
+
+// subscriber counting readings and their latencies
+struct bench_sub{
+
+	struct mosquitto	*mosq;			// connection of the subscriber
+	volatile int		subscribed;		// broker acknowledged the subscription
+	volatile long		received;		// readings received
+	double			*lat_us;		// publish to receive time of traced readings
+	long			lat_cnt;		// amount of them
+	long			lat_cap;		// room of lat_us
+};
+
+static long s_readings;				// readings the sensor writes
+static int s_rate;				// readings/s of the sensor, 0 as fast as possible
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// subscribe callback of the subscriber
+static void sub_cb_subscribe(struct mosquitto *mosq, void *obj, int mid, int qos_count, const int *granted_qos){
+
+	(void)mosq; (void)mid; (void)qos_count; (void)granted_qos;
+	((struct bench_sub*)obj)->subscribed = 1;
+}
+
+// message callback of the subscriber, traced reading "value;seq;t0;t1;t2" gets its latency taken
+static void sub_cb_message(struct mosquitto *mosq, void *obj, const struct mosquitto_message *msg){
+
+	struct bench_sub *sub = obj;
+	char buf[PUB_DATA_LEN];
+	long long t0, t1, t2;
+	unsigned long seq;
+	int value;
+
+	(void)mosq;
+	int len = msg->payloadlen < (int)sizeof(buf) - 1 ? msg->payloadlen : (int)sizeof(buf) - 1;
+	memcpy(buf, msg->payload, len);
+	buf[len] = '\0';
+
+	if(sscanf(buf, "%d;%lu;%lld;%lld;%lld", &value, &seq, &t0, &t1, &t2) == 5 && sub->lat_cnt < sub->lat_cap){
+		sub->lat_us[sub->lat_cnt++] = (client_mono_ns() - t2) / 1e3;
+	}
+	sub->received++;
+}
+
+// sensor writing readings at the rate, or as fast as the pipe takes them, closes the pipe when done
+static void *bench_sensor(void *arg){
+
+	int fd = *(int*)arg;
+	char data[SENSOR_DATA_LEN] = {0};
+	double start = now_ns();
+
+	for(long n = 0; n < s_readings; n++){
+
+		if(s_rate > 0){
+
+			double due = start + n * 1e9 / s_rate;
+			while(now_ns() < due) usleep(100);
+			snprintf(data, sizeof(data), "%ld;%ld;%lld", n % 100, n, (long long)client_mono_ns());
+		}
+		else{
+			snprintf(data, sizeof(data), "%ld", n % 100);
+		}
+		if(write(fd, data, sizeof(data)) == -1) break;
+	}
+	close(fd);
+	return NULL;
+}
+
+// compares doubles for qsort
+static int cmp_double(const void *a, const void *b){
+
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+// returns percentile p of sorted values
+static double percentile(const double *v, long cnt, double p){
+
+	return cnt > 0 ? v[(long)(p * (cnt - 1))] : 0;
+}
+
+// subscribes the topic with qos on a connection of its own
+static void sub_start(struct bench_sub *sub, const char *ip, int qos){
+
+	sub->mosq = mosquitto_new(NULL, true, sub);
+	if(sub->mosq == NULL || mosquitto_connect(sub->mosq, ip, PORT, PING) != MOSQ_ERR_SUCCESS){
+		fprintf(stderr, "error: subscriber unable to connect to broker %s\n", ip);
+		exit(EXIT_FAILURE);
+	}
+	mosquitto_subscribe_callback_set(sub->mosq, sub_cb_subscribe);
+	mosquitto_message_callback_set(sub->mosq, sub_cb_message);
+	mosquitto_subscribe(sub->mosq, NULL, BENCH_TOPIC, qos);
+	mosquitto_loop_start(sub->mosq);
+
+	for(int tries = 0; !sub->subscribed && tries < 200; tries++){
+		usleep(10000);
+	}
+	if(!sub->subscribed){
+		fprintf(stderr, "error: subscriber not subscribed to %s\n", BENCH_TOPIC);
+		exit(EXIT_FAILURE);
+	}
+}
+
+// waits until subscriber received published readings or gave up, then closes its connection
+static void sub_stop(struct bench_sub *sub, long published){
+
+	for(int waited = 0; sub->received < published && waited < RECEIVE_WAIT_MS; waited += 10){
+		usleep(10000);
+	}
+	mosquitto_disconnect(sub->mosq);
+	mosquitto_loop_stop(sub->mosq, false);
+	mosquitto_destroy(sub->mosq);
+}
+
+// publishes readings of one run with qos and window, returns seconds sensor client took
+static double run(const char *ip, int qos, int window, struct bench_sub *sub, long *published){
+
+	int pfd[2];
+	pthread_t sensor;
+
+	sub_start(sub, ip, qos);
+
+	struct mosquitto *mosq = mosquitto_new(NULL, true, NULL);
+	if(mosq == NULL || mosquitto_connect(mosq, ip, PORT, PING) != MOSQ_ERR_SUCCESS){
+		fprintf(stderr, "error: unable to connect to broker %s\n", ip);
+		exit(EXIT_FAILURE);
+	}
+	// acknowledgements free the window, connection messages of the other callbacks are not wanted
+	mosquitto_publish_callback_set(mosq, mqtt_cb_publish);
+	if(pipe(pfd) == -1){
+		fprintf(stderr, "error: pipe creation failed(%d) --- %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	double start = now_ns();
+	pthread_create(&sensor, NULL, bench_sensor, &pfd[1]);
+
+	// returns once every message in flight is acknowledged
+	*published = client_read_and_pub(pfd[0], BENCH_TOPIC, mosq, NULL, NULL, qos, window);
+
+	double secs = (now_ns() - start) / 1e9;
+	pthread_join(sensor, NULL);
+	close(pfd[0]);
+	mosquitto_destroy(mosq);
+
+	sub_stop(sub, *published);
+	return secs;
+}
+
+int main(int argc, char *argv[]){
+
+	const char *ip = argc > 1 ? argv[1] : "127.0.0.1";
+	int rate = argc > 2 ? atoi(argv[2]) : LATENCY_RATE;
+	long published;
+
+	mosquitto_lib_init();
+
+	fprintf(stdout, "throughput, %d readings as fast as possible\n", THROUGHPUT_READINGS);
+	fprintf(stdout, "%-4s %-7s %12s %12s %10s\n", "qos", "window", "published/s", "received/s", "received");
+
+	for(int qos = 0; qos <= QOS_MAX; qos++){
+		for(int w = 0; w < (int)(sizeof(s_windows) / sizeof(s_windows[0])); w++){
+
+			// window has no effect on qos 0, it is run once
+			if(qos == 0 && w > 0) break;
+
+			struct bench_sub sub = {0};
+			s_readings = THROUGHPUT_READINGS;
+			s_rate = 0;
+
+			double secs = run(ip, qos, s_windows[w], &sub, &published);
+			fprintf(stdout, "%-4d %-7d %12.0f %12.0f %10ld\n", qos, qos ? s_windows[w] : 0, published / secs,
+				sub.received / secs, sub.received);
+		}
+	}
+
+	fprintf(stdout, "\nlatency, publish to receive of %d readings/s for %d s\n", rate, LATENCY_SECONDS);
+	fprintf(stdout, "%-4s %-7s %10s %10s %10s %10s %10s\n", "qos", "window", "received", "p50(us)", "p90(us)",
+		"p99(us)", "max(us)");
+
+	for(int qos = 0; qos <= QOS_MAX; qos++){
+
+		struct bench_sub sub = {0};
+		s_readings = (long)rate * LATENCY_SECONDS;
+		s_rate = rate;
+
+		sub.lat_cap = s_readings;
+		sub.lat_us = malloc(sub.lat_cap * sizeof(double));
+		if(sub.lat_us == NULL){
+			fprintf(stderr, "error: allocation failed\n");
+			exit(EXIT_FAILURE);
+		}
+
+		run(ip, qos, PUB_INFLIGHT, &sub, &published);
+		qsort(sub.lat_us, sub.lat_cnt, sizeof(double), cmp_double);
+
+		fprintf(stdout, "%-4d %-7d %10ld %10.0f %10.0f %10.0f %10.0f\n", qos, qos ? PUB_INFLIGHT : 0, sub.received,
+			percentile(sub.lat_us, sub.lat_cnt, 0.5), percentile(sub.lat_us, sub.lat_cnt, 0.9),
+			percentile(sub.lat_us, sub.lat_cnt, 0.99), percentile(sub.lat_us, sub.lat_cnt, 1));
+		free(sub.lat_us);
+	}
+
+	mosquitto_lib_cleanup();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+#!/bin/sh
+
+# file: bench_reconnect.sh
+# measures recovery of subscriptions and sensors from a restart of the local broker
+# shell subscribes every topic from a startup config on one shared connection, one sensor client
+# publishes a reading to every topic at the given rate, then the broker is stopped and started again
+# shell logs per topic when it subscribed again and the gap between its last reading before the
+# restart and the first one after it, sensor client prints how long it was reconnecting
+#
+# usage: ./bench_reconnect.sh [-n topics(2..1000)] [-r readings/s per topic] [-d seconds broker is down]
+# needs mosquitto and built shell, shell client, sensor client and sensor simulator
+
+TOPICS=1000
+RATE=2
+DOWN=1
+WARMUP=2
+RECOVER_S=30			# longest wait for every topic to get readings again
+
+while getopts "n:r:d:" opt; do
+	case $opt in
+		n) TOPICS=$OPTARG ;;
+		r) RATE=$OPTARG ;;
+		d) DOWN=$OPTARG ;;
+		*) sed -n '10p' "$0"; exit 2 ;;
+	esac
+done
+
+SRC=$(cd "$(dirname "$0")/.." && pwd)
+SHELL_BIN=$SRC/shell/shell
+SENSOR=$SRC/client_sensor/sensor_client
+SIMULATOR=$SRC/client_sensor/sensors/sensor_simulator
+BROKER=127.0.0.1
+PORT=1883			# compiled into the clients
+
+for bin in "$SHELL_BIN" "$SRC/client_shell/shell_client" "$SENSOR" "$SIMULATOR"; do
+	if [ ! -x "$bin" ]; then
+		echo "error: $bin is not built" >&2
+		exit 2
+	fi
+done
+if ! command -v mosquitto >/dev/null; then
+	echo "error: mosquitto broker is not installed" >&2
+	exit 2
+fi
+if [ $TOPICS -lt 2 ] || [ $TOPICS -gt 1000 ]; then
+	echo "error: one sensor simulator serves 2..1000 topics" >&2
+	exit 2
+fi
+
+# shell runs in its own directory, it finds shell client through ../client_shell
+WORK=$(mktemp -d)
+mkdir "$WORK/run"
+ln -s "$SRC/client_shell" "$WORK/client_shell"
+
+BROKER_PID=
+SHELL_PID=
+SENSOR_PID=
+
+cleanup(){
+	[ -n "$SENSOR_PID" ] && kill $SENSOR_PID 2>/dev/null
+	# clients are children of the shell, they are found before it is gone
+	[ -n "$SHELL_PID" ] && pkill -USR1 -P $SHELL_PID 2>/dev/null
+	[ -n "$SHELL_PID" ] && kill -9 $SHELL_PID 2>/dev/null
+	[ -n "$BROKER_PID" ] && kill $BROKER_PID 2>/dev/null
+	wait 2>/dev/null
+	rm -rf "$WORK"
+}
+trap cleanup EXIT
+trap 'exit 2' INT TERM
+
+# returns monotonic seconds
+now(){
+	awk '{print $1}' /proc/uptime
+}
+
+# opens the shell menu and enters lines
+menu(){
+	kill -INT $SHELL_PID
+	sleep 0.2
+	for line in "$@"; do
+		echo "$line" >&4
+		sleep 0.1
+	done
+}
+
+# counts lines of the shell log matching a pattern
+logged(){
+	n=$(grep -c "$1" "$WORK/run/log.txt" 2>/dev/null)
+	echo ${n:-0}
+}
+
+# local broker on loopback only, started again after the restart with the same config
+cat > "$WORK/mosquitto.conf" <<EOF
+listener $PORT $BROKER
+allow_anonymous true
+EOF
+start_broker(){
+	mosquitto -c "$WORK/mosquitto.conf" >>"$WORK/broker.out" 2>&1 &
+	BROKER_PID=$!
+	sleep 0.2
+	if ! kill -0 $BROKER_PID 2>/dev/null; then
+		echo "error: broker did not start, is port $PORT in use?" >&2
+		cat "$WORK/broker.out" >&2
+		exit 2
+	fi
+}
+start_broker
+
+# sensor publishes channel c of its simulator to bench/rc/c
+{
+	echo "broker $BROKER"
+	c=0
+	while [ $c -lt $TOPICS ]; do
+		echo "bench/rc/$c"
+		c=$((c + 1))
+	done
+} > "$WORK/topics.conf"
+
+mkfifo "$WORK/in"
+(cd "$WORK/run" && exec "$SHELL_BIN" -C "$WORK/topics.conf" -s "$WORK/tsdb" <"$WORK/in" >"$WORK/shell.out" 2>&1) &
+SHELL_PID=$!
+exec 4>"$WORK/in"
+
+tries=0
+while [ "$(logged 'subscribed to topic bench/rc/')" -lt $TOPICS ]; do
+	tries=$((tries + 1))
+	if [ $tries -gt 100 ]; then
+		echo "error: shell did not subscribe all $TOPICS topics" >&2
+		exit 2
+	fi
+	sleep 0.1
+done
+
+"$SENSOR" "$SIMULATOR" $BROKER bench/rc -r $((RATE * TOPICS)) -c $TOPICS -d $((WARMUP + DOWN + RECOVER_S)) \
+	>"$WORK/sensor.out" 2>"$WORK/sensor.err" &
+SENSOR_PID=$!
+sleep $WARMUP
+
+# broker stops the way a restart does, its clients see the socket closed
+kill $BROKER_PID
+wait $BROKER_PID 2>/dev/null
+t_down=$(now)
+sleep $DOWN
+start_broker
+t_up=$(now)
+
+tries=0
+while [ "$(logged 'readings resumed')" -lt $TOPICS ] && [ $tries -lt $((RECOVER_S * 10)) ]; do
+	tries=$((tries + 1))
+	sleep 0.1
+done
+t_done=$(now)
+
+# sensor client ends when its simulator does, it prints its reconnect time on exit
+pkill -P $SENSOR_PID 2>/dev/null
+wait $SENSOR_PID 2>/dev/null
+SENSOR_PID=
+
+menu 1
+wait $SHELL_PID 2>/dev/null
+SHELL_PID=
+
+# prints count, p50, p99 and max of the numbers in a file
+summary(){
+	sort -n "$2" | awk -v name="$1" '{ t[NR] = $1 }
+		END { if(NR == 0){ printf "%-28s %6d\n", name, 0; exit }
+		      printf "%-28s %6d %10.1f %10.1f %10.1f\n", name, NR, t[int(NR * 0.5 + 0.5)], t[int(NR * 0.99 + 0.5)], t[NR] }'
+}
+
+awk '/subscribed again to/ {print $(NF - 3)}' "$WORK/run/log.txt" > "$WORK/resub"
+awk '/readings resumed after/ {print $(NF - 2)}' "$WORK/run/log.txt" > "$WORK/gap"
+awk '/sensor reconnected after/ {print $(NF - 1)}' "$WORK/sensor.out" > "$WORK/sensor"
+
+echo "$TOPICS topics, $RATE readings/s per topic, broker down $(awk -v a=$t_down -v b=$t_up 'BEGIN {printf "%.0f", (b - a) * 1000}') ms"
+printf "%-28s %6s %10s %10s %10s\n" "" "count" "p50(ms)" "p99(ms)" "max(ms)"
+summary "subscribed again after loss" "$WORK/resub"
+summary "gap of readings" "$WORK/gap"
+summary "sensor reconnected after" "$WORK/sensor"
+echo "every topic back after restart $(awk -v a=$t_up -v b=$t_done 'BEGIN {printf "%.0f", (b - a) * 1000}') ms"
+grep "dropped" "$WORK/sensor.err" || true
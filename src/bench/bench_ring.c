@@ -0,0 +1,224 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_ring.c
+ * @brief: compares syscalls per message and latency of the common pipe and the shared memory ring
+ * @note: syscalls are counted by wrapping them at link time(-Wl,--wrap), see Makefile
+*/
+
+
+#include"shell_ring.h"
+#include<pthread.h>
+#include<time.h>
+
+#define BENCH_SECONDS	3		// duration of one run
+#define BENCH_RATE	100000		// default messages per second sent by the producer
+#define LAT_MAX		(1 << 24)	// maximum amount of measured messages
+#define BENCH_BUDGET	1024		// records handled per event like SHELL_INGEST_BUDGET
+
+// syscall counters of producer and consumer
+static _Atomic long s_prod_calls = 0;
+static _Atomic long s_cons_calls = 0;
+static __thread int s_is_producer = 0;
+
+static volatile int s_running = 1;
+static long s_rate = BENCH_RATE;		// 0 sends as fast as possible
+static long s_sent = 0;
+static long s_recv = 0;
+static double *s_lat;
+
+ssize_t __real_read(int fd, void *buf, size_t cnt);
+ssize_t __real_write(int fd, const void *buf, size_t cnt);
+int __real_epoll_wait(int epfd, struct epoll_event *ev, int max, int timeout);
+int __real_eventfd_read(int fd, eventfd_t *val);
+int __real_eventfd_write(int fd, eventfd_t val);
+
+// counts syscall for the calling side
+static void count_call(void){
+
+	if(s_is_producer) s_prod_calls++;
+	else s_cons_calls++;
+}
+
+ssize_t __wrap_read(int fd, void *buf, size_t cnt){ count_call(); return __real_read(fd, buf, cnt); }
+ssize_t __wrap_write(int fd, const void *buf, size_t cnt){ count_call(); return __real_write(fd, buf, cnt); }
+int __wrap_epoll_wait(int epfd, struct epoll_event *ev, int max, int timeout){ count_call(); return __real_epoll_wait(epfd, ev, max, timeout); }
+int __wrap_eventfd_read(int fd, eventfd_t *val){ count_call(); return __real_eventfd_read(fd, val); }
+int __wrap_eventfd_write(int fd, eventfd_t val){ count_call(); return __real_eventfd_write(fd, val); }
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// spins until the send time of the next message, clock_gettime does not enter the kernel
+static void pace(double start, long n){
+
+	if(s_rate == 0) return;
+
+	double due = start + n * (1e9 / s_rate);
+	while(now_ns() < due);
+}
+
+// sends records holding their send time through the pipe like shell_client does without a ring
+static void *pipe_producer(void *arg){
+
+	int fd = *(int*)arg;
+	char rec[PROTO_RECORD_MAX];
+	struct client_value value = { VALUE_TEXT, 0, 0 };
+	double start = now_ns();
+
+	s_is_producer = 1;
+	while(s_running){
+
+		double ts = now_ns();
+		int len = proto_put_data(rec, 7, &value, &ts, sizeof(ts));
+
+		if(write(fd, rec, len) == -1) break;
+		s_sent++;
+		pace(start, s_sent);
+	}
+	return NULL;
+}
+
+// sends records holding their send time through the ring like shell_client does
+static void *ring_producer(void *arg){
+
+	struct shell_ring *sr = arg;
+	char rec[PROTO_RECORD_MAX];
+	struct client_value value = { VALUE_TEXT, 0, 0 };
+	double start = now_ns();
+
+	s_is_producer = 1;
+	while(s_running){
+
+		double ts = now_ns();
+		int len = proto_put_data(rec, 7, &value, &ts, sizeof(ts));
+		int ret;
+
+		while((ret = ring_write(sr->ring, rec, len)) == -1 && s_running);
+		if(ret == 1){
+			eventfd_write(sr->h.fd, 1);
+		}
+		s_sent++;
+		pace(start, s_sent);
+	}
+	return NULL;
+}
+
+// stores latency of a received record
+static void on_record(const struct proto_hdr *hdr, const char *body, void *arg){
+
+	double ts;
+
+	(void)arg;
+	if(hdr->type != PROTO_DATA) return;
+
+	memcpy(&ts, body + PROTO_VALUE_LEN, sizeof(ts));
+	if(s_recv < LAT_MAX){
+		s_lat[s_recv] = (now_ns() - ts) / 1000.0;
+	}
+	s_recv++;
+}
+
+static void on_pipe(int fd, uint32_t events, void *arg){
+
+	(void)events;
+	shell_proto_read(fd, arg, BENCH_BUDGET, on_record, NULL);
+}
+
+static void on_ring(int fd, uint32_t events, void *arg){
+
+	struct shell_ring *sr = arg;
+
+	(void)fd;
+	(void)events;
+	shell_ring_drain(sr, BENCH_BUDGET, on_record, NULL);
+}
+
+static int cmp_double(const void *a, const void *b){
+
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+// runs the loop for the benchmark duration and prints results of the transport
+static void run(const char *name, struct shell_loop *loop, void *(*producer)(void*), void *arg){
+
+	pthread_t th;
+
+	s_running = 1;
+	s_sent = s_recv = 0;
+	s_prod_calls = s_cons_calls = 0;
+
+	pthread_create(&th, NULL, producer, arg);
+
+	double start = now_ns();
+	while(now_ns() - start < BENCH_SECONDS * 1e9){
+		shell_loop_run_once(loop, 100);
+	}
+	s_running = 0;
+	pthread_join(th, NULL);
+
+	long n = s_recv < LAT_MAX ? s_recv : LAT_MAX;
+	qsort(s_lat, n, sizeof(double), cmp_double);
+
+	fprintf(stdout, "%-5s %ld msgs  producer %.3f syscalls/msg  consumer %.3f syscalls/msg  latency p50 %.1f us  p99 %.1f us  max %.1f us\n",
+		name, s_sent, (double)s_prod_calls / s_sent, (double)s_cons_calls / s_sent,
+		n ? s_lat[n / 2] : 0, n ? s_lat[n * 99 / 100] : 0, n ? s_lat[n - 1] : 0);
+}
+
+int main(int argc, char *argv[]){
+
+	static struct proto_reader rd;
+	struct shell_loop loop;
+	struct shell_transport tp = {0};
+	int data[2];
+
+	// usage: bench_ring [msgs/s], 0 floods
+	if(argc > 1){
+		s_rate = atol(argv[1]);
+	}
+
+	s_lat = malloc(LAT_MAX * sizeof(double));
+	if(s_lat == NULL){
+		fprintf(stderr, "error: allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	shell_loop_init(&loop);
+	fprintf(stdout, "%ld msgs/s for %d s\n", s_rate, BENCH_SECONDS);
+
+	// common pipe
+	if(pipe(data) == -1){
+		fprintf(stderr, "error: pipe creation failed(%d) --- %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	shell_set_nonblock(data[0]);
+	shell_proto_init(&rd);
+
+	struct shell_loop_handler pipe_h = { data[0], on_pipe, &rd };
+	shell_loop_add(&loop, &pipe_h, EPOLLIN);
+	run("pipe", &loop, pipe_producer, &data[1]);
+	shell_loop_del(&loop, &pipe_h);
+	close(data[0]);
+	close(data[1]);
+
+	// shared memory ring
+	tp.loop = &loop;
+	tp.ring_fn = on_ring;
+
+	struct shell_ring *sr = shell_ring_create(&tp);
+	if(sr == NULL){
+		exit(EXIT_FAILURE);
+	}
+	run("ring", &loop, ring_producer, sr);
+	shell_ring_destroy(&tp, sr);
+
+	shell_loop_close(&loop);
+	free(s_lat);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_rules.c
+ * @brief: measures alert rule evaluation of 10k rules over a stream of 1M readings per second
+ * @note: 9000 exact rules on topics site/<s>/room/<r>/temp and 1000 wildcard rules site/<s>/+/+/temp,
+ *	  so every topic is bound to 11 rules, stream time advances 1 us per reading
+*/
+
+
+#include"shell_rules.h"
+
+#define SITES		100		// topics are site/<s>/room/<r>/temp
+#define ROOMS		100
+#define TOPIC_CNT	(SITES * ROOMS)
+#define EXACT_RULES	9000		// one per topic, the rest of the topics have only wildcard rules
+#define WILD_PER_SITE	10		// wildcard rules of one site
+#define READINGS	20000000	// readings of the stream
+#define STREAM_NS	1000		// time between readings, 1M readings/s
+#define TOPIC_BUF	32
+
+static char s_topics[TOPIC_CNT][TOPIC_BUF];
+static struct rule_bind *s_binds[TOPIC_CNT];
+static double s_values[TOPIC_CNT];
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void){
+
+	static const char *kinds[] = { "above 28 1", "below 12 1", "rate 50 5" };
+	struct shell_rules r;
+	char line[RULES_LINE_LEN];
+	uint32_t src = 0;
+	volatile long sink = 0;
+
+	for(int n = 0; n < TOPIC_CNT; n++){
+		snprintf(s_topics[n], TOPIC_BUF, "site/%d/room/%d/temp", n % SITES, n / SITES);
+		s_values[n] = 20;
+	}
+
+	// log and output are left out, alerts are only counted
+	shell_rules_init(&r, NULL, NULL);
+
+	double t0 = now_ns();
+	for(int n = 0; n < EXACT_RULES; n++){
+		snprintf(line, sizeof(line), "site/%d/room/%d/temp %s", n % SITES, n / SITES, kinds[n % 3]);
+		shell_rules_add(&r, line, ++src);
+	}
+	for(int s = 0; s < SITES; s++){
+		for(int k = 0; k < WILD_PER_SITE; k++){
+			snprintf(line, sizeof(line), "site/%d/+/+/temp above %d 1", s, 30 + k);
+			shell_rules_add(&r, line, ++src);
+		}
+	}
+	shell_rules_compile(&r, 0);
+	double t_compile = (now_ns() - t0) / 1e6;
+
+	// values walk randomly so alerts fire and clear
+	srand(1);
+	int64_t stream = 0;
+
+	t0 = now_ns();
+	for(int n = 0; n < TOPIC_CNT; n++){
+		sink += shell_rules_eval(&r, &s_binds[n], s_topics[n], s_values[n], stream += STREAM_NS);
+	}
+	double t_bind = (now_ns() - t0) / TOPIC_CNT;
+
+	t0 = now_ns();
+	for(long i = 0; i < READINGS; i++){
+
+		int n = rand() % TOPIC_CNT;
+		s_values[n] += (rand() % 3 - 1) * 0.5;
+		sink += shell_rules_eval(&r, &s_binds[n], s_topics[n], s_values[n], stream += STREAM_NS);
+	}
+	double t_eval = (now_ns() - t0) / READINGS;
+
+	// cost of the stream itself: picking topics and walking values
+	t0 = now_ns();
+	for(long i = 0; i < READINGS; i++){
+
+		int n = rand() % TOPIC_CNT;
+		s_values[n] += (rand() % 3 - 1) * 0.5;
+		sink += (long)s_values[n];
+	}
+	double t_base = (now_ns() - t0) / READINGS;
+
+	fprintf(stdout, "%d rules(%d wildcard) on %d topics, %d bindings\n", r.cnt, r.wild_cnt, TOPIC_CNT, r.bind_cnt);
+	fprintf(stdout, "compile                  %8.1f ms\n", t_compile);
+	fprintf(stdout, "first reading(binds)     %8.1f ns\n", t_bind);
+	fprintf(stdout, "evaluation               %8.1f ns/reading, %.1f M readings/s, %.1f%% of a cpu at 1M readings/s\n",
+			t_eval - t_base, 1e3 / (t_eval - t_base), (t_eval - t_base) / STREAM_NS * 100);
+	fprintf(stdout, "alerts fired %ld, cleared %ld\n", r.fired, r.cleared);
+
+	shell_rules_free(&r);
+
+	return sink < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
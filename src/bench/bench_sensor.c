@@ -0,0 +1,100 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_sensor.c
+ * @brief: measures publish throughput of sensor client for a sensor producing readings as fast as possible
+ * @note: usage: bench_sensor [broker ip], needs a running broker
+*/
+
+
+#include"sensor_client.h"
+#include<time.h>
+
+#define BENCH_SECONDS	3		// how long the sensor produces readings
+#define BENCH_TOPIC	"bench/sensor"
+
+static long s_produced;
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// sensor writing readings as fast as the pipe takes them, closes the pipe when done
+static void *fast_sensor(void *arg){
+
+	int fd = *(int*)arg;
+	char data[SENSOR_DATA_LEN] = {0};
+	double start = now_ns();
+
+	while(now_ns() - start < BENCH_SECONDS * 1e9){
+
+		snprintf(data, sizeof(data), "%ld", s_produced % 100);
+		if(write(fd, data, sizeof(data)) == -1) break;
+		s_produced++;
+	}
+	close(fd);
+	return NULL;
+}
+
+// publish path before the publisher thread: one publish and one network loop per reading
+static long legacy_read_and_pub(int pfd, struct mosquitto *mosq){
+
+	char data[SENSOR_DATA_LEN];
+	long published = 0;
+
+	while(read(pfd, data, sizeof(data)) == sizeof(data)){
+
+		if(mosquitto_publish(mosq, NULL, BENCH_TOPIC, sizeof(data), data, QOS, RETAIN) != MOSQ_ERR_SUCCESS) break;
+		if(mosquitto_loop(mosq, TIMEOUT, MAX_PACKETS) != MOSQ_ERR_SUCCESS) break;
+		published++;
+	}
+	mosquitto_disconnect(mosq);
+	return published;
+}
+
+// runs sensor against one publish path and prints its throughput
+static void run(const char *name, const char *ip, int threaded){
+
+	int pfd[2];
+	pthread_t sensor;
+
+	struct mosquitto *mosq = mosquitto_new(NULL, true, NULL);
+	if(mosq == NULL || mosquitto_connect(mosq, ip, PORT, PING) != MOSQ_ERR_SUCCESS){
+		fprintf(stderr, "error: unable to connect to broker %s\n", ip);
+		exit(EXIT_FAILURE);
+	}
+	if(pipe(pfd) == -1){
+		fprintf(stderr, "error: pipe creation failed(%d) --- %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	s_produced = 0;
+	double start = now_ns();
+	pthread_create(&sensor, NULL, fast_sensor, &pfd[1]);
+
+	long published = threaded ? client_read_and_pub(pfd[0], BENCH_TOPIC, mosq, NULL, NULL, QOS, PUB_INFLIGHT) : legacy_read_and_pub(pfd[0], mosq);
+
+	pthread_join(sensor, NULL);
+	double secs = (now_ns() - start) / 1e9;
+
+	fprintf(stdout, "%-9s sensor %9.0f readings/s  published %9.0f readings/s\n", name, s_produced / secs, published / secs);
+
+	close(pfd[0]);
+	mosquitto_destroy(mosq);
+}
+
+int main(int argc, char *argv[]){
+
+	const char *ip = argc > 1 ? argv[1] : "127.0.0.1";
+
+	mosquitto_lib_init();
+	run("legacy", ip, 0);
+	run("threaded", ip, 1);
+	mosquitto_lib_cleanup();
+
+	return EXIT_SUCCESS;
+}
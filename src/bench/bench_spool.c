@@ -0,0 +1,171 @@
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_spool.c
+ * @brief: measures write cost per reading and drain throughput of the disk spool of sensor client
+ * @note: mosquitto_publish is wrapped to take every message without a broker, so drain measures the
+ *	  spool and payload building of the publisher only, rate limited drains show how close they keep
+ *	  to the configured rate. usage: ./bench_spool [directory of the spool file, default /tmp]
+*/
+
+
+#include"sensor_client.h"
+
+#define SPOOL_MB	16		// size of the measured spool
+#define WRITES		1000000		// readings written, more than the spool holds so it wraps
+#define RATE_READINGS	20000		// readings of a rate limited drain
+
+static long s_published;		// messages taken by the wrapped mosquitto_publish
+
+// takes message without sending it
+int __wrap_mosquitto_publish(struct mosquitto *mosq, int *mid, const char *topic, int len, const void *payload,
+			     int qos, bool retain){
+
+	(void)mosq; (void)mid; (void)topic; (void)len; (void)payload; (void)qos; (void)retain;
+	s_published++;
+	return MOSQ_ERR_SUCCESS;
+}
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// opens a new spool file in dir with the given items
+static void open_spool(struct sensor_spool *sp, const char *dir, const char *items){
+
+	char spec[SPOOL_PATH_LEN + 64];
+
+	snprintf(spec, sizeof(spec), "%s/bench_spool.%d", dir, getpid());
+	unlink(spec);
+	snprintf(spec + strlen(spec), sizeof(spec) - strlen(spec), ",max:%d%s", SPOOL_MB, items);
+
+	if(sensor_spool_open(sp, spec) == -1){
+		exit(EXIT_FAILURE);
+	}
+}
+
+// closes spool and removes its file
+static void remove_spool(struct sensor_spool *sp){
+
+	char path[SPOOL_PATH_LEN];
+
+	snprintf(path, sizeof(path), "%s", sp->path);
+	sensor_spool_close(sp);
+	unlink(path);
+}
+
+// writes readings, traced ones as "value;seq;t0", the others as "channel:value"
+static void fill(struct sensor_spool *sp, long cnt, int traced){
+
+	char data[SENSOR_DATA_LEN] = {0};
+
+	for(long n = 0; n < cnt; n++){
+
+		if(traced) snprintf(data, sizeof(data), "%ld;%ld;%.0f", 10 + n % 21, n, now_ns());
+		else snprintf(data, sizeof(data), "%ld:%ld", n % 100, 10 + n % 21);
+		sensor_spool_push(sp, data, (int64_t)now_ns());
+	}
+}
+
+// prints ns per written reading while the spool fills and once it drops the oldest readings
+static void bench_write(const char *dir){
+
+	struct sensor_spool sp;
+	char data[SENSOR_DATA_LEN] = "42:21.5";
+
+	open_spool(&sp, dir, "");
+	long cap = sp.hdr->cap;
+
+	// first pass touches every page of the file, the second one only drops and overwrites
+	double t0 = now_ns();
+	for(long n = 0; n < cap; n++){
+		sensor_spool_push(&sp, data, n);
+	}
+	double spent = now_ns() - t0;
+	fprintf(stdout, "write, filling(%ld readings) %8.1f ns/reading\n", cap, spent / cap);
+
+	t0 = now_ns();
+	for(long n = cap; n < WRITES; n++){
+		sensor_spool_push(&sp, data, n);
+	}
+	spent = now_ns() - t0;
+	fprintf(stdout, "write, full(drops oldest)      %8.1f ns/reading, %ld dropped\n", spent / (WRITES - cap),
+		(long)sp.hdr->dropped);
+
+	t0 = now_ns();
+	msync(sp.hdr, sp.len, MS_SYNC);
+	fprintf(stdout, "sync of %d MB spool            %8.1f ms\n", SPOOL_MB, (now_ns() - t0) / 1e6);
+
+	remove_spool(&sp);
+}
+
+// prints drain throughput of readings published as fast as they are taken
+static void bench_drain(const char *dir, int traced){
+
+	struct sensor_spool sp;
+	struct sensor_pub pub;
+
+	open_spool(&sp, dir, "");
+	long cnt = sp.hdr->cap;
+	fill(&sp, cnt, traced);
+
+	sensor_pub_init(&pub, NULL, "bench/spool", NULL);
+	pub.spool = &sp;
+	s_published = 0;
+
+	double t0 = now_ns();
+	while(sensor_pub_drain(&pub) != -1);
+	double spent = now_ns() - t0;
+
+	fprintf(stdout, "drain, %-8s no limit        %8.0f readings/s, %.1f ns/reading, %ld published\n",
+		traced ? "traced" : "channel", cnt / spent * 1e9, spent / cnt, s_published);
+
+	sensor_pub_free(&pub);
+	remove_spool(&sp);
+}
+
+// prints rate a drain limited to rate readings/s keeps
+static void bench_rate(const char *dir, int rate){
+
+	struct sensor_spool sp;
+	struct sensor_pub pub;
+	char items[32];
+	int wait;
+
+	snprintf(items, sizeof(items), ",rate:%d", rate);
+	open_spool(&sp, dir, items);
+	long cnt = rate < RATE_READINGS ? rate : RATE_READINGS;
+	fill(&sp, cnt, 0);
+
+	sensor_pub_init(&pub, NULL, "bench/spool", NULL);
+	pub.spool = &sp;
+
+	double t0 = now_ns();
+	while((wait = sensor_pub_drain(&pub)) != -1){
+		if(wait > 0) usleep(wait * 1000);
+	}
+	double spent = now_ns() - t0;
+
+	fprintf(stdout, "drain, rate:%-8d             %8.0f readings/s, %ld readings in %.0f ms\n",
+		rate, cnt / spent * 1e9, cnt, spent / 1e6);
+
+	sensor_pub_free(&pub);
+	remove_spool(&sp);
+}
+
+int main(int argc, char *argv[]){
+
+	const char *dir = argc > 1 ? argv[1] : "/tmp";
+
+	bench_write(dir);
+	bench_drain(dir, 0);
+	bench_drain(dir, 1);
+	bench_rate(dir, 1000);
+	bench_rate(dir, 10000);
+	bench_rate(dir, 50000);
+
+	return EXIT_SUCCESS;
+}
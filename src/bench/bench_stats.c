@@ -0,0 +1,91 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_stats.c
+ * @brief: measures cost of a statistics update and accuracy of estimated percentiles
+*/
+
+
+#include"shell_stats.h"
+#include<stdlib.h>
+#include<time.h>
+
+#define BENCH_UPDATES	10000000	// readings per distribution
+
+// returns monotonic time in nanoseconds
+static int64_t now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// uniform random number in (0, 1)
+static double uniform(void){
+
+	return (random() + 1.0) / ((double)RAND_MAX + 2.0);
+}
+
+// normal distribution around 20 like a temperature sensor
+static double gen_normal(void){
+
+	return 20 + 2 * sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+}
+
+// long tailed distribution like a latency
+static double gen_exp(void){
+
+	return -log(uniform()) * 10;
+}
+
+static int cmp_double(const void *a, const void *b){
+
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+// feeds readings to statistics and compares estimates to exact values
+static void run(const char *name, double (*gen)(void), double *values){
+
+	struct topic_stats st;
+	static const double ps[STATS_QUANTILES] = { 0.50, 0.95, 0.99 };
+
+	for(long i = 0; i < BENCH_UPDATES; i++){
+		values[i] = gen();
+	}
+
+	shell_stats_init(&st);
+	int64_t start = now_ns();
+	for(long i = 0; i < BENCH_UPDATES; i++){
+		shell_stats_update(&st, values[i], start + i * 1000);
+	}
+	double ns = (double)(now_ns() - start) / BENCH_UPDATES;
+
+	qsort(values, BENCH_UPDATES, sizeof(double), cmp_double);
+
+	fprintf(stdout, "%-7s %.1f ns/update  mean %.3f  var %.3f  size %zu bytes\n",
+		name, ns, st.mean, shell_stats_variance(&st), sizeof(st));
+	for(int i = 0; i < STATS_QUANTILES; i++){
+
+		double exact = values[(long)(ps[i] * (BENCH_UPDATES - 1))];
+		double est = p2_value(&st.quant[i]);
+		fprintf(stdout, "        p%-3.0f estimate %8.3f  exact %8.3f  error %.2f%%\n",
+			ps[i] * 100, est, exact, 100 * fabs(est - exact) / fabs(exact));
+	}
+}
+
+int main(void){
+
+	double *values = malloc(BENCH_UPDATES * sizeof(double));
+	if(values == NULL){
+		fprintf(stderr, "error: allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	srandom(1);
+	run("normal", gen_normal, values);
+	run("exp", gen_exp, values);
+
+	free(values);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+#!/bin/sh
+
+# file: bench_subscriber.sh
+# compares memory and cpu per topic of one shell client process per topic
+# against one multiplexed shell client process serving every topic
+#
+# usage: ./bench_subscriber.sh [topics] [messages per topic] [broker ip]
+# needs a running mosquitto broker and mosquitto_pub
+
+TOPICS=${1:-100}
+MSGS=${2:-100}
+BROKER=${3:-127.0.0.1}
+CLIENT=../client_shell/shell_client
+SETTLE=2
+
+HZ=$(getconf CLK_TCK)
+
+# prints rss(kB) and cpu time(ticks) of a process
+proc_usage(){
+	rss=$(awk '/VmRSS/ {print $2}' /proc/$1/status)
+	cpu=$(awk '{print $14 + $15}' /proc/$1/stat)
+	echo "$rss $cpu"
+}
+
+# publishes messages to every topic
+publish(){
+	n=0
+	while [ $n -lt $TOPICS ]; do
+		i=0
+		while [ $i -lt $MSGS ]; do
+			echo "$i"
+			i=$((i + 1))
+		done | mosquitto_pub -h $BROKER -t bench/$n -l &
+		n=$((n + 1))
+	done
+	wait
+}
+
+# sums usage of processes and prints per topic figures
+report(){
+	label=$1
+	conns=$3
+	total_rss=0
+	total_cpu=0
+	for pid in $2; do
+		usage=$(proc_usage $pid)
+		total_rss=$((total_rss + ${usage% *}))
+		total_cpu=$((total_cpu + ${usage#* }))
+	done
+	echo "$label: rss $total_rss kB ($((total_rss / TOPICS)) kB/topic)," \
+		"cpu $((total_cpu * 1000 / HZ)) ms ($((total_cpu * 1000000 / HZ / TOPICS)) us/topic)," \
+		"connections $conns"
+}
+
+# shell clients write to a discarded file descriptor
+exec 3>/dev/null
+
+# one process per topic
+pids=""
+n=0
+while [ $n -lt $TOPICS ]; do
+	$CLIENT $n 3 $BROKER bench/$n &
+	pids="$pids $!"
+	n=$((n + 1))
+done
+sleep $SETTLE
+publish
+sleep $SETTLE
+report "process per topic" "$pids" $TOPICS
+kill -USR1 $pids
+wait
+
+# one multiplexed process for all topics
+args=""
+n=0
+while [ $n -lt $TOPICS ]; do
+	args="$args $n bench/$n"
+	n=$((n + 1))
+done
+$CLIENT -m 3 $BROKER $args &
+pids=$!
+sleep $SETTLE
+publish
+sleep $SETTLE
+report "multiplexed" "$pids" 1
+kill -USR1 $pids
+wait
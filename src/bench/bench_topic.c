@@ -0,0 +1,121 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_topic.c
+ * @brief: measures dispatch of readings to concrete topic states of the topic trie
+ * @note: trie is compared with one hash table of whole topics, the cost a flat index would have
+*/
+
+
+#include"shell_topic.h"
+#include<time.h>
+
+#define TOPIC_CNT	100000		// distinct concrete topics
+#define SITES		100		// topics are site/<s>/room/<r>/temp
+#define ROUNDS		20		// dispatch passes over all topics
+#define TOPIC_BUF	32
+
+static char s_topics[TOPIC_CNT][TOPIC_BUF];
+static int s_len[TOPIC_CNT];
+static int s_order[TOPIC_CNT];
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// finds topic in flat open addressing table of topic numbers, adds it when it is missing
+static int flat_get(int *table, uint32_t mask, const char *topic, int len, int n){
+
+	uint32_t i = hash_fnv1a(topic, len) & mask;
+
+	while(table[i] != -1){
+
+		int k = table[i];
+		if(s_len[k] == len && memcmp(s_topics[k], topic, len) == 0) return k;
+		i = (i + 1) & mask;
+	}
+	table[i] = n;
+	return n;
+}
+
+int main(void){
+
+	struct shell_topics t;
+	struct client_list clist;
+	double t0, t_insert, t_trie, t_flat, t_sweep;
+	volatile long sink = 0;
+
+	for(int n = 0; n < TOPIC_CNT; n++){
+		s_len[n] = snprintf(s_topics[n], TOPIC_BUF, "site/%d/room/%d/temp", n % SITES, n / SITES);
+		s_order[n] = n;
+	}
+
+	// readings arrive in random topic order
+	srand(1);
+	for(int n = TOPIC_CNT - 1; n > 0; n--){
+		int k = rand() % (n + 1);
+		int tmp = s_order[n];
+		s_order[n] = s_order[k];
+		s_order[k] = tmp;
+	}
+
+	shell_topics_init(&t);
+
+	// first reading of every topic creates its state
+	t0 = now_ns();
+	for(int n = 0; n < TOPIC_CNT; n++){
+		int k = s_order[n];
+		sink += shell_topics_get(&t, s_topics[k], s_len[k], 1)->cid;
+	}
+	t_insert = (now_ns() - t0) / TOPIC_CNT;
+
+	t0 = now_ns();
+	for(int r = 0; r < ROUNDS; r++){
+		for(int n = 0; n < TOPIC_CNT; n++){
+			int k = s_order[n];
+			sink += shell_topics_get(&t, s_topics[k], s_len[k], 1)->stats.count;
+		}
+	}
+	t_trie = (now_ns() - t0) / ((double)ROUNDS * TOPIC_CNT);
+
+	// whole topics in one table
+	uint32_t sz = 1;
+	while(sz < 2 * TOPIC_CNT) sz <<= 1;
+	int *table = malloc(sz * sizeof(int));
+	memset(table, -1, sz * sizeof(int));
+
+	for(int n = 0; n < TOPIC_CNT; n++){
+		flat_get(table, sz - 1, s_topics[n], s_len[n], n);
+	}
+	t0 = now_ns();
+	for(int r = 0; r < ROUNDS; r++){
+		for(int n = 0; n < TOPIC_CNT; n++){
+			int k = s_order[n];
+			sink += flat_get(table, sz - 1, s_topics[k], s_len[k], k);
+		}
+	}
+	t_flat = (now_ns() - t0) / ((double)ROUNDS * TOPIC_CNT);
+
+	fprintf(stdout, "%d topics, %ld trie nodes\n", TOPIC_CNT, t.nodes);
+	fprintf(stdout, "first reading(creates state) %7.1f ns\n", t_insert);
+	fprintf(stdout, "dispatch trie                %7.1f ns\n", t_trie);
+	fprintf(stdout, "dispatch flat topic table    %7.1f ns\n", t_flat);
+
+	// client id of the states is not listed, so every state is dropped
+	shell_clist_init(&clist, CLIENTS_INIT_CNT);
+	t0 = now_ns();
+	shell_topics_sweep(&t, &clist);
+	t_sweep = (now_ns() - t0) / TOPIC_CNT;
+
+	fprintf(stdout, "sweep of every state         %7.1f ns, %ld nodes left\n", t_sweep, t.nodes);
+
+	shell_clist_free(&clist);
+	shell_topics_free(&t);
+	free(table);
+
+	return sink == 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
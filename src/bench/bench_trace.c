@@ -0,0 +1,92 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_trace.c
+ * @brief: measures cost of recording a traced reading and accuracy of histogram percentiles
+*/
+
+
+#include"shell_trace.h"
+#include<math.h>
+#include<time.h>
+
+#define BENCH_READINGS	10000000	// traced readings
+#define BENCH_LOSS	1000		// every BENCH_LOSS:th sequence number is lost
+
+// returns monotonic time in nanoseconds
+static int64_t now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// uniform random number in (0, 1)
+static double uniform(void){
+
+	return (random() + 1.0) / ((double)RAND_MAX + 2.0);
+}
+
+static int cmp_i64(const void *a, const void *b){
+
+	int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+	return (x > y) - (x < y);
+}
+
+int main(void){
+
+	static const double ps[] = { 0.50, 0.90, 0.99, 0.999 };
+	struct topic_trace *tt = shell_trace_new();
+	struct client_trace *traces = malloc(BENCH_READINGS * sizeof(struct client_trace));
+	int64_t *total = malloc(BENCH_READINGS * sizeof(int64_t));
+
+	if(traces == NULL || total == NULL){
+		fprintf(stderr, "error: allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// long tailed hop latencies around tens of microseconds
+	srandom(1);
+	uint32_t seq = 0;
+	long skipped = 0;
+	for(long i = 0; i < BENCH_READINGS; i++){
+
+		struct client_trace *tr = &traces[i];
+		if(++seq % BENCH_LOSS == 0){
+			seq++;
+			skipped++;
+		}
+
+		tr->on = 1;
+		tr->seq = seq;
+		tr->ts[TRACE_SENSOR] = 0;
+		for(int s = 1; s < TRACE_STAMPS; s++){
+			tr->ts[s] = tr->ts[s - 1] + (int64_t)(-log(uniform()) * 10000);
+		}
+		total[i] = tr->ts[TRACE_RECEIVE] + 5000;
+	}
+
+	int64_t start = now_ns();
+	for(long i = 0; i < BENCH_READINGS; i++){
+		shell_trace_update(tt, &traces[i], traces[i].ts[TRACE_RECEIVE] + 5000);
+	}
+	double ns = (double)(now_ns() - start) / BENCH_READINGS;
+
+	fprintf(stdout, "%.1f ns/reading  %zu bytes/topic  received %ld  lost %ld(expected %ld)\n",
+		ns, sizeof(struct topic_trace), tt->received, tt->lost, skipped);
+
+	// histogram percentiles are upper bounds of buckets, error stays below 1/HIST_SUB
+	qsort(total, BENCH_READINGS, sizeof(int64_t), cmp_i64);
+	for(unsigned i = 0; i < sizeof(ps) / sizeof(ps[0]); i++){
+
+		int64_t exact = total[(long)(ps[i] * (BENCH_READINGS - 1))];
+		int64_t est = hist_percentile(&tt->hops[HOP_TOTAL], ps[i]);
+		fprintf(stdout, "total p%-5g estimate %8ld  exact %8ld  error %.2f%%\n",
+			ps[i] * 100, (long)est, (long)exact, 100.0 * labs(est - exact) / exact);
+	}
+
+	free(traces);
+	free(total);
+	free(tt);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_tsdb.c
+ * @brief: measures append rate, reopen time and range queries of the time-series store
+ * @note: usage: bench_tsdb [dir], default dir bench_tsdb.d, store directory is removed afterwards
+*/
+
+
+#include"shell_tsdb.h"
+#include<time.h>
+#include<dirent.h>
+
+#define BENCH_APPENDS	10000000	// appended readings
+#define BENCH_TOPICS	16		// topics readings are spread over
+#define BENCH_DIR	"bench_tsdb.d"	// default store directory, the binary itself is bench_tsdb
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// removes store directory
+static void remove_store(const char *dir){
+
+	char path[PATH_MAX];
+	struct dirent *ent;
+	DIR *d = opendir(dir);
+
+	if(d == NULL) return;
+	while((ent = readdir(d)) != NULL){
+		if(ent->d_name[0] == '.') continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+		unlink(path);
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+static void sum_record(const struct tsdb_rec *rec, void *arg){
+
+	*(double*)arg += rec->value;
+}
+
+int main(int argc, char *argv[]){
+
+	const char *dir = argc > 1 ? argv[1] : BENCH_DIR;
+	struct shell_tsdb db;
+	char topics[BENCH_TOPICS][CLIENT_TOPIC_LEN];
+	double sum = 0;
+
+	for(int t = 0; t < BENCH_TOPICS; t++){
+		snprintf(topics[t], CLIENT_TOPIC_LEN, "sensor/%d", t);
+	}
+
+	remove_store(dir);
+	if(shell_tsdb_open(&db, dir) == -1){
+		exit(EXIT_FAILURE);
+	}
+
+	// append readings with increasing time round robin over topics
+	double start = now_ns();
+	for(long i = 0; i < BENCH_APPENDS; i++){
+		if(shell_tsdb_append(&db, topics[i % BENCH_TOPICS], i * 1000, (double)(i % 100)) == -1){
+			exit(EXIT_FAILURE);
+		}
+	}
+	double secs = (now_ns() - start) / 1e9;
+	fprintf(stdout, "append: %d readings over %d topics  %.2f M appends/s\n", BENCH_APPENDS, BENCH_TOPICS, BENCH_APPENDS / secs / 1e6);
+
+	shell_tsdb_close(&db);
+
+	// reopen and continue every series
+	start = now_ns();
+	shell_tsdb_open(&db, dir);
+	for(int t = 0; t < BENCH_TOPICS; t++){
+		shell_tsdb_append(&db, topics[t], (long)BENCH_APPENDS * 1000, 0);
+	}
+	fprintf(stdout, "reopen: %.1f us for %d series\n", (now_ns() - start) / 1000, BENCH_TOPICS);
+
+	// narrow range in the middle and whole history of one topic
+	int64_t mid = (int64_t)BENCH_APPENDS / 2 * 1000;
+
+	start = now_ns();
+	long n = shell_tsdb_query(&db, topics[0], mid, mid + 1000000, sum_record, &sum);
+	fprintf(stdout, "query: %ld readings of 1 ms range in %.1f us\n", n, (now_ns() - start) / 1000);
+
+	start = now_ns();
+	n = shell_tsdb_query(&db, topics[0], TSDB_NO_TIME, TSDB_NO_TIME, sum_record, &sum);
+	secs = (now_ns() - start) / 1e9;
+	fprintf(stdout, "query: %ld readings of whole history in %.1f ms(%.0f M readings/s)\n", n, secs * 1000, n / secs / 1e6);
+
+	shell_tsdb_close(&db);
+	remove_store(dir);
+
+	return sum < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
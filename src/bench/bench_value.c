@@ -0,0 +1,134 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_value.c
+ * @brief: measures parse throughput of integer, float and malformed readings against strtod
+*/
+
+
+#include"client_value.h"
+#include<stdio.h>
+#include<time.h>
+
+#define BENCH_PAYLOADS	1000000		// different payloads of every kind
+#define BENCH_ROUNDS	10		// passes over the payloads
+#define PAYLOAD_LEN	32
+
+// payloads of one kind, they are not terminated like mosquitto payloads
+struct payloads{
+
+	char		data[BENCH_PAYLOADS][PAYLOAD_LEN];
+	int		len[BENCH_PAYLOADS];
+};
+
+static struct payloads s_set;
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// fills payloads of a kind: integer readings, float readings or text
+static void generate(const char *kind){
+
+	char tmp[PAYLOAD_LEN + 1];
+
+	for(long i = 0; i < BENCH_PAYLOADS; i++){
+
+		long r = random();
+		int len;
+
+		if(strcmp(kind, "int") == 0){
+			len = snprintf(tmp, sizeof(tmp), "%ld", r % 200000 - 100000);
+		}
+		else if(strcmp(kind, "float") == 0){
+			len = snprintf(tmp, sizeof(tmp), "%.*f", (int)(r % 6) + 1, (r % 1000000) / 1000.0 - 500);
+		}
+		else{
+			// text, json and numbers followed by garbage
+			static const char *bad[] = { "on", "{\"t\":21.5}", "21.5C", "0x1F", "nan", "1e", "--3", "" };
+			len = snprintf(tmp, sizeof(tmp), "%s", bad[r % 8]);
+		}
+		memcpy(s_set.data[i], tmp, len);
+		s_set.len[i] = len;
+	}
+}
+
+// parses with value_parse and returns time of one parse(ns)
+static double run_parse(double *sum){
+
+	struct client_value v;
+	double start = now_ns();
+
+	for(int r = 0; r < BENCH_ROUNDS; r++){
+		for(long i = 0; i < BENCH_PAYLOADS; i++){
+			if(value_parse(s_set.data[i], s_set.len[i], &v) != VALUE_TEXT) *sum += v.f;
+		}
+	}
+	return (now_ns() - start) / ((double)BENCH_ROUNDS * BENCH_PAYLOADS);
+}
+
+// parses like the shell did before: terminated copy and strtod, returns time of one parse(ns)
+static double run_strtod(double *sum){
+
+	char num[PAYLOAD_LEN + 1];
+	char *end;
+	double start = now_ns();
+
+	for(int r = 0; r < BENCH_ROUNDS; r++){
+		for(long i = 0; i < BENCH_PAYLOADS; i++){
+			memcpy(num, s_set.data[i], s_set.len[i]);
+			num[s_set.len[i]] = '\0';
+			double d = strtod(num, &end);
+			if(end != num && *end == '\0' && d == d) *sum += d;
+		}
+	}
+	return (now_ns() - start) / ((double)BENCH_ROUNDS * BENCH_PAYLOADS);
+}
+
+// counts payloads whose value differs from strtod
+static long check(void){
+
+	char num[PAYLOAD_LEN + 1];
+	char *end;
+	struct client_value v;
+	long bad = 0;
+
+	for(long i = 0; i < BENCH_PAYLOADS; i++){
+
+		memcpy(num, s_set.data[i], s_set.len[i]);
+		num[s_set.len[i]] = '\0';
+		double d = strtod(num, &end);
+		int number = end != num && *end == '\0' && strstr(num, "0x") == NULL && strstr(num, "nan") == NULL;
+
+		value_parse(s_set.data[i], s_set.len[i], &v);
+		if(number != (v.type != VALUE_TEXT) || (number && v.f != d)) bad++;
+	}
+	return bad;
+}
+
+int main(void){
+
+	static const char *kinds[] = { "int", "float", "text" };
+	double sum = 0;
+
+	srandom(1);
+	fprintf(stdout, "%-8s %14s %14s %10s %10s\n", "payload", "parse(ns)", "strtod(ns)", "speedup", "mismatch");
+
+	for(int k = 0; k < 3; k++){
+
+		generate(kinds[k]);
+
+		double t_parse = run_parse(&sum);
+		double t_strtod = run_strtod(&sum);
+
+		fprintf(stdout, "%-8s %14.1f %14.1f %9.1fx %10ld\n", kinds[k], t_parse, t_strtod, t_strtod / t_parse, check());
+	}
+	// keeps sums alive so parsing is not optimized away
+	fprintf(stdout, "checksum %g\n", sum);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: bench_window.c
+ * @brief: compares printing and logging every reading with tumbling window aggregation
+ * @note: usage: bench_window [topics], stdout of the shell is replaced by /dev/null, log file is removed afterwards
+*/
+
+
+#include"shell_log.h"
+#include"shell_stats.h"
+
+#define BENCH_READINGS	2000000		// readings of one run
+#define BENCH_TOPICS	1000		// default topics readings are spread over
+#define BENCH_WINDOW	100000		// readings of one window, as 100k readings/s and 1 s windows
+#define BENCH_PATH	"bench_window.txt"
+#define LOG_MSG_LEN	80		// same as the shell
+
+// returns monotonic time in nanoseconds
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// opens log of the benchmark
+static void open_log(struct shell_log *log){
+
+	struct shell_log_cfg cfg = { BENCH_PATH, LOG_FLUSH_MS, LOG_SYNC_NONE, 0, 0 };
+	shell_log_open(log, &cfg);
+}
+
+// every reading is printed and logged the way the shell does without aggregation
+static double run_lines(FILE *out, struct topic_stats *st, int topics, long *lines, long *drops){
+
+	struct shell_log log;
+	char msg[LOG_MSG_LEN];
+
+	open_log(&log);
+	double start = now_ns();
+
+	for(long n = 0; n < BENCH_READINGS; n++){
+
+		int c = n % topics;
+		shell_stats_update(&st[c], n % 40, (int64_t)n * 10000);
+
+		sprintf(msg, "client %d(%d) data received: %ld\n", c, 4000 + c, n % 40);
+		shell_log_write(&log, msg);
+		fprintf(out, "%s", msg);
+	}
+	fflush(out);
+
+	double ns = (now_ns() - start) / BENCH_READINGS;
+	*lines = BENCH_READINGS;
+	shell_log_close(&log);
+	*drops = log.drops;
+
+	return ns;
+}
+
+// readings are added to windows of their topics, every window writes one record per topic
+static double run_windows(FILE *out, struct topic_stats *st, int topics, long *lines, long *drops){
+
+	struct shell_log log;
+	char topic[32];
+	char line[WINDOW_LINE_LEN];
+
+	open_log(&log);
+	*lines = 0;
+	double start = now_ns();
+
+	for(long n = 0; n < BENCH_READINGS; n++){
+
+		int c = n % topics;
+		shell_stats_update(&st[c], n % 40, (int64_t)n * 10000);
+
+		if((n + 1) % BENCH_WINDOW != 0) continue;
+
+		for(int k = 0; k < topics; k++){
+
+			snprintf(topic, sizeof(topic), "bench/%d", k);
+			shell_window_record(&st[k].agg, topic, n / BENCH_WINDOW, 1, line, sizeof(line));
+			shell_log_write(&log, line);
+			fprintf(out, "%s", line);
+			(*lines)++;
+		}
+	}
+	fflush(out);
+
+	double ns = (now_ns() - start) / BENCH_READINGS;
+	shell_log_close(&log);
+	*drops = log.drops;
+
+	return ns;
+}
+
+int main(int argc, char *argv[]){
+
+	int topics = argc > 1 ? atoi(argv[1]) : BENCH_TOPICS;
+	long lines, drops;
+
+	FILE *out = fopen("/dev/null", "w");
+	if(out == NULL || topics <= 0){
+		fprintf(stderr, "usage: %s [topics]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	// statistics are kept in both modes, the window only adds to them
+	struct topic_stats *st = calloc(topics, sizeof(struct topic_stats));
+	for(int c = 0; c < topics; c++){
+		shell_stats_init(&st[c]);
+	}
+
+	fprintf(stdout, "%d readings on %d topics, one window every %d readings\n", BENCH_READINGS, topics, BENCH_WINDOW);
+
+	// log drops what does not fit its buffers, dropped lines are cheap but lost
+	double ns = run_lines(out, st, topics, &lines, &drops);
+	fprintf(stdout, "line per reading    %7.1f ns/reading  %8ld lines  %8ld dropped by log\n", ns, lines, drops);
+
+	ns = run_windows(out, st, topics, &lines, &drops);
+	fprintf(stdout, "window records      %7.1f ns/reading  %8ld lines  %8ld dropped by log\n", ns, lines, drops);
+
+	free(st);
+	fclose(out);
+	unlink(BENCH_PATH);
+
+	return EXIT_SUCCESS;
+}
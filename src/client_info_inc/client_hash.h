@@ -0,0 +1,35 @@
+// file: client_hash.h
+
+#ifndef CLIENT_HASH_H
+#define CLIENT_HASH_H
+
+#include<stdint.h>
+
+// fnv-1a hash of topics and topic segments, every hash table of the shell and the shell client uses it
+
+#define HASH_FNV_BASIS		2166136261u
+#define HASH_FNV_PRIME		16777619u
+
+// hashes len bytes of key(fnv-1a)
+static inline uint32_t hash_fnv1a(const char *key, int len){
+
+	uint32_t h = HASH_FNV_BASIS;
+
+	for(int i = 0; i < len; i++){
+		h = (h ^ (unsigned char)key[i]) * HASH_FNV_PRIME;
+	}
+	return h;
+}
+
+// hashes terminated string(fnv-1a)
+static inline uint32_t hash_fnv1a_str(const char *key){
+
+	uint32_t h = HASH_FNV_BASIS;
+
+	while(*key){
+		h = (h ^ (unsigned char)*key++) * HASH_FNV_PRIME;
+	}
+	return h;
+}
+
+#endif // CLIENT_HASH_H
@@ -5,10 +5,12 @@
 #define CLIENT_INFO_H
 
 #include<sys/types.h>	// pid_t
+#include<stdint.h>
+#include<netinet/in.h>	// INET_ADDRSTRLEN
 
 #define CLIENT_DATA_LEN		20
 #define CLIENT_TOPIC_LEN 	20
-#define IP_ADDR_LEN		15
+#define IP_ADDR_LEN		INET_ADDRSTRLEN	// longest dotted ip address and its terminator
 
 // enum holding client status
 enum client_status{
@@ -23,7 +25,49 @@ enum client_status{
 	CLIENT_SUB_SUCCESS,		// client subscribed	
 	CLIENT_SUB_FAILURE,		// client subscuption failed
 	CLIENT_DATA_READY,		// client is sending data
-	CLIENT_DATA_MISSING		// client did not receive data from broker
+	CLIENT_DATA_MISSING,		// client did not receive data from broker
+	CLIENT_UNSUB_SUCCESS,		// client unsubscribed topic, its connection stays up
+	CLIENT_CONN_RETRY		// client lost connection, it reconnects and subscribes again
+};
+
+// traced reading carries its sequence number and CLOCK_MONOTONIC stamps of every hop
+// sensor writes "value;seq;t0", sensor client publishes "value;seq;t0;t1;t2"
+// stamps of different processes are comparable only when they run on the same host
+#define TRACE_SEP		';'
+
+// stamps of a traced reading
+enum trace_stamp{
+
+	TRACE_SENSOR,			// sensor wrote reading to its pipe
+	TRACE_READ,			// sensor client read it from the pipe
+	TRACE_PUBLISH,			// sensor client handed it to mosquitto
+	TRACE_RECEIVE,			// shell client received it from the broker
+	TRACE_STAMPS
+};
+
+// trace of a reading
+struct client_trace{
+
+	int			on;				// reading is traced
+	uint32_t		seq;				// sequence number given by the sensor
+	int64_t			ts[TRACE_STAMPS];		// monotonic stamps(ns)
+};
+
+// readings are parsed once by the shell client, the shell gets them as typed values
+// payload that is not a decimal integer or float is not dropped, it is tagged as text
+enum value_type{
+
+	VALUE_TEXT,			// payload is not a number
+	VALUE_INT,			// decimal integer that fits int64_t
+	VALUE_FLOAT			// decimal float, or integer too large for int64_t
+};
+
+// typed value of a reading
+struct client_value{
+
+	enum value_type		type;				// type of the payload
+	int64_t			i;				// exact value of an integer
+	double			f;				// value of any number as double
 };
 
 // structure holding information about client
@@ -37,6 +81,10 @@ struct client_info{
 	char			topic[CLIENT_TOPIC_LEN];	// topic to which client is subscribed
 	int			pipefd;				// pipe to which client writes
 	int			slot_pos;			// clients slot position in list
+	struct client_trace	trace;				// trace of data, if sensor traces it
+	struct client_value	value;				// typed value of data
+	const char		*payload;			// whole received data of any length, data holds its start
+	uint32_t		payload_len;			// length of payload, valid while data is handled
 };
 
 
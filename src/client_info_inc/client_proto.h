@@ -0,0 +1,237 @@
+
+// file: client_proto.h
+
+#ifndef CLIENT_PROTO_H
+#define CLIENT_PROTO_H
+
+#include"client_info.h"
+#include<stdint.h>
+#include<string.h>
+#include<limits.h>	// PIPE_BUF
+
+// records that clients send to the shell
+// every record starts with a header holding its length so the shell can split
+// a byte stream into records no matter how reads happen to cut it
+//
+//   header:  len(2) version(1) type(1) cid(4)
+//   status:  header pid(4) status(1) ip_len(1) topic_len(1) pad(1) ip topic
+//   data:    header value payload
+//   trace:   header seq(4) pad(4) stamps(8 * TRACE_STAMPS) value payload
+//   value:   type(1) pad(7) int(8) float(8)
+//   frag:    header total(4) offset(4) type(1) pad(3) part of data or trace body
+//
+// payload that does not fit one record is sent in fragments, the shell puts the body
+// of the data or trace record back together from the fragments of the same client id
+
+#define PROTO_VERSION		3
+#define PROTO_RECORD_MAX	PIPE_BUF	// larger writes to the common pipe are not atomic
+#define PROTO_PAYLOAD_MAX	(16 << 20)	// largest payload passed to the shell
+
+// types of records
+enum proto_type{
+
+	PROTO_STATUS = 1,		// client status changed
+	PROTO_DATA   = 2,		// client received data
+	PROTO_TRACE  = 3,		// client received traced data
+	PROTO_FRAG   = 4		// part of data or trace record too large for one record
+};
+
+// header of every record
+struct proto_hdr{
+
+	uint16_t	len;			// record length including header
+	uint8_t		version;		// PROTO_VERSION
+	uint8_t		type;			// enum proto_type
+	int32_t		cid;			// client id
+};
+
+// body of status record, ip and topic strings follow it
+struct proto_status{
+
+	int32_t		pid;			// client process id
+	uint8_t		status;			// enum client_status
+	uint8_t		ip_len;			// length of ip string
+	uint8_t		topic_len;		// length of topic string
+	uint8_t		pad;
+};
+
+// body of trace record, payload follows it
+struct proto_trace{
+
+	uint32_t	seq;			// sequence number of the reading
+	uint32_t	pad;
+	int64_t		ts[TRACE_STAMPS];	// monotonic stamps of the hops
+};
+
+// typed value that comes before the payload of data and trace records
+// reading of a wildcard subscription has its concrete topic between the value and the payload
+struct proto_value{
+
+	uint8_t		type;			// enum value_type
+	uint8_t		topic_len;		// length of the concrete topic that follows, 0 if there is none
+	uint8_t		pad[6];
+	int64_t		i;			// integer value
+	double		f;			// value as double
+};
+
+// body of fragment record, part of the body of a data or trace record follows it
+struct proto_frag{
+
+	uint32_t	total;			// length of the whole body
+	uint32_t	offset;			// position of this part in the body
+	uint8_t		type;			// PROTO_DATA or PROTO_TRACE
+	uint8_t		pad[3];
+};
+
+// operation of a job
+enum proto_job_op{
+
+	JOB_SUB = 1,				// subscribe topic for client id
+	JOB_UNSUB				// unsubscribe topic of client id
+};
+
+// job given by the shell to a pooled client through its control pipe
+// first job makes the client the shared connection to its broker, later ones add and remove topics
+// it is the only message shell sends to a client, written at once and smaller than PIPE_BUF
+struct proto_job{
+
+	uint8_t		op;			// enum proto_job_op
+	uint8_t		qos;			// quality of service topic is subscribed with
+	uint8_t		pad[2];
+	int32_t		cid;			// client id
+	char		ip[IP_ADDR_LEN];	// broker ip address
+	char		topic[CLIENT_TOPIC_LEN];	// topic to subscribe to
+};
+
+// topic given to the shell may end with ",qos:N", the quality of service(0..2) it is subscribed with
+// without it the topic is subscribed with qos 0, a topic holding a comma needs the suffix
+#define PROTO_QOS_SUFFIX	",qos:"
+#define PROTO_QOS_MAX		2
+
+// returns quality of service of topic "topic[,qos:N]" and sets length of the topic without the suffix
+// -1 if the suffix is not valid or there is no topic before it
+static inline int proto_topic_qos(const char *spec, int *topic_len){
+
+	const char *sep = strrchr(spec, ',');
+	int len = sizeof(PROTO_QOS_SUFFIX) - 1;
+
+	*topic_len = strlen(spec);
+	if(sep == NULL){
+		return 0;
+	}
+	if(sep == spec || strncmp(sep, PROTO_QOS_SUFFIX, len) != 0 || sep[len] < '0' || sep[len] > '0' + PROTO_QOS_MAX || sep[len + 1] != '\0'){
+		return -1;
+	}
+	*topic_len = sep - spec;
+	return sep[len] - '0';
+}
+
+#define PROTO_HDR_LEN		((int)sizeof(struct proto_hdr))
+#define PROTO_STATUS_LEN	((int)sizeof(struct proto_status))
+#define PROTO_TRACE_LEN		((int)sizeof(struct proto_trace))
+#define PROTO_VALUE_LEN		((int)sizeof(struct proto_value))
+#define PROTO_TOPIC_MAX		UINT8_MAX	// longest concrete topic a record carries
+// longest body of a fragmented record, the client drops payloads over PROTO_PAYLOAD_MAX so it never sends more
+#define PROTO_BODY_MAX		(PROTO_TRACE_LEN + PROTO_VALUE_LEN + PROTO_TOPIC_MAX + PROTO_PAYLOAD_MAX)
+#define PROTO_FRAG_LEN		((int)sizeof(struct proto_frag))
+#define PROTO_FRAG_DATA_MAX	(PROTO_DATA_MAX - PROTO_FRAG_LEN)
+#define PROTO_DATA_MAX		(PROTO_RECORD_MAX - PROTO_HDR_LEN)
+
+// writes header to buffer
+static inline void proto_put_hdr(char *buf, int len, enum proto_type type, int cid){
+
+	struct proto_hdr hdr = { (uint16_t)len, PROTO_VERSION, (uint8_t)type, cid };
+	memcpy(buf, &hdr, sizeof(hdr));
+}
+
+// builds status record of client into buffer and returns its length
+static inline int proto_put_status(char *buf, const struct client_info *info){
+
+	struct proto_status st = {0};
+	int ip_len = strnlen(info->ip, IP_ADDR_LEN);
+	int topic_len = strnlen(info->topic, CLIENT_TOPIC_LEN);
+	int len = PROTO_HDR_LEN + PROTO_STATUS_LEN + ip_len + topic_len;
+
+	st.pid = info->pid;
+	st.status = info->status;
+	st.ip_len = ip_len;
+	st.topic_len = topic_len;
+
+	proto_put_hdr(buf, len, PROTO_STATUS, info->id);
+	memcpy(buf + PROTO_HDR_LEN, &st, sizeof(st));
+	memcpy(buf + PROTO_HDR_LEN + PROTO_STATUS_LEN, info->ip, ip_len);
+	memcpy(buf + PROTO_HDR_LEN + PROTO_STATUS_LEN + ip_len, info->topic, topic_len);
+
+	return len;
+}
+
+// writes value body and concrete topic, if there is one, to buffer and returns their length
+// topic must not be longer than PROTO_TOPIC_MAX
+static inline int proto_put_value_body(char *buf, const struct client_value *value, const char *topic, int topic_len){
+
+	struct proto_value val = {0};
+
+	val.type = value->type;
+	val.topic_len = topic != NULL ? (uint8_t)topic_len : 0;
+	val.i = value->i;
+	val.f = value->f;
+	memcpy(buf, &val, sizeof(val));
+	if(val.topic_len > 0){
+		memcpy(buf + PROTO_VALUE_LEN, topic, val.topic_len);
+	}
+
+	return PROTO_VALUE_LEN + val.topic_len;
+}
+
+// builds data record into buffer and returns its length, payload is cut to fit the record
+static inline int proto_put_data(char *buf, int cid, const struct client_value *value, const void *data, int data_len){
+
+	if(data_len > PROTO_DATA_MAX - PROTO_VALUE_LEN) data_len = PROTO_DATA_MAX - PROTO_VALUE_LEN;
+
+	proto_put_hdr(buf, PROTO_HDR_LEN + PROTO_VALUE_LEN + data_len, PROTO_DATA, cid);
+	proto_put_value_body(buf + PROTO_HDR_LEN, value, NULL, 0);
+	memcpy(buf + PROTO_HDR_LEN + PROTO_VALUE_LEN, data, data_len);
+
+	return PROTO_HDR_LEN + PROTO_VALUE_LEN + data_len;
+}
+
+// writes trace body to buffer and returns its length
+static inline int proto_put_trace_body(char *buf, const struct client_trace *trace){
+
+	struct proto_trace tr = {0};
+
+	tr.seq = trace->seq;
+	memcpy(tr.ts, trace->ts, sizeof(tr.ts));
+	memcpy(buf, &tr, sizeof(tr));
+
+	return PROTO_TRACE_LEN;
+}
+
+// builds trace record into buffer and returns its length, payload is cut to fit the record
+static inline int proto_put_trace(char *buf, int cid, const struct client_trace *trace, const struct client_value *value,
+				  const void *data, int data_len){
+
+	int pre_len = PROTO_TRACE_LEN + PROTO_VALUE_LEN;
+
+	if(data_len > PROTO_DATA_MAX - pre_len) data_len = PROTO_DATA_MAX - pre_len;
+
+	proto_put_hdr(buf, PROTO_HDR_LEN + pre_len + data_len, PROTO_TRACE, cid);
+	proto_put_trace_body(buf + PROTO_HDR_LEN, trace);
+	proto_put_value_body(buf + PROTO_HDR_LEN + PROTO_TRACE_LEN, value, NULL, 0);
+	memcpy(buf + PROTO_HDR_LEN + pre_len, data, data_len);
+
+	return PROTO_HDR_LEN + pre_len + data_len;
+}
+
+// writes header and fragment body of a part_len long part to buffer and returns their length
+static inline int proto_put_frag_hdr(char *buf, int cid, enum proto_type type, uint32_t total, uint32_t offset, int part_len){
+
+	struct proto_frag fr = { total, offset, (uint8_t)type, {0} };
+
+	proto_put_hdr(buf, PROTO_HDR_LEN + PROTO_FRAG_LEN + part_len, PROTO_FRAG, cid);
+	memcpy(buf + PROTO_HDR_LEN, &fr, sizeof(fr));
+
+	return PROTO_HDR_LEN + PROTO_FRAG_LEN;
+}
+
+#endif // CLIENT_PROTO_H
@@ -0,0 +1,119 @@
+
+// file: client_ring.h
+
+#ifndef CLIENT_RING_H
+#define CLIENT_RING_H
+
+#include<stdint.h>
+#include<string.h>
+#include<stdatomic.h>
+#include<sys/uio.h>		// iovec
+
+// single producer single consumer byte ring in shared memory
+// client(producer) appends records, shell(consumer) drains them in batches
+// producer wakes consumer through an eventfd only when consumer is waiting
+
+#define RING_ENV		"SHELL_CLIENT_RING"	// environment variable: "memfd:eventfd"
+#define RING_DATA_LEN		(1 << 18)		// ring bytes, power of two
+
+// ring header followed by data bytes
+struct ring{
+
+	_Atomic uint32_t	head;			// bytes written, owned by producer
+	char			pad0[60];		// keep head and tail on own cache lines
+	_Atomic uint32_t	tail;			// bytes read, owned by consumer
+	char			pad1[60];
+	_Atomic uint32_t	waiting;		// consumer waits for a wakeup
+	_Atomic uint32_t	closed;			// producer is gone
+	uint32_t		size;			// amount of data bytes
+	char			data[];
+};
+
+#define RING_MAP_LEN(size)	(sizeof(struct ring) + (size))
+
+// initializes ring header, consumer starts waiting for the first record
+static inline void ring_init(struct ring *r, uint32_t size){
+
+	atomic_store(&r->head, 0);
+	atomic_store(&r->tail, 0);
+	atomic_store(&r->waiting, 1);
+	atomic_store(&r->closed, 0);
+	r->size = size;
+}
+
+// appends record gathered from cnt buffers to ring
+// returns -1 when there is no room, 1 when consumer must be woken up, 0 otherwise
+static inline int ring_writev(struct ring *r, const struct iovec *iov, int cnt){
+
+	uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+	uint32_t len = 0;
+
+	for(int i = 0; i < cnt; i++){
+		len += iov[i].iov_len;
+	}
+	if(r->size - (head - tail) < len){
+		return -1;
+	}
+
+	// copy every buffer in up to two parts when it wraps around the end
+	uint32_t at = head;
+	for(int i = 0; i < cnt; i++){
+
+		uint32_t pos = at & (r->size - 1);
+		uint32_t part = iov[i].iov_len;
+		uint32_t first = r->size - pos < part ? r->size - pos : part;
+
+		memcpy(r->data + pos, iov[i].iov_base, first);
+		memcpy(r->data, (const char*)iov[i].iov_base + first, part - first);
+		at += part;
+	}
+
+	// publishing head and checking waiting flag must not be reordered
+	// or a consumer going to sleep could miss the record
+	// flag is taken so that only the first record after consumer fell asleep wakes it
+	atomic_store_explicit(&r->head, head + len, memory_order_seq_cst);
+	if(atomic_load_explicit(&r->waiting, memory_order_seq_cst) == 0){
+		return 0;
+	}
+	return atomic_exchange_explicit(&r->waiting, 0, memory_order_seq_cst) ? 1 : 0;
+}
+
+// appends record to ring
+// returns -1 when there is no room, 1 when consumer must be woken up, 0 otherwise
+static inline int ring_write(struct ring *r, const void *rec, uint32_t len){
+
+	struct iovec iov = { (void*)rec, len };
+	return ring_writev(r, &iov, 1);
+}
+
+// copies at most max bytes from ring to buffer and returns their amount
+static inline uint32_t ring_read(struct ring *r, char *buf, uint32_t max){
+
+	uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+	uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+	uint32_t len = head - tail < max ? head - tail : max;
+
+	uint32_t pos = tail & (r->size - 1);
+	uint32_t first = r->size - pos < len ? r->size - pos : len;
+
+	memcpy(buf, r->data + pos, first);
+	memcpy(buf + first, r->data, len - first);
+
+	atomic_store_explicit(&r->tail, tail + len, memory_order_release);
+	return len;
+}
+
+// marks consumer as waiting, returns 0 if data arrived meanwhile and consumer must not sleep
+static inline int ring_wait_prepare(struct ring *r){
+
+	atomic_store_explicit(&r->waiting, 1, memory_order_seq_cst);
+
+	if(atomic_load_explicit(&r->head, memory_order_seq_cst) != atomic_load_explicit(&r->tail, memory_order_relaxed)){
+		atomic_store_explicit(&r->waiting, 0, memory_order_relaxed);
+		return 0;
+	}
+	return 1;
+}
+
+#endif // CLIENT_RING_H
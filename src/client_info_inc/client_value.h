@@ -0,0 +1,130 @@
+// file: client_value.h
+
+#ifndef CLIENT_VALUE_H
+#define CLIENT_VALUE_H
+
+#include"client_info.h"
+#include<stdint.h>
+#include<stdlib.h>	// strtod
+#include<string.h>
+
+// parser of ascii readings: [spaces][+|-]digits[.digits][e[+|-]digits][spaces]
+// payload is not terminated and is parsed in place, nothing is allocated
+// floats with at most 19 significant digits and a small exponent are computed exactly
+// from the digits(clinger's fast path), others are left to strtod on a copy on the stack
+// hex, inf, nan and anything else is text
+
+#define VALUE_NUM_MAX		64	// longer numbers that need strtod are taken as text
+#define VALUE_EXACT_MANT	(1ULL << 53)	// integers up to this are exact doubles
+#define VALUE_EXACT_EXP		22		// powers of ten up to this are exact doubles
+
+// exact powers of ten
+static const double value_pow10[VALUE_EXACT_EXP + 1] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// returns nonzero for spaces around the number
+static inline int value_is_space(char c){
+
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// parses len bytes of payload into value and returns its type
+static inline enum value_type value_parse(const char *payload, int len, struct client_value *value){
+
+	const char *p = payload;
+	const char *end = payload + len;
+	uint64_t mant = 0;
+	int neg = 0, digits = 0, point = 0, exp_given = 0;
+	int exp10 = 0;				// decimal exponent of mant
+
+	value->type = VALUE_TEXT;
+	value->i = 0;
+	value->f = 0;
+
+	while(p < end && value_is_space(*p)) p++;
+	while(end > p && value_is_space(end[-1])) end--;
+	const char *start = p;
+
+	if(p < end && (*p == '+' || *p == '-')){
+		neg = *p++ == '-';
+	}
+
+	// digits beyond what mant holds only move the exponent
+	for(; p < end; p++){
+
+		if(*p >= '0' && *p <= '9'){
+			if(mant < 1000000000000000000ULL){
+				mant = mant * 10 + (*p - '0');
+				exp10 -= point;
+			}
+			else{
+				exp10 += !point;
+			}
+			digits++;
+		}
+		else if(*p == '.' && !point){
+			point = 1;
+		}
+		else{
+			break;
+		}
+	}
+	if(digits == 0){
+		return VALUE_TEXT;
+	}
+
+	if(p < end && (*p == 'e' || *p == 'E')){
+
+		int exp_neg = 0, exp = 0;
+
+		p++;
+		if(p < end && (*p == '+' || *p == '-')){
+			exp_neg = *p++ == '-';
+		}
+		if(p == end || *p < '0' || *p > '9'){
+			return VALUE_TEXT;
+		}
+		for(; p < end && *p >= '0' && *p <= '9'; p++){
+			if(exp < 100000) exp = exp * 10 + (*p - '0');
+		}
+		exp10 += exp_neg ? -exp : exp;
+		exp_given = 1;
+	}
+	if(p != end){
+		return VALUE_TEXT;
+	}
+
+	// plain integer that fits int64_t
+	if(!point && !exp_given && exp10 == 0 && mant <= (uint64_t)INT64_MAX + neg){
+
+		value->type = VALUE_INT;
+		value->i = neg ? (int64_t)(0 - mant) : (int64_t)mant;
+		value->f = (double)value->i;
+		return VALUE_INT;
+	}
+
+	value->type = VALUE_FLOAT;
+
+	if(mant <= VALUE_EXACT_MANT && exp10 >= -VALUE_EXACT_EXP && exp10 <= VALUE_EXACT_EXP){
+		value->f = exp10 < 0 ? (double)mant / value_pow10[-exp10] : (double)mant * value_pow10[exp10];
+	}
+	else{
+		char num[VALUE_NUM_MAX];
+
+		if(end - start >= VALUE_NUM_MAX){
+			value->type = VALUE_TEXT;
+			return VALUE_TEXT;
+		}
+		memcpy(num, start, end - start);
+		num[end - start] = '\0';
+		value->f = strtod(num, NULL);
+		return VALUE_FLOAT;
+	}
+	if(neg) value->f = -value->f;
+
+	return VALUE_FLOAT;
+}
+
+#endif // CLIENT_VALUE_H
@@ -9,35 +9,75 @@
 #include"sensor_client.h"
 
 // mqtt connect callback function
+// refused connection is retried by the network thread like a lost one
 void mqtt_cb_connect(struct mosquitto *mosq, void *obj, int rc){
 	
-	if(rc == 0){
-		fprintf(stdout, "sensor connected successfully\n");
+	struct sensor_pub *pub = obj;
+
+	(void)mosq;
+	if(rc != 0){
+		fprintf(stderr, "error: sensor unable to connect(%d), retrying\n", rc);
+		return;
+	}
+
+	pthread_mutex_lock(&pub->lock);
+
+	if(pub->lost_ns != 0){
+		fprintf(stdout, "sensor reconnected after %.1f ms\n", (client_mono_ns() - pub->lost_ns) / 1e6);
+		pub->reconnects++;
 	}
 	else{
-		fprintf(stderr, "error: sensor unable to connect\n");
-		mosquitto_destroy(mosq);
-		mosquitto_lib_cleanup();
-		exit(EXIT_FAILURE);
+		fprintf(stdout, "sensor connected successfully\n");
 	}
+	pub->attempt = 0;
+	pub->lost_ns = 0;
+
+	// publisher waiting for the connection takes its reading again
+	pthread_cond_broadcast(&pub->up);
+	pthread_mutex_unlock(&pub->lock);
 }
 
 // disconnect callback function
 void mqtt_cb_disconnect(struct mosquitto *mosq, void *obj, int rc){
 
+	struct sensor_pub *pub = obj;
+
+	(void)mosq;
 	if(rc == 0){
 		fprintf(stdout, "sensor disconnected normally\n");
 	}
 	else{
-		fprintf(stderr, "sensor disconnected abnormally\n");	
+		fprintf(stderr, "sensor disconnected abnormally(%d), reconnecting\n", rc);
+
+		pthread_mutex_lock(&pub->lock);
+		if(pub->lost_ns == 0) pub->lost_ns = client_mono_ns();
+		pthread_mutex_unlock(&pub->lock);
 	}
 }
 
+// publish callback function, message is acknowledged(qos 1 and 2) or written(qos 0)
+// acknowledgement frees a place in the window of the publisher
+void mqtt_cb_publish(struct mosquitto *mosq, void *obj, int mid){
+
+	struct sensor_pub *pub = obj;
+
+	(void)mosq;
+	(void)mid;
+	pthread_mutex_lock(&pub->lock);
+	if(pub->inflight > 0){
+		pub->inflight--;
+		pub->acked++;
+		pthread_cond_broadcast(&pub->up);
+	}
+	pthread_mutex_unlock(&pub->lock);
+}
+
 // sets up callback functions for mosquitto instance
 void mqtt_set_callbacks(struct mosquitto *mosq){
 	
 	mosquitto_connect_callback_set(mosq, mqtt_cb_connect);
 	mosquitto_disconnect_callback_set(mosq, mqtt_cb_disconnect);
+	mosquitto_publish_callback_set(mosq, mqtt_cb_publish);
 }
 
 // validates mosquitto topic
@@ -51,67 +91,517 @@ void mqtt_validate_topic(const char *topic){
 	}
 }
 
-// excecutes a sensor program as a child process
-void client_start_sensor(int pfd, const char *path, char *sensor_name){
+// returns monotonic time in nanoseconds
+int64_t client_mono_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// sets until to the realtime clock ms from now, deadline of a timed condition wait
+static void client_deadline(struct timespec *until, int ms){
+
+	clock_gettime(CLOCK_REALTIME, until);
+
+	until->tv_sec += ms / 1000;
+	until->tv_nsec += (long)(ms % 1000) * 1000000;
+	if(until->tv_nsec >= 1000000000){
+		until->tv_sec++;
+		until->tv_nsec -= 1000000000;
+	}
+}
 
-	char pfd_arg[10] = {0};
+// excecutes a sensor program as a child process, options are passed to the sensor program
+void client_start_sensor(int pfd, const char *path, char *sensor_name, char *opts[], int opt_cnt){
+
+	char pfd_arg[12] = {0};
+	char **args = calloc(opt_cnt + 3, sizeof(char*));
+
+	if(args == NULL){
+		fprintf(stderr, "error: allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
 
 	// convert pipe filedescriptor into program argument(string)
 	sprintf(pfd_arg, "%d", pfd);
 
+	// sensor_name fd [options...]
+	args[0] = sensor_name;
+	args[1] = pfd_arg;
+	for(int i = 0; i < opt_cnt; i++){
+		args[i + 2] = opts[i];
+	}
+
 	// execute sensor program
-	if(execl(path, sensor_name, pfd_arg, (char*)NULL) == -1){
+	if(execv(path, args) == -1){
 		fprintf(stderr, "error: exec failed(%d) --- %s\n", errno, strerror(errno));
 	}
 	exit(EXIT_FAILURE);
 }
 
-// reads sensor data from pipe and publishes it to a mosquitto topic
-void client_read_and_pub(int pfd, const char *topic, struct mosquitto *mosq_sensor){
+// initializes queue with capacity of len readings
+void sensor_queue_init(struct sensor_queue *q, int len){
+
+	memset(q, 0, sizeof(struct sensor_queue));
+
+	q->data = malloc(len * sizeof(struct sensor_reading));
+	if(q->data == NULL){
+		fprintf(stderr, "error: queue allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+	q->len = len;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->not_empty, NULL);
+}
+
+// frees queue
+void sensor_queue_free(struct sensor_queue *q){
+
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->not_empty);
+	free(q->data);
+	q->data = NULL;
+}
+
+// adds reading read at read_ns to queue, drops the oldest reading when queue is full
+void sensor_queue_push(struct sensor_queue *q, const char *data, int64_t read_ns){
+
+	pthread_mutex_lock(&q->lock);
+
+	if(q->head - q->tail == (unsigned long)q->len){
+		q->tail++;
+		q->dropped++;
+	}
+	memcpy(q->data[q->head % q->len].data, data, SENSOR_DATA_LEN);
+	q->data[q->head % q->len].read_ns = read_ns;
+
+	// publisher sleeps only on an empty queue
+	if(q->head++ == q->tail){
+		pthread_cond_signal(&q->not_empty);
+	}
+
+	pthread_mutex_unlock(&q->lock);
+}
+
+// marks queue closed and wakes publisher
+void sensor_queue_close(struct sensor_queue *q){
 
-	char sensor_data[SENSOR_DATA_LEN] = {0};
+	pthread_mutex_lock(&q->lock);
+	q->closed = 1;
+	pthread_cond_signal(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+}
+
+// takes at most max readings from queue, waits for them at most ms(-1 no limit)
+// returns amount of readings, -1 if none came in time, 0 when queue is closed and empty
+int sensor_queue_pop(struct sensor_queue *q, struct sensor_reading *out, int max, int ms){
+
+	struct timespec until;
+	int cnt = 0;
+
+	if(ms >= 0) client_deadline(&until, ms);
+
+	pthread_mutex_lock(&q->lock);
+
+	while(q->head == q->tail && !q->closed){
+
+		if(ms < 0){
+			pthread_cond_wait(&q->not_empty, &q->lock);
+		}
+		else if(pthread_cond_timedwait(&q->not_empty, &q->lock, &until) == ETIMEDOUT){
+			break;
+		}
+	}
+	while(cnt < max && q->tail != q->head){
+		out[cnt++] = q->data[q->tail++ % q->len];
+	}
+	if(cnt == 0 && !q->closed){
+		cnt = -1;
+	}
+
+	pthread_mutex_unlock(&q->lock);
+	return cnt;
+}
+
+// initializes publisher of queued readings to topic, qos 0 and window PUB_INFLIGHT
+void sensor_pub_init(struct sensor_pub *pub, struct mosquitto *mosq, const char *topic, struct sensor_queue *queue){
+
+	memset(pub, 0, sizeof(struct sensor_pub));
+	pub->mosq = mosq;
+	pub->topic = topic;
+	pub->queue = queue;
+	pub->qos = QOS;
+	pub->window = PUB_INFLIGHT;
+
+	// sensors started together get different backoffs
+	pub->seed = getpid() ^ (unsigned int)client_mono_ns();
+	pthread_mutex_init(&pub->lock, NULL);
+	pthread_cond_init(&pub->up, NULL);
+}
+
+// frees publisher
+void sensor_pub_free(struct sensor_pub *pub){
+
+	pthread_mutex_destroy(&pub->lock);
+	pthread_cond_destroy(&pub->up);
+}
+
+// sensor stopped, threads waiting for the connection give up
+void sensor_pub_stop(struct sensor_pub *pub){
+
+	pthread_mutex_lock(&pub->lock);
+	pub->stop = 1;
+	pthread_cond_broadcast(&pub->up);
+	pthread_mutex_unlock(&pub->lock);
+}
+
+// waits on the connection condition for at most ms, called with lock held
+static void sensor_pub_wait(struct sensor_pub *pub, int ms){
+
+	struct timespec until;
+
+	client_deadline(&until, ms);
+	pthread_cond_timedwait(&pub->up, &pub->lock, &until);
+}
+
+// waits at most ms until every message in flight is acknowledged, returns amount still in flight
+// acknowledgements do not come while connection is down, then it does not wait
+int sensor_pub_flush(struct sensor_pub *pub, int ms){
+
+	int64_t until = client_mono_ns() + (int64_t)ms * 1000000;
+
+	pthread_mutex_lock(&pub->lock);
+	while(pub->inflight > 0 && pub->lost_ns == 0 && client_mono_ns() < until){
+		sensor_pub_wait(pub, PUB_RETRY_MS);
+	}
+	int left = pub->inflight;
+	pthread_mutex_unlock(&pub->lock);
+
+	return left;
+}
+
+// returns backoff before next reconnect attempt in ms and counts the attempt
+// backoff doubles every attempt up to RECONN_MAX_MS, its second half is random(equal jitter)
+int sensor_backoff_next(struct sensor_pub *pub){
+
+	int ms = RECONN_MAX_MS;
+
+	if(pub->attempt < 16 && (RECONN_MIN_MS << pub->attempt) < RECONN_MAX_MS){
+		ms = RECONN_MIN_MS << pub->attempt;
+	}
+	pub->attempt++;
+
+	return ms / 2 + rand_r(&pub->seed) % (ms / 2 + 1);
+}
+
+// network thread: runs mosquitto loop and restores lost connection until sensor stops
+// connection that is down at the start, refused or lost is reconnected after a backoff, stop ends the wait
+void *client_network(void *arg){
+
+	struct sensor_pub *pub = arg;
 
 	while(1){
-		
-		// read incoming sensor data from pipe
-		if( (read(pfd, sensor_data, sizeof(sensor_data))) == -1){
-		
-			printf("stop\n");
-
-			fprintf(stderr, "read failed: %d --- %s", errno, strerror(errno));
-			mosquitto_destroy(mosq_sensor);
-			mosquitto_lib_cleanup();
-			exit(EXIT_FAILURE);
+
+		int rc = mosquitto_loop(pub->mosq, NET_LOOP_MS, MAX_PACKETS);
+
+		pthread_mutex_lock(&pub->lock);
+
+		if(rc != MOSQ_ERR_SUCCESS && !pub->stop){
+
+			if(pub->lost_ns == 0) pub->lost_ns = client_mono_ns();
+			sensor_pub_wait(pub, sensor_backoff_next(pub));
+		}
+		int stop = pub->stop;
+
+		pthread_mutex_unlock(&pub->lock);
+
+		// stopped sensor ends with its connection, disconnect request ends it
+		if(rc == MOSQ_ERR_SUCCESS) continue;
+		if(stop) break;
+
+		mosquitto_reconnect(pub->mosq);
+	}
+	return NULL;
+}
+
+// takes a place in the window for a qos 1 or 2 message, -1 if window is full
+// stopped sensor does not wait for acknowledgements, its last readings may exceed the window
+static int sensor_pub_window(struct sensor_pub *pub){
+
+	pthread_mutex_lock(&pub->lock);
+	int full = pub->inflight >= pub->window && !pub->stop;
+	if(!full) pub->inflight++;
+	pthread_mutex_unlock(&pub->lock);
+
+	return full ? -1 : 0;
+}
+
+// publishes reading read at read_ns, returns result of mosquitto_publish
+// mosquitto_publish only queues the message, network thread of mosquitto sends it
+// reading "channel:value" of a multi-channel sensor is published as value to topic/channel
+// traced reading "value;seq;t0" is published as "value;seq;t0;t1;t2" with read and publish stamps
+// traced reading read_ns 0 lost its stamps(spooled before a reboot), only its value is published
+// full window of qos 1 and 2 messages is reported as MOSQ_ERR_NO_CONN, reading waits like without connection
+// qos 1 and 2 message published while connection is down is kept by mosquitto and sent once it is back
+static int sensor_pub_send(struct sensor_pub *pub, const char *data, int64_t read_ns){
+
+	if(pub->qos > 0 && sensor_pub_window(pub) == -1){
+		return MOSQ_ERR_NO_CONN;
+	}
+
+	char channel_topic[PUB_TOPIC_LEN];
+	char payload[PUB_DATA_LEN];
+	const char *topic = pub->topic;
+	const char *value = data;
+	const char *sep = memchr(data, ':', SENSOR_DATA_LEN);
+
+	if(sep != NULL){
+		snprintf(channel_topic, sizeof(channel_topic), "%s/%.*s", pub->topic, (int)(sep - data), data);
+		topic = channel_topic;
+		value = sep + 1;
+	}
+
+	int len = strnlen(value, SENSOR_DATA_LEN - (value - data));
+
+	const char *trace = memchr(value, TRACE_SEP, len);
+
+	if(trace != NULL && read_ns == 0){
+		len = trace - value;
+	}
+	else if(trace != NULL){
+		len = snprintf(payload, sizeof(payload), "%.*s%c%lld%c%lld", len, value,
+			TRACE_SEP, (long long)read_ns, TRACE_SEP, (long long)client_mono_ns());
+		value = payload;
+	}
+
+	int ret = mosquitto_publish(pub->mosq, NULL, topic, len, value, pub->qos, RETAIN);
+
+	if(pub->qos > 0 && ret == MOSQ_ERR_NO_CONN){
+		ret = MOSQ_ERR_SUCCESS;
+	}
+	else if(pub->qos > 0 && ret != MOSQ_ERR_SUCCESS){
+
+		pthread_mutex_lock(&pub->lock);
+		pub->inflight--;
+		pthread_mutex_unlock(&pub->lock);
+	}
+	return ret;
+}
+
+// waits at most PUB_RETRY_MS for an acknowledgement while window of qos 1 and 2 messages is full
+// returns -1 without waiting for qos 0, when connection is down or sensor stopped
+static int sensor_pub_wait_ack(struct sensor_pub *pub){
+
+	if(pub->qos == 0){
+		return -1;
+	}
+
+	pthread_mutex_lock(&pub->lock);
+	int up = pub->lost_ns == 0 && !pub->stop;
+	if(up && pub->inflight >= pub->window){
+		sensor_pub_wait(pub, PUB_RETRY_MS);
+	}
+	pthread_mutex_unlock(&pub->lock);
+
+	return up ? 0 : -1;
+}
+
+// publishes reading taken from the queue, -1 when publishing has to stop
+// reading goes to the spool while connection is down or older readings wait there, so order is kept
+// without a spool reading waits for the connection, queue keeps the newest readings meanwhile
+static int sensor_pub_reading(struct sensor_pub *pub, const struct sensor_reading *r){
+
+	if(pub->spool != NULL && sensor_spool_peek(pub->spool) != NULL){
+		sensor_spool_push(pub->spool, r->data, r->read_ns);
+		return 0;
+	}
+
+	int ret = sensor_pub_send(pub, r->data, r->read_ns);
+	while(ret == MOSQ_ERR_NO_CONN && sensor_pub_wait_ack(pub) == 0){
+		ret = sensor_pub_send(pub, r->data, r->read_ns);
+	}
+	if(ret == MOSQ_ERR_NO_CONN && pub->spool != NULL){
+		sensor_spool_push(pub->spool, r->data, r->read_ns);
+		return 0;
+	}
+
+	// stopped sensor tries the reading once more, its window is open then
+	int stop = 0;
+	while(ret == MOSQ_ERR_NO_CONN && !stop){
+
+		pthread_mutex_lock(&pub->lock);
+		stop = pub->stop;
+		if(!stop) sensor_pub_wait(pub, PUB_RETRY_MS);
+		pthread_mutex_unlock(&pub->lock);
+
+		ret = sensor_pub_send(pub, r->data, r->read_ns);
+	}
+	if(ret == MOSQ_ERR_NO_CONN){
+
+		fprintf(stderr, "error: unable to publish the message, client isnt connected to a valid broker\n");
+		pub->error = 1;
+		return -1;
+	}
+	else if(ret != MOSQ_ERR_SUCCESS){
+
+		fprintf(stderr, "error: publishing failed --- %s\n", mosquitto_strerror(ret));
+		pub->error = 1;
+		return -1;
+	}
+	pub->published++;
+	return 0;
+}
+
+// publishes spooled readings the drain rate allows
+// returns ms until next reading may be drained, PUB_RETRY_MS while connection is down, -1 if spool is empty
+// full window of qos 1 and 2 messages is waited for once, then queue is looked at again
+// reading keeps the time it was read, its publish stamp is the time it was drained
+int sensor_pub_drain(struct sensor_pub *pub){
+
+	struct sensor_spool *sp = pub->spool;
+
+	for(int n = 0; n < PUB_BATCH; n++){
+
+		int64_t now = client_mono_ns();
+		int wait = sensor_spool_wait_ms(sp, now);
+		if(wait != 0){
+			return wait;
 		}
-		// publish sensor data to a broker
-		if(mosquitto_publish(mosq_sensor, NULL, topic, sizeof(sensor_data), sensor_data, QOS, RETAIN) == MOSQ_ERR_NO_CONN){
-				
-			fprintf(stderr, "error: unable to publish the message, client isnt connected to a valid broker\n");
-			mosquitto_destroy(mosq_sensor);
-			mosquitto_lib_cleanup();
-			exit(EXIT_FAILURE);
+
+		struct spool_rec *rec = sensor_spool_peek(sp);
+		int ret = sensor_pub_send(pub, rec->data, sensor_spool_stale(sp) ? 0 : rec->read_ns);
+		if(ret == MOSQ_ERR_NO_CONN){
+			return sensor_pub_wait_ack(pub) == 0 ? 0 : PUB_RETRY_MS;
 		}
 
-		int loop = mosquitto_loop(mosq_sensor, TIMEOUT, MAX_PACKETS);
-		if(loop != MOSQ_ERR_SUCCESS){
-
-			if(loop == MOSQ_ERR_CONN_LOST){
-				fprintf(stderr,"error: connection to broker was lost %s\n", topic);
-			}
-			else if(loop == MOSQ_ERR_NO_CONN){
-				fprintf(stderr, "error: no connection to broker %s\n", topic);
-			}
-			else if(loop == MOSQ_ERR_PROTOCOL){
-				fprintf(stderr, "error: protocol error %s\n", topic);
-			}
-			else{
-				fprintf(stderr, "error: system call error %s\n", topic);
-			}
-			break;
+		// reading the broker does not take for another reason is not retried
+		if(ret == MOSQ_ERR_SUCCESS){
+			pub->published++;
 		}
+		else{
+			fprintf(stderr, "error: publishing spooled reading failed --- %s\n", mosquitto_strerror(ret));
+		}
+		sensor_spool_pop(sp, now);
 	}
-	mosquitto_destroy(mosq_sensor);
-	mosquitto_lib_cleanup();
-	exit(EXIT_FAILURE);
+	return sensor_spool_wait_ms(sp, client_mono_ns());
+}
+
+// publisher thread: publishes queued readings
+// with a spool it wakes up to drain it even when no readings come, it is left for the next start
+// once the sensor stops
+void *client_publisher(void *arg){
+
+	struct sensor_pub *pub = arg;
+	struct sensor_reading batch[PUB_BATCH];
+	int wait = pub->spool != NULL ? sensor_pub_drain(pub) : -1;
+	int cnt;
+
+	while( (cnt = sensor_queue_pop(pub->queue, batch, PUB_BATCH, wait)) != 0 ){
+
+		for(int i = 0; i < cnt; i++){
+			if(sensor_pub_reading(pub, &batch[i]) == -1) return NULL;
+		}
+		if(pub->spool != NULL){
+			wait = sensor_pub_drain(pub);
+		}
+	}
+	return NULL;
 }
 
+// reads sensor data from pipe and publishes it to a mosquitto topic until the sensor stops
+// pipe is read in batches by this thread, publishing and network run in their own threads
+// filter runs here so dropped readings never reach the queue
+// readings left when the sensor stops are published unless connection is down then, spool keeps them
+// qos 1 and 2 messages in flight then are waited for ACK_WAIT_MS at most
+long client_read_and_pub(int pfd, const char *topic, struct mosquitto *mosq_sensor, struct sensor_filter *filter,
+			 struct sensor_spool *spool, int qos, int window){
+
+	char buf[READ_BATCH * SENSOR_DATA_LEN];
+	int len = 0;
+
+	struct sensor_queue queue;
+	struct sensor_pub pub;
+	pthread_t pub_thread;
+	pthread_t net_thread;
+
+	sensor_queue_init(&queue, QUEUE_LEN);
+	sensor_pub_init(&pub, mosq_sensor, topic, &queue);
+	pub.spool = spool;
+	pub.qos = qos;
+	pub.window = window;
+
+	// mosquitto holds back messages over its own window, it is kept the same
+	mosquitto_max_inflight_messages_set(mosq_sensor, window);
+
+	// callbacks run in the network thread and share the connection state with the publisher
+	mosquitto_user_data_set(mosq_sensor, &pub);
+	mosquitto_threaded_set(mosq_sensor, true);
+
+	if(pthread_create(&net_thread, NULL, client_network, &pub) != 0){
+		fprintf(stderr, "error: starting network thread failed\n");
+		return -1;
+	}
+	if(pthread_create(&pub_thread, NULL, client_publisher, &pub) != 0){
+		fprintf(stderr, "error: starting publisher thread failed\n");
+		sensor_pub_stop(&pub);
+		mosquitto_disconnect(mosq_sensor);
+		pthread_join(net_thread, NULL);
+		return -1;
+	}
+
+	while(!pub.error){
+
+		// read incoming sensor data from pipe
+		int ret = read(pfd, buf + len, sizeof(buf) - len);
+		if(ret == -1){
+			if(errno == EINTR) continue;
+			fprintf(stderr, "read failed: %d --- %s\n", errno, strerror(errno));
+			break;
+		}
+		if(ret == 0){
+			break;
+		}
+		len += ret;
+
+		// queue every complete reading with the time of the read, keep partial one for the next read
+		int64_t read_ns = client_mono_ns();
+		int n = len / SENSOR_DATA_LEN;
+		for(int i = 0; i < n; i++){
+
+			char *data = buf + i * SENSOR_DATA_LEN;
+			if(filter != NULL && !sensor_filter_apply(filter, data, SENSOR_DATA_LEN, read_ns)) continue;
+			sensor_queue_push(&queue, data, read_ns);
+		}
+		len -= n * SENSOR_DATA_LEN;
+		memmove(buf, buf + n * SENSOR_DATA_LEN, len);
+	}
+
+	// publish what is left, then let the network thread send it
+	sensor_queue_close(&queue);
+	sensor_pub_stop(&pub);
+	pthread_join(pub_thread, NULL);
+	int unacked = qos > 0 ? sensor_pub_flush(&pub, ACK_WAIT_MS) : 0;
+	mosquitto_disconnect(mosq_sensor);
+	pthread_join(net_thread, NULL);
+
+	if(queue.dropped > 0){
+		fprintf(stderr, "sensor: %ld readings dropped, broker was too slow or unreachable\n", queue.dropped);
+	}
+	if(qos > 0){
+		fprintf(stderr, "sensor: %ld qos %d messages acknowledged, %d not acknowledged\n", pub.acked, qos, unacked);
+	}
+	if(pub.reconnects > 0){
+		fprintf(stderr, "sensor: connection restored %ld times\n", pub.reconnects);
+	}
+	if(filter != NULL){
+		sensor_filter_report(filter, stderr);
+	}
+	if(spool != NULL){
+		sensor_spool_report(spool, stderr);
+	}
+	sensor_queue_free(&queue);
+	sensor_pub_free(&pub);
+
+	return pub.error ? -1 : pub.published;
+}
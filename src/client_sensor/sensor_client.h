@@ -15,17 +15,85 @@
 #include<string.h>
 #include<unistd.h>
 #include<errno.h>
+#include<pthread.h>
+#include<stdint.h>
+#include<time.h>
+#include"sensor_filter.h"
+#include"sensor_spool.h"
 
 
-#define SENSOR_DATA_LEN	20
+#define SENSOR_DATA_LEN	48	// reading "[channel:]value[;seq;t0]" written by the sensor
+#define TRACE_SEP	';'	// separates value from its trace
 
-#define QOS		0
+#define QOS		0	// default quality of service
+#define QOS_MAX		2
 #define RETAIN		0
 #define PORT		1883
 #define PING		60
 #define TIMEOUT 	(-1)
 #define MAX_PACKETS	1
 
+#define QUEUE_LEN	4096	// readings buffered between pipe reader and publisher
+#define READ_BATCH	64	// readings read from the pipe at once
+#define PUB_BATCH	64	// readings taken from the queue at once
+#define PUB_TOPIC_LEN	256	// topic of a channel: topic/channel
+#define PUB_DATA_LEN	(SENSOR_DATA_LEN + 48)	// published payload, traced reading gets two stamps more
+
+#define NET_LOOP_MS	100	// wait of network loop for packets
+#define RECONN_MIN_MS	100	// backoff before first reconnect attempt
+#define RECONN_MAX_MS	10000	// longest backoff between reconnect attempts
+#define PUB_RETRY_MS	100	// publisher retries a reading at least this often while connection is down
+#define PUB_INFLIGHT	20	// default window of qos 1 and 2 messages waiting for acknowledgement
+#define ACK_WAIT_MS	5000	// longest wait for acknowledgements of messages in flight when sensor stops
+
+// reading and the monotonic time(ns) it was read from the pipe
+struct sensor_reading{
+
+	char		data[SENSOR_DATA_LEN];		// reading written by the sensor
+	int64_t		read_ns;			// stamp of the read
+};
+
+// bounded queue of readings between pipe reader and publisher thread
+// when publisher falls behind the oldest readings are dropped so the sensor is never blocked
+struct sensor_queue{
+
+	struct sensor_reading *data;			// readings
+	unsigned long	head;				// readings pushed
+	unsigned long	tail;				// readings popped
+	int		len;				// capacity of the queue
+	int		closed;				// reader is done
+	long		dropped;			// readings dropped because queue was full
+	pthread_mutex_t	lock;
+	pthread_cond_t	not_empty;			// wakes publisher
+};
+
+// publisher and network thread arguments and counters, object of the mosquitto instance
+// lost connection is restored in place: backoff doubles from RECONN_MIN_MS to RECONN_MAX_MS and half
+// of it is random, publisher keeps its reading meanwhile and queue drops the oldest ones
+// with a spool readings go to disk instead and are drained in order once connection is back
+// qos 1 and 2 messages are acknowledged in the network thread, publisher does not wait for every
+// acknowledgement, only when window messages are in flight
+struct sensor_pub{
+
+	struct mosquitto	*mosq;			// sensors mosquitto instance, network runs in its own thread
+	const char		*topic;			// topic to publish to
+	struct sensor_queue	*queue;			// readings to publish
+	long			published;		// readings handed to mosquitto
+	int			error;			// publishing stopped because of an error
+	int			stop;			// sensor stopped, lost connection is not waited for anymore
+	int			attempt;		// reconnect attempts since connection was lost
+	unsigned int		seed;			// seed of the random part of the backoff
+	int64_t			lost_ns;		// monotonic time connection was lost, 0 while it is up
+	long			reconnects;		// connections restored
+	struct sensor_spool	*spool;			// readings kept while connection is down, NULL waits for it
+	int			qos;			// quality of service of published readings
+	int			window;			// messages that may wait for acknowledgement
+	int			inflight;		// messages waiting for acknowledgement
+	long			acked;			// messages acknowledged by the broker
+	pthread_mutex_t		lock;
+	pthread_cond_t		up;			// wakes threads waiting for the connection or the stop
+};
+
 
 // connect callback function
 void mqtt_cb_connect(struct mosquitto *mosq, void *obj, int rc);
@@ -33,16 +101,68 @@ void mqtt_cb_connect(struct mosquitto *mosq, void *obj, int rc);
 // disconnect callback function
 void mqtt_cb_disconnect(struct mosquitto *mosq, void *obj, int rc);
 
+// publish callback function, message is acknowledged(qos 1 and 2) or written(qos 0)
+void mqtt_cb_publish(struct mosquitto *mosq, void *obj, int mid);
+
 // sets up callback functions for mosquitto instance
 void mqtt_set_callbacks(struct mosquitto *mosq);
 
+// initializes publisher of queued readings to topic, qos 0 and window PUB_INFLIGHT
+void sensor_pub_init(struct sensor_pub *pub, struct mosquitto *mosq, const char *topic, struct sensor_queue *queue);
+
+// waits at most ms until every message in flight is acknowledged, returns amount still in flight
+int sensor_pub_flush(struct sensor_pub *pub, int ms);
+
+// frees publisher
+void sensor_pub_free(struct sensor_pub *pub);
+
+// sensor stopped, threads waiting for the connection give up
+void sensor_pub_stop(struct sensor_pub *pub);
+
+// returns backoff before next reconnect attempt in ms and counts the attempt
+int sensor_backoff_next(struct sensor_pub *pub);
+
+// network thread: runs mosquitto loop and restores lost connection until sensor stops
+void *client_network(void *arg);
+
 // validates mosquitto topic
 void mqtt_validate_topic(const char *topic);
 
-// executes sensor program as a child process
-void client_start_sensor(int pfd, const char *path, char *sensor_name);
+// returns monotonic time in nanoseconds
+int64_t client_mono_ns(void);
+
+// executes sensor program as a child process, options are passed to the sensor program
+void client_start_sensor(int pfd, const char *path, char *sensor_name, char *opts[], int opt_cnt);
+
+// initializes queue with capacity of len readings
+void sensor_queue_init(struct sensor_queue *q, int len);
+
+// frees queue
+void sensor_queue_free(struct sensor_queue *q);
+
+// adds reading read at read_ns to queue, drops the oldest reading when queue is full
+void sensor_queue_push(struct sensor_queue *q, const char *data, int64_t read_ns);
+
+// marks queue closed and wakes publisher
+void sensor_queue_close(struct sensor_queue *q);
+
+// takes at most max readings from queue, waits for them at most ms(-1 no limit)
+// returns amount of readings, -1 if none came in time, 0 when queue is closed and empty
+int sensor_queue_pop(struct sensor_queue *q, struct sensor_reading *out, int max, int ms);
+
+// publishes spooled readings the drain rate allows
+// returns ms until next reading may be drained, PUB_RETRY_MS while connection is down, -1 if spool is empty
+int sensor_pub_drain(struct sensor_pub *pub);
+
+// publisher thread: publishes queued readings
+void *client_publisher(void *arg);
 
-// reads sensor data from pipe and publishes it to a topic
-void client_read_and_pub(int pfd, const char *topic, struct mosquitto *mosq_sensor);
+// reads sensor data from pipe and publishes it to a topic until the sensor stops
+// readings are run through filter before they are queued, NULL publishes every reading
+// readings that can not be published are spooled, NULL spool keeps them in memory
+// readings are published with qos, at most window qos 1 and 2 messages wait for acknowledgement
+// returns amount of published readings, -1 on error
+long client_read_and_pub(int pfd, const char *topic, struct mosquitto *mosq_sensor, struct sensor_filter *filter,
+			 struct sensor_spool *spool, int qos, int window);
 
 #endif	// SENSOR_CLIENT_H
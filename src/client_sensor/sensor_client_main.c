@@ -11,15 +11,66 @@
 int main(int argc, char* argv[]){
 
 	struct mosquitto *mosq_sensor = NULL;	// sensors mosquitto instance
-	const char *path  = argv[1];		// path to sensor program that will be excecuted
-	const char *ip    = argv[2];		// ip address of the broker
-	const char *topic = argv[3];		// mosquitto topic to which to publish
+	struct sensor_filter filter;		// edge filter of readings
+	struct sensor_filter *fp = NULL;	// NULL when every reading is published
+	struct sensor_spool spool;		// readings kept on disk while broker is unreachable
+	struct sensor_spool *sp = NULL;		// NULL when they wait in memory
+	int qos = QOS;				// quality of service of published readings
+	int window = PUB_INFLIGHT;		// qos 1 and 2 messages waiting for acknowledgement at once
+	char *end;
 	int pipefd[2];				// pipe from which sensor client will recieve data from sensor
+	int opt;
 
-	if(argc != 4){
+	// sensor_client [-f filter] [-S spool] [-q qos] [-i window] path ip topic [sensor options...]
+	// options end at the path, the ones after the topic belong to the sensor
+	while((opt = getopt(argc, argv, "+f:S:q:i:")) != -1){
+
+		if(opt == 'f'){
+			if(fp != NULL) sensor_filter_free(fp);
+			if(sensor_filter_init(&filter, optarg) == -1){
+				exit(EXIT_FAILURE);
+			}
+			fp = &filter;
+		}
+		else if(opt == 'S'){
+			if(sp != NULL) sensor_spool_close(sp);
+			if(sensor_spool_open(&spool, optarg) == -1){
+				exit(EXIT_FAILURE);
+			}
+			sp = &spool;
+		}
+		else if(opt == 'q'){
+			qos = strtol(optarg, &end, 10);
+			if(end == optarg || *end != '\0' || qos < 0 || qos > QOS_MAX){
+				fprintf(stderr, "error: qos %s is not valid, it is 0, 1 or 2\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if(opt == 'i'){
+			window = strtol(optarg, &end, 10);
+			if(end == optarg || *end != '\0' || window < 1 || window > UINT16_MAX){
+				fprintf(stderr, "error: in-flight window %s is not valid\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else{
+			fprintf(stderr, "usage: %s [-f stage:arg,...] [-S path[,max:MB][,rate:N]] [-q qos] [-i in-flight window]"
+				" path ip topic [sensor options...]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if(argc - optind < 3){
 		fprintf(stderr, "error: incorrect amount of arguments\n");
 		exit(EXIT_FAILURE);
 	}
+
+	const char *path  = argv[optind];	// path to sensor program that will be excecuted
+	const char *ip    = argv[optind + 1];	// ip address of the broker
+	const char *topic = argv[optind + 2];	// mosquitto topic to which to publish
+	char **opts = argv + optind + 3;	// options of the sensor program
+	int opt_cnt = argc - optind - 3;
+
 	
 	if( (pipe(pipefd)) == -1 ){
 		fprintf(stderr, "error creating pipe: %d --- %s\n", errno, strerror(errno));
@@ -30,8 +81,8 @@ int main(int argc, char* argv[]){
 	mosquitto_lib_init();
 	mqtt_validate_topic(topic);
 
-	// create mosquitto instance
-	mosq_sensor = mosquitto_new(NULL, true, (void*)topic);
+	// create mosquitto instance, its object is set once publishing starts
+	mosq_sensor = mosquitto_new(NULL, true, NULL);
 	if(mosq_sensor == NULL){
 		fprintf(stderr, "error: unable to create a moquitto instance\n");
 		mosquitto_lib_cleanup();
@@ -41,8 +92,10 @@ int main(int argc, char* argv[]){
 	// setup callbacks for client
 	mqtt_set_callbacks(mosq_sensor);
 
-	// connect to a broker
-	mosquitto_connect(mosq_sensor, ip, PORT, PING);
+	// connect to a broker, broker that is not up yet is connected by the network thread later
+	if(mosquitto_connect(mosq_sensor, ip, PORT, PING) != MOSQ_ERR_SUCCESS){
+		fprintf(stderr, "error: sensor unable to connect to %s, retrying\n", ip);
+	}
 
 	// parent process(sensor_client) will fork child process that will execute sensor program
 	pid_t pid = fork();
@@ -50,12 +103,18 @@ int main(int argc, char* argv[]){
 	// child process
 	if(pid == 0){
 		close(pipefd[0]);
-		client_start_sensor(pipefd[1], path, "sensor");
+		client_start_sensor(pipefd[1], path, "sensor", opts, opt_cnt);
 	}
 	// parent process
 	else if(pid > 0){
 		close(pipefd[1]);
-		client_read_and_pub(pipefd[0], topic, mosq_sensor);
+		long ret = client_read_and_pub(pipefd[0], topic, mosq_sensor, fp, sp, qos, window);
+		if(fp != NULL) sensor_filter_free(fp);
+		if(sp != NULL) sensor_spool_close(sp);
+
+		mosquitto_destroy(mosq_sensor);
+		mosquitto_lib_cleanup();
+		exit(ret == -1 ? EXIT_FAILURE : EXIT_SUCCESS);
 	}
 	else{
 		fprintf(stderr, "fork failed: %d --- %s\n", errno, strerror(errno));
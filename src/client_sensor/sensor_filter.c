@@ -0,0 +1,320 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: sensor_filter.c
+ * @brief: declarations of edge filter functions of sensor client
+ * @note: descriptions for the functions in sensor_filter.h
+*/
+
+
+#include"sensor_filter.h"
+
+// parses one stage of the chain spec, -1 if it is not valid
+static int filter_parse_stage(struct sensor_filter *f, char *item){
+
+	char *sep = strchr(item, ':');
+	char *end;
+
+	if(sep == NULL){
+		return -1;
+	}
+	*sep = '\0';
+
+	double arg = strtod(sep + 1, &end);
+	if(end == sep + 1 || arg < 0){
+		return -1;
+	}
+
+	if(strcmp(item, "heartbeat") == 0){
+		if(*end != '\0' || arg <= 0) return -1;
+		f->heartbeat = (int64_t)(arg * 1e9);
+		return 0;
+	}
+	if(f->stage_cnt == FILTER_STAGES_MAX){
+		return -1;
+	}
+
+	struct filter_stage *st = &f->stage[f->stage_cnt];
+
+	if(strcmp(item, "deadband") == 0 && *end == '%'){
+		if(end[1] != '\0') return -1;
+		st->kind = FILTER_DEADBAND_REL;
+		st->arg = arg / 100;
+	}
+	else if(*end != '\0'){
+		return -1;
+	}
+	else if(strcmp(item, "deadband") == 0){
+		st->kind = FILTER_DEADBAND;
+		st->arg = arg;
+	}
+	else if(strcmp(item, "decim") == 0 && arg >= 1){
+		st->kind = FILTER_DECIM;
+		st->arg = (long)arg;
+	}
+	else if(strcmp(item, "avg") == 0 && arg >= 1 && arg <= FILTER_WIN_MAX){
+		st->kind = FILTER_AVG;
+		st->arg = (int)arg;
+	}
+	else if(strcmp(item, "median") == 0 && arg >= 1 && arg <= FILTER_WIN_MAX){
+		st->kind = FILTER_MEDIAN;
+		st->arg = (int)arg;
+	}
+	else{
+		return -1;
+	}
+	f->stage_cnt++;
+
+	return 0;
+}
+
+// initializes filter from chain spec
+int sensor_filter_init(struct sensor_filter *f, const char *spec){
+
+	char buf[256];
+	char *save = NULL;
+
+	memset(f, 0, sizeof(struct sensor_filter));
+
+	if(snprintf(buf, sizeof(buf), "%s", spec) >= (int)sizeof(buf)){
+		fprintf(stderr, "error: filter %s is too long\n", spec);
+		return -1;
+	}
+
+	for(char *item = strtok_r(buf, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)){
+
+		char stage[64];
+		snprintf(stage, sizeof(stage), "%s", item);
+
+		if(filter_parse_stage(f, item) == -1){
+			fprintf(stderr, "error: filter stage %s is not valid\n", stage);
+			return -1;
+		}
+	}
+
+	f->chans = calloc(FILTER_CHANS_INIT, sizeof(struct filter_chan));
+	if(f->chans == NULL){
+		fprintf(stderr, "error: filter allocation failed\n");
+		return -1;
+	}
+	f->chan_sz = FILTER_CHANS_INIT;
+
+	return 0;
+}
+
+// frees state of every channel
+void sensor_filter_free(struct sensor_filter *f){
+
+	for(int i = 0; i < f->chan_sz; i++){
+		free(f->chans[i].state);
+	}
+	free(f->chans);
+	f->chans = NULL;
+	f->chan_cnt = 0;
+	f->chan_sz = 0;
+}
+
+// hashes channel name of len bytes(fnv-1a)
+static uint32_t filter_hash(const char *key, int len){
+
+	uint32_t h = 2166136261u;
+
+	for(int i = 0; i < len; i++){
+		h = (h ^ (unsigned char)key[i]) * 16777619u;
+	}
+	return h;
+}
+
+// finds entry of channel name in table of sz entries, or the empty entry where it belongs
+static struct filter_chan *filter_slot(struct filter_chan *chans, int sz, const char *key, int len){
+
+	uint32_t mask = sz - 1;
+	uint32_t i = filter_hash(key, len) & mask;
+
+	while(chans[i].used){
+
+		if(chans[i].key_len == len && memcmp(chans[i].key, key, len) == 0) break;
+		i = (i + 1) & mask;
+	}
+	return &chans[i];
+}
+
+// doubles table of channels, -1 on failure
+static int filter_grow(struct sensor_filter *f){
+
+	int sz = 2 * f->chan_sz;
+	struct filter_chan *chans = calloc(sz, sizeof(struct filter_chan));
+
+	if(chans == NULL){
+		return -1;
+	}
+	for(int i = 0; i < f->chan_sz; i++){
+
+		if(!f->chans[i].used) continue;
+		*filter_slot(chans, sz, f->chans[i].key, f->chans[i].key_len) = f->chans[i];
+	}
+	free(f->chans);
+	f->chans = chans;
+	f->chan_sz = sz;
+
+	return 0;
+}
+
+// finds state of channel name, adds it on its first reading at now, NULL if memory runs out
+static struct filter_chan *filter_chan_get(struct sensor_filter *f, const char *key, int len, int64_t now){
+
+	struct filter_chan *c = filter_slot(f->chans, f->chan_sz, key, len);
+
+	if(c->used){
+		return c;
+	}
+
+	// table grows when it gets half full
+	if(2 * (f->chan_cnt + 1) > f->chan_sz){
+		if(filter_grow(f) == -1) return NULL;
+		c = filter_slot(f->chans, f->chan_sz, key, len);
+	}
+
+	c->state = calloc(f->stage_cnt ? f->stage_cnt : 1, sizeof(struct filter_state));
+	if(c->state == NULL){
+		return NULL;
+	}
+	memcpy(c->key, key, len);
+	c->key_len = len;
+	c->used = 1;
+	c->last_pub = now;
+	f->chan_cnt++;
+
+	return c;
+}
+
+// puts value into window of n values of stage state
+static void filter_window_put(struct filter_state *s, int n, double value){
+
+	if(s->fill == n){
+		s->sum -= s->win[s->pos];
+	}
+	else{
+		s->fill++;
+	}
+	s->win[s->pos] = value;
+	s->sum += value;
+	s->pos = (s->pos + 1) % n;
+}
+
+// returns median of values in window of stage state
+static double filter_window_median(const struct filter_state *s){
+
+	double sorted[FILTER_WIN_MAX];
+	int n = s->fill;
+
+	// windows are short, insertion sort is the cheapest
+	for(int i = 0; i < n; i++){
+
+		int j = i;
+		while(j > 0 && sorted[j - 1] > s->win[i]){
+			sorted[j] = sorted[j - 1];
+			j--;
+		}
+		sorted[j] = s->win[i];
+	}
+	return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+// runs reading through the chain, 1 if it is published, 0 if it is dropped
+int sensor_filter_apply(struct sensor_filter *f, char *data, int len, int64_t now){
+
+	int data_len = strnlen(data, len);
+	const char *sep = memchr(data, ':', data_len);
+	int key_len = sep != NULL ? sep - data : 0;
+	char *value = sep != NULL ? (char*)sep + 1 : data;
+	char *end;
+
+	f->seen++;
+
+	// value ends where its trace starts
+	double v = strtod(value, &end);
+	if(end == value || (end != data + data_len && *end != ';') || key_len >= FILTER_KEY_LEN){
+		f->passed++;
+		return 1;
+	}
+
+	struct filter_chan *c = filter_chan_get(f, data, key_len, now);
+	if(c == NULL){
+		f->passed++;
+		return 1;
+	}
+
+	int keep = 1;
+	int smoothed = 0;
+
+	for(int i = 0; i < f->stage_cnt && keep; i++){
+
+		struct filter_stage *st = &f->stage[i];
+		struct filter_state *s = &c->state[i];
+
+		switch(st->kind){
+
+			case FILTER_AVG:
+				filter_window_put(s, (int)st->arg, v);
+				v = s->sum / s->fill;
+				smoothed = 1;
+				break;
+
+			case FILTER_MEDIAN:
+				filter_window_put(s, (int)st->arg, v);
+				v = filter_window_median(s);
+				smoothed = 1;
+				break;
+
+			case FILTER_DEADBAND:
+			case FILTER_DEADBAND_REL:
+			{
+				double band = st->kind == FILTER_DEADBAND ? st->arg : st->arg * fabs(s->ref);
+				if(s->have_ref && fabs(v - s->ref) <= band){
+					keep = 0;
+					break;
+				}
+				s->ref = v;
+				s->have_ref = 1;
+				break;
+			}
+
+			case FILTER_DECIM:
+				keep = s->cnt++ % (long)st->arg == 0;
+				break;
+		}
+	}
+
+	// quiet channel still shows it is alive
+	if(!keep && f->heartbeat > 0 && now - c->last_pub >= f->heartbeat){
+		keep = 1;
+	}
+	if(!keep){
+		return 0;
+	}
+	c->last_pub = now;
+	f->passed++;
+
+	// smoothed value replaces the sensor value, channel and trace stay
+	if(smoothed){
+
+		char buf[FILTER_KEY_LEN * 2];
+		int n = snprintf(buf, sizeof(buf), "%.*s%.6g%.*s", (int)(value - data), data, v,
+				(int)(data + data_len - end), end);
+
+		if(n < len){
+			memcpy(data, buf, n + 1);
+		}
+	}
+	return 1;
+}
+
+// prints how many readings were dropped by the filter
+void sensor_filter_report(const struct sensor_filter *f, FILE *out){
+
+	double cut = f->seen > 0 ? 100.0 * (f->seen - f->passed) / f->seen : 0;
+
+	fprintf(out, "sensor: filter passed %ld of %ld readings on %d channels, %.1f%% fewer publishes\n",
+			f->passed, f->seen, f->chan_cnt, cut);
+}
@@ -0,0 +1,102 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: sensor_filter.h
+ * @brief: definitions and descriptions of edge filter functions of sensor client
+*/
+
+
+#ifndef SENSOR_FILTER_H
+#define SENSOR_FILTER_H
+
+#include<stdlib.h>
+#include<stdio.h>
+#include<string.h>
+#include<stdint.h>
+#include<math.h>
+
+// readings pass a chain of stages between the pipe and the publisher, in the order they were given
+// smoothing stages replace the value, the others decide if the reading is published at all
+// every channel of a sensor runs the chain with its own state
+// chain is given as comma separated stages, e.g. "median:5,deadband:0.5,heartbeat:30":
+//   deadband:D	 publish when value differs by more than D from the last value that passed
+//   deadband:P%	 same, by more than P percent of the last value
+//   decim:N	 publish every Nth reading
+//   avg:N	 replace value with the moving average of the last N values
+//   median:N	 replace value with the median of the last N values
+//   heartbeat:S	 publish a reading anyway when channel published nothing for S seconds,
+//		 with a deadband this is report by exception
+// readings that are not numbers pass unchanged
+
+#define FILTER_STAGES_MAX	8	// stages of one chain
+#define FILTER_WIN_MAX		32	// values a smoothing window holds at most
+#define FILTER_CHANS_INIT	16	// channels the table has room for at first
+#define FILTER_KEY_LEN		48	// longest channel name, as long as a whole reading
+
+enum filter_kind{
+
+	FILTER_DEADBAND,		// absolute deadband
+	FILTER_DEADBAND_REL,		// deadband relative to the last value, fraction
+	FILTER_DECIM,			// decimation
+	FILTER_AVG,			// moving average
+	FILTER_MEDIAN			// moving median
+};
+
+// stage of the chain
+struct filter_stage{
+
+	enum filter_kind	kind;
+	double			arg;			// deadband, or N of the window or decimation
+};
+
+// state of one stage of one channel
+struct filter_state{
+
+	double		ref;				// last value that passed a deadband
+	int		have_ref;			// deadband has a value to compare with
+	long		cnt;				// readings seen by decimation
+	double		sum;				// sum of values in window of moving average
+	int		pos;				// next position in window
+	int		fill;				// values in window
+	double		win[FILTER_WIN_MAX];		// last values
+};
+
+// state of the chain of one channel
+struct filter_chan{
+
+	char		key[FILTER_KEY_LEN];		// channel name, empty for a sensor without channels
+	int		key_len;			// length of channel name
+	int		used;				// table entry holds a channel
+	int64_t		last_pub;			// monotonic time(ns) channel last published
+	struct filter_state *state;			// state of every stage
+};
+
+// chain of stages and its channels
+struct sensor_filter{
+
+	struct filter_stage	stage[FILTER_STAGES_MAX];	// stages in order
+	int			stage_cnt;		// amount of stages
+	int64_t			heartbeat;		// ns of silence after which a reading is published, 0 none
+	struct filter_chan	*chans;			// open addressing table of channels
+	int			chan_cnt;		// amount of channels
+	int			chan_sz;		// size of table, power of two
+	long			seen;			// readings given to the filter
+	long			passed;			// readings that passed it
+};
+
+
+// initializes filter from chain spec, -1 if spec is not valid
+int sensor_filter_init(struct sensor_filter *f, const char *spec);
+
+// frees state of every channel
+void sensor_filter_free(struct sensor_filter *f);
+
+// runs reading "[channel:]value[;trace]" of len bytes read at now(monotonic ns) through the chain
+// smoothed value is written into reading, which must have room for len bytes
+// returns 1 if reading is published, 0 if it is dropped
+int sensor_filter_apply(struct sensor_filter *f, char *data, int len, int64_t now);
+
+// prints how many readings were dropped by the filter
+void sensor_filter_report(const struct sensor_filter *f, FILE *out);
+
+#endif	// SENSOR_FILTER_H
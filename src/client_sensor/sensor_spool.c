@@ -0,0 +1,280 @@
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: sensor_spool.c
+ * @brief: declarations of disk spool functions of sensor client
+*/
+
+
+#include"sensor_spool.h"
+
+// parses spool item "name:arg" into spool, -1 if it is not valid
+static int spool_parse_item(struct sensor_spool *sp, char *item, double *max_mb){
+
+	char *sep = strchr(item, ':');
+	char *end;
+
+	if(sep == NULL){
+		return -1;
+	}
+	*sep = '\0';
+
+	double arg = strtod(sep + 1, &end);
+	if(end == sep + 1 || *end != '\0' || arg < 0){
+		return -1;
+	}
+
+	if(strcmp(item, "max") == 0 && arg > 0){
+		*max_mb = arg;
+	}
+	else if(strcmp(item, "rate") == 0){
+		sp->rate = arg;
+	}
+	else{
+		return -1;
+	}
+	return 0;
+}
+
+// reads boot id of the running system into boot, -1 if it is not known
+static int spool_boot_id(uint8_t *boot){
+
+	char buf[64];
+	int n = 0;
+
+	FILE *f = fopen(SPOOL_BOOT_ID, "r");
+	if(f == NULL){
+		return -1;
+	}
+
+	// boot id is a uuid, its hex digits are packed into bytes
+	memset(boot, 0, SPOOL_BOOT_LEN);
+	if(fgets(buf, sizeof(buf), f) != NULL){
+
+		for(const char *c = buf; *c != '\0' && n < 2 * SPOOL_BOOT_LEN; c++){
+
+			if(*c == '-') continue;
+			if(!isxdigit((unsigned char)*c)) break;
+
+			int v = isdigit((unsigned char)*c) ? *c - '0' : tolower((unsigned char)*c) - 'a' + 10;
+			boot[n / 2] = (boot[n / 2] << 4) | v;
+			n++;
+		}
+	}
+	fclose(f);
+
+	return n == 2 * SPOOL_BOOT_LEN ? 0 : -1;
+}
+
+// maps spool file with room for cap records, an existing spool keeps its own size, -1 on failure
+// file stays open and locked until the spool is closed
+static int spool_map(struct sensor_spool *sp, uint64_t cap){
+
+	struct stat st;
+	struct spool_hdr hdr = {0};
+	uint8_t boot[SPOOL_BOOT_LEN];
+
+	int fd = open(sp->path, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if(fd < 0){
+		fprintf(stderr, "error: opening spool %s failed(%d) --- %s\n", sp->path, errno, strerror(errno));
+		return -1;
+	}
+
+	// two clients writing the same ring would corrupt it
+	if(flock(fd, LOCK_EX | LOCK_NB) == -1){
+		if(errno == EWOULDBLOCK) fprintf(stderr, "error: spool %s is used by another sensor client\n", sp->path);
+		else fprintf(stderr, "error: locking spool %s failed(%d) --- %s\n", sp->path, errno, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	if(fstat(fd, &st) == -1){
+		fprintf(stderr, "error: opening spool %s failed(%d) --- %s\n", sp->path, errno, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	// readings of an earlier client are kept, so is the size of their ring
+	if(st.st_size >= (off_t)sizeof(hdr) && pread(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) &&
+	   hdr.magic == SPOOL_MAGIC && hdr.rec_size == sizeof(struct spool_rec) &&
+	   st.st_size == (off_t)(sizeof(hdr) + hdr.cap * sizeof(struct spool_rec))){
+		cap = hdr.cap;
+	}
+	else{
+		hdr.magic = 0;
+	}
+
+	// new spool is a sparse file, pages get allocated as readings are spooled
+	sp->len = sizeof(struct spool_hdr) + cap * sizeof(struct spool_rec);
+	if(hdr.magic == 0 && (ftruncate(fd, 0) == -1 || ftruncate(fd, sp->len) == -1)){
+		fprintf(stderr, "error: sizing spool %s failed(%d) --- %s\n", sp->path, errno, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	sp->hdr = mmap(NULL, sp->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(sp->hdr == MAP_FAILED){
+		fprintf(stderr, "error: mapping spool %s failed(%d) --- %s\n", sp->path, errno, strerror(errno));
+		sp->hdr = NULL;
+		close(fd);
+		return -1;
+	}
+	sp->recs = (struct spool_rec*)(sp->hdr + 1);
+	sp->fd = fd;
+
+	if(hdr.magic == 0){
+		sp->hdr->rec_size = sizeof(struct spool_rec);
+		sp->hdr->cap = cap;
+		sp->hdr->head = 0;
+		sp->hdr->tail = 0;
+		sp->hdr->dropped = 0;
+		sp->hdr->fresh = 0;
+		sp->hdr->magic = SPOOL_MAGIC;
+	}
+
+	// readings of an earlier boot keep their values, not their stamps
+	// boot that is not known is taken as a new one every time
+	if(spool_boot_id(boot) == -1){
+		memset(boot, 0, sizeof(boot));
+		sp->hdr->fresh = sp->hdr->head;
+	}
+	else if(memcmp(sp->hdr->boot, boot, sizeof(boot)) != 0){
+		sp->hdr->fresh = sp->hdr->head;
+	}
+	memcpy(sp->hdr->boot, boot, sizeof(boot));
+
+	return 0;
+}
+
+// opens or creates spool from its spec, -1 if spec is not valid or file can not be mapped
+int sensor_spool_open(struct sensor_spool *sp, const char *spec){
+
+	char buf[SPOOL_PATH_LEN + 64];
+	char *save = NULL;
+	double max_mb = SPOOL_MAX_MB;
+
+	memset(sp, 0, sizeof(struct sensor_spool));
+	sp->fd = -1;
+
+	if(snprintf(buf, sizeof(buf), "%s", spec) >= (int)sizeof(buf)){
+		fprintf(stderr, "error: spool %s is too long\n", spec);
+		return -1;
+	}
+
+	char *path = buf[0] == ',' ? NULL : strtok_r(buf, ",", &save);
+	if(path == NULL || snprintf(sp->path, SPOOL_PATH_LEN, "%s", path) >= SPOOL_PATH_LEN){
+		fprintf(stderr, "error: spool %s has no valid path\n", spec);
+		return -1;
+	}
+
+	for(char *item = strtok_r(NULL, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)){
+
+		char name[64];
+		snprintf(name, sizeof(name), "%s", item);
+
+		if(spool_parse_item(sp, item, &max_mb) == -1){
+			fprintf(stderr, "error: spool item %s is not valid\n", name);
+			return -1;
+		}
+	}
+
+	uint64_t cap = (uint64_t)(max_mb * (1 << 20)) / sizeof(struct spool_rec);
+	if(cap == 0 || spool_map(sp, cap) == -1){
+		return -1;
+	}
+	sp->dropped = sp->hdr->dropped;
+
+	return 0;
+}
+
+// flushes and unmaps spool, readings that were not drained stay in the file
+// closing the file releases its lock
+void sensor_spool_close(struct sensor_spool *sp){
+
+	if(sp->hdr == NULL){
+		return;
+	}
+	msync(sp->hdr, sp->len, MS_ASYNC);
+	munmap(sp->hdr, sp->len);
+	close(sp->fd);
+	sp->hdr = NULL;
+	sp->recs = NULL;
+	sp->fd = -1;
+}
+
+// returns amount of spooled readings
+long sensor_spool_count(const struct sensor_spool *sp){
+
+	return sp->hdr->head - sp->hdr->tail;
+}
+
+// adds reading read at read_ns, drops the oldest reading when ring is full
+// record is written before the head moves, so a crash leaves no half written reading in the ring
+void sensor_spool_push(struct sensor_spool *sp, const char *data, int64_t read_ns){
+
+	struct spool_hdr *hdr = sp->hdr;
+
+	if(hdr->head - hdr->tail == hdr->cap){
+		hdr->tail++;
+		hdr->dropped++;
+	}
+
+	struct spool_rec *rec = &sp->recs[hdr->head % hdr->cap];
+	memcpy(rec->data, data, SPOOL_DATA_LEN);
+	rec->read_ns = read_ns;
+
+	hdr->head++;
+	sp->spooled++;
+}
+
+// returns oldest spooled reading, NULL if spool is empty
+struct spool_rec *sensor_spool_peek(struct sensor_spool *sp){
+
+	if(sp->hdr->head == sp->hdr->tail){
+		return NULL;
+	}
+	return &sp->recs[sp->hdr->tail % sp->hdr->cap];
+}
+
+// returns 1 if oldest spooled reading was spooled in an earlier boot
+int sensor_spool_stale(const struct sensor_spool *sp){
+
+	return sp->hdr->tail < sp->hdr->fresh;
+}
+
+// removes oldest spooled reading that was drained at now(monotonic ns)
+// drain rate is kept by spacing readings evenly, a drain woken late catches up for SPOOL_SLACK_MS
+// at most, so time the spool was idle does not add up to a burst
+void sensor_spool_pop(struct sensor_spool *sp, int64_t now){
+
+	sp->hdr->tail++;
+	sp->drained++;
+
+	if(sp->rate > 0){
+
+		int64_t gap = (int64_t)(1e9 / sp->rate);
+		int64_t slack = (int64_t)SPOOL_SLACK_MS * 1000000;
+
+		if(sp->next_ns < now - slack){
+			sp->next_ns = now - slack;
+		}
+		sp->next_ns += gap;
+	}
+}
+
+// returns ms until next reading may be drained at now(monotonic ns), 0 now, -1 if spool is empty
+int sensor_spool_wait_ms(const struct sensor_spool *sp, int64_t now){
+
+	if(sp->hdr->head == sp->hdr->tail){
+		return -1;
+	}
+	if(sp->rate == 0 || now >= sp->next_ns){
+		return 0;
+	}
+	return (sp->next_ns - now + 999999) / 1000000;
+}
+
+// prints how many readings were spooled, drained, dropped and are left
+void sensor_spool_report(const struct sensor_spool *sp, FILE *out){
+
+	fprintf(out, "sensor: spool %s: %ld readings spooled, %ld drained, %lu dropped, %ld left\n", sp->path,
+		sp->spooled, sp->drained, (unsigned long)(sp->hdr->dropped - sp->dropped), sensor_spool_count(sp));
+}
@@ -0,0 +1,104 @@
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: sensor_spool.h
+ * @brief: definitions and descriptions of disk spool functions of sensor client
+*/
+
+
+#ifndef SENSOR_SPOOL_H
+#define SENSOR_SPOOL_H
+
+#include<stdlib.h>
+#include<stdio.h>
+#include<string.h>
+#include<stdint.h>
+#include<unistd.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<ctype.h>
+#include<sys/file.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+// readings the broker can not take are kept in a spool file until it is reachable again
+// the file is a header followed by a ring of fixed-size records written through mmap, readings
+// survive a restart of the sensor client and are drained by the next one
+// stamps are monotonic time, readings spooled before a reboot lose them and are published without trace
+// the file is locked while it is open, a second sensor client given the same spool fails to start
+// when the ring is full the oldest reading is dropped
+// spool is given as comma separated items, the path first, e.g. "/var/spool/s1,max:64,rate:500":
+//   max:MB	 size of the ring, an existing spool keeps the size it was made with
+//   rate:N	 readings drained per second after reconnect, 0 as fast as they are taken
+
+#define SPOOL_MAGIC		0x31505353	// "SSP1"
+#define SPOOL_DATA_LEN		48		// reading, as long as the reading of the sensor
+#define SPOOL_MAX_MB		16		// default size of the ring
+#define SPOOL_PATH_LEN		256		// longest spool path
+#define SPOOL_SLACK_MS		10		// drain that fell behind its rate catches up at most this much
+#define SPOOL_BOOT_ID		"/proc/sys/kernel/random/boot_id"	// changes with every boot
+#define SPOOL_BOOT_LEN		16		// bytes of the boot id
+
+// spooled reading and the monotonic time(ns) it was read from the pipe
+struct spool_rec{
+
+	char		data[SPOOL_DATA_LEN];		// reading written by the sensor
+	int64_t		read_ns;			// stamp of the read
+};
+
+// header of the spool file
+struct spool_hdr{
+
+	uint32_t	magic;				// SPOOL_MAGIC
+	uint32_t	rec_size;			// size of a record
+	uint64_t	cap;				// records the ring has room for
+	uint64_t	head;				// records written
+	uint64_t	tail;				// records drained or dropped
+	uint64_t	dropped;			// records dropped because ring was full
+	uint8_t		boot[SPOOL_BOOT_LEN];		// boot the stamps of the records were taken in
+	uint64_t	fresh;				// records before it were spooled in an earlier boot
+};
+
+// spool of a sensor client
+struct sensor_spool{
+
+	struct spool_hdr	*hdr;			// mapped file
+	struct spool_rec	*recs;			// ring of records after the header
+	size_t			len;			// mapped length
+	int			fd;			// spool file, locked while it is open
+	double			rate;			// readings drained per second, 0 no limit
+	int64_t			next_ns;		// monotonic time next reading may be drained
+	long			spooled;		// readings written by this client
+	long			drained;		// readings drained by this client
+	uint64_t		dropped;		// dropped readings when the spool was opened
+	char			path[SPOOL_PATH_LEN];	// spool file
+};
+
+
+// opens or creates spool from its spec, -1 if spec is not valid or file can not be mapped
+int sensor_spool_open(struct sensor_spool *sp, const char *spec);
+
+// flushes and unmaps spool, readings that were not drained stay in the file
+void sensor_spool_close(struct sensor_spool *sp);
+
+// returns amount of spooled readings
+long sensor_spool_count(const struct sensor_spool *sp);
+
+// adds reading read at read_ns, drops the oldest reading when ring is full
+void sensor_spool_push(struct sensor_spool *sp, const char *data, int64_t read_ns);
+
+// returns oldest spooled reading, NULL if spool is empty
+struct spool_rec *sensor_spool_peek(struct sensor_spool *sp);
+
+// returns 1 if oldest spooled reading was spooled in an earlier boot, its stamps mean nothing then
+int sensor_spool_stale(const struct sensor_spool *sp);
+
+// removes oldest spooled reading that was drained at now(monotonic ns)
+void sensor_spool_pop(struct sensor_spool *sp, int64_t now);
+
+// returns ms until next reading may be drained at now(monotonic ns), 0 now, -1 if spool is empty
+int sensor_spool_wait_ms(const struct sensor_spool *sp, int64_t now);
+
+// prints how many readings were spooled, drained, dropped and are left
+void sensor_spool_report(const struct sensor_spool *sp, FILE *out);
+
+#endif	// SENSOR_SPOOL_H
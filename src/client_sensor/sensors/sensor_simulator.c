@@ -3,54 +3,242 @@
 
 #include<stdio.h>
 #include<stdlib.h>
+#include<stdint.h>
 #include<time.h>	// time_t
 #include<unistd.h>	// write
 #include<string.h>	// strtod
 #include<errno.h>
+#include<signal.h>
+#include<limits.h>	// PIPE_BUF
+#include<getopt.h>
 
 #define DELAY		2
 #define UPPER		30
 #define LOWER		10
-#define SENSOR_DATA_LEN	20
+#define SENSOR_DATA_LEN	48	// reading "[channel:]value[;seq;t0]"
+
+#define MAX_CHANNELS	1000				// channels of one simulator
+#define WRITE_BATCH	(PIPE_BUF / SENSOR_DATA_LEN)	// readings written at once, write stays atomic
+
+// how readings are spread in time
+enum profile{
+
+	PROFILE_STEADY,			// evenly spaced readings
+	PROFILE_BURST			// bursts of readings at full speed, idle between them
+};
+
+// load generator settings
+struct sim_cfg{
+
+	double		rate;			// readings per second, 0 as fast as the pipe takes them
+	int		channels;		// simulated sensors, readings are "channel:value" when more than one
+	enum profile	profile;		// steady or burst
+	int		burst;			// readings in one burst
+	unsigned long	seed;			// seed of generated values
+	double		duration;		// seconds to run, 0 forever
+	int		trace;			// readings carry sequence number and monotonic stamp
+};
+
+static volatile sig_atomic_t s_stop = 0;
+
+// stops the generator so that it can report its rate
+static void sim_stop(int sig){
+
+	(void)sig;
+	s_stop = 1;
+}
+
+// returns monotonic time in nanoseconds, origin stamp of traced readings
+static long long sim_now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// returns monotonic time in seconds
+static double sim_now(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// sleeps until monotonic time t
+static void sim_sleep_until(double t){
+
+	struct timespec ts;
+	ts.tv_sec = (time_t)t;
+	ts.tv_nsec = (long)((t - ts.tv_sec) * 1e9);
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+// xorshift64* generator, same seed gives same readings
+static uint64_t sim_random(uint64_t *state){
+
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ULL;
+}
+
+// prints usage of the simulator
+static void sim_usage(const char *name){
+
+	fprintf(stderr, "usage: %s fd [-r rate] [-c channels] [-p steady|burst] [-b burst] [-s seed] [-d seconds] [-t]\n"
+			"  -r  readings per second, 0 as fast as possible(default one per %d s)\n"
+			"  -c  simulated sensors(1..%d, default 1)\n"
+			"  -p  steady spreads readings evenly, burst sends -b readings at once\n"
+			"  -b  readings in one burst(default 100)\n"
+			"  -s  seed of values(default time)\n"
+			"  -d  seconds to run, 0 forever(default)\n"
+			"  -t  trace readings: value;seq;monotonic ns\n", name, DELAY, MAX_CHANNELS);
+}
 
 int main(int argc, char *argv[]){
 
-	if(argc != 2){
+	struct sim_cfg cfg = { 1.0 / DELAY, 1, PROFILE_STEADY, 100, (unsigned long)time(NULL), 0, 0 };
+	int opt;
+
+	if(UPPER < LOWER){
+		fprintf(stderr, "error: upper limit is lower than lower limit\n");
+		exit(EXIT_FAILURE);
+	}
+
+	while((opt = getopt(argc, argv, "r:c:p:b:s:d:t")) != -1){
+
+		switch(opt){
+
+			case 'r': cfg.rate = strtod(optarg, NULL); break;
+			case 'c': cfg.channels = atoi(optarg); break;
+			case 'b': cfg.burst = atoi(optarg); break;
+			case 's': cfg.seed = strtoul(optarg, NULL, 10); break;
+			case 'd': cfg.duration = strtod(optarg, NULL); break;
+			case 't': cfg.trace = 1; break;
+			case 'p':
+				if(strcmp(optarg, "burst") == 0) cfg.profile = PROFILE_BURST;
+				else if(strcmp(optarg, "steady") == 0) cfg.profile = PROFILE_STEADY;
+				else{
+					sim_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			default:
+				sim_usage(argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	if(optind != argc - 1){
 		fprintf(stderr, "error: filedescriptor not specified\n");
+		sim_usage(argv[0]);
 		exit(EXIT_FAILURE);
 	}
-	
-	if(UPPER < LOWER){
-		fprintf(stderr, "error: upper limit is lower than lower limit\n");
+	if(cfg.rate < 0 || cfg.channels < 1 || cfg.channels > MAX_CHANNELS || cfg.burst < 1 || cfg.duration < 0){
+		fprintf(stderr, "error: invalid option\n");
+		sim_usage(argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
 	// get file descriptor of the pipe
-	int pipefd = strtod(argv[1], NULL);
+	int pipefd = strtod(argv[optind], NULL);
 	if(pipefd < 0){
 		fprintf(stderr, "invalid filedescriptor\n");
 		exit(EXIT_FAILURE);
 	}
 
-	char sensor_data[SENSOR_DATA_LEN] = {0};	// simulated sensor data
+	// report achieved rate also when stopped by a signal or a closed pipe
+	signal(SIGTERM, sim_stop);
+	signal(SIGINT, sim_stop);
+	signal(SIGPIPE, SIG_IGN);
 
-	// initialize seed for random number generator
-	srand(time(NULL));
+	// every channel has its own generator and sequence of traced readings
+	static uint64_t state[MAX_CHANNELS];
+	static uint32_t seq[MAX_CHANNELS];
+	for(int c = 0; c < cfg.channels; c++){
+		state[c] = (cfg.seed + 1) * 0x9E3779B97F4A7C15ULL + c;
+	}
 
-	while(1){
-		
-		// random number between upper and lower limits
-		int rval = (rand() % (UPPER - LOWER + 1)) + LOWER;	
-		sprintf(sensor_data, "%d", rval);
-		
-		if((write(pipefd, sensor_data, sizeof(sensor_data))) == -1){
-			
-			fprintf(stderr, "write failed: %d --- %s\n", errno, strerror(errno));
-			exit(EXIT_FAILURE);
+	char batch[WRITE_BATCH][SENSOR_DATA_LEN];	// simulated sensor data
+	long sent = 0;
+	int channel = 0;
+	double start = sim_now();
+
+	while(!s_stop){
+
+		double now = sim_now();
+		double elapsed = now - start;
+
+		if(cfg.duration > 0 && elapsed >= cfg.duration){
+			break;
+		}
+
+		// readings that are due now, steady profile sends them as they become due
+		// burst profile sends a whole burst once its first reading is due
+		long due;
+		if(cfg.rate == 0){
+			due = sent + WRITE_BATCH;
+		}
+		else if(cfg.profile == PROFILE_STEADY){
+			due = (long)(elapsed * cfg.rate) + 1;
 		}
 		else{
-			sleep(DELAY);
+			due = ((long)(elapsed * cfg.rate / cfg.burst) + 1) * cfg.burst;
 		}
+
+		if(due <= sent){
+
+			// sleep until the next reading or burst is due, at most until the end of the run
+			double next = cfg.profile == PROFILE_STEADY ? sent / cfg.rate : (double)(sent / cfg.burst * cfg.burst) / cfg.rate;
+			if(cfg.duration > 0 && next > cfg.duration){
+				next = cfg.duration;
+			}
+			sim_sleep_until(start + next);
+			continue;
+		}
+
+		int cnt = due - sent > WRITE_BATCH ? WRITE_BATCH : due - sent;
+
+		// whole batch goes to the pipe at once so it shares one origin stamp
+		long long stamp = cfg.trace ? sim_now_ns() : 0;
+
+		for(int i = 0; i < cnt; i++){
+
+			// random number between upper and lower limits
+			int rval = sim_random(&state[channel]) % (UPPER - LOWER + 1) + LOWER;
+
+			memset(batch[i], 0, SENSOR_DATA_LEN);
+			int len = 0;
+			if(cfg.channels > 1){
+				len = snprintf(batch[i], SENSOR_DATA_LEN, "%d:", channel);
+			}
+			if(cfg.trace){
+				snprintf(batch[i] + len, SENSOR_DATA_LEN - len, "%d;%u;%lld", rval, seq[channel]++, stamp);
+			}
+			else{
+				snprintf(batch[i] + len, SENSOR_DATA_LEN - len, "%d", rval);
+			}
+			channel = (channel + 1) % cfg.channels;
+		}
+
+		if((write(pipefd, batch, cnt * SENSOR_DATA_LEN)) == -1){
+
+			if(errno == EINTR) continue;
+			if(errno != EPIPE){
+				fprintf(stderr, "write failed: %d --- %s\n", errno, strerror(errno));
+			}
+			break;
+		}
+		sent += cnt;
+	}
+
+	double secs = sim_now() - start;
+	fprintf(stderr, "sensor: %ld readings on %d channels in %.2f s, achieved %.1f readings/s", sent, cfg.channels, secs, secs > 0 ? sent / secs : 0);
+	if(cfg.rate > 0){
+		fprintf(stderr, "(target %.1f)\n", cfg.rate);
+	}
+	else{
+		fprintf(stderr, "(target max)\n");
 	}
 
 	return EXIT_SUCCESS;
@@ -34,6 +34,98 @@ void client_setup_signal_handler(struct sigaction *sa){
 	}
 }
 
+// waits for the job of an idle client on its control pipe, -1 if the client is retired or stopped
+// shell writes a job at once, so it is read whole or the pipe is closed
+int client_wait_job(int ctl, struct proto_job *job){
+
+	int ret;
+
+	do{
+		ret = read(ctl, job, sizeof(struct proto_job));
+	}while(ret == -1 && errno == EINTR && !g_signal_caught);
+
+	if(ret != (int)sizeof(struct proto_job)){
+		return -1;
+	}
+
+	// strings come from the shell, still they must be terminated
+	job->ip[IP_ADDR_LEN - 1] = '\0';
+	job->topic[CLIENT_TOPIC_LEN - 1] = '\0';
+
+	return 0;
+}
+
+// shared memory ring to the shell and its wakeup eventfd
+static struct ring *s_ring = NULL;
+static int s_ring_efd = -1;
+
+// maps shared memory ring given by the shell, records go to the pipe when there is none
+void client_ring_attach(void){
+
+	const char *env = getenv(RING_ENV);
+	int memfd, efd;
+	struct stat st;
+
+	if(env == NULL || sscanf(env, "%d:%d", &memfd, &efd) != 2){
+		return;
+	}
+
+	if(fstat(memfd, &st) == -1 || st.st_size < (off_t)sizeof(struct ring)){
+		fprintf(stderr, "error: invalid shell ring, using pipe\n");
+		return;
+	}
+
+	void *mem = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	close(memfd);
+
+	if(mem == MAP_FAILED){
+		fprintf(stderr, "error: mapping shell ring failed(%d) --- %s, using pipe\n", errno, strerror(errno));
+		return;
+	}
+	s_ring = mem;
+	s_ring_efd = efd;
+
+	// shell frees the ring once it sees it closed and empty
+	atexit(client_ring_close);
+}
+
+// marks ring closed so the shell can free it
+void client_ring_close(void){
+
+	if(s_ring == NULL) return;
+
+	atomic_store(&s_ring->closed, 1);
+	eventfd_write(s_ring_efd, 1);
+	s_ring = NULL;
+}
+
+// sends record gathered from cnt buffers through the ring, -1 if shell does not drain it
+int client_ring_sendv(const struct iovec *iov, int cnt){
+
+	int ret;
+	int tries = 0;
+
+	// ring is full: make sure shell is awake and wait like a full pipe would block
+	while( (ret = ring_writev(s_ring, iov, cnt)) == -1 ){
+
+		if(++tries > RING_FULL_TRIES) return -1;
+		eventfd_write(s_ring_efd, 1);
+		usleep(RING_FULL_WAIT_US);
+	}
+
+	// shell sleeps only when ring was empty, so one wakeup covers a whole batch
+	if(ret == 1){
+		eventfd_write(s_ring_efd, 1);
+	}
+	return 0;
+}
+
+// checks if topic is a wildcard filter, its readings carry their concrete topic
+int client_topic_is_filter(const char *topic){
+
+	return strpbrk(topic, "+#") != NULL;
+}
+
 // initialises client information
 void client_init_info(struct client_info *info, int id, int fd, char *ip, char *topic){
 
@@ -42,6 +134,7 @@ void client_init_info(struct client_info *info, int id, int fd, char *ip, char *
 	info->pipefd = fd;
 	info->status = CLIENT_INITIAL;
 	info->slot_pos = -1;
+	memset(&info->trace, 0, sizeof(struct client_trace));
 
 	strcpy(info->ip, ip);
 	strcpy(info->topic, topic);
@@ -51,10 +144,10 @@ void client_init_info(struct client_info *info, int id, int fd, char *ip, char *
 // sends client information via file descriptor
 void client_send_info(struct client_info *info, struct mosquitto *mosq){
 
+#if DEBUG
+
 	int fd = info->pipefd;
 	int ret = 0;
-
-#if DEBUG
 	
 	if( (ret = write(fd, info->data, CLIENT_DATA_LEN)) == -1){
 
@@ -74,7 +167,30 @@ void client_send_info(struct client_info *info, struct mosquitto *mosq){
 	}
 #else
 
-	if( (ret = write(fd, info, sizeof(struct client_info))) == -1){
+	// status records carry the whole identity, data is sent by client_send_data
+	char rec[PROTO_RECORD_MAX];
+	struct iovec iov = { rec, proto_put_status(rec, info) };
+
+	client_send_iov(info, &iov, 1, mosq);
+
+#endif
+
+}
+
+// sends one record gathered from cnt buffers to the shell, terminates the client if shell is gone
+void client_send_iov(struct client_info *info, const struct iovec *iov, int cnt, struct mosquitto *mosq){
+
+	int ret;
+
+	// one record per write keeps records of different clients from interleaving
+	if(s_ring != NULL){
+		ret = client_ring_sendv(iov, cnt);
+	}
+	else{
+		ret = writev(info->pipefd, iov, cnt);
+	}
+
+	if(ret == -1){
 
 		fprintf(stderr, "client %d(%d): write failed(%d) --- %s\n", info->id, info->pid, errno, strerror(errno));
 		
@@ -85,9 +201,174 @@ void client_send_info(struct client_info *info, struct mosquitto *mosq){
 
 		exit(EXIT_FAILURE);
 	}
+}
 
-#endif
+// sends received payload to the shell with its typed value
+// header, trace and value are gathered with the payload itself, so payload is not copied on its way to the write
+// payload too large for one atomic record goes in fragments that the shell puts back together
+void client_send_data(struct client_info *info, const char *topic, const char *payload, int len, struct mosquitto *mosq){
+
+	char hdr[PROTO_HDR_LEN + PROTO_FRAG_LEN];
+	char pre[PROTO_TRACE_LEN + PROTO_VALUE_LEN + PROTO_TOPIC_MAX];	// trace, value and topic go before the payload
+	int pre_len = 0;
+	enum proto_type type = PROTO_DATA;
+	struct iovec iov[3];
+
+	int value_len = client_parse_trace(info, payload, len);
+
+	info->status = CLIENT_DATA_READY;
+	if(info->trace.on){
+		pre_len = proto_put_trace_body(pre, &info->trace);
+		type = PROTO_TRACE;
+	}
+
+	// rest of the body is bounded, so the shell takes every record within PROTO_BODY_MAX
+	if(value_len > PROTO_PAYLOAD_MAX){
+		fprintf(stderr, "client %d(%d): payload of %d bytes dropped, limit is %d\n", info->id, info->pid, value_len, PROTO_PAYLOAD_MAX);
+		return;
+	}
+
+	// concrete topic too long for a record leaves the reading to the subscription
+	int topic_len = topic != NULL ? (int)strlen(topic) : 0;
+	if(topic_len > PROTO_TOPIC_MAX){
+		topic = NULL;
+	}
+
+	// payload that is not a number is still sent, its value is tagged as text
+	value_parse(payload, value_len, &info->value);
+	pre_len += proto_put_value_body(pre + pre_len, &info->value, topic, topic_len);
+
+	// whole record fits one atomic write
+	if(PROTO_HDR_LEN + pre_len + value_len <= PROTO_RECORD_MAX){
+
+		proto_put_hdr(hdr, PROTO_HDR_LEN + pre_len + value_len, type, info->id);
+		iov[0] = (struct iovec){ hdr, PROTO_HDR_LEN };
+		iov[1] = (struct iovec){ pre, pre_len };
+		iov[2] = (struct iovec){ (char*)payload, value_len };
+		client_send_iov(info, iov, 3, mosq);
+		return;
+	}
+
+	// body is trace and value followed by payload, every fragment takes the next part of it
+	uint32_t total = pre_len + value_len;
+	uint32_t off = 0;
+
+	while(off < total){
+
+		int part = total - off < PROTO_FRAG_DATA_MAX ? (int)(total - off) : PROTO_FRAG_DATA_MAX;
+		int pre_part = off < (uint32_t)pre_len ? pre_len - (int)off : 0;
+		if(pre_part > part) pre_part = part;
+
+		iov[0] = (struct iovec){ hdr, proto_put_frag_hdr(hdr, info->id, type, total, off, part) };
+		iov[1] = (struct iovec){ pre + (pre_part ? off : 0), pre_part };
+		iov[2] = (struct iovec){ (char*)payload + off + pre_part - pre_len, part - pre_part };
+		client_send_iov(info, iov, 3, mosq);
+
+		off += part;
+	}
+}
+
+// returns monotonic time in nanoseconds
+int64_t client_mono_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// reconnect state of single topic client
+static struct client_backoff s_backoff;
+
+// returns backoff before next reconnect attempt in ms and counts the attempt
+// backoff doubles every attempt up to RECONN_MAX_MS, its second half is random(equal jitter)
+int client_backoff_next(struct client_backoff *b){
+
+	int ms = RECONN_MAX_MS;
+
+	if(b->attempt < 16 && (RECONN_MIN_MS << b->attempt) < RECONN_MAX_MS){
+		ms = RECONN_MIN_MS << b->attempt;
+	}
+	b->attempt++;
 
+	return ms / 2 + rand_r(&b->seed) % (ms / 2 + 1);
+}
+
+// connection is up, next loss starts again from the shortest backoff
+void client_backoff_up(struct client_backoff *b){
+
+	// clients started together get different backoffs
+	if(!b->established){
+		b->seed = getpid() ^ (unsigned int)client_mono_ns();
+		b->established = 1;
+	}
+	b->attempt = 0;
+	b->lost_ns = 0;
+}
+
+// connection is lost, returns 1 if this is the start of the loss, 0 if it was lost already
+int client_backoff_lost(struct client_backoff *b){
+
+	if(b->lost_ns != 0){
+		return 0;
+	}
+	b->lost_ns = client_mono_ns();
+	return 1;
+}
+
+// waits the backoff of the single topic client and reconnects, -1 if its connection was never up
+// signal ends the wait early, reconnect that fails shows up in the next loop
+int client_reconnect_wait(struct mosquitto *mosq){
+
+	if(!s_backoff.established){
+		return -1;
+	}
+	client_backoff_lost(&s_backoff);
+	poll(NULL, 0, client_backoff_next(&s_backoff));
+
+	if(!g_signal_caught){
+		mosquitto_reconnect(mosq);
+	}
+	return 0;
+}
+
+// parses trace of a payload and returns length of the value
+// traced payload "value;seq;t0;t1;t2" is split into the value and its trace stamped with receive time
+// payload that is not text, like json or a binary frame, is taken whole when its end is not a trace
+int client_parse_trace(struct client_info *info, const char *payload, int len){
+
+	info->trace.on = 0;
+
+	// trace is short, so it is searched only from the end of the payload
+	int from = len > CLIENT_TRACE_LEN ? len - CLIENT_TRACE_LEN : 0;
+	const char *sep = memchr(payload + from, TRACE_SEP, len - from);
+
+	if(sep == NULL){
+		return len;
+	}
+
+	// payload is not terminated, parse a terminated copy of the trace
+	char trace[CLIENT_TRACE_LEN];
+	unsigned long seq;
+	long long t0, t1, t2;
+	int trace_len = len - (sep + 1 - payload);
+
+	if(trace_len >= CLIENT_TRACE_LEN) return len;
+	memcpy(trace, sep + 1, trace_len);
+	trace[trace_len] = '\0';
+
+	int end = 0;
+	if(sscanf(trace, "%lu;%lld;%lld;%lld%n", &seq, &t0, &t1, &t2, &end) != 4 || end != trace_len){
+		return len;
+	}
+
+	info->trace.on = 1;
+	info->trace.seq = seq;
+	info->trace.ts[TRACE_SENSOR] = t0;
+	info->trace.ts[TRACE_READ] = t1;
+	info->trace.ts[TRACE_PUBLISH] = t2;
+	info->trace.ts[TRACE_RECEIVE] = client_mono_ns();
+
+	return sep - payload;
 }
 
 // connect callback function
@@ -98,6 +379,7 @@ void mqtt_cb_connect(struct mosquitto *mosq, void *obj, int rc){
 	// connection attempt to a broker succeeds
 	if(rc == 0){
 
+		client_backoff_up(&s_backoff);
 		info->status = CLIENT_CONN_SUCCESS;
 
 	#if DEBUG
@@ -107,7 +389,7 @@ void mqtt_cb_connect(struct mosquitto *mosq, void *obj, int rc){
 	#endif
 		client_send_info(info, mosq);
 
-		if(mosquitto_subscribe(mosq, NULL, info->topic ,QOS) != MOSQ_ERR_SUCCESS){
+		if(mosquitto_subscribe(mosq, NULL, info->topic, g_qos) != MOSQ_ERR_SUCCESS){
 
 		#if DEBUG
 
@@ -124,6 +406,16 @@ void mqtt_cb_connect(struct mosquitto *mosq, void *obj, int rc){
 		}
 	}
 
+	// reconnect attempt fails, client loop tries again after a longer backoff
+	else if(s_backoff.established){
+
+	#if DEBUG
+
+		fprintf(stderr, "DEBUG: user client %d reconnect refused (%d)\n", info->id, rc);
+
+	#endif
+	}
+
 	// connection attemp to a broker fails
 	else{
 
@@ -163,6 +455,15 @@ void mqtt_cb_disconnect(struct mosquitto *mosq, void *obj, int rc){
 
 	}
 
+	// connection that was up is restored by the client loop, shell is told once per loss
+	else if(s_backoff.established){
+
+		if(client_backoff_lost(&s_backoff)){
+			info->status = CLIENT_CONN_RETRY;
+			client_send_info(info, mosq);
+		}
+	}
+
 	// client disconnected abnormally
 	else{
 		
@@ -211,20 +512,19 @@ void mqqt_cb_message(struct mosquitto *mosq, void *obj, const struct mosquitto_m
 		fprintf(stdout, "DEBUG: client user received message %s\n", (char*)message->payload);
 
 	#endif
-		info->status = CLIENT_DATA_READY;
-		strcpy(info->data, (char*)message->payload);
-	}else{
-
-	#if DEBUG
+		client_send_data(info, client_topic_is_filter(info->topic) ? message->topic : NULL,
+				 message->payload, message->payloadlen, mosq);
+		return;
+	}
 
-		fprintf(stderr, "DEBUG: client user didnt receive a message\n");
-		info->status = CLIENT_DATA_MISSING;
+#if DEBUG
 
-	#endif
+	fprintf(stderr, "DEBUG: client user didnt receive a message\n");
 
-	}
+#endif
 
 	// send client information
+	info->status = CLIENT_DATA_MISSING;
 	client_send_info(info, mosq);
 }
 
@@ -239,3 +539,479 @@ void mqtt_setup_callbacks(struct mosquitto *mosq){
 
 
 
+// adds topic at position n to the index, duplicate topics keep the first client
+// wildcard filters are indexed too, so the same filter is found when it is unsubscribed
+static void client_mux_index_put(struct client_mux *mux, int n){
+
+	if(client_topic_is_filter(mux->infos[n].topic)){
+		mux->filters[mux->filter_cnt++] = n;
+	}
+
+	unsigned int mask = mux->index_sz - 1;
+	unsigned int i = hash_fnv1a_str(mux->infos[n].topic) & mask;
+
+	while(mux->index[i] != -1){
+		if(strcmp(mux->infos[mux->index[i]].topic, mux->infos[n].topic) == 0) return;
+		i = (i + 1) & mask;
+	}
+	mux->index[i] = n;
+}
+
+// rebuilds topic index for the current topics
+static void client_mux_index(struct client_mux *mux){
+
+	int sz = 2;
+
+	// keep index at most half full so probe sequences stay short
+	while(sz < 2 * mux->cnt){
+		sz <<= 1;
+	}
+	if(sz != mux->index_sz){
+
+		int *index = realloc(mux->index, sz * sizeof(int));
+		if(index == NULL){
+			fprintf(stderr, "error: multiplexed client allocation failed\n");
+			exit(EXIT_FAILURE);
+		}
+		mux->index = index;
+		mux->index_sz = sz;
+	}
+	memset(mux->index, -1, mux->index_sz * sizeof(int));
+	mux->filter_cnt = 0;
+
+	for(int n = 0; n < mux->cnt; n++){
+		client_mux_index_put(mux, n);
+	}
+}
+
+// cuts qos suffix off topic "topic[,qos:N]" and returns its quality of service, -1 if it is not valid
+int client_topic_split(char *topic){
+
+	int len;
+	int qos = proto_topic_qos(topic, &len);
+
+	if(qos == -1){
+		fprintf(stderr, "error: qos of topic %s is not valid\n", topic);
+		return -1;
+	}
+	topic[len] = '\0';
+	return qos;
+}
+
+// initializes multiplexed client from client id and topic argument pairs, topics may have a qos suffix
+void client_mux_init(struct client_mux *mux, int fd, char *ip, char *args[], int cnt){
+
+	memset(mux, 0, sizeof(struct client_mux));
+	mux->fd = fd;
+	snprintf(mux->ip, IP_ADDR_LEN, "%s", ip);
+
+	for(int n = 0; n < cnt; n++){
+
+		int qos = client_topic_split(args[2 * n + 1]);
+		if(qos == -1){
+			exit(EXIT_FAILURE);
+		}
+		client_mux_add(mux, strtod(args[2 * n], NULL), args[2 * n + 1], qos);
+	}
+}
+
+// adds topic of client id subscribed with qos to multiplexed client, returns its client information
+struct client_info *client_mux_add(struct client_mux *mux, int cid, char *topic, int qos){
+
+	if(mux->cnt == mux->cap){
+
+		int cap = mux->cap ? 2 * mux->cap : MUX_INIT_CNT;
+		struct client_info *infos = realloc(mux->infos, cap * sizeof(struct client_info));
+		int *sub_mids = infos != NULL ? realloc(mux->sub_mids, cap * sizeof(int)) : NULL;
+		int *sub_pos = sub_mids != NULL ? realloc(mux->sub_pos, cap * sizeof(int)) : NULL;
+		int *qoss = sub_pos != NULL ? realloc(mux->qos, cap * sizeof(int)) : NULL;
+		int *filters = qoss != NULL ? realloc(mux->filters, cap * sizeof(int)) : NULL;
+
+		if(infos != NULL) mux->infos = infos;
+		if(sub_mids != NULL) mux->sub_mids = sub_mids;
+		if(sub_pos != NULL) mux->sub_pos = sub_pos;
+		if(qoss != NULL) mux->qos = qoss;
+		if(filters == NULL){
+			fprintf(stderr, "error: multiplexed client allocation failed\n");
+			exit(EXIT_FAILURE);
+		}
+		mux->filters = filters;
+		mux->cap = cap;
+	}
+
+	int n = mux->cnt++;
+	client_init_info(&mux->infos[n], cid, mux->fd, mux->ip, topic);
+	mux->sub_mids[n] = -1;
+	mux->sub_pos[n] = 0;
+	mux->qos[n] = qos;
+
+	// index grows when it gets half full, otherwise the topic is only added
+	if(2 * mux->cnt > mux->index_sz){
+		client_mux_index(mux);
+	}
+	else{
+		client_mux_index_put(mux, n);
+	}
+
+	return &mux->infos[n];
+}
+
+// removes topic at position n from multiplexed client, last topic takes its position
+void client_mux_remove(struct client_mux *mux, int n){
+
+	mux->cnt--;
+	if(n != mux->cnt){
+		mux->infos[n] = mux->infos[mux->cnt];
+		mux->sub_mids[n] = mux->sub_mids[mux->cnt];
+		mux->sub_pos[n] = mux->sub_pos[mux->cnt];
+		mux->qos[n] = mux->qos[mux->cnt];
+	}
+	if(mux->sub_next >= mux->cnt){
+		mux->sub_next = 0;
+	}
+	client_mux_index(mux);
+}
+
+// finds position of client id in multiplexed client, -1 if it is unknown
+int client_mux_find_id(struct client_mux *mux, int cid){
+
+	for(int n = 0; n < mux->cnt; n++){
+		if(mux->infos[n].id == cid) return n;
+	}
+	return -1;
+}
+
+// frees resources of multiplexed client
+void client_mux_free(struct client_mux *mux){
+
+	free(mux->infos);
+	free(mux->sub_mids);
+	free(mux->sub_pos);
+	free(mux->qos);
+	free(mux->index);
+	free(mux->filters);
+	mux->infos = NULL;
+	mux->sub_mids = NULL;
+	mux->sub_pos = NULL;
+	mux->qos = NULL;
+	mux->index = NULL;
+	mux->filters = NULL;
+	mux->filter_cnt = 0;
+	mux->cnt = 0;
+	mux->cap = 0;
+	mux->index_sz = 0;
+}
+
+// finds client information subscribed to exactly this topic or filter, NULL if there is none
+struct client_info *client_mux_find_exact(struct client_mux *mux, const char *topic){
+
+	if(mux->cnt == 0){
+		return NULL;
+	}
+
+	unsigned int mask = mux->index_sz - 1;
+	unsigned int i = hash_fnv1a_str(topic) & mask;
+
+	while(mux->index[i] != -1){
+
+		struct client_info *info = &mux->infos[mux->index[i]];
+		if(strcmp(info->topic, topic) == 0){
+			return info;
+		}
+		i = (i + 1) & mask;
+	}
+	return NULL;
+}
+
+// finds client information of a topic, NULL if topic is unknown
+// topic without a client of its own goes to the first wildcard filter matching it
+struct client_info *client_mux_find(struct client_mux *mux, const char *topic){
+
+	struct client_info *info = client_mux_find_exact(mux, topic);
+
+	for(int k = 0; info == NULL && k < mux->filter_cnt; k++){
+
+		bool match = false;
+		struct client_info *f = &mux->infos[mux->filters[k]];
+
+		if(mosquitto_topic_matches_sub(f->topic, topic, &match) == MOSQ_ERR_SUCCESS && match){
+			info = f;
+		}
+	}
+	return info;
+}
+
+// sets status of every topic and sends the client information
+void client_mux_send_all(struct client_mux *mux, enum client_status status, struct mosquitto *mosq){
+
+	for(int n = 0; n < mux->cnt; n++){
+		mux->infos[n].status = status;
+		client_send_info(&mux->infos[n], mosq);
+	}
+}
+
+// connection of multiplexed client is down, topics are told once and next reconnect attempt is scheduled
+// called for every failure of the connection, only the first one of an attempt schedules the next
+void client_mux_lost(struct client_mux *mux, struct mosquitto *mosq){
+
+	mux->connected = 0;
+
+	if(client_backoff_lost(&mux->backoff)){
+		client_mux_send_all(mux, CLIENT_CONN_RETRY, mosq);
+	}
+	if(mux->retry_ns == 0){
+		mux->retry_ns = client_mono_ns() + (int64_t)client_backoff_next(&mux->backoff) * 1000000;
+	}
+}
+
+// reconnects multiplexed client once its backoff is over, returns ms until then, -1 if no attempt is due
+// broker that accepts the socket answers through the connect callback, refused socket is retried later
+int client_mux_reconnect(struct client_mux *mux, struct mosquitto *mosq){
+
+	if(mux->retry_ns == 0){
+		return -1;
+	}
+
+	int64_t left = mux->retry_ns - client_mono_ns();
+	if(left > 0){
+		return (left + 999999) / 1000000;
+	}
+
+	mux->retry_ns = 0;
+	if(mosquitto_reconnect(mosq) != MOSQ_ERR_SUCCESS){
+		client_mux_lost(mux, mosq);
+		return client_mux_reconnect(mux, mosq);
+	}
+	return -1;
+}
+
+// subscribes cnt topics from position n on the connection, MUX_SUB_BATCH topics of the same qos share a request
+// a broker acknowledges every topic of a request in one suback, other requests are served if one fails
+// request has a single qos, so a topic of another qos starts the next request
+void client_mux_subscribe(struct client_mux *mux, int n, int cnt, struct mosquitto *mosq){
+
+	for(int first = n, k; first < n + cnt; first += k){
+
+		int qos = mux->qos[first];
+		int mid;
+
+		for(k = 1; k < MUX_SUB_BATCH && first + k < n + cnt && mux->qos[first + k] == qos; k++);
+
+	#if MUX_SUB_BATCH > 1
+
+		char *topics[MUX_SUB_BATCH];
+		for(int i = 0; i < k; i++){
+			topics[i] = mux->infos[first + i].topic;
+		}
+		int rc = mosquitto_subscribe_multiple(mosq, &mid, k, topics, qos, 0, NULL);
+
+	#else
+
+		int rc = mosquitto_subscribe(mosq, &mid, mux->infos[first].topic, qos);
+
+	#endif
+		for(int i = 0; i < k; i++){
+
+			struct client_info *info = &mux->infos[first + i];
+
+			if(rc == MOSQ_ERR_SUCCESS){
+				mux->sub_mids[first + i] = mid;
+				mux->sub_pos[first + i] = i;
+				continue;
+			}
+
+		#if DEBUG
+
+			fprintf(stderr, "DEBUG: client %d subscription failed\n", info->id);
+
+		#endif
+			info->status = CLIENT_SUB_FAILURE;
+			client_send_info(info, mosq);
+		}
+	}
+}
+
+// handles jobs shell sent to a shared connection, -1 if shell released the connection
+// topic given to a live connection is subscribed on it without reconnecting
+int client_mux_control(struct client_mux *mux, int ctl, struct mosquitto *mosq){
+
+	struct proto_job jobs[MUX_JOB_BATCH];
+
+	// jobs are written whole and smaller than PIPE_BUF, so reads return whole jobs
+	int ret = read(ctl, jobs, sizeof(jobs));
+
+	if(ret == 0){
+		return -1;
+	}
+	if(ret == -1){
+		return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+	}
+
+	// topics of the jobs read together are subscribed together
+	// topics added before the connection is up are subscribed by the connect callback
+	int from = mux->cnt;
+
+	for(int k = 0; k < ret / (int)sizeof(struct proto_job); k++){
+
+		struct proto_job *job = &jobs[k];
+
+		if(job->op == JOB_SUB){
+
+			job->topic[CLIENT_TOPIC_LEN - 1] = '\0';
+
+			struct client_info *info = client_mux_add(mux, job->cid, job->topic, job->qos);
+			info->status = CLIENT_CREAT_SUCCESS;
+			client_send_info(info, mosq);
+
+			if(mux->connected){
+				info->status = CLIENT_CONN_SUCCESS;
+				client_send_info(info, mosq);
+			}
+		}
+		else if(job->op == JOB_UNSUB){
+
+			// removing moves the last topic, topics added so far are subscribed first
+			if(mux->connected){
+				client_mux_subscribe(mux, from, mux->cnt - from, mosq);
+			}
+			from = mux->cnt;
+
+			int n = client_mux_find_id(mux, job->cid);
+			if(n == -1) continue;
+
+			char topic[CLIENT_TOPIC_LEN];
+			strcpy(topic, mux->infos[n].topic);
+
+			mux->infos[n].status = CLIENT_UNSUB_SUCCESS;
+			client_send_info(&mux->infos[n], mosq);
+			client_mux_remove(mux, n);
+
+			// broker keeps sending a topic another client id still wants
+			if(client_mux_find_exact(mux, topic) == NULL){
+				mosquitto_unsubscribe(mosq, NULL, topic);
+			}
+			from = mux->cnt;
+		}
+	}
+	if(mux->connected){
+		client_mux_subscribe(mux, from, mux->cnt - from, mosq);
+	}
+	return 0;
+}
+
+// connect callback function for multiplexed client
+void mqtt_mux_cb_connect(struct mosquitto *mosq, void *obj, int rc){
+
+	struct client_mux *mux = (struct client_mux*)obj;
+
+	// reconnect attempt fails, it is tried again after a longer backoff
+	if(rc != 0 && mux->backoff.established){
+		client_mux_lost(mux, mosq);
+		return;
+	}
+
+	// connection attempt to a broker fails
+	if(rc != 0){
+
+		client_mux_send_all(mux, CLIENT_CONN_FAILURE, mosq);
+
+		// cleanup and free rescources before terminating
+		mosquitto_destroy(mosq);
+		mosquitto_lib_cleanup();
+		exit(EXIT_FAILURE);
+	}
+
+	mux->connected = 1;
+	client_backoff_up(&mux->backoff);
+	client_mux_send_all(mux, CLIENT_CONN_SUCCESS, mosq);
+
+	// subscribe every topic on the same connection, after a reconnect the clean session has none
+	mux->sub_next = 0;
+	client_mux_subscribe(mux, 0, mux->cnt, mosq);
+}
+
+// disconnect callback function for multiplexed client
+void mqtt_mux_cb_disconnect(struct mosquitto *mosq, void *obj, int rc){
+
+	struct client_mux *mux = (struct client_mux*)obj;
+
+	// client disconnected normally
+	if(rc == 0){
+		client_mux_send_all(mux, CLIENT_DISCON_SUCCESS, mosq);
+	}
+
+	// connection that was up is restored in place by the client loop
+	else if(mux->backoff.established){
+		client_mux_lost(mux, mosq);
+	}
+
+	// client disconnected abnormally
+	else{
+		client_mux_send_all(mux, CLIENT_CONN_LOST, mosq);
+
+		// cleanup and free rescources before terminating
+		mosquitto_destroy(mosq);
+		mosquitto_lib_cleanup();
+		exit(EXIT_FAILURE);
+	}
+}
+
+// subscribe callback function for multiplexed client
+void mqtt_mux_cb_subscribe(struct mosquitto *mosq, void *obj, int mid, int qos_count, const int *granted_qos){
+
+	struct client_mux *mux = (struct client_mux*)obj;
+
+	int start = mux->sub_next;
+	int found = 0;
+
+	// subacks arrive in request order and topics of a request follow each other,
+	// so search starts where previous one matched and ends when every topic of the request is found
+	for(int k = 0; k < mux->cnt && found < qos_count; k++){
+
+		int n = (start + k) % mux->cnt;
+
+		if(mux->sub_mids[n] != mid) continue;
+
+		// broker refuses a topic with granted qos 0x80
+		int pos = mux->sub_pos[n];
+		int refused = pos < qos_count && granted_qos[pos] >= 0x80;
+
+		mux->sub_next = (n + 1) % mux->cnt;
+		mux->sub_mids[n] = -1;
+		mux->infos[n].status = refused ? CLIENT_SUB_FAILURE : CLIENT_SUB_SUCCESS;
+		client_send_info(&mux->infos[n], mosq);
+		found++;
+	}
+}
+
+// message callback function for multiplexed client
+void mqtt_mux_cb_message(struct mosquitto *mosq, void *obj, const struct mosquitto_message *message){
+
+	struct client_mux *mux = (struct client_mux*)obj;
+
+	// demultiplex the message to the client of its topic, or of a wildcard filter matching it
+	struct client_info *info = client_mux_find(mux, message->topic);
+	if(info == NULL){
+		return;
+	}
+
+	if(message->payloadlen){
+		client_send_data(info, client_topic_is_filter(info->topic) ? message->topic : NULL,
+				 message->payload, message->payloadlen, mosq);
+		return;
+	}
+
+	// send client information
+	info->status = CLIENT_DATA_MISSING;
+	client_send_info(info, mosq);
+}
+
+// sets up callback functions for multiplexed mosquitto instance
+void mqtt_mux_setup_callbacks(struct mosquitto *mosq){
+
+	mosquitto_connect_callback_set(mosq, mqtt_mux_cb_connect);
+	mosquitto_disconnect_callback_set(mosq, mqtt_mux_cb_disconnect);
+	mosquitto_subscribe_callback_set(mosq, mqtt_mux_cb_subscribe);
+	mosquitto_message_callback_set(mosq, mqtt_mux_cb_message);
+}
+
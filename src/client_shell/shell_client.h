@@ -9,6 +9,10 @@
 #define SHELL_CLIENT_H
 
 #include"client_info.h"
+#include"client_proto.h"
+#include"client_ring.h"
+#include"client_value.h"
+#include"client_hash.h"
 #include<mosquitto.h>
 #include<stdio.h>
 #include<stdlib.h>
@@ -16,31 +20,132 @@
 #include<unistd.h>
 #include<signal.h>
 #include<errno.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<sys/eventfd.h>
+#include<sys/uio.h>
+#include<poll.h>
+#include<fcntl.h>
+#include<time.h>
 
 #define DEBUG		 0				// turn on(1) off(0) debugging	
 
 #define CLEAN_SESSION	 1
-#define QOS		 0				// mqtt quality of service
+#define QOS		 0				// mqtt quality of service of a topic without qos suffix
 #define PORT		 1883				// mqtt port number
 #define PING		 60				// mqtt ping interval in seconds
 #define TIMEOUT		 (-1)				// mqtt timeout 
 #define MAX_PACKETS	 1				// mqtt parameter for future use must be set to 1
 
+#define RING_FULL_WAIT_US 100				// wait between tries when shell ring is full
+#define RING_FULL_TRIES	 100000				// tries before shell is considered gone
+
+#define MUX_OPTION	 "-m"				// argument that starts client in multiplexed mode
+#define WORKER_OPTION	 "-w"				// argument that starts client idle, waiting for a job
+#define MUX_INIT_CNT	 8				// topics a multiplexed client has room for at first
+#define MUX_JOB_BATCH	 128				// jobs read from the control pipe at once
+#define MUX_SUB_BATCH	 128				// topics of one subscribe request, 1 sends a request per topic
+							// more than 1 needs mosquitto_subscribe_multiple(libmosquitto 1.6)
+#define MUX_POLL_MS	 1000				// wait of shared connection loop, keepalive is checked after it
+
+#define RECONN_MIN_MS	 100				// backoff before first reconnect attempt
+#define RECONN_MAX_MS	 10000				// longest backoff between reconnect attempts
+
+#define CLIENT_TRACE_LEN 80				// trace part of a traced payload: seq;t0;t1;t2
+
+// reconnect state of a connection
+// connection that was up once is restored in place when it is lost, attempts wait a backoff doubling
+// from RECONN_MIN_MS to RECONN_MAX_MS, half of it is random so clients of a restarted broker do not
+// reconnect all at once
+struct client_backoff{
+
+	int			established;		// connection was up once, only then it is restored
+	int			attempt;		// reconnect attempts since connection was lost
+	int64_t			lost_ns;		// monotonic time connection was lost, 0 while it is up
+	unsigned int		seed;			// seed of the random part of the backoff
+};
+
+// structure holding the topics of a multiplexed client
+// one mosquitto connection serves every topic, messages are demultiplexed by topic
+// pooled client keeps it as the shared connection to its broker, shell adds and removes topics
+struct client_mux{
+
+	struct client_info	*infos;			// client information of every topic
+	int			cnt;			// amount of topics
+	int			cap;			// topics infos has room for
+	int			fd;			// filedescriptor to which client information is sent
+	char			ip[IP_ADDR_LEN];	// broker ip address
+	int			connected;		// broker accepted the connection
+	int			*index;			// open addressing topic index(info position or -1)
+	int			index_sz;		// size of topic index, power of two
+	int			*filters;		// positions of wildcard filters
+	int			filter_cnt;		// amount of wildcard filters
+	int			*sub_mids;		// message ids of subscribe requests
+	int			*sub_pos;		// position of topic in its subscribe request
+	int			*qos;			// quality of service every topic is subscribed with
+	int			sub_next;		// info position where next suback is expected
+	struct client_backoff	backoff;		// reconnect state of the connection
+	int64_t			retry_ns;		// monotonic time of next reconnect attempt, 0 if none is due
+};
+
 // global variable used to indicate that signal was caught
 extern int g_signal_caught;
 
+// quality of service the single topic client subscribes with
+extern int g_qos;
+
 // signal handler for SIGINT or SIGTERM
 void client_sa_handler(int signo);
 
 // setup signal handler for client
 void client_setup_signal_handler(struct sigaction *sa);
 
+// checks if topic is a wildcard filter, its readings carry their concrete topic
+int client_topic_is_filter(const char *topic);
+
 // initialize client information
 void client_init_info(struct client_info *info, int id, int fd, char *ip, char *topic);
 
+// waits for the job of an idle client on its control pipe, -1 if the client is retired or stopped
+int client_wait_job(int ctl, struct proto_job *job);
+
+// maps shared memory ring given by the shell, records go to the pipe when there is none
+void client_ring_attach(void);
+
+// marks ring closed so the shell can free it
+void client_ring_close(void);
+
+// sends record gathered from cnt buffers through the ring, -1 if shell does not drain it
+int client_ring_sendv(const struct iovec *iov, int cnt);
+
+// returns monotonic time in nanoseconds
+int64_t client_mono_ns(void);
+
+// parses trace of a payload and returns length of the value
+int client_parse_trace(struct client_info *info, const char *payload, int len);
+
+// returns backoff before next reconnect attempt in ms and counts the attempt
+int client_backoff_next(struct client_backoff *b);
+
+// connection is up, next loss starts again from the shortest backoff
+void client_backoff_up(struct client_backoff *b);
+
+// connection is lost, returns 1 if this is the start of the loss, 0 if it was lost already
+int client_backoff_lost(struct client_backoff *b);
+
+// waits the backoff of the single topic client and reconnects, -1 if its connection was never up
+int client_reconnect_wait(struct mosquitto *mosq);
+
 // sends client information using file descriptor
 void client_send_info(struct client_info *info, struct mosquitto *mosq);
 
+// sends one record gathered from cnt buffers to the shell, terminates the client if shell is gone
+void client_send_iov(struct client_info *info, const struct iovec *iov, int cnt, struct mosquitto *mosq);
+
+// sends received payload of any length and its typed value to the shell without copying it
+// topic is the concrete topic of a reading of a wildcard subscription, NULL otherwise
+void client_send_data(struct client_info *info, const char *topic, const char *payload, int len, struct mosquitto *mosq);
+
 // mqtt connect callback function
 void mqtt_cb_connect(struct mosquitto *mosq, void *obj, int rc);
 
@@ -56,5 +161,61 @@ void mqqt_cb_message(struct mosquitto *mosq, void *obj, const struct mosquitto_m
 // mqtt sets up callback functions for mosquitto client
 void mqtt_setup_callbacks(struct mosquitto *mosq);
 
+// cuts qos suffix off topic "topic[,qos:N]" and returns its quality of service, -1 if it is not valid
+int client_topic_split(char *topic);
+
+// initializes multiplexed client from client id and topic argument pairs, topics may have a qos suffix
+void client_mux_init(struct client_mux *mux, int fd, char *ip, char *args[], int cnt);
+
+// adds topic of client id subscribed with qos to multiplexed client, returns its client information
+struct client_info *client_mux_add(struct client_mux *mux, int cid, char *topic, int qos);
+
+// removes topic at position n from multiplexed client, last topic takes its position
+void client_mux_remove(struct client_mux *mux, int n);
+
+// finds position of client id in multiplexed client, -1 if it is unknown
+int client_mux_find_id(struct client_mux *mux, int cid);
+
+// subscribes cnt topics from position n on the connection, MUX_SUB_BATCH topics of the same qos share a request
+// other topics are served if a request fails
+void client_mux_subscribe(struct client_mux *mux, int n, int cnt, struct mosquitto *mosq);
+
+// handles jobs shell sent to a shared connection, -1 if shell released the connection
+int client_mux_control(struct client_mux *mux, int ctl, struct mosquitto *mosq);
+
+// frees resources of multiplexed client
+void client_mux_free(struct client_mux *mux);
+
+// finds client information subscribed to exactly this topic or filter, NULL if there is none
+struct client_info *client_mux_find_exact(struct client_mux *mux, const char *topic);
+
+// finds client information of a topic, NULL if topic is unknown
+// topic without a client of its own goes to the first wildcard filter matching it
+struct client_info *client_mux_find(struct client_mux *mux, const char *topic);
+
+// sets status of every topic and sends the client information
+void client_mux_send_all(struct client_mux *mux, enum client_status status, struct mosquitto *mosq);
+
+// connection of multiplexed client is down, topics are told once and next reconnect attempt is scheduled
+void client_mux_lost(struct client_mux *mux, struct mosquitto *mosq);
+
+// reconnects multiplexed client once its backoff is over, returns ms until then, -1 if no attempt is due
+int client_mux_reconnect(struct client_mux *mux, struct mosquitto *mosq);
+
+// mqtt connect callback function for multiplexed client
+void mqtt_mux_cb_connect(struct mosquitto *mosq, void *obj, int rc);
+
+// mqtt disconnect callback function for multiplexed client
+void mqtt_mux_cb_disconnect(struct mosquitto *mosq, void *obj, int rc);
+
+// mqtt subscribe callback function for multiplexed client
+void mqtt_mux_cb_subscribe(struct mosquitto *mosq, void *obj, int mid, int qos_count, const int *granted_qos);
+
+// mqtt message callback function for multiplexed client
+void mqtt_mux_cb_message(struct mosquitto *mosq, void *obj, const struct mosquitto_message *message);
+
+// mqtt sets up callback functions for multiplexed mosquitto client
+void mqtt_mux_setup_callbacks(struct mosquitto *mosq);
+
 #endif	// SHELL_CLIENT_H
 
@@ -10,45 +10,123 @@
 
 // extern variable see shell_client.h
 int g_signal_caught = 0;
+int g_qos = QOS;
 
-int main(int argc, char *argv[]){
+// serves shared connection until shell releases it or client is stopped
+// mosquitto socket and control pipe are polled together, so topics come and go on the live session
+// lost connection is restored in place, control pipe is served while it is down, ctl -1 has no pipe
+static void client_shared_loop(struct client_mux *mux, int ctl, struct mosquitto *mosq){
 
-#if DEBUG
+	struct pollfd fds[2];
 
-	int cid = 0;
-	int fd = 0;
-	char *broker_ip = "127.0.0.1";
-	char *topic = "r/t";
+	fds[1].fd = ctl;
+	fds[1].events = POLLIN;
 
-#else
+	while(!g_signal_caught){
 
-	if(argc != 5){
+		// poll waits at most until the next reconnect attempt
+		int wait = client_mux_reconnect(mux, mosq);
+		if(wait == -1 || wait > MUX_POLL_MS){
+			wait = MUX_POLL_MS;
+		}
+
+		// socket is -1 until connected, poll skips it then
+		fds[0].fd = mosquitto_socket(mosq);
+		fds[0].events = POLLIN | (mosquitto_want_write(mosq) ? POLLOUT : 0);
+		fds[0].revents = 0;
+		fds[1].revents = 0;
+
+		if(poll(fds, 2, wait) == -1){
+
+			if(errno == EINTR) continue;
+			fprintf(stderr, "error: poll failed(%d) --- %s\n", errno, strerror(errno));
+			break;
+		}
+
+		int rc = MOSQ_ERR_SUCCESS;
+
+		if(fds[0].revents & (POLLIN | POLLERR | POLLHUP)){
+			rc = mosquitto_loop_read(mosq, MAX_PACKETS);
+		}
+		if(rc == MOSQ_ERR_SUCCESS && mosquitto_want_write(mosq)){
+			rc = mosquitto_loop_write(mosq, MAX_PACKETS);
+		}
+		if(rc == MOSQ_ERR_SUCCESS){
+			rc = mosquitto_loop_misc(mosq);
+		}
+
+		// connection that never came up ends the client, shell was told by the connect callback
+		if(rc != MOSQ_ERR_SUCCESS){
+			if(!mux->backoff.established) break;
+			client_mux_lost(mux, mosq);
+		}
+
+		if(fds[1].revents && client_mux_control(mux, ctl, mosq) == -1){
+			break;
+		}
+	}
+}
+
+// runs multiplexed client: shell_client -m fd ip cid topic [cid topic ...]
+static int client_mux_main(int argc, char *argv[]){
+
+	if(argc < 6 || (argc - 4) % 2 != 0){
 
 		fprintf(stderr, "error: incorrect amount of arguments\n");
 		exit(EXIT_FAILURE);
 	}
 
-	int cid = strtod(argv[1], NULL);		// client id
 	int fd = strtod(argv[2], NULL);			// filedescriptor to which send client information
 	char *broker_ip = argv[3];			// broker ip address to which client will connect
-	char *topic = argv[4];				// topic to which client will subscribe
-
-#endif
 
 	// setup signal handler
 	struct sigaction sa = {0};
 	client_setup_signal_handler(&sa);
 
-	// setup client information
-	struct client_info info;
-	client_init_info(&info, cid, fd, broker_ip, topic);
+	// use shared memory ring when shell gave one
+	client_ring_attach();
+
+	// setup information of every topic
+	struct client_mux mux;
+	client_mux_init(&mux, fd, broker_ip, &argv[4], (argc - 4) / 2);
 
 	// initialize the mosquitto library
 	mosquitto_lib_init();
 
-	// create mosquitto instance
-	struct mosquitto *mosq_client = NULL;
-	mosq_client = mosquitto_new(NULL, CLEAN_SESSION, &info);
+	// one mosquitto instance serves all topics
+	struct mosquitto *mosq_client = mosquitto_new(NULL, CLEAN_SESSION, &mux);
+
+	if(mosq_client == NULL){
+
+		client_mux_send_all(&mux, CLIENT_CREAT_FAILURE, mosq_client);
+		mosquitto_lib_cleanup();
+		exit(EXIT_FAILURE);
+	}
+	client_mux_send_all(&mux, CLIENT_CREAT_SUCCESS, mosq_client);
+
+	// set up callbacks and connect to a mosquitto broker
+	mqtt_mux_setup_callbacks(mosq_client);
+	if(mosquitto_connect(mosq_client, broker_ip, PORT, PING) != MOSQ_ERR_SUCCESS){
+		client_mux_send_all(&mux, CLIENT_CONN_FAILURE, mosq_client);
+	}
+
+	// main client loop, it has no control pipe
+	client_shared_loop(&mux, -1, mosq_client);
+
+	// client cleanup code
+	for(int n = 0; n < mux.cnt; n++){
+		mosquitto_unsubscribe(mosq_client, NULL, mux.infos[n].topic);
+	}
+	mosquitto_disconnect(mosq_client);
+	mosquitto_destroy(mosq_client);
+	mosquitto_lib_cleanup();
+	client_mux_free(&mux);
+
+	return EXIT_SUCCESS;
+}
+
+// runs single topic client until it is stopped, mosquitto instance is created with info as its object
+static int client_run(struct client_info *info, struct mosquitto *mosq_client){
 
 	if(mosq_client == NULL){
 	
@@ -57,8 +135,8 @@ int main(int argc, char *argv[]){
 		fprintf(stderr, "DEBUG: unable to create mosquitto instance\n");
 
 	#endif
-		info.status = CLIENT_CREAT_FAILURE;
-		client_send_info(&info, mosq_client);
+		info->status = CLIENT_CREAT_FAILURE;
+		client_send_info(info, mosq_client);
 
 		// clean up library before terminating
 		mosquitto_lib_cleanup();
@@ -72,32 +150,160 @@ int main(int argc, char *argv[]){
 
 	#endif
 	
-		info.status = CLIENT_CREAT_SUCCESS;
-		client_send_info(&info, mosq_client);
+		info->status = CLIENT_CREAT_SUCCESS;
+		client_send_info(info, mosq_client);
 	}
 
 	// set up callbacks for mosquitto client
 	mqtt_setup_callbacks(mosq_client);
 
 	// connect to a mosquitto broker
-	mosquitto_connect(mosq_client, broker_ip, PORT, PING);
+	mosquitto_connect(mosq_client, info->ip, PORT, PING);
 
-	// main client loop
+	// main client loop, lost connection is restored in place
 	while(1){
 
 		int con_loop = mosquitto_loop(mosq_client, TIMEOUT, MAX_PACKETS);
-		if(con_loop != MOSQ_ERR_SUCCESS) break;
 		if(g_signal_caught){
 			break;
 		}
+		if(con_loop != MOSQ_ERR_SUCCESS && client_reconnect_wait(mosq_client) == -1) break;
+	}
+
+	// client cleanup code
+	mosquitto_unsubscribe(mosq_client, NULL, info->topic);
+	mosquitto_disconnect(mosq_client);
+	mosquitto_destroy(mosq_client);
+	mosquitto_lib_cleanup();
+
+	return EXIT_SUCCESS;
+}
+
+// runs pooled client: shell_client -w ctl fd
+// client is started, linked and initialized before it is needed, then waits for the
+// shell to give it a client id, broker and topic through its control pipe
+// it stays the shared connection to that broker, later topics of it come through the same pipe
+static int client_worker_main(int argc, char *argv[]){
+
+	if(argc != 4){
+
+		fprintf(stderr, "error: incorrect amount of arguments\n");
+		exit(EXIT_FAILURE);
 	}
 
+	int ctl = strtod(argv[2], NULL);		// control pipe from which jobs are read
+	int fd = strtod(argv[3], NULL);			// filedescriptor to which send client information
+
+	// setup signal handler
+	struct sigaction sa = {0};
+	client_setup_signal_handler(&sa);
+
+	// use shared memory ring when shell gave one
+	client_ring_attach();
+
+	// mosquitto instance is ready before the job, topics are added once it comes
+	struct client_mux mux;
+	mosquitto_lib_init();
+	struct mosquitto *mosq_client = mosquitto_new(NULL, CLEAN_SESSION, &mux);
+
+	struct proto_job job;
+	if(client_wait_job(ctl, &job) == -1 || job.op != JOB_SUB){
+
+		// shell retired the client before it was needed
+		if(mosq_client != NULL) mosquitto_destroy(mosq_client);
+		mosquitto_lib_cleanup();
+		return EXIT_SUCCESS;
+	}
+
+	// further jobs are taken between network events
+	fcntl(ctl, F_SETFL, O_NONBLOCK);
+
+	client_mux_init(&mux, fd, job.ip, NULL, 0);
+	client_mux_add(&mux, job.cid, job.topic, job.qos);
+
+	if(mosq_client == NULL){
+
+		client_mux_send_all(&mux, CLIENT_CREAT_FAILURE, mosq_client);
+		mosquitto_lib_cleanup();
+		exit(EXIT_FAILURE);
+	}
+	client_mux_send_all(&mux, CLIENT_CREAT_SUCCESS, mosq_client);
+
+	// set up callbacks and connect to a mosquitto broker
+	// broker that refuses the socket is reported like one refusing the connection
+	mqtt_mux_setup_callbacks(mosq_client);
+	if(mosquitto_connect(mosq_client, mux.ip, PORT, PING) != MOSQ_ERR_SUCCESS){
+		client_mux_send_all(&mux, CLIENT_CONN_FAILURE, mosq_client);
+	}
+	else{
+		client_shared_loop(&mux, ctl, mosq_client);
+	}
+	close(ctl);
+
 	// client cleanup code
-	mosquitto_unsubscribe(mosq_client, NULL, topic);
+	for(int n = 0; n < mux.cnt; n++){
+		mosquitto_unsubscribe(mosq_client, NULL, mux.infos[n].topic);
+	}
 	mosquitto_disconnect(mosq_client);
 	mosquitto_destroy(mosq_client);
 	mosquitto_lib_cleanup();
+	client_mux_free(&mux);
 
 	return EXIT_SUCCESS;
 }
 
+int main(int argc, char *argv[]){
+
+	if(argc > 1 && strcmp(argv[1], MUX_OPTION) == 0){
+		return client_mux_main(argc, argv);
+	}
+	if(argc > 1 && strcmp(argv[1], WORKER_OPTION) == 0){
+		return client_worker_main(argc, argv);
+	}
+
+#if DEBUG
+
+	int cid = 0;
+	int fd = 0;
+	char *broker_ip = "127.0.0.1";
+	char *topic = "r/t";
+
+#else
+
+	if(argc != 5){
+
+		fprintf(stderr, "error: incorrect amount of arguments\n");
+		exit(EXIT_FAILURE);
+	}
+
+	int cid = strtod(argv[1], NULL);		// client id
+	int fd = strtod(argv[2], NULL);			// filedescriptor to which send client information
+	char *broker_ip = argv[3];			// broker ip address to which client will connect
+	char *topic = argv[4];				// topic to which client will subscribe, may have a qos suffix
+
+	if((g_qos = client_topic_split(topic)) == -1){
+		exit(EXIT_FAILURE);
+	}
+
+#endif
+
+	// setup signal handler
+	struct sigaction sa = {0};
+	client_setup_signal_handler(&sa);
+
+	// use shared memory ring when shell gave one
+	client_ring_attach();
+
+	// setup client information
+	struct client_info info;
+	client_init_info(&info, cid, fd, broker_ip, topic);
+
+	// initialize the mosquitto library
+	mosquitto_lib_init();
+
+	// create mosquitto instance
+	struct mosquitto *mosq_client = NULL;
+	mosq_client = mosquitto_new(NULL, CLEAN_SESSION, &info);
+
+	return client_run(&info, mosq_client);
+}
@@ -9,75 +9,46 @@
 
 #include"shell.h"
 
-void shell_sa_handler(int signo){
+// blocks sigint and sigchld and returns signalfd from which the event loop reads them
+int shell_setup_signal_fd(void){
 
-	g_signal_caught = signo;
-}
-
-// setup singal handler for shell
-void shell_setup_signal_handler(struct sigaction *sa){
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGCHLD);
 
-	sa->sa_handler = shell_sa_handler;
-	sa->sa_flags = 0;
-	sigfillset(&sa->sa_mask);
+	return shell_signalfd_open(&mask);
+}
 
-	if(sigaction(SIGINT, sa, NULL) == -1){
+// returns monotonic time in nanoseconds
+int64_t shell_mono_ns(void){
 
-		int en = errno;
-		fprintf(stderr, "ERROR cannot install SIGINT(%d) --- %s\n", en, strerror(en));
-		exit(EXIT_FAILURE);
-	}
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
-// read option number from user
-int shell_read_option(){
+// parses option number from input line, -1 if line is not a number
+int shell_parse_option(const char *line){
 
-	int opt = 0;
-	int res = scanf("%d", &opt);
+	char *end = NULL;
+	long opt = strtol(line, &end, 10);
 
-	getchar();
-	if(res == EOF){
-		fprintf(stdout, "error: EOF caught, try again\n");
-	}
-	if(res == 0){
-		while(fgetc(stdin) != '\n');
+	if(end == line || *end != '\0' || opt < 0 || opt > INT_MAX){
+		return -1;
 	}
-
-	return opt;
+	return (int)opt;
 }
 
-// reads string from the user
-int shell_read_string(char *prompt, char *str, size_t sz){
+// copies input line to a string checking its length
+int shell_parse_string(const char *line, char *str, size_t sz){
 
-	int ch;
-	int extra;	// excess characters
-	
-	if(prompt != NULL){
-		printf("%s", prompt);
-		fflush(stdout);
-	}
-
-	// reading input failed
-	if(fgets(str, sz, stdin) == NULL){
-		return INPUT_FAIL;
-	}
+	size_t len = strlen(line);
 
-	if(str[0] == '\n') return INPUT_SHORT;
+	if(len == 0) return INPUT_SHORT;
+	if(len >= sz) return INPUT_LONG;
 
-	// if string was too long flush till the end of line
-	if(str[strlen(str)-1] != '\n'){
-		extra = 0;
-		while( ((ch = getchar()) != '\n') && (ch != EOF)){
-			extra = 1;
-		}
-		if(extra == 1){
-			return INPUT_LONG;
-		}
-		return INPUT_OK;
-	}
-
-	// remove newline and give string to caller
-	str[strlen(str)-1] = '\0';
+	memcpy(str, line, len + 1);
 	return INPUT_OK;
 }
 
@@ -154,151 +125,103 @@ int shell_validate_address(char *ip){
 
 #if USE_BUILTIN
 
-// finds most significant bit from 32bit value
-int find_msb(int x){
-	
-	// uses gcc builtin function to count leading zeros
-	// zero is not passed to function to avoid undefined behaviour
-	if(x == 0) return 0;
-	return 31 - __builtin_clz(x);
-}
-
 // terminates the shell and all client processes
 void shell_terminate_blt(int *flag, struct client_list *clist){
 
-	int temp = clist->slots;
 	*flag = SHELL_TERMINATE;
 
-	while(temp != 0){
+	for(int w = 0; w < SLOT_WORDS(clist->cap); w++){
+
+		unsigned int temp = clist->slots[w];
 
-		// find set slot from client list
-		int n = FIND_SET_SLOT(temp);
-		temp = temp ^ (1 << n);
+		while(temp != 0){
+
+			// find set slot from client list
+			int b = FIND_SET_SLOT(temp);
+			int n = w * SLOT_WORD_BITS + b;
+			temp = temp ^ (1u << b);
 		
-		// send termination signal to the client process
-		kill(clist->clients[n].pid, SIGUSR1);
-		fprintf(stdout, "sending signal to client %d(%d)\n", clist->clients[n].id, clist->clients[n].pid);
+			// send termination signal to the client process
+			kill(clist->clients[n].pid, SIGUSR1);
+			fprintf(stdout, "sending signal to client %d(%d)\n", clist->clients[n].id, clist->clients[n].pid);
+		}
 	}
 }
 
 // adds client to client list and sets slot position for the client
 void shell_add_client_blt(struct client_info *client, struct client_list *clist){
 
-	int slots = clist->slots;
-	int slots_inv = slots;
-
-	// mask(reverse) the slot values
-	// now all set bits in slots_inv are empty slots
-	slots_inv = slots_inv ^ CLIENT_SLOTS_FULL;
-
-	// find empty slot
-	int n = FIND_EMPTY_SLOT(slots_inv);
-		
-	// set slot for the new client
-	slots = slots | (1 << n);
-	clist->slots = slots;
-
-	// set clients position in the client list
-	client->slot_pos = n;
-
-	// add new client to client list
-	clist->clients[n] = *(client);
-
-	if(clist->slots == (clist->slots_max)){
-		clist->full = true;
-	}
+	// free slot is taken from the free slot stack, list grows when it runs out
+	shell_clist_add(clist, client);
 }
 
 // finds and removes client from client list
 void shell_rm_client_blt(pid_t pid, struct client_list *clist){
 
-	int slots = clist->slots;
-	int temp = slots;
+	int n;
 
-	// search for a client using process id
-	while(temp != 0){
+	// search for a client using process id index
+	// multiplexed client process may own many slots
+	while( (n = shell_clist_find_pid(clist, pid)) != -1 ){
+			
+		// remove the client
+		// doesnt actually remove the client from the client list 
+		// just sets the slot where client resides as empty
+		shell_clist_rm_slot(clist, n);
+	}
+}
 
-		int n = FIND_SET_SLOT(temp);
-		temp = temp ^ (1 << n);
+// finds and removes client id from client list, process of the client may serve other ids
+void shell_rm_client_id_blt(int id, struct client_list *clist){
 
-		if(clist->clients[n].pid == pid){
-			
-			// remove the client
-			// doesnt actually remove the client from the client list 
-			// just sets the slot where client resides as empty
+	// search for a client using client id index
+	int n = shell_clist_find_id(clist, id);
 
-			clist->slots = slots ^ (1 << n);
-		}
+	if(n != -1){
+		shell_clist_rm_slot(clist, n);
 	}
 }
 
 // shows clients that are currently connected
 void shell_show_clients_blt(struct client_list *clist){
 
-	int temp = clist->slots;
 	struct client_info *clients = clist->clients;
 	
-	fprintf(stdout, "connected clients:\n");
-	fprintf(stdout, "OPTION	CID	PID	SENSOR\n");
-
-	while(temp != 0){
+	int64_t now = shell_mono_ns();
 
-		int n = FIND_SET_SLOT(temp);
-		temp = temp ^ (1 << n);
-		fprintf(stdout, "%d %d	%d	%s\n", n, clients[n].id, clients[n].pid, clients[n].topic);
-	}
-}
+	fprintf(stdout, "connected clients:\n");
+	fprintf(stdout, "OPTION	CID	PID	SENSOR	");
+	shell_stats_print_head(stdout);
+	fprintf(stdout, "\n");
 
-// connects to a sensor
-void shell_connect_sensor_blt(char *pipefd){
+	for(int w = 0; w < SLOT_WORDS(clist->cap); w++){
 
-	char ip[IP_ADDR_LEN];
-	char topic[TOPIC_MAX_LEN];
+		unsigned int temp = clist->slots[w];
 
-	int ret = shell_read_string("enter ip address of the broker: ", ip, sizeof(ip));
-	if(ret == INPUT_FAIL){
-		fprintf(stderr, "error: reading input failed\n");
-	}
-	if(ret == INPUT_OK){
+		while(temp != 0){
 
-		if(shell_validate_address(ip)){
-			
-			int ret = shell_read_string("enter topic of the sensor: ", topic, sizeof(topic));
-		
-			if(ret == INPUT_FAIL){
-				fprintf(stderr, "error: reading input failed\n");
-			}
-			if(ret == INPUT_LONG){
-				fprintf(stderr, "error: topic is too long\n");
-			}
-			if(ret == INPUT_SHORT){
-				fprintf(stderr, "error: topic is too short");
-			}
-			if(ret == INPUT_OK){
-				shell_create_client(pipefd, ip, topic);
-			}
-		}
-		else{
-			fprintf(stderr, "error: invalid ip address\n");
+			int b = FIND_SET_SLOT(temp);
+			int n = w * SLOT_WORD_BITS + b;
+			temp = temp ^ (1u << b);
+			fprintf(stdout, "%d %d	%d	%s	", n, clients[n].id, clients[n].pid, clients[n].topic);
+			shell_stats_print(stdout, &clist->stats[n], now);
+			fprintf(stdout, "\n");
 		}
 	}
 }
 
 // disconnects from a sensor
-void shell_disconnect_sensor_blt(struct client_list *clist){
+void shell_disconnect_sensor_blt(struct shell_pool *pool, struct client_list *clist, int option){
 
-	int slots = clist->slots;
 	struct client_info *clients = clist->clients;
 
-	// show connected clients
-	shell_show_clients_blt(clist);
-
-	fprintf(stdout, "option: ");
-	int option = shell_read_option();
-	
-	if( !(slots & (1 << option)) ){
+	if( option < 0 || option >= clist->cap || !SLOT_IS_SET(clist, option) ){
 		fprintf(stdout, "error: invalid option, no such option is available\n");
 	}
+	// topic of a shared connection is unsubscribed, other topics keep the connection
+	else if(shell_pool_unsubscribe(pool, clients[option].pid, clients[option].id) == 0){
+		fprintf(stdout, "unsubscribing client %d(%d)\n", clients[option].id, clients[option].pid);
+	}
 	else{
 		// send termination signal to a client process
 		kill(clients[option].pid, SIGUSR1);
@@ -312,15 +235,14 @@ void shell_disconnect_sensor_blt(struct client_list *clist){
 // terminates the shell and all client processes
 void shell_terminate(int *flag, struct client_list *clist){
 
-	int slots = clist->slots;
 	struct client_info *clients = clist->clients;
 
 	*flag = SHELL_TERMINATE;		// set shell termination flag
 	
-	for(int n = 0; n < CLIENTS_MAX_CNT; n++){
+	for(int n = 0; n < clist->cap; n++){
 	
 		// find set slot
-		if( (slots & (1 << n)) ){
+		if( SLOT_IS_SET(clist, n) ){
 
 			// send termination signal to the client process
 			kill(clients[n].pid, SIGUSR1);
@@ -332,283 +254,704 @@ void shell_terminate(int *flag, struct client_list *clist){
 // adds client to client list and sets slot position for the client
 void shell_add_client(struct client_info *client, struct client_list *clist){
 
-	int slots = clist->slots;
-	
-	for(int n = 0; n < CLIENTS_MAX_CNT; n++){
-
-		// find empty slot
-		if( !(slots & (1 << n)) ){
-			
-			// set slot for the new client
-			slots = slots | (1 << n);
-			clist->slots = slots;
-
-			// set clients position in the client list
-			client->slot_pos = n;
-
-			// add new client to client list
-			clist->clients[n] = *(client);
-			break;
-		}
-	}
-	if(clist->slots == clist->slots_max){
-		clist->full = true;
-	}
+	// free slot is taken from the free slot stack, list grows when it runs out
+	shell_clist_add(clist, client);
 }
 
 // finds and removes client from client list
 void shell_rm_client(pid_t pid, struct client_list *clist){
 
-	int slots = clist->slots;
 	struct client_info *clients = clist->clients;
 
 	// search for a client using process id
-	for(int n = 0; n < CLIENTS_MAX_CNT; n++){
+	// multiplexed client process may own many slots
+	for(int n = 0; n < clist->cap; n++){
 		
 		// find set slot
-		if( (slots & (1 << n)) ){
+		if( SLOT_IS_SET(clist, n) ){
 
 			if(clients[n].pid == pid){
 		
 				// remove the client
 				// doesnt actually remove the client from the client list 
 				// just sets the slot where client resides as empty
-
-				clist->slots = slots ^ (1 << n);
+				shell_clist_rm_slot(clist, n);
 			}
 		}
 	}
 }
 
-// deletes client from the client list(outdated function not in use)
-void shell_del_client(int *client_slots, pid_t pid, int n){
+// finds and removes client id from client list, process of the client may serve other ids
+void shell_rm_client_id(int id, struct client_list *clist){
+
+	struct client_info *clients = clist->clients;
 
-	// does not actually delete the client from the list just sets the slot for that client as empty
-	// so the client can be later just be overwritten
-	// also sends termination signal to the client process
+	for(int n = 0; n < clist->cap; n++){
 
-	*client_slots = *client_slots ^ (1 << n);
-	kill(pid, SIGUSR1);
+		// find set slot
+		if( SLOT_IS_SET(clist, n) && clients[n].id == id ){
+			shell_clist_rm_slot(clist, n);
+			return;
+		}
+	}
 }
 
 // shows clients that are currently connected
 void shell_show_clients(struct client_list *clist){
 
-	int slots = clist->slots;
 	struct client_info *clients = clist->clients;
 	
+	int64_t now = shell_mono_ns();
+
 	fprintf(stdout, "connected clients:\n");
-	fprintf(stdout, "CID	PID	SENSOR IP\n");
+	fprintf(stdout, "OPTION	CID	PID	SENSOR	IP	");
+	shell_stats_print_head(stdout);
+	fprintf(stdout, "\n");
 		
-	for(int n = 0; n < CLIENTS_MAX_CNT; n++){
+	for(int n = 0; n < clist->cap; n++){
 			
 		// find set slot
-		if( (slots & (1 << n)) ){
-			fprintf(stdout, "%d	%d	%s\n", clients[n].id, clients[n].pid, clients[n].topic, clients[n].ip);
+		if( SLOT_IS_SET(clist, n) ){
+			fprintf(stdout, "%d %d	%d	%s	%s	", n, clients[n].id, clients[n].pid, clients[n].topic, clients[n].ip);
+			shell_stats_print(stdout, &clist->stats[n], now);
+			fprintf(stdout, "\n");
 		}
 	}
 }
 
-// connects to a sensor
-void shell_connect_sensor(char *pipefd){
+// disconnects from a sensor
+void shell_disconnect_sensor(struct shell_pool *pool, struct client_list *clist, int option){
 
-	char ip[IP_ADDR_LEN];
-	char topic[TOPIC_MAX_LEN];
+	struct client_info *clients = clist->clients;
 
-	int ret = shell_read_string("enter ip address of the broker", ip, sizeof(ip));
-	if(ret == INPUT_FAIL){
-		fprintf(stderr, "error: reading input failed\n");
+	if( option < 0 || option >= clist->cap || !SLOT_IS_SET(clist, option) ){
+		fprintf(stdout, "error: invalid option, no such option is available\n");
+	}
+	// topic of a shared connection is unsubscribed, other topics keep the connection
+	else if(shell_pool_unsubscribe(pool, clients[option].pid, clients[option].id) == 0){
+		return;
+	}
+	else{
+		// send termination signal to a client process
+		kill(clients[option].pid, SIGUSR1);
 	}
-	if(ret == INPUT_OK){
+}
 
-		if(shell_validate_address(ip)){
-			
-			ret = shell_read_string("enter topic of the sensor: ", topic, sizeof(topic));
-		
-			if(ret == INPUT_FAIL){
-				fprintf(stderr, "error: reading input failed\n");
-			}
-			if(ret == INPUT_LONG){
-				fprintf(stderr, "error: topic is too long\n");
-			}
-			if(ret == INPUT_SHORT){
-				fprintf(stderr, "error: topic is too short\n");
-			}
-			if(ret == INPUT_OK){
-				shell_create_client(pipefd, ip, topic);
-			}
-		}
-		else{
-			fprintf(stderr, "error: invalid ip address\n");
+#endif // USE_BUILTIN
+
+
+// client id to be assigned to a next client
+static int s_cid = 0;
+
+// subscribes topics of one broker for new client ids on the shared connection to it
+// connection is made by an idle client of the pool when the broker has none yet
+int shell_create_clients(struct shell_pool *pool, char *ip, char *topics[], int cnt, int *failed){
+
+	int cid = s_cid;	// client id of the first topic
+	int64_t start = shell_mono_ns();
+
+	// every topic keeps its client id, even when it could not be subscribed
+	s_cid += cnt;
+	if(failed != NULL) *failed = 0;
+
+	for(int n = 0; n < cnt; n++){
+
+		if(shell_pool_subscribe(pool, cid + n, ip, topics[n]) == -1){
+			fprintf(stderr, "error: topic %s of %s not subscribed\n", topics[n], ip);
+			if(failed != NULL) (*failed)++;
 		}
 	}
+	shell_pool_track(pool, cid, cnt, start);
+
+	return cid;
 }
 
-// disconnects from a sensor
-void shell_disconnect_sensor(struct client_list *clist){
+// subscribes topic of a broker for a new client id
+void shell_create_client(struct shell_pool *pool, char *ip, char *topic){
 
-	int slots = clist->slots;
-	struct client_info *clients = clist->clients;
+	shell_create_clients(pool, ip, &topic, 1, NULL);
+}
 
-	// show connected clients
-	shell_show_clients(clist);
+// reaps exited client processes, idle clients and connections of the pool are forgotten
+void shell_reap_clients(struct shell_pool *pool){
 
-	fprintf(stdout, "option: ");
-	int option = shell_read_option();
-	printf("opt %d\n", option);
+	pid_t pid;
 
-	if( !(slots & (1 << option)) ){
-		fprintf(stdout, "error: invalid option, no such option is available\n");
+	while((pid = waitpid(-1, NULL, WNOHANG)) > 0){
+		shell_pool_forget(pool, pid);
 	}
-	else{
-		// send termination signal to a client process
-		kill(clients[option].pid, SIGUSR1);
+}
+
+// connects to a sensor
+void shell_connect_sensor(struct shell_pool *pool, char *ip, const char *line){
+
+	char topic[CLIENT_TOPIC_LEN + sizeof(PROTO_QOS_SUFFIX)];
+	int len;
+
+	int ret = shell_parse_string(line, topic, sizeof(topic));
+
+	if(ret == INPUT_OK && proto_topic_qos(topic, &len) == -1){
+		fprintf(stderr, "error: qos of topic %s is not valid\n", topic);
+		return;
+	}
+	if(ret == INPUT_LONG || (ret == INPUT_OK && len >= CLIENT_TOPIC_LEN)){
+		fprintf(stderr, "error: topic is too long\n");
+	}
+	if(ret == INPUT_SHORT){
+		fprintf(stderr, "error: topic is too short\n");
+	}
+	if(ret == INPUT_OK && len < CLIENT_TOPIC_LEN){
+		shell_create_client(pool, ip, topic);
 	}
 }
 
-#endif // USE_BUILTIN
+// connects to many sensors of one broker using its shared connection
+void shell_connect_sensors(struct shell_pool *pool, char *ip, const char *line){
 
+	char topics_line[TOPICS_LINE_LEN];
+	char *topics[TOPICS_LINE_LEN / 2];
+	int cnt = 0;
 
-// creates new client process
-void shell_create_client(char *pipefd, char *ip, char *topic){
+	int ret = shell_parse_string(line, topics_line, sizeof(topics_line));
 
-	static int cid = 0;	// client id to be assigned to a next client process
-	char cid_arg[2];	// client id as an argument for client program	
-	
-	// convert cid intger to a string
-	sprintf(cid_arg, "%d", cid);
-	cid++;
+	if(ret == INPUT_LONG){
+		fprintf(stderr, "error: topics are too long\n");
+	}
+	if(ret == INPUT_SHORT){
+		fprintf(stderr, "error: topics are too short\n");
+	}
+	if(ret != INPUT_OK){
+		return;
+	}
 
-	pid_t pid;
-	pid_t cpid;
+	// split the line into topics
+	for(char *topic = strtok(topics_line, " \t"); topic != NULL; topic = strtok(NULL, " \t")){
+
+		int len;
+		if(proto_topic_qos(topic, &len) == -1){
+			fprintf(stderr, "error: qos of topic %s is not valid\n", topic);
+			return;
+		}
+		if(len >= CLIENT_TOPIC_LEN){
+			fprintf(stderr, "error: topic %s is too long\n", topic);
+			return;
+		}
+		topics[cnt++] = topic;
+	}
+
+	if(cnt > 0){
+		shell_create_clients(pool, ip, topics, cnt, NULL);
+	}
+}
+
+// turns body of a data or trace record into client information and manages it
+// payload is handed on where it was received, only its start is copied to the client data
+static void shell_handle_data(struct shell_ctx *ctx, int cid, int type, const char *body, uint32_t len){
+
+	struct client_info info;
+
+	// reading of the next window closes the current one when it comes before the timer
+	shell_close_windows(ctx, time(NULL));
+
+	// data records carry only client id, rest comes from the client list
+	int n = shell_clist_find_id(&ctx->clist, cid);
+	if(n != -1){
+		info = ctx->clist.clients[n];
+	}
+	else{
+		memset(&info, 0, sizeof(info));
+		info.id = cid;
+		info.slot_pos = -1;
+	}
+	memset(&info.trace, 0, sizeof(struct client_trace));
+
+	// trace of the reading comes before its value
+	if(type == PROTO_TRACE){
+
+		struct proto_trace tr;
+
+		if(len < (uint32_t)PROTO_TRACE_LEN) return;
+		memcpy(&tr, body, sizeof(tr));
 
-	pid = fork();
+		info.trace.on = 1;
+		info.trace.seq = tr.seq;
+		memcpy(info.trace.ts, tr.ts, sizeof(tr.ts));
 
-	if(pid > 0){
-		wait(NULL);
+		body += PROTO_TRACE_LEN;
+		len -= PROTO_TRACE_LEN;
 	}
-	else if(pid == 0){
 
-		cpid = fork();
+	// typed value parsed by the client comes before the payload
+	struct proto_value val;
+
+	if(len < (uint32_t)PROTO_VALUE_LEN) return;
+	memcpy(&val, body, sizeof(val));
+
+	info.value.type = val.type;
+	info.value.i = val.i;
+	info.value.f = val.f;
+
+	body += PROTO_VALUE_LEN;
+	len -= PROTO_VALUE_LEN;
+
+	// reading of a wildcard subscription goes to the state of its concrete topic
+	struct topic_state *ts = NULL;
+
+	if(val.topic_len > 0){
+
+		if(len < val.topic_len) return;
 
-		if(cpid > 0){
-			exit(EXIT_SUCCESS);
+		if(n != -1){
+			ts = shell_topics_get(&ctx->topics, body, val.topic_len, cid);
 		}
-		else if(pid == 0){
-			
-			// execute the new user client process that will handle the sensor
-			if(execl("../client_shell/shell_client", "shell_client", cid_arg, pipefd, ip, topic, (char*)NULL) == -1){
-				fprintf(stderr, "shell error: exec failed(%d) --- %s\n", errno, strerror(errno));
-			}
-			exit(EXIT_FAILURE);
+
+		// concrete topic names the stored series, topic too long for it is not stored
+		if(val.topic_len < CLIENT_TOPIC_LEN){
+			memcpy(info.topic, body, val.topic_len);
+			info.topic[val.topic_len] = '\0';
 		}
 		else{
-			fprintf(stderr, "error: first fork failed(%d) --- %s\n", errno, strerror(errno));
+			info.topic[0] = '\0';
 		}
+
+		body += val.topic_len;
+		len -= val.topic_len;
 	}
-	else{
-		fprintf(stderr, "error: second fork failed(%d) --- %s\n", errno, strerror(errno));
-		cid--;
+
+	info.status = CLIENT_DATA_READY;
+	info.payload = body;
+	info.payload_len = len;
+
+	// start of the payload is kept printable for the log
+	uint32_t show = len < CLIENT_DATA_LEN - 1 ? len : CLIENT_DATA_LEN - 1;
+	for(uint32_t i = 0; i < show; i++){
+		info.data[i] = isprint((unsigned char)body[i]) ? body[i] : '.';
+	}
+	info.data[show] = '\0';
+
+	// every concrete topic has its own sequence of traced readings, subscription would mix them up
+	struct client_trace trace = info.trace;
+	if(ts != NULL){
+		info.trace.on = 0;
 	}
-}
 
-// manages clients coming from the common pipe
-void shell_manage_client(int fd, int log_fd, struct client_info *info, struct client_list *clist){
+	shell_manage_client(ctx, &info);
 
-	char log_msg[LOG_MSG_LEN] = {0};
+	int64_t now = shell_mono_ns();
 
-	// receive client information from pipe
-	int ret = read(fd, info, sizeof(struct client_info));
+	// subscription keeps statistics of all its topics, state those of one
+	if(ts != NULL){
 
-	if(ret == -1){
+		if(info.value.type == VALUE_TEXT) ts->stats.text++;
+		else shell_stats_update(&ts->stats, info.value.f, now);
 
-		if(errno != EINTR){		// do nothing if read was interrupted
-			fprintf(stderr, "read failed(%d) --- %s\n", errno, strerror(errno));
-			fprintf(stdout, "terminating the program...\n");
-			exit(EXIT_FAILURE);
+		if(trace.on){
+			if(ts->stats.trace == NULL) ts->stats.trace = shell_trace_new();
+			shell_trace_update(ts->stats.trace, &trace, now);
 		}
 	}
-	if(ret == 0){
-		fprintf(stderr, "no data(%d) --- %s\n", errno, strerror(errno));
+
+	// rules watch concrete topics, binding of the topic is kept with its statistics
+	if(ctx->rules.cnt > 0 && info.value.type != VALUE_TEXT){
+
+		if(ts != NULL){
+			shell_rules_eval(&ctx->rules, &ts->stats.rules, ts->topic, info.value.f, now);
+		}
+		else if(n != -1){
+			shell_rules_eval(&ctx->rules, &ctx->clist.stats[n].rules, ctx->clist.clients[n].topic, info.value.f, now);
+		}
+	}
+}
+
+// turns a record into client information and manages it
+static void shell_handle_record(const struct proto_hdr *hdr, const char *body, void *arg){
+
+	struct shell_ctx *ctx = arg;
+	struct client_info info;
+
+	if(hdr->type == PROTO_STATUS && hdr->len >= PROTO_HDR_LEN + PROTO_STATUS_LEN){
+		shell_proto_status_info(hdr, body, &info);
+		shell_manage_client(ctx, &info);
+	}
+	else if(hdr->type == PROTO_DATA || hdr->type == PROTO_TRACE){
+		shell_handle_data(ctx, hdr->cid, hdr->type, body, hdr->len - PROTO_HDR_LEN);
+	}
+	else if(hdr->type == PROTO_FRAG){
+
+		// record is handled once all of its fragments arrived
+		const struct proto_assembly *pa = shell_proto_assemble(&ctx->frags, hdr, body);
+		if(pa != NULL){
+			shell_handle_data(ctx, hdr->cid, pa->type, pa->buf, pa->total);
+		}
+	}
+	else{
+		fprintf(stderr, "error: unknown record type %d\n", hdr->type);
+	}
+}
+
+// reads client records from the non-blocking common pipe
+// at most SHELL_INGEST_BUDGET records are handled so other events get their turn
+void shell_ingest(int fd, struct shell_ctx *ctx){
+
+	if(shell_proto_read(fd, &ctx->reader, SHELL_INGEST_BUDGET, shell_handle_record, ctx) == -1){
+
+		fprintf(stderr, "read failed(%d) --- %s\n", errno, strerror(errno));
+		fprintf(stdout, "terminating the program...\n");
 		exit(EXIT_FAILURE);
 	}
-	if(ret > 0){
+}
 
-		switch(info->status){
+// reads client records from a clients shared memory ring
+void shell_ingest_ring(struct shell_ctx *ctx, struct shell_ring *sr){
 
-			case CLIENT_CREAT_SUCCESS:
-				sprintf(log_msg, "client %d(%d) created\n", info->id, info->pid);
-				break;
+	// client process is gone and its ring is empty
+	if(shell_ring_drain(sr, SHELL_INGEST_BUDGET, shell_handle_record, ctx)){
+		shell_ring_destroy(&ctx->tp, sr);
+	}
+}
 
-			case CLIENT_CREAT_FAILURE:
-				sprintf(log_msg, "client %d(%d) unable to be created\n", info->id, info->pid);
-				break;
+// manages client information received from the common pipe
+void shell_manage_client(struct shell_ctx *ctx, struct client_info *info){
+
+	struct client_list *clist = &ctx->clist;
+	char log_msg[LOG_MSG_LEN] = {0};
+	double connect_ms;
+	int n;
+
+	switch(info->status){
+
+		case CLIENT_CREAT_SUCCESS:
+			sprintf(log_msg, "client %d(%d) created\n", info->id, info->pid);
+			break;
+
+		case CLIENT_CREAT_FAILURE:
+			sprintf(log_msg, "client %d(%d) unable to be created\n", info->id, info->pid);
+			break;
 
-			case CLIENT_CONN_SUCCESS:
+		case CLIENT_CONN_SUCCESS:
+			n = shell_clist_find_id(clist, info->id);
+			if(n != -1 && clist->stats[n].lost_ns != 0){
+				snprintf(log_msg, LOG_MSG_LEN, "client %d(%d) reconnected to %s after %.1f ms\n", info->id, info->pid, info->ip,
+					 (shell_mono_ns() - clist->stats[n].lost_ns) / 1e6);
+			}
+			else{
 				sprintf(log_msg, "client %d(%d) connected to %s\n", info->id, info->pid, info->ip);
-				break;
+			}
+			break;
+
+		case CLIENT_CONN_FAILURE:
+			sprintf(log_msg, "client %d(%d) unable to connect\n", info->id, info->pid);
 
-			case CLIENT_CONN_FAILURE:
-				sprintf(log_msg, "client %d(%d) unable to connect\n", info->id, info->pid);
+			// connection exits, next topic of the broker makes a new one
+			shell_pool_forget(&ctx->pool, info->pid);
+			shell_ctl_notify(&ctx->ctl, info->id, 0);
+			break;
+
+		case CLIENT_SUB_SUCCESS:
+			// listed client subscribed again after its connection was restored, it keeps its slot
+			n = shell_clist_find_id(clist, info->id);
+			if(n != -1){
+				snprintf(log_msg, LOG_MSG_LEN, "client %d(%d) subscribed again to %s %.1f ms after loss\n", info->id, info->pid, info->topic,
+					 clist->stats[n].lost_ns ? (shell_mono_ns() - clist->stats[n].lost_ns) / 1e6 : 0.0);
 				break;
+			}
 
-			case CLIENT_SUB_SUCCESS:
+			// time from the connect request is shown when the request was timed
+			connect_ms = shell_pool_connect_ms(&ctx->pool, info->id, shell_mono_ns());
+			if(connect_ms >= 0){
+				snprintf(log_msg, LOG_MSG_LEN, "client %d(%d) subscribed to topic %s in %.1f ms\n", info->id, info->pid, info->topic, connect_ms);
+			}
+			else{
 				sprintf(log_msg, "client %d(%d) subscribed to topic %s\n", info->id, info->pid, info->topic);
+			}
 
-				// add client to the client list
-				#if USE_BUILTIN
-				shell_add_client_blt(info, clist);
-				#else
-				shell_add_client(info, clist);
-				#endif // USE_BUILTIN
-				break;
+			// client taken from the pool is replaced now that it does not need the cpu to start up
+			shell_pool_refill(&ctx->pool);
 
-			case CLIENT_SUB_FAILURE:
-				sprintf(log_msg, "client %d(%d) unable to subscribe to topic %s\n", info->id, info->pid, info->topic);
-				break;
+			// add client to the client list
+			#if USE_BUILTIN
+			shell_add_client_blt(info, clist);
+			#else
+			shell_add_client(info, clist);
+			#endif // USE_BUILTIN
+			shell_ctl_notify(&ctx->ctl, info->id, 1);
+			break;
 
-			case CLIENT_CONN_LOST:
-				sprintf(log_msg, "client %d(%d) lost connection to %s\n", info->id, info->pid, info->ip);
-				
-				// remove client from the client list
-				#if USE_BUILTIN
-				shell_rm_client_blt(info->pid, clist);
-				#else
-				shell_rm_client(info->pid, clist);
-				#endif // USE_BUILTIN
-				break;
+		case CLIENT_SUB_FAILURE:
+			sprintf(log_msg, "client %d(%d) unable to subscribe to topic %s\n", info->id, info->pid, info->topic);
+			shell_pool_unref(&ctx->pool, info->pid);
+			shell_ctl_notify(&ctx->ctl, info->id, 0);
+
+			// topic that could not be subscribed again after a reconnect is not served anymore
+			if(shell_clist_find_id(clist, info->id) == -1) break;
+			#if USE_BUILTIN
+			shell_rm_client_id_blt(info->id, clist);
+			#else
+			shell_rm_client_id(info->id, clist);
+			#endif // USE_BUILTIN
+			shell_topics_sweep(&ctx->topics, clist);
+			break;
 
-			case CLIENT_DISCON_SUCCESS:
-				sprintf(log_msg, "client %d(%d) disconnected\n", info->id, info->pid);
+		case CLIENT_CONN_RETRY:
+			sprintf(log_msg, "client %d(%d) lost connection to %s, reconnecting\n", info->id, info->pid, info->ip);
 
-				// remove client from the client list
-				#if USE_BUILTIN
-				shell_rm_client_blt(info->pid, clist);
-				#else
-				shell_rm_client(info->pid, clist);
-				#endif // USE_BUILTIN
-				break;
+			// client stays listed, gap of its readings is measured once they resume
+			n = shell_clist_find_id(clist, info->id);
+			if(n != -1 && clist->stats[n].lost_ns == 0){
+				clist->stats[n].lost_ns = shell_mono_ns();
+			}
+			break;
+
+		case CLIENT_CONN_LOST:
+			sprintf(log_msg, "client %d(%d) lost connection to %s\n", info->id, info->pid, info->ip);
+			shell_pool_forget(&ctx->pool, info->pid);
+
+			// remove client from the client list
+			#if USE_BUILTIN
+			shell_rm_client_blt(info->pid, clist);
+			#else
+			shell_rm_client(info->pid, clist);
+			#endif // USE_BUILTIN
+			shell_topics_sweep(&ctx->topics, clist);
+			break;
+
+		case CLIENT_DISCON_SUCCESS:
+			sprintf(log_msg, "client %d(%d) disconnected\n", info->id, info->pid);
+
+			// remove client from the client list
+			#if USE_BUILTIN
+			shell_rm_client_blt(info->pid, clist);
+			#else
+			shell_rm_client(info->pid, clist);
+			#endif // USE_BUILTIN
+			shell_topics_sweep(&ctx->topics, clist);
+			break;
+
+		case CLIENT_UNSUB_SUCCESS:
+			sprintf(log_msg, "client %d(%d) unsubscribed from topic %s\n", info->id, info->pid, info->topic);
 
-			case CLIENT_DATA_READY:
+			// remove only this topic, connection serves the other ones
+			#if USE_BUILTIN
+			shell_rm_client_id_blt(info->id, clist);
+			#else
+			shell_rm_client_id(info->id, clist);
+			#endif // USE_BUILTIN
+			shell_topics_sweep(&ctx->topics, clist);
+			break;
+
+		case CLIENT_DATA_READY:
+			// aggregated readings are only written as summary records of their window
+			if(ctx->window.len > 0){
+				shell_handle_reading(ctx, info);
+				return;
+			}
+			// long payload is logged by its start and length
+			if(info->payload_len >= CLIENT_DATA_LEN){
+				snprintf(log_msg, LOG_MSG_LEN, "client %d(%d) data received: %s... (%u bytes)\n", info->id, info->pid, info->data, info->payload_len);
+			}
+			else{
 				sprintf(log_msg, "client %d(%d) data received: %s\n", info->id, info->pid, info->data);
-				break;
-			
-			case CLIENT_DATA_MISSING:
-				sprintf(log_msg, "client %d(%d) is not receiving any data\n", info->id, info->pid);
-				break;
-			
-			default:
-				fprintf(stderr, "error: unknown enum value\n");
-				break;
+			}
+			shell_handle_reading(ctx, info);
+			break;
+		
+		case CLIENT_DATA_MISSING:
+			sprintf(log_msg, "client %d(%d) is not receiving any data\n", info->id, info->pid);
+			break;
+		
+		default:
+			fprintf(stderr, "error: unknown enum value\n");
+			break;
+	}
+	// log a message
+	shell_log_write(&ctx->log, log_msg);
+	fprintf(stdout, "%s", log_msg);
+}
+
+// updates statistics of a client and stores its reading if it is a number
+void shell_handle_reading(struct shell_ctx *ctx, const struct client_info *info){
+
+	struct timespec real;
+	int n = info->slot_pos;
+	int listed = n >= 0 && n < ctx->clist.cap && SLOT_IS_SET(&ctx->clist, n);
+	int64_t now = shell_mono_ns();
+
+	// first reading after a reconnect shows how long the topic went without readings
+	if(listed){
+
+		struct topic_stats *st = &ctx->clist.stats[n];
+		if(st->lost_ns != 0){
+
+			char log_msg[LOG_MSG_LEN];
+			snprintf(log_msg, LOG_MSG_LEN, "client %d(%d) readings resumed after %.1f ms gap\n", info->id, info->pid,
+				 (now - (st->last_ns ? st->last_ns : st->lost_ns)) / 1e6);
+			shell_log_write(&ctx->log, log_msg);
+			fprintf(stdout, "%s", log_msg);
+			st->lost_ns = 0;
+		}
+		st->last_ns = now;
+	}
+
+	// latency of traced readings is kept whatever their value is
+	if(listed && info->trace.on){
+
+		struct topic_stats *st = &ctx->clist.stats[n];
+		if(st->trace == NULL){
+			st->trace = shell_trace_new();
+		}
+		shell_trace_update(st->trace, &info->trace, now);
+	}
+
+	// readings that are not numbers are only counted and logged
+	if(info->value.type == VALUE_TEXT){
+		if(listed) ctx->clist.stats[n].text++;
+		return;
+	}
+	double value = info->value.f;
+
+	if(listed){
+		shell_stats_update(&ctx->clist.stats[n], value, now);
+	}
+
+	if(info->topic[0] != '\0'){
+		clock_gettime(CLOCK_REALTIME, &real);
+		shell_tsdb_append(&ctx->db, info->topic, (int64_t)real.tv_sec * 1000000000 + real.tv_nsec, value);
+	}
+}
+
+// closes aggregation window of every topic once the window clock passed its end
+void shell_close_windows(struct shell_ctx *ctx, int64_t now){
+
+	struct client_list *clist = &ctx->clist;
+	char line[WINDOW_LINE_LEN];
+
+	if(!shell_window_roll(&ctx->window, now)){
+		return;
+	}
+
+	int64_t end = shell_window_end(&ctx->window);
+	int64_t len = ctx->window.len;
+
+	for(int n = 0; n < clist->cap; n++){
+
+		if(!SLOT_IS_SET(clist, n)) continue;
+
+		struct topic_window *tw = &clist->stats[n].agg;
+
+		// readings of a wildcard subscription are summed up by their concrete topics
+		if(strpbrk(clist->clients[n].topic, "+#") != NULL){
+			tw->count = 0;
+			tw->sum = 0;
+			continue;
+		}
+		shell_window_record(tw, clist->clients[n].topic, end, len, line, sizeof(line));
+		shell_log_write(&ctx->log, line);
+		fprintf(stdout, "%s", line);
+	}
+	for(struct topic_state *ts = ctx->topics.states; ts != NULL; ts = ts->next){
+
+		shell_window_record(&ts->stats.agg, ts->topic, end, len, line, sizeof(line));
+		shell_log_write(&ctx->log, line);
+		fprintf(stdout, "%s", line);
+	}
+}
+
+// shows latencies and lost readings of traced sensors
+// concrete topics of wildcard subscriptions are summed up in all topics, TOPICS_SHOW_MAX of them are printed
+void shell_show_latency(struct client_list *clist, struct shell_topics *topics){
+
+	struct topic_trace *all = NULL;
+	int shown = 0;
+
+	fprintf(stdout, "latency of traced sensors in microseconds:\n");
+
+	for(int n = 0; n < clist->cap; n++){
+
+		if(SLOT_IS_SET(clist, n) && clist->stats[n].trace != NULL){
+
+			shell_trace_print(stdout, clist->clients[n].topic, clist->stats[n].trace);
+
+			if(all == NULL) all = shell_trace_new();
+			shell_trace_merge(all, clist->stats[n].trace);
+		}
+	}
+	for(struct topic_state *ts = topics->states; ts != NULL; ts = ts->next){
+
+		if(ts->stats.trace == NULL) continue;
+
+		if(shown++ < TOPICS_SHOW_MAX){
+			shell_trace_print(stdout, ts->topic, ts->stats.trace);
 		}
-		// log a message
-		shell_log_write(log_fd, log_msg);
-		fprintf(stdout, "%s", log_msg);
+		if(all == NULL) all = shell_trace_new();
+		shell_trace_merge(all, ts->stats.trace);
+	}
+	if(all == NULL){
+		fprintf(stdout, "no traced readings, start sensor simulator with -t\n");
+		return;
+	}
+
+	// whole pipeline comes last so it is easy to find
+	shell_trace_print(stdout, "all topics", all);
+	free(all);
+}
+
+// summary of a history query
+struct query_sum{
+
+	long		cnt;			// amount of records
+	double		min;			// smallest value
+	double		max;			// largest value
+	double		sum;			// sum of values
+};
+
+// prints first records of a query and sums up all of them
+static void shell_query_record(const struct tsdb_rec *rec, void *arg){
+
+	struct query_sum *qs = arg;
+
+	if(qs->cnt < SHELL_QUERY_SHOW){
+
+		time_t sec = rec->ts / 1000000000;
+		char stamp[32];
+
+		strftime(stamp, sizeof(stamp), "%F %T", localtime(&sec));
+		fprintf(stdout, "%s.%03d\t%g\n", stamp, (int)(rec->ts % 1000000000 / 1000000), rec->value);
 	}
+
+	if(qs->cnt == 0 || rec->value < qs->min) qs->min = rec->value;
+	if(qs->cnt == 0 || rec->value > qs->max) qs->max = rec->value;
+	qs->sum += rec->value;
+	qs->cnt++;
+}
+
+// prints stored readings of topic received between from and to(seconds since epoch)
+void shell_query_history(struct shell_tsdb *db, const char *topic, int64_t from, int64_t to){
+
+	struct query_sum qs = {0};
+
+	if(db->off){
+		fprintf(stdout, "readings are not stored, shell was started with -s %s\n", TSDB_OFF);
+		return;
+	}
+
+	fprintf(stdout, "history of topic %s:\n", topic);
+	shell_tsdb_query(db, topic,
+		from == TSDB_NO_TIME ? TSDB_NO_TIME : from * 1000000000,
+		to == TSDB_NO_TIME ? TSDB_NO_TIME : to * 1000000000 + 999999999,
+		shell_query_record, &qs);
+
+	if(qs.cnt == 0){
+		fprintf(stdout, "no readings\n");
+		return;
+	}
+	if(qs.cnt > SHELL_QUERY_SHOW){
+		fprintf(stdout, "... %ld more\n", qs.cnt - SHELL_QUERY_SHOW);
+	}
+	fprintf(stdout, "%ld readings: min %g  max %g  mean %g\n", qs.cnt, qs.min, qs.max, qs.sum / qs.cnt);
 }
 
-// handles request from the user: what to do
-void shell_handle_request(char *pipefd, int *flag, struct client_list *clist){
+// shows the menu and waits for an option
+void shell_show_menu(struct shell_menu *menu){
 
 	fprintf(stdout, "What to do:\n");
 	fprintf(stdout, "1. Terminate the shell\n");
@@ -616,12 +959,36 @@ void shell_handle_request(char *pipefd, int *flag, struct client_list *clist){
 	fprintf(stdout, "3. Disconnect from sensor\n");
 	fprintf(stdout, "4. Show clients\n");
 	fprintf(stdout, "5. Close the menu\n");
+	fprintf(stdout, "6. Connect to many sensors of one broker\n");
+	fprintf(stdout, "7. Query sensor history\n");
+	fprintf(stdout, "8. Show latency of traced sensors\n");
+	fflush(stdout);
+
+	menu->state = MENU_OPTION;
+}
 
-	int option = shell_read_option();
+// prints a prompt and sets the menu to wait for its answer
+static void shell_menu_prompt(struct shell_menu *menu, enum menu_state state, const char *prompt){
+
+	fprintf(stdout, "%s", prompt);
+	fflush(stdout);
+	menu->state = state;
+}
+
+// handles menu option chosen by the user
+static void shell_handle_option(struct shell_ctx *ctx, const char *line){
+
+	struct shell_menu *menu = &ctx->menu;
+	struct client_list *clist = &ctx->clist;
+	int *flag = &ctx->flag;
+	int option = shell_parse_option(line);
 	printf("option :%d\n", option);
 
-	// terminate the shell
+	menu->state = MENU_IDLE;
+
+	// terminate the shell, idle clients and connections exit when their control pipes close
 	if(option == 1){
+		shell_pool_free(&ctx->pool);
 	#if USE_BUILTIN
 		shell_terminate_blt(flag, clist);
 	#else
@@ -631,70 +998,219 @@ void shell_handle_request(char *pipefd, int *flag, struct client_list *clist){
 
 	// connect to a sensor
 	else if(option == 2){
-		if(clist->full){
-			fprintf(stdout, "no more room for clients, list is full\n");
-			return;
-		}
-	#if USE_BUILTIN
-		shell_connect_sensor_blt(pipefd);
-	#else
-		shell_connect_sensor(pipefd);
-	#endif // USE_BUILTIN
+		menu->connect_many = 0;
+		shell_menu_prompt(menu, MENU_CONNECT_IP, "enter ip address of the broker: ");
 	}
 
 	// disconnect from the sensor
 	else if(option == 3){
-		if(clist->slots == 0){
+		if(clist->cnt == 0){
 			fprintf(stdout, "no connected clients to disconnect\n");
 			return;
 		}
 	#if USE_BUILTIN
-		shell_disconnect_sensor_blt(clist);
+		shell_show_clients_blt(clist);
 	#else
-		shell_disconnect_sensor(clist);
-	#endif
+		shell_show_clients(clist);
+	#endif // USE_BUILTIN
+		shell_menu_prompt(menu, MENU_DISCONNECT, "option: ");
 	}
 
-	// show clients
+	// show clients and concrete topics of their wildcard subscriptions
 	else if(option == 4){
 	#if USE_BUILTIN
 		shell_show_clients_blt(clist);
 	#else
 		shell_show_clients(clist);
 	#endif // USE_BUILTIN
-	
+		shell_topics_print(&ctx->topics, stdout, shell_mono_ns());
 	}
 	// exit from the menu
 	else if(option == 5) return;
 
+	// connect to many sensors of one broker
+	else if(option == 6){
+		menu->connect_many = 1;
+		shell_menu_prompt(menu, MENU_CONNECT_IP, "enter ip address of the broker: ");
+	}
+
+	// query stored readings of a topic
+	else if(option == 7){
+		shell_menu_prompt(menu, MENU_QUERY_TOPIC, "enter topic of the sensor: ");
+	}
+
+	// show latency histograms of traced readings
+	else if(option == 8){
+		shell_show_latency(clist, &ctx->topics);
+	}
+
 	// undefined option: do nothing
 	else{
 		fprintf(stdout, "error: invalid option\n");
 	}
 }
 
-// opens or creates a new log file
-int shell_log_open(const char *path){
-	
-	int fd = open(path, O_CREAT | O_APPEND | O_WRONLY, S_IRUSR | S_IWUSR);
-	if(fd < 0){
-		fprintf(stderr, "error: opening log file failed(%d) --- %s\n", errno, strerror(errno));
-		exit(EXIT_FAILURE);
+// handles ip address line for connect requests
+static void shell_handle_ip(struct shell_menu *menu, const char *line){
+
+	int ret = shell_parse_string(line, menu->ip, sizeof(menu->ip));
+
+	menu->state = MENU_IDLE;
+
+	if(ret != INPUT_OK || !shell_validate_address(menu->ip)){
+		fprintf(stderr, "error: invalid ip address\n");
+		return;
+	}
+
+	if(menu->connect_many){
+		shell_menu_prompt(menu, MENU_CONNECT_TOPICS, "enter topics of the sensors separated by spaces(topic,qos:N for qos 1 or 2): ");
+	}
+	else{
+		shell_menu_prompt(menu, MENU_CONNECT_TOPIC, "enter topic of the sensor(topic,qos:N for qos 1 or 2): ");
 	}
-	return fd;
 }
 
-// logs a message to a log file
-void shell_log_write(int fd, const char msg[]){
+// parses time of a query range: seconds since epoch, negative seconds ago or * for open end
+static int shell_parse_time(const char *tok, time_t now, int64_t *t){
 
-	int ret = write(fd, msg, strlen(msg));
-	if(ret < 0){
-		fprintf(stderr, "error: writing to a log file failed(%d) --- %s\n", errno, strerror(errno));
-		// close log file only if it is actually open
-		if(errno != EBADF) close(fd);
+	char *end;
 
-		exit(EXIT_FAILURE);
+	if(strcmp(tok, "*") == 0){
+		*t = TSDB_NO_TIME;
+		return 1;
+	}
+
+	long long val = strtoll(tok, &end, 10);
+	if(end == tok || *end != '\0'){
+		return 0;
+	}
+	*t = val < 0 ? now + val : val;
+	return 1;
+}
+
+// handles time range line of history query
+static void shell_handle_range(struct shell_ctx *ctx, const char *line){
+
+	char range[64];
+	int64_t from = TSDB_NO_TIME, to = TSDB_NO_TIME;
+	time_t now = time(NULL);
+
+	// empty line queries the whole history
+	snprintf(range, sizeof(range), "%s", line);
+	char *tok_from = strtok(range, " \t");
+	char *tok_to = tok_from != NULL ? strtok(NULL, " \t") : NULL;
+
+	if( (tok_from != NULL && !shell_parse_time(tok_from, now, &from)) ||
+	    (tok_to != NULL && !shell_parse_time(tok_to, now, &to)) ){
+		fprintf(stderr, "error: invalid time range\n");
+		return;
+	}
+
+	shell_query_history(&ctx->db, ctx->menu.topic, from, to);
+}
+
+// handles line of user input depending on what the menu waits for
+void shell_handle_request(struct shell_ctx *ctx, const char *line){
+
+	struct shell_menu *menu = &ctx->menu;
+	struct shell_pool *pool = &ctx->pool;
+	struct client_list *clist = &ctx->clist;
+
+	switch(menu->state){
+
+		case MENU_IDLE:
+			// input outside of the menu is ignored
+			break;
+
+		case MENU_OPTION:
+			shell_handle_option(ctx, line);
+			break;
+
+		case MENU_CONNECT_IP:
+			shell_handle_ip(menu, line);
+			break;
+
+		case MENU_CONNECT_TOPIC:
+			menu->state = MENU_IDLE;
+			shell_connect_sensor(pool, menu->ip, line);
+			break;
+
+		case MENU_CONNECT_TOPICS:
+			menu->state = MENU_IDLE;
+			shell_connect_sensors(pool, menu->ip, line);
+			break;
+
+		case MENU_DISCONNECT:
+			menu->state = MENU_IDLE;
+		#if USE_BUILTIN
+			shell_disconnect_sensor_blt(pool, clist, shell_parse_option(line));
+		#else
+			shell_disconnect_sensor(pool, clist, shell_parse_option(line));
+		#endif // USE_BUILTIN
+			break;
+
+		case MENU_QUERY_TOPIC:
+			menu->state = MENU_IDLE;
+			if(shell_parse_string(line, menu->topic, sizeof(menu->topic)) != INPUT_OK){
+				fprintf(stderr, "error: invalid topic\n");
+				break;
+			}
+			shell_menu_prompt(menu, MENU_QUERY_RANGE, "enter time range \"from to\" in seconds since epoch, negative for seconds ago, * or empty for open end: ");
+			break;
+
+		case MENU_QUERY_RANGE:
+			menu->state = MENU_IDLE;
+			shell_handle_range(ctx, line);
+			break;
+
+		default:
+			menu->state = MENU_IDLE;
+			break;
 	}
 }
 
+// reads user input and hands complete lines to the menu
+// returns 0 when stdin was closed
+int shell_read_input(int fd, struct shell_ctx *ctx){
+
+	struct shell_menu *menu = &ctx->menu;
+	int ret = read(fd, menu->line + menu->len, sizeof(menu->line) - menu->len - 1);
+
+	if(ret == -1){
+		return (errno == EAGAIN || errno == EINTR);
+	}
+	if(ret == 0){
+		fprintf(stdout, "error: EOF caught, user input is closed\n");
+		return 0;
+	}
+	menu->len += ret;
+	menu->line[menu->len] = '\0';
+
+	// handle every complete line
+	char *start = menu->line;
+	char *nl;
+
+	while( (nl = strchr(start, '\n')) != NULL ){
+
+		*nl = '\0';
+		if(menu->discard){
+			fprintf(stderr, "error: input is too long\n");
+			menu->state = MENU_IDLE;
+			menu->discard = 0;
+		}
+		else{
+			shell_handle_request(ctx, start);
+		}
+		start = nl + 1;
+	}
+
+	// keep partial line, drop it if it fills the whole buffer
+	menu->len = strlen(start);
+	memmove(menu->line, start, menu->len + 1);
 
+	if(menu->len == sizeof(menu->line) - 1){
+		menu->discard = 1;
+		menu->len = 0;
+	}
+	return 1;
+}
@@ -21,22 +21,29 @@
 #include<signal.h>
 #include<errno.h>
 #include<fcntl.h>
+#include<limits.h>
 
 
 #define USE_BUILTIN		1	// use gcc builtin function
 
-#define SHELL_TERMINATE		1		
-#define CLIENTS_MAX_CNT		5
-#define CLIENT_SLOTS_FULL 	(int)(pow(2, CLIENTS_MAX_CNT) -1)
-
-#if USE_BUILTIN
+#include"shell_clist.h"		// client list(registry)
+#include"shell_loop.h"		// epoll event loop
+#include"shell_proto.h"		// client record reader
+#include"shell_ring.h"		// shared memory ring transport
+#include"shell_pool.h"		// client spawning, idle client pool and shared broker connections
+#include"shell_log.h"		// asynchronous log writer
+#include"shell_tsdb.h"		// time-series store of readings
+#include"shell_trace.h"		// latency tracing
+#include"shell_topic.h"		// concrete topics of wildcard subscriptions
+#include"shell_window.h"		// tumbling window aggregation
+#include"shell_rules.h"		// alert rules
+#include"shell_ctl.h"		// control socket
+#include"shell_config.h"		// startup config of brokers and topics
 
-#define FIND_EMPTY_SLOT(x)	find_msb(x)
-#define FIND_SET_SLOT(x)	find_msb(x)
-
-#endif // USE_BUILTIN
+#define SHELL_TERMINATE		1		
 
 #define TOPIC_MAX_LEN		100
+#define TOPICS_LINE_LEN		4096	// input line holding many topics
 #define INPUT_OK		0
 #define INPUT_FAIL		1
 #define INPUT_LONG		2
@@ -47,29 +54,68 @@
 
 #define LOG_MSG_LEN		80
 
-// client list structure
-struct client_list{
-
-	struct 	  	client_info *clients;	// pointer to client array
-	int 	  	slots;			// used slots in array
-	int 		slots_max;		// maximum value of used slots
-	bool		full;			// list is full
+#define SHELL_INGEST_BUDGET	1024	// client records handled per pipe event
+#define SHELL_TICK_MS		1000	// interval of shell timer
+#define SHELL_TERM_GRACE	5	// timer ticks to wait for clients on termination
+#define SHELL_QUERY_SHOW	20	// records of a history query printed at most
+
+// states of the menu: what user input is expected next
+enum menu_state{
+
+	MENU_IDLE,			// menu is closed
+	MENU_OPTION,			// waiting for menu option
+	MENU_CONNECT_IP,		// waiting for broker ip address
+	MENU_CONNECT_TOPIC,		// waiting for topic
+	MENU_CONNECT_TOPICS,		// waiting for many topics
+	MENU_DISCONNECT,		// waiting for client option to disconnect
+	MENU_QUERY_TOPIC,		// waiting for topic of history query
+	MENU_QUERY_RANGE		// waiting for time range of history query
 };
 
+// menu structure, user input is handled line by line from the event loop
+struct shell_menu{
 
-extern int g_signal_caught;
+	enum menu_state	state;				// what input is expected
+	int		connect_many;			// connect many topics in one request
+	int		discard;			// input line was too long
+	char		ip[IP_ADDR_LEN];		// broker ip of connect request
+	char		topic[CLIENT_TOPIC_LEN];	// topic of history query
+	char		line[TOPICS_LINE_LEN];		// partially read input line
+	size_t		len;				// length of partial line
+};
 
-// signal handler for the shell
-void shell_sa_handler(int signo);
+// state of the shell shared by event handlers
+struct shell_ctx{
+
+	struct shell_loop	loop;			// event loop
+	struct shell_menu	menu;			// user menu
+	struct client_list	clist;			// connected clients
+	struct proto_reader	reader;			// splits pipe data into records
+	struct proto_assembler	frags;			// puts fragmented records of clients together
+	struct shell_transport	tp;			// how clients reach the shell
+	struct shell_pool	pool;			// idle clients and shared broker connections
+	struct shell_log	log;			// log file
+	struct shell_tsdb	db;			// stored readings
+	struct shell_topics	topics;			// concrete topics of wildcard subscriptions
+	struct shell_window	window;			// aggregation window, readings are not printed one by one
+	struct shell_rules	rules;			// alert rules, none when no rule file is given
+	struct shell_log	alerts;			// log of alerts
+	struct shell_ctl	ctl;			// control socket, scripts connect and disconnect clients through it
+	int			flag;			// shell termination flag
+	int			term_ticks;		// timer ticks since termination started
+};
+
+// blocks sigint and sigchld and returns signalfd from which the event loop reads them
+int shell_setup_signal_fd(void);
 
-// sets up singal handler for the shell
-void shell_setup_signal_handler(struct sigaction *sa);
+// returns monotonic time in nanoseconds
+int64_t shell_mono_ns(void);
 
-// reads option number from the user
-int shell_read_option();
+// parses option number from input line, -1 if line is not a number
+int shell_parse_option(const char *line);
 
-// reads string from the user
-int shell_read_string(char *prompt, char *str, size_t sz);
+// copies input line to a string checking its length
+int shell_parse_string(const char *line, char *str, size_t sz);
 
 // checks if segment is a number
 int seg_is_number(char *seg);
@@ -80,9 +126,6 @@ int shell_validate_address(char *ip);
 
 #if USE_BUILTIN 	// use functions with gcc builtin functions
 
-// finds most significant bit from 32bit value
-int find_msb(int x);
-
 // terminates the shell and all client processes uses gcc builtin function
 void shell_terminate_blt(int *flag, struct client_list *clist);
 
@@ -92,14 +135,14 @@ void shell_add_client_blt(struct client_info *client, struct client_list *clist)
 // finds and removes client from client list uses gcc builtin function
 void shell_rm_client_blt(pid_t pid, struct client_list *clist);
 
+// finds and removes client id from client list, process of the client may serve other ids
+void shell_rm_client_id_blt(int id, struct client_list *clist);
+
 // shows clients that are currently connected
 void shell_show_clients_blt(struct client_list *clist);
 
-// connects client to a sensor
-void shell_connect_sensor_blt(char *pipefd);
-
-// disconnects the client from the sensor
-void shell_disconnect_sensor_blt(struct client_list *clist);
+// disconnects the client in option slot from the sensor, shared connection only unsubscribes it
+void shell_disconnect_sensor_blt(struct shell_pool *pool, struct client_list *clist, int option);
 
 #else // USE_BUILTIN
 
@@ -112,35 +155,66 @@ void shell_add_client(struct client_info *client, struct client_list *clist);
 // finds and removes client from client list
 void shell_rm_client(pid_t pid, struct client_list *clist);
 
-// deletes client from the client list
-void shell_del_client(int *client_slots, pid_t pid, int n);
+// finds and removes client id from client list, process of the client may serve other ids
+void shell_rm_client_id(int id, struct client_list *clist);
 
 // shows clients that are currently connected
 void shell_show_clients(struct client_list *clist);
 
+// disconnects the client in option slot from the sensor, shared connection only unsubscribes it
+void shell_disconnect_sensor(struct shell_pool *pool, struct client_list *clist, int option);
+
+#endif // USE_BUILTIN
+
+
+// subscribes topics of one broker for new client ids on the shared connection to it
+// returns client id of the first topic, the others follow it
+// topics that could not be requested get no status from a client, their amount is written to failed if it is not NULL
+int shell_create_clients(struct shell_pool *pool, char *ip, char *topics[], int cnt, int *failed);
+
+// subscribes topic of a broker for a new client id
+void shell_create_client(struct shell_pool *pool, char *ip, char *topic);
+
+// reaps exited client processes, idle clients and connections of the pool are forgotten
+void shell_reap_clients(struct shell_pool *pool);
+
 // connects client to a sensor
-void shell_connect_sensor(char *pipefd);
+void shell_connect_sensor(struct shell_pool *pool, char *ip, const char *line);
 
-// disconnects the client from the sensor
-void shell_disconnect_sensor(struct client_list *clist);
+// connects to many sensors of one broker using its shared connection
+void shell_connect_sensors(struct shell_pool *pool, char *ip, const char *line);
 
-#endif // USE_BUILTIN
+// reads client records from the non-blocking common pipe
+void shell_ingest(int fd, struct shell_ctx *ctx);
+
+// reads client records from a clients shared memory ring
+void shell_ingest_ring(struct shell_ctx *ctx, struct shell_ring *sr);
+
+// manages client information received from the common pipe
+void shell_manage_client(struct shell_ctx *ctx, struct client_info *info);
+
+// updates statistics of a client and stores its reading if it is a number
+void shell_handle_reading(struct shell_ctx *ctx, const struct client_info *info);
+
+// closes aggregation window of every topic once the window clock passed its end at now(seconds since epoch)
+// every topic writes its summary record, also the ones without readings
+void shell_close_windows(struct shell_ctx *ctx, int64_t now);
 
+// shows latencies and lost readings of traced sensors, also of concrete topics of wildcard subscriptions
+void shell_show_latency(struct client_list *clist, struct shell_topics *topics);
 
-// creates new client process
-void shell_create_client(char *pipefd, char *ip, char *topic);
+// prints stored readings of topic received between from and to(seconds since epoch)
+void shell_query_history(struct shell_tsdb *db, const char *topic, int64_t from, int64_t to);
 
-// manages client coming from the common pipe
-void shell_manage_client(int fd, int log_fd, struct client_info *info, struct client_list *clist);
+// shows the menu and waits for an option
+void shell_show_menu(struct shell_menu *menu);
 
-// handles request from the user
-void shell_handle_request(char *pipefd, int *flag, struct client_list *clist);
+// handles line of user input depending on what the menu waits for
+void shell_handle_request(struct shell_ctx *ctx, const char *line);
 
-// opens or creates a new log file
-int shell_log_open(const char *path);
+// reads user input and hands complete lines to the menu, returns 0 when input is closed
+int shell_read_input(int fd, struct shell_ctx *ctx);
 
-// logs a message to a log file
-void shell_log_write(int fd, const char msg[]);
 
 
 #endif // SHELL_H
@@ -0,0 +1,288 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_clist.c
+ * @brief: declarations of client list(registry) functions
+ * @note: descriptions for the functions in shell_clist.h
+*/
+
+
+#include"shell_clist.h"
+
+// hash function of the client in a slot
+typedef unsigned int (*clist_hash_fn)(struct client_list *clist, int n);
+
+
+#if USE_BUILTIN
+
+// finds most significant bit from 32bit value
+int find_msb(unsigned int x){
+
+	// uses gcc builtin function to count leading zeros
+	// zero is not passed to function to avoid undefined behaviour
+	if(x == 0) return 0;
+	return 31 - __builtin_clz(x);
+}
+
+#endif // USE_BUILTIN
+
+
+// allocates memory or terminates the program
+static void *clist_alloc(void *ptr, size_t sz){
+
+	void *mem = realloc(ptr, sz);
+	if(mem == NULL){
+		fprintf(stderr, "error: client list allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+	return mem;
+}
+
+// hashes a client id
+static unsigned int clist_hash_id_key(int id){
+
+	return (unsigned int)id * 2654435769u;
+}
+
+// hashes a process id
+static unsigned int clist_hash_pid_key(pid_t pid){
+
+	return (unsigned int)pid * 2654435769u;
+}
+
+static unsigned int clist_hash_id(struct client_list *clist, int n){
+
+	return clist_hash_id_key(clist->clients[n].id);
+}
+
+static unsigned int clist_hash_pid(struct client_list *clist, int n){
+
+	return clist_hash_pid_key(clist->clients[n].pid);
+}
+
+static unsigned int clist_hash_topic(struct client_list *clist, int n){
+
+	return hash_fnv1a_str(clist->clients[n].topic);
+}
+
+// allocates index with all entries empty
+static void clist_index_init(struct client_index *idx, int size){
+
+	idx->entries = clist_alloc(NULL, size * sizeof(int));
+	idx->size = size;
+	idx->used = 0;
+
+	for(int i = 0; i < size; i++){
+		idx->entries[i] = INDEX_EMPTY;
+	}
+}
+
+// places slot to the first free entry of its probe sequence
+static void clist_index_place(struct client_index *idx, unsigned int h, int n){
+
+	unsigned int mask = idx->size - 1;
+	unsigned int i = h & mask;
+
+	while(idx->entries[i] >= 0){
+		i = (i + 1) & mask;
+	}
+	if(idx->entries[i] == INDEX_EMPTY){
+		idx->used++;
+	}
+	idx->entries[i] = n;
+}
+
+// rebuilds index with new size dropping deleted entries
+static void clist_index_resize(struct client_list *clist, struct client_index *idx, clist_hash_fn hash, int size){
+
+	struct client_index old = *idx;
+
+	clist_index_init(idx, size);
+	for(int i = 0; i < old.size; i++){
+		if(old.entries[i] >= 0){
+			clist_index_place(idx, hash(clist, old.entries[i]), old.entries[i]);
+		}
+	}
+	free(old.entries);
+}
+
+// adds slot to the index
+static void clist_index_add(struct client_list *clist, struct client_index *idx, clist_hash_fn hash, int n){
+
+	// keep at most half of the entries used(live or deleted)
+	if( (idx->used + 1) * 2 > idx->size ){
+
+		int size = idx->size;
+		while(size < 4 * (clist->cnt + 1)){
+			size <<= 1;
+		}
+		clist_index_resize(clist, idx, hash, size);
+	}
+	clist_index_place(idx, hash(clist, n), n);
+}
+
+// removes slot from the index
+static void clist_index_rm(struct client_list *clist, struct client_index *idx, clist_hash_fn hash, int n){
+
+	unsigned int mask = idx->size - 1;
+	unsigned int i = hash(clist, n) & mask;
+
+	while(idx->entries[i] != INDEX_EMPTY){
+
+		if(idx->entries[i] == n){
+			idx->entries[i] = INDEX_DELETED;
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+}
+
+// doubles slot capacity of the list
+static void clist_grow(struct client_list *clist, int cap){
+
+	int old_words = SLOT_WORDS(clist->cap);
+	int words = SLOT_WORDS(cap);
+
+	clist->clients = clist_alloc(clist->clients, cap * sizeof(struct client_info));
+	clist->stats = clist_alloc(clist->stats, cap * sizeof(struct topic_stats));
+	clist->slots = clist_alloc(clist->slots, words * sizeof(unsigned int));
+	clist->free = clist_alloc(clist->free, cap * sizeof(int));
+
+	memset(clist->clients + clist->cap, 0, (cap - clist->cap) * sizeof(struct client_info));
+	memset(clist->slots + old_words, 0, (words - old_words) * sizeof(unsigned int));
+
+	// push new slots so that the lowest one is taken first
+	for(int n = cap - 1; n >= clist->cap; n--){
+		clist->free[clist->free_cnt++] = n;
+	}
+	clist->cap = cap;
+}
+
+// initializes client list with initial slot capacity
+void shell_clist_init(struct client_list *clist, int cap){
+
+	int size = 2;
+
+	memset(clist, 0, sizeof(struct client_list));
+	clist_grow(clist, cap > 0 ? cap : CLIENTS_INIT_CNT);
+
+	while(size < 2 * clist->cap){
+		size <<= 1;
+	}
+	clist_index_init(&clist->by_id, size);
+	clist_index_init(&clist->by_pid, size);
+	clist_index_init(&clist->by_topic, size);
+}
+
+// frees resources of client list
+void shell_clist_free(struct client_list *clist){
+
+	for(int n = 0; n < clist->cap; n++){
+		if(SLOT_IS_SET(clist, n)) shell_stats_free(&clist->stats[n]);
+	}
+
+	free(clist->clients);
+	free(clist->stats);
+	free(clist->slots);
+	free(clist->free);
+	free(clist->by_id.entries);
+	free(clist->by_pid.entries);
+	free(clist->by_topic.entries);
+	memset(clist, 0, sizeof(struct client_list));
+}
+
+// adds client to a free slot, grows the list when needed and returns the slot
+int shell_clist_add(struct client_list *clist, struct client_info *client){
+
+	if(clist->free_cnt == 0){
+		clist_grow(clist, 2 * clist->cap);
+	}
+
+	// take free slot and mark it used
+	int n = clist->free[--clist->free_cnt];
+	clist->slots[n / SLOT_WORD_BITS] |= SLOT_BIT(n);
+	clist->cnt++;
+
+	// set clients position in the client list
+	client->slot_pos = n;
+	clist->clients[n] = *(client);
+	shell_stats_init(&clist->stats[n]);
+
+	clist_index_add(clist, &clist->by_id, clist_hash_id, n);
+	clist_index_add(clist, &clist->by_pid, clist_hash_pid, n);
+	clist_index_add(clist, &clist->by_topic, clist_hash_topic, n);
+
+	return n;
+}
+
+// removes client in slot from the list
+void shell_clist_rm_slot(struct client_list *clist, int n){
+
+	if(n < 0 || n >= clist->cap || !SLOT_IS_SET(clist, n)){
+		return;
+	}
+
+	// client stays in the array, only its slot is set as empty
+	clist_index_rm(clist, &clist->by_id, clist_hash_id, n);
+	clist_index_rm(clist, &clist->by_pid, clist_hash_pid, n);
+	clist_index_rm(clist, &clist->by_topic, clist_hash_topic, n);
+
+	shell_stats_free(&clist->stats[n]);
+	clist->slots[n / SLOT_WORD_BITS] &= ~SLOT_BIT(n);
+	clist->free[clist->free_cnt++] = n;
+	clist->cnt--;
+}
+
+// finds slot of a client using client id, -1 if not found
+int shell_clist_find_id(struct client_list *clist, int id){
+
+	struct client_index *idx = &clist->by_id;
+	unsigned int mask = idx->size - 1;
+	unsigned int i = clist_hash_id_key(id) & mask;
+
+	while(idx->entries[i] != INDEX_EMPTY){
+
+		int n = idx->entries[i];
+		if(n >= 0 && clist->clients[n].id == id){
+			return n;
+		}
+		i = (i + 1) & mask;
+	}
+	return -1;
+}
+
+// finds slot of a client using process id, -1 if not found
+int shell_clist_find_pid(struct client_list *clist, pid_t pid){
+
+	struct client_index *idx = &clist->by_pid;
+	unsigned int mask = idx->size - 1;
+	unsigned int i = clist_hash_pid_key(pid) & mask;
+
+	while(idx->entries[i] != INDEX_EMPTY){
+
+		int n = idx->entries[i];
+		if(n >= 0 && clist->clients[n].pid == pid){
+			return n;
+		}
+		i = (i + 1) & mask;
+	}
+	return -1;
+}
+
+// finds slot of a client using topic, -1 if not found
+int shell_clist_find_topic(struct client_list *clist, const char *topic){
+
+	struct client_index *idx = &clist->by_topic;
+	unsigned int mask = idx->size - 1;
+	unsigned int i = hash_fnv1a_str(topic) & mask;
+
+	while(idx->entries[i] != INDEX_EMPTY){
+
+		int n = idx->entries[i];
+		if(n >= 0 && strcmp(clist->clients[n].topic, topic) == 0){
+			return n;
+		}
+		i = (i + 1) & mask;
+	}
+	return -1;
+}
@@ -0,0 +1,93 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_clist.h
+ * @brief: definitions and descriptions of client list(registry) functions
+*/
+
+
+#ifndef SHELL_CLIST_H
+#define SHELL_CLIST_H
+
+#include"client_info.h"
+#include"client_hash.h"
+#include"shell_stats.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<stdbool.h>
+
+
+#ifndef USE_BUILTIN
+#define USE_BUILTIN		1	// use gcc builtin function
+#endif
+
+#define CLIENTS_INIT_CNT	32	// initial slot capacity of the client list
+
+#define SLOT_WORD_BITS		32	// slots in one word of the slot bitset
+#define SLOT_WORDS(cap)		(((cap) + SLOT_WORD_BITS - 1) / SLOT_WORD_BITS)
+#define SLOT_BIT(n)		(1u << ((n) % SLOT_WORD_BITS))
+#define SLOT_IS_SET(clist, n)	((clist)->slots[(n) / SLOT_WORD_BITS] & SLOT_BIT(n))
+
+#if USE_BUILTIN
+
+#define FIND_SET_SLOT(x)	find_msb(x)
+
+#endif // USE_BUILTIN
+
+#define INDEX_EMPTY		(-1)	// index entry was never used
+#define INDEX_DELETED		(-2)	// index entry was removed
+
+// hash index mapping a key of the client to its slot
+struct client_index{
+
+	int		*entries;		// slots or INDEX_EMPTY/INDEX_DELETED
+	int		size;			// amount of entries, power of two
+	int		used;			// entries that are not empty
+};
+
+// client list structure
+struct client_list{
+
+	struct 	  	client_info *clients;	// pointer to client array
+	struct		topic_stats *stats;	// statistics of readings of client in slot
+	unsigned int	*slots;			// bitset of used slots in array
+	int		*free;			// stack of free slots
+	int		free_cnt;		// amount of free slots
+	int		cap;			// slot capacity of the list
+	int		cnt;			// amount of used slots
+	struct client_index by_id;		// index by client id
+	struct client_index by_pid;		// index by client process id
+	struct client_index by_topic;		// index by client topic
+};
+
+
+#if USE_BUILTIN
+
+// finds most significant bit from 32bit value
+int find_msb(unsigned int x);
+
+#endif // USE_BUILTIN
+
+// initializes client list with initial slot capacity
+void shell_clist_init(struct client_list *clist, int cap);
+
+// frees resources of client list
+void shell_clist_free(struct client_list *clist);
+
+// adds client to a free slot, grows the list when needed and returns the slot
+int shell_clist_add(struct client_list *clist, struct client_info *client);
+
+// removes client in slot from the list
+void shell_clist_rm_slot(struct client_list *clist, int n);
+
+// finds slot of a client using client id, -1 if not found
+int shell_clist_find_id(struct client_list *clist, int id);
+
+// finds slot of a client using process id, -1 if not found
+int shell_clist_find_pid(struct client_list *clist, pid_t pid);
+
+// finds slot of a client using topic, -1 if not found
+int shell_clist_find_topic(struct client_list *clist, const char *topic);
+
+#endif // SHELL_CLIST_H
@@ -0,0 +1,206 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_config.c
+ * @brief: declarations of startup config functions
+ * @note: descriptions for the functions in shell_config.h
+*/
+
+
+#include"shell.h"
+
+// returns broker of ip, added when config has none yet, NULL if memory runs out
+static struct config_broker *config_broker_get(struct config_broker **brokers, int *cnt, const char *ip){
+
+	for(int n = 0; n < *cnt; n++){
+		if(strcmp((*brokers)[n].ip, ip) == 0) return &(*brokers)[n];
+	}
+
+	struct config_broker *b = realloc(*brokers, (*cnt + 1) * sizeof(struct config_broker));
+	if(b == NULL){
+		return NULL;
+	}
+	*brokers = b;
+
+	b = &b[(*cnt)++];
+	memset(b, 0, sizeof(struct config_broker));
+	strcpy(b->ip, ip);
+
+	return b;
+}
+
+// adds topic to broker, -1 if memory runs out
+static int config_broker_add(struct config_broker *b, const char *topic){
+
+	if(b->cnt == b->cap){
+
+		int cap = b->cap ? 2 * b->cap : CONFIG_INIT_CNT;
+		char **topics = realloc(b->topics, cap * sizeof(char*));
+
+		if(topics == NULL){
+			return -1;
+		}
+		b->topics = topics;
+		b->cap = cap;
+	}
+	if((b->topics[b->cnt] = strdup(topic)) == NULL){
+		return -1;
+	}
+	b->cnt++;
+
+	return 0;
+}
+
+// frees brokers of config
+static void config_free(struct config_broker *brokers, int cnt){
+
+	for(int n = 0; n < cnt; n++){
+
+		for(int t = 0; t < brokers[n].cnt; t++){
+			free(brokers[n].topics[t]);
+		}
+		free(brokers[n].topics);
+	}
+	free(brokers);
+}
+
+// cuts comment off line, it starts with a word beginning with "//", so topic "a//b" is kept whole
+static void config_strip_comment(char *line){
+
+	for(char *c = strstr(line, "//"); c != NULL; c = strstr(c + 1, "//")){
+
+		if(c == line || strchr(CONFIG_DELIM, c[-1]) != NULL){
+			*c = '\0';
+			return;
+		}
+	}
+}
+
+// parses line src of config file at path, b is the broker of the lines before
+// returns amount of topics on the line, -1 if it is not valid
+static int config_line(char *line, int src, const char *path, struct config_broker **b, struct config_broker **brokers, int *cnt){
+
+	char *save;
+	int topics = 0;
+
+	config_strip_comment(line);
+
+	char *tok = strtok_r(line, CONFIG_DELIM, &save);
+	if(tok == NULL){
+		return 0;
+	}
+
+	// broker line starts topics of the broker
+	if(strcmp(tok, "broker") == 0){
+
+		char *ip = strtok_r(NULL, CONFIG_DELIM, &save);
+		if(ip == NULL || strlen(ip) >= IP_ADDR_LEN || !shell_validate_address(ip) || strtok_r(NULL, CONFIG_DELIM, &save) != NULL){
+			fprintf(stderr, "error: broker on line %d of %s is not valid\n", src, path);
+			return -1;
+		}
+		if((*b = config_broker_get(brokers, cnt, ip)) == NULL){
+			fprintf(stderr, "error: config allocation failed\n");
+			return -1;
+		}
+		return 0;
+	}
+
+	if(*b == NULL){
+		fprintf(stderr, "error: topic on line %d of %s has no broker\n", src, path);
+		return -1;
+	}
+	for( ; tok != NULL; tok = strtok_r(NULL, CONFIG_DELIM, &save)){
+
+		int len;
+		if(proto_topic_qos(tok, &len) == -1){
+			fprintf(stderr, "error: qos of topic %s on line %d of %s is not valid\n", tok, src, path);
+			return -1;
+		}
+		if(len >= CLIENT_TOPIC_LEN){
+			fprintf(stderr, "error: topic %s on line %d of %s is too long\n", tok, src, path);
+			return -1;
+		}
+		if(config_broker_add(*b, tok) == -1){
+			fprintf(stderr, "error: config allocation failed\n");
+			return -1;
+		}
+		topics++;
+	}
+	return topics;
+}
+
+// reads brokers and topics of config file, returns amount of topics, -1 on failure
+static int config_read(const char *path, struct config_broker **brokers, int *cnt){
+
+	char line[CONFIG_LINE_LEN];
+	struct config_broker *b = NULL;
+	int src = 0;
+	int topics = 0;
+
+	FILE *f = fopen(path, "r");
+	if(f == NULL){
+		fprintf(stderr, "error: config file %s can not be opened(%d) --- %s\n", path, errno, strerror(errno));
+		return -1;
+	}
+
+	while(fgets(line, sizeof(line), f) != NULL){
+
+		int ret = -1;
+
+		src++;
+		if(strchr(line, '\n') == NULL && !feof(f)){
+			fprintf(stderr, "error: line %d of %s is too long\n", src, path);
+		}
+		else{
+			ret = config_line(line, src, path, &b, brokers, cnt);
+		}
+		if(ret == -1){
+			fclose(f);
+			return -1;
+		}
+		topics += ret;
+	}
+	fclose(f);
+
+	return topics;
+}
+
+// subscribes brokers and topics of config file at path
+int shell_config_load(struct shell_ctx *ctx, const char *path){
+
+	struct config_broker *brokers = NULL;
+	int cnt = 0;
+	char log_msg[LOG_MSG_LEN];
+
+	int64_t start = shell_mono_ns();
+	int topics = config_read(path, &brokers, &cnt);
+
+	if(topics <= 0){
+		if(topics == 0) fprintf(stderr, "error: config file %s has no topics\n", path);
+		config_free(brokers, cnt);
+		return -1;
+	}
+
+	// client ids of all brokers follow each other, so the whole config is waited for at once
+	int cid = -1;
+	int failed = 0;
+	for(int n = 0; n < cnt; n++){
+
+		if(brokers[n].cnt == 0) continue;
+
+		int broker_failed;
+		int first = shell_create_clients(&ctx->pool, brokers[n].ip, brokers[n].topics, brokers[n].cnt, &broker_failed);
+		if(cid == -1) cid = first;
+		failed += broker_failed;
+	}
+	shell_ctl_track(&ctx->ctl, cid, topics, failed, start);
+
+	snprintf(log_msg, sizeof(log_msg), "config %d topics of %d brokers requested in %.1f ms\n",
+			topics, cnt, (shell_mono_ns() - start) / 1e6);
+	shell_log_write(&ctx->log, log_msg);
+	fprintf(stdout, "%s", log_msg);
+
+	config_free(brokers, cnt);
+
+	return topics;
+}
@@ -0,0 +1,46 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_config.h
+ * @brief: definitions and descriptions of startup config functions
+*/
+
+
+#ifndef SHELL_CONFIG_H
+#define SHELL_CONFIG_H
+
+#include"client_info.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<errno.h>
+
+
+// brokers and topics the shell subscribes at startup, a word starting with "//" begins a comment:
+//   broker <ip>			topics on the next lines belong to this broker
+//   <topic> [topic]...		one or more topics, "topic,qos:N" subscribes it with qos N
+// a broker may appear more than once, its topics are added together
+// every broker gets its own shared connection, so brokers are brought up side by side,
+// topics of a broker are sent to its connection at once and subscribed in batches
+
+#define CONFIG_LINE_LEN		4096	// line of the config file
+#define CONFIG_INIT_CNT		64	// topics a broker has room for at first
+#define CONFIG_DELIM		" \t\r\n"	// separators of words
+
+struct shell_ctx;
+
+// topics of one broker
+struct config_broker{
+
+	char		ip[IP_ADDR_LEN];	// broker ip address
+	char		**topics;		// topics
+	int		cnt;			// amount of topics
+	int		cap;			// topics the array has room for
+};
+
+
+// subscribes brokers and topics of config file at path, the time until every topic is subscribed is logged
+// returns amount of topics, -1 if the file can not be read or is not valid
+int shell_config_load(struct shell_ctx *ctx, const char *path);
+
+#endif // SHELL_CONFIG_H
@@ -0,0 +1,531 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_ctl.c
+ * @brief: declarations of shell control socket functions
+ * @note: descriptions for the functions in shell_ctl.h
+*/
+
+
+#define _GNU_SOURCE		// accept4
+
+#include"shell.h"
+
+// controller events watched besides input, output is watched only while replies wait to be written
+static uint32_t ctl_conn_events(const struct ctl_conn *conn){
+
+	return EPOLLIN | (conn->out_len > conn->out_off || conn->broken ? EPOLLOUT : 0);
+}
+
+// writes replies of controller until they are written or the socket is full
+static void ctl_conn_flush(struct ctl_conn *conn){
+
+	while(conn->out_off < conn->out_len){
+
+		ssize_t ret = send(conn->h.fd, conn->out + conn->out_off, conn->out_len - conn->out_off, MSG_NOSIGNAL);
+		if(ret == -1){
+
+			if(errno == EINTR) continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK) return;
+
+			// controller is closed by its own handler, the reply may be sent from another one
+			conn->broken = 1;
+			conn->out_len = conn->out_off = 0;
+			return;
+		}
+		conn->out_off += ret;
+	}
+	conn->out_len = conn->out_off = 0;
+}
+
+// queues reply of len bytes to controller and writes what the socket takes
+static void ctl_send(struct ctl_conn *conn, const char *reply, size_t len){
+
+	struct shell_loop *loop = &conn->ctl->ctx->loop;
+	int pending = conn->out_len > conn->out_off;
+
+	if(conn->broken){
+		return;
+	}
+	if(conn->out_len + len > CTL_OUT_MAX){
+		fprintf(stderr, "error: controller %d does not read its replies\n", conn->h.fd);
+		conn->broken = 1;
+		conn->out_len = conn->out_off = 0;
+		shell_loop_mod(loop, &conn->h, ctl_conn_events(conn));
+		return;
+	}
+
+	if(conn->out_len + len > conn->out_cap){
+
+		size_t cap = conn->out_cap ? conn->out_cap : CTL_REPLY_LEN;
+		while(cap < conn->out_len + len) cap *= 2;
+
+		char *out = realloc(conn->out, cap);
+		if(out == NULL){
+			fprintf(stderr, "error: reply buffer allocation failed(%d) --- %s\n", errno, strerror(errno));
+			conn->broken = 1;
+			shell_loop_mod(loop, &conn->h, ctl_conn_events(conn));
+			return;
+		}
+		conn->out = out;
+		conn->out_cap = cap;
+	}
+	memcpy(conn->out + conn->out_len, reply, len);
+	conn->out_len += len;
+
+	// earlier replies keep their order, the socket takes this one once they are written
+	if(!pending){
+		ctl_conn_flush(conn);
+	}
+	if(pending != (conn->out_len > conn->out_off) || conn->broken){
+		shell_loop_mod(loop, &conn->h, ctl_conn_events(conn));
+	}
+}
+
+// queues formatted single line reply to controller
+static void ctl_reply(struct ctl_conn *conn, const char *fmt, ...){
+
+	char reply[CTL_REPLY_LEN];
+	va_list ap;
+
+	va_start(ap, fmt);
+	int len = vsnprintf(reply, sizeof(reply) - 1, fmt, ap);
+	va_end(ap);
+
+	if(len > (int)sizeof(reply) - 2) len = sizeof(reply) - 2;
+	reply[len++] = '\n';
+	ctl_send(conn, reply, len);
+}
+
+// answers waiting connect request and stops waiting for it
+static void ctl_wait_done(struct shell_ctl *ctl, int n, int timeout){
+
+	struct ctl_wait *w = &ctl->waits[n];
+	double ms = (shell_mono_ns() - w->start) / 1e6;
+	char log_msg[LOG_MSG_LEN];
+
+	// request of the shell itself is logged
+	if(w->conn == NULL){
+		snprintf(log_msg, sizeof(log_msg), "%s%d of %d topics subscribed, %d failed in %.1f ms\n",
+				timeout ? "timed out, " : "", w->ok, w->cnt, w->failed, ms);
+		shell_log_write(&ctl->ctx->log, log_msg);
+		fprintf(stdout, "%s", log_msg);
+	}
+	else if(timeout){
+		ctl_reply(w->conn, "error %d %d timed out subscribed %d failed %d %.1f ms", w->cid, w->cnt, w->ok, w->failed, ms);
+	}
+	else{
+		ctl_reply(w->conn, "ok %d %d subscribed %d failed %d %.1f ms", w->cid, w->cnt, w->ok, w->failed, ms);
+	}
+	ctl->waits[n] = ctl->waits[--ctl->wait_cnt];
+}
+
+// waits for client ids of a connect request, topics that failed already are counted at once
+// request whose topics all failed is answered right away
+static void ctl_wait_add(struct shell_ctl *ctl, struct ctl_conn *conn, int cid, int cnt, int failed, int64_t start){
+
+	ctl->waits[ctl->wait_cnt++] = (struct ctl_wait){ conn, cid, cnt, 0, failed, 0, start };
+
+	if(failed == cnt){
+		ctl_wait_done(ctl, ctl->wait_cnt - 1, 0);
+	}
+}
+
+// subscribes topics of a broker: connect [-w] <ip> <topic>...
+static void ctl_connect(struct ctl_conn *conn, char *save){
+
+	struct shell_ctl *ctl = conn->ctl;
+	char *topics[CTL_TOPICS_MAX];
+	int cnt = 0;
+	int wait = 0;
+
+	char *ip = strtok_r(NULL, CTL_DELIM, &save);
+	if(ip != NULL && strcmp(ip, "-w") == 0){
+		wait = 1;
+		ip = strtok_r(NULL, CTL_DELIM, &save);
+	}
+	if(ip == NULL || strlen(ip) >= IP_ADDR_LEN || !shell_validate_address(ip)){
+		ctl_reply(conn, "error invalid ip address");
+		return;
+	}
+
+	for(char *topic = strtok_r(NULL, CTL_DELIM, &save); topic != NULL; topic = strtok_r(NULL, CTL_DELIM, &save)){
+
+		int len;
+		if(proto_topic_qos(topic, &len) == -1){
+			ctl_reply(conn, "error qos of topic %.64s is not valid", topic);
+			return;
+		}
+		if(len >= CLIENT_TOPIC_LEN){
+			ctl_reply(conn, "error topic %.64s is too long", topic);
+			return;
+		}
+		if(cnt == CTL_TOPICS_MAX){
+			ctl_reply(conn, "error more than %d topics", CTL_TOPICS_MAX);
+			return;
+		}
+		topics[cnt++] = topic;
+	}
+	if(cnt == 0){
+		ctl_reply(conn, "error no topics");
+		return;
+	}
+	if(ctl->ctx->flag == SHELL_TERMINATE){
+		ctl_reply(conn, "error shell is terminating");
+		return;
+	}
+	if(wait && ctl->wait_cnt == CTL_WAITS_MAX){
+		ctl_reply(conn, "error too many waiting connect requests");
+		return;
+	}
+
+	int64_t start = shell_mono_ns();
+	int failed;
+	int cid = shell_create_clients(&ctl->ctx->pool, ip, topics, cnt, &failed);
+
+	if(!wait){
+		ctl_reply(conn, "ok %d %d", cid, cnt);
+		return;
+	}
+	ctl_wait_add(ctl, conn, cid, cnt, failed, start);
+}
+
+// disconnects clients: disconnect <cid>...
+static void ctl_disconnect(struct ctl_conn *conn, char *save){
+
+	struct client_list *clist = &conn->ctl->ctx->clist;
+	struct shell_pool *pool = &conn->ctl->ctx->pool;
+	int cnt = 0;
+
+	for(char *tok = strtok_r(NULL, CTL_DELIM, &save); tok != NULL; tok = strtok_r(NULL, CTL_DELIM, &save)){
+
+		int n = shell_parse_option(tok);
+		int slot = n < 0 ? -1 : shell_clist_find_id(clist, n);
+
+		if(slot == -1){
+			ctl_reply(conn, "unknown %.64s", tok);
+			continue;
+		}
+	#if USE_BUILTIN
+		shell_disconnect_sensor_blt(pool, clist, slot);
+	#else
+		shell_disconnect_sensor(pool, clist, slot);
+	#endif // USE_BUILTIN
+		cnt++;
+	}
+	ctl_reply(conn, "ok %d", cnt);
+}
+
+// lists clients: list
+static void ctl_list(struct ctl_conn *conn){
+
+	struct client_list *clist = &conn->ctl->ctx->clist;
+	int cnt = 0;
+
+	for(int n = 0; n < clist->cap; n++){
+
+		if(!SLOT_IS_SET(clist, n)) continue;
+
+		struct client_info *c = &clist->clients[n];
+		ctl_reply(conn, "%d %d %s %s", c->id, c->pid, c->ip, c->topic);
+		cnt++;
+	}
+	ctl_reply(conn, "ok %d", cnt);
+}
+
+// shows statistics of every topic: stats
+// rows of wildcard subscriptions are followed by rows of their concrete topics
+static void ctl_stats(struct ctl_conn *conn){
+
+	struct shell_ctx *ctx = conn->ctl->ctx;
+	struct client_list *clist = &ctx->clist;
+	int64_t now = shell_mono_ns();
+	char *buf = NULL;
+	size_t len = 0;
+	int cnt = 0;
+
+	// rows are printed by the same functions as the menu
+	FILE *out = open_memstream(&buf, &len);
+	if(out == NULL){
+		ctl_reply(conn, "error statistics unavailable(%d) --- %s", errno, strerror(errno));
+		return;
+	}
+	fprintf(out, "CID	TOPIC	");
+	shell_stats_print_head(out);
+	fprintf(out, "\n");
+
+	for(int n = 0; n < clist->cap; n++){
+
+		if(!SLOT_IS_SET(clist, n)) continue;
+
+		fprintf(out, "%d	%s	", clist->clients[n].id, clist->clients[n].topic);
+		shell_stats_print(out, &clist->stats[n], now);
+		fprintf(out, "\n");
+		cnt++;
+	}
+	for(struct topic_state *ts = ctx->topics.states; ts != NULL; ts = ts->next){
+
+		fprintf(out, "%d	%s	", ts->cid, ts->topic);
+		shell_stats_print(out, &ts->stats, now);
+		fprintf(out, "\n");
+		cnt++;
+	}
+	fprintf(out, "ok %d\n", cnt);
+	fclose(out);
+
+	ctl_send(conn, buf, len);
+	free(buf);
+}
+
+// runs one command line of controller
+static void ctl_command(struct ctl_conn *conn, char *line){
+
+	char *save;
+	char *cmd = strtok_r(line, CTL_DELIM, &save);
+
+	if(cmd == NULL){
+		return;
+	}
+	if(strcmp(cmd, "connect") == 0){
+		ctl_connect(conn, save);
+	}
+	else if(strcmp(cmd, "disconnect") == 0){
+		ctl_disconnect(conn, save);
+	}
+	else if(strcmp(cmd, "list") == 0){
+		ctl_list(conn);
+	}
+	else if(strcmp(cmd, "stats") == 0){
+		ctl_stats(conn);
+	}
+	else{
+		ctl_reply(conn, "error unknown command %.64s", cmd);
+	}
+}
+
+// closes controller, its waiting connect requests are dropped
+static void ctl_conn_close(struct ctl_conn *conn){
+
+	struct shell_ctl *ctl = conn->ctl;
+
+	for(int n = 0; n < ctl->wait_cnt; ){
+
+		if(ctl->waits[n].conn == conn){
+			ctl->waits[n] = ctl->waits[--ctl->wait_cnt];
+		}
+		else n++;
+	}
+	for(int n = 0; n < ctl->conn_cnt; n++){
+
+		if(ctl->conns[n] == conn){
+			ctl->conns[n] = ctl->conns[--ctl->conn_cnt];
+			break;
+		}
+	}
+	shell_loop_del(&ctl->ctx->loop, &conn->h);
+	close(conn->h.fd);
+	free(conn->out);
+	free(conn);
+}
+
+// reads commands of controller and writes its pending replies
+static void on_ctl_conn(int fd, uint32_t events, void *arg){
+
+	struct ctl_conn *conn = arg;
+
+	if(events & EPOLLOUT){
+
+		ctl_conn_flush(conn);
+		shell_loop_mod(&conn->ctl->ctx->loop, &conn->h, ctl_conn_events(conn));
+	}
+	if(conn->broken){
+		ctl_conn_close(conn);
+		return;
+	}
+	if(!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))){
+		return;
+	}
+
+	ssize_t ret = read(fd, conn->in + conn->in_len, sizeof(conn->in) - conn->in_len - 1);
+
+	if(ret == -1 && (errno == EAGAIN || errno == EINTR)){
+		return;
+	}
+	if(ret <= 0){
+		ctl_conn_close(conn);
+		return;
+	}
+	conn->in_len += ret;
+	conn->in[conn->in_len] = '\0';
+
+	// run every complete line
+	char *start = conn->in;
+	char *nl;
+
+	while((nl = memchr(start, '\n', conn->in + conn->in_len - start)) != NULL){
+
+		*nl = '\0';
+		if(conn->discard){
+			ctl_reply(conn, "error line is too long");
+			conn->discard = 0;
+		}
+		else{
+			ctl_command(conn, start);
+		}
+		start = nl + 1;
+	}
+
+	// keep partial line, a line filling the whole buffer is dropped up to its end
+	conn->in_len -= start - conn->in;
+	memmove(conn->in, start, conn->in_len);
+
+	if(conn->in_len == sizeof(conn->in) - 1){
+		conn->discard = 1;
+		conn->in_len = 0;
+	}
+	if(conn->broken){
+		ctl_conn_close(conn);
+	}
+}
+
+// accepts controllers
+static void on_ctl_accept(int fd, uint32_t events, void *arg){
+
+	struct shell_ctl *ctl = arg;
+	int cfd;
+
+	(void)events;
+	while((cfd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1){
+
+		if(ctl->conn_cnt == CTL_CONNS_MAX){
+			fprintf(stderr, "error: more than %d controllers, controller refused\n", CTL_CONNS_MAX);
+			close(cfd);
+			continue;
+		}
+
+		struct ctl_conn *conn = calloc(1, sizeof(struct ctl_conn));
+		if(conn == NULL){
+			fprintf(stderr, "error: controller allocation failed(%d) --- %s\n", errno, strerror(errno));
+			close(cfd);
+			continue;
+		}
+		conn->h = (struct shell_loop_handler){ cfd, on_ctl_conn, conn };
+		conn->ctl = ctl;
+
+		if(shell_loop_add(&ctl->ctx->loop, &conn->h, EPOLLIN) == -1){
+			close(cfd);
+			free(conn);
+			continue;
+		}
+		ctl->conns[ctl->conn_cnt++] = conn;
+	}
+	if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+		fprintf(stderr, "error: accepting controller failed(%d) --- %s\n", errno, strerror(errno));
+	}
+}
+
+// initializes control socket without listening
+void shell_ctl_init(struct shell_ctl *ctl, struct shell_ctx *ctx){
+
+	memset(ctl, 0, sizeof(*ctl));
+	ctl->h.fd = -1;
+	ctl->ctx = ctx;
+}
+
+// listens for controllers at path
+int shell_ctl_open(struct shell_ctl *ctl, const char *path){
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct stat st;
+
+	if(strlen(path) >= sizeof(addr.sun_path)){
+		fprintf(stderr, "error: control socket path %s is too long\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	// socket left by a shell that did not exit cleanly is replaced, other files are not touched
+	if(stat(path, &st) == 0 && S_ISSOCK(st.st_mode)){
+		unlink(path);
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(fd == -1){
+		fprintf(stderr, "error: control socket creation failed(%d) --- %s\n", errno, strerror(errno));
+		return -1;
+	}
+	if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, CTL_CONNS_MAX) == -1){
+		fprintf(stderr, "error: listening on %s failed(%d) --- %s\n", path, errno, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	ctl->h = (struct shell_loop_handler){ fd, on_ctl_accept, ctl };
+	if(shell_loop_add(&ctl->ctx->loop, &ctl->h, EPOLLIN) == -1){
+		close(fd);
+		unlink(path);
+		ctl->h.fd = -1;
+		return -1;
+	}
+	strcpy(ctl->path, path);
+
+	return 0;
+}
+
+// closes controllers and the socket
+void shell_ctl_close(struct shell_ctl *ctl){
+
+	while(ctl->conn_cnt > 0){
+		ctl_conn_close(ctl->conns[0]);
+	}
+	if(ctl->h.fd == -1){
+		return;
+	}
+	shell_loop_del(&ctl->ctx->loop, &ctl->h);
+	close(ctl->h.fd);
+	unlink(ctl->path);
+	ctl->h.fd = -1;
+}
+
+// waits for subscriptions of client ids cid..cid + cnt - 1 requested at start(monotonic ns) by the shell itself
+int shell_ctl_track(struct shell_ctl *ctl, int cid, int cnt, int failed, int64_t start){
+
+	if(ctl->wait_cnt == CTL_WAITS_MAX){
+		return -1;
+	}
+	ctl_wait_add(ctl, NULL, cid, cnt, failed, start);
+
+	return 0;
+}
+
+// counts client id for connect requests waiting for it
+void shell_ctl_notify(struct shell_ctl *ctl, int cid, int ok){
+
+	for(int n = 0; n < ctl->wait_cnt; n++){
+
+		struct ctl_wait *w = &ctl->waits[n];
+		if(cid < w->cid || cid >= w->cid + w->cnt) continue;
+
+		if(ok) w->ok++;
+		else w->failed++;
+
+		if(w->ok + w->failed == w->cnt){
+			ctl_wait_done(ctl, n, 0);
+		}
+		// client ids of requests do not overlap
+		return;
+	}
+}
+
+// answers connect requests that waited for too long
+void shell_ctl_tick(struct shell_ctl *ctl, uint64_t ticks){
+
+	for(int n = 0; n < ctl->wait_cnt; ){
+
+		ctl->waits[n].ticks += ticks;
+		if(ctl->waits[n].ticks > CTL_WAIT_TICKS){
+			ctl_wait_done(ctl, n, 1);
+		}
+		else n++;
+	}
+}
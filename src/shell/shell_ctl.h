@@ -0,0 +1,109 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_ctl.h
+ * @brief: definitions and descriptions of shell control socket functions
+*/
+
+
+#ifndef SHELL_CTL_H
+#define SHELL_CTL_H
+
+#include"shell_loop.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<stdarg.h>
+#include<unistd.h>
+#include<errno.h>
+#include<sys/socket.h>
+#include<sys/stat.h>
+#include<sys/un.h>
+
+
+// scripts drive the shell through a unix domain socket without the menu, one command per line:
+//   connect [-w] <ip> <topic>...	subscribes topics on the shared connection to the broker
+//					"topic,qos:N" subscribes it with qos N
+//					reply: ok <first cid> <cnt>
+//					with -w the reply comes once every topic is subscribed or failed:
+//					ok <first cid> <cnt> subscribed <n> failed <n> <ms> ms
+//   disconnect <cid>...		disconnects clients, reply: unknown <cid> for every unknown client, ok <cnt>
+//   list				reply: <cid> <pid> <ip> <topic> for every client, ok <cnt>
+//   stats				reply: statistics of every topic, ok <cnt>
+// every reply ends with a line starting with "ok" or "error", replies of commands come in order
+// except the ones of connect -w, they carry their first client id to be told apart
+
+#define CTL_LINE_LEN		65536		// command line, holds a batch of hundreds of topics
+#define CTL_TOPICS_MAX		4096		// topics of one connect command
+#define CTL_CONNS_MAX		16		// connected controllers
+#define CTL_WAITS_MAX		64		// connect requests waiting for their subscriptions
+#define CTL_WAIT_TICKS		30		// timer ticks a connect request waits for its subscriptions
+#define CTL_OUT_MAX		(16 << 20)	// replies a controller may leave unread before it is dropped
+#define CTL_REPLY_LEN		256		// single line reply
+#define CTL_DELIM		" \t\r"		// separators of command words
+
+struct shell_ctx;
+struct shell_ctl;
+
+// connected controller
+struct ctl_conn{
+
+	struct shell_loop_handler h;		// socket of the controller
+	struct shell_ctl	*ctl;		// control socket it connected to
+	int			broken;		// writing failed, closed on its next event
+	int			discard;	// command line was too long
+	size_t			in_len;		// length of partial command line
+	char			*out;		// replies not written yet
+	size_t			out_len;	// length of replies
+	size_t			out_off;	// written part of replies
+	size_t			out_cap;	// size of reply buffer
+	char			in[CTL_LINE_LEN];	// partially read command line
+};
+
+// connect request waiting for its subscriptions
+struct ctl_wait{
+
+	struct ctl_conn		*conn;		// controller the reply goes to, NULL request of the shell
+	int			cid;		// first client id of the request
+	int			cnt;		// amount of client ids
+	int			ok;		// subscribed topics
+	int			failed;		// topics that failed
+	int			ticks;		// timer ticks waited
+	int64_t			start;		// monotonic time of the request
+};
+
+// control socket
+struct shell_ctl{
+
+	struct shell_loop_handler h;		// listening socket, fd -1 if there is none
+	struct shell_ctx	*ctx;		// shell the commands are run on
+	struct ctl_conn		*conns[CTL_CONNS_MAX];	// connected controllers
+	int			conn_cnt;	// amount of them
+	struct ctl_wait		waits[CTL_WAITS_MAX];	// waiting connect requests
+	int			wait_cnt;	// amount of them
+	char			path[sizeof(((struct sockaddr_un*)0)->sun_path)];	// path of the socket
+};
+
+
+// initializes control socket without listening
+void shell_ctl_init(struct shell_ctl *ctl, struct shell_ctx *ctx);
+
+// listens for controllers at path and watches the socket with the event loop of the shell, -1 on failure
+int shell_ctl_open(struct shell_ctl *ctl, const char *path);
+
+// closes controllers and the socket, its path is removed
+void shell_ctl_close(struct shell_ctl *ctl);
+
+// waits for subscriptions of client ids cid..cid + cnt - 1 requested at start(monotonic ns) by the shell itself
+// topics that failed to be requested are counted at once
+// the result is logged instead of sent to a controller, -1 if too many requests wait
+int shell_ctl_track(struct shell_ctl *ctl, int cid, int cnt, int failed, int64_t start);
+
+// counts client id as subscribed(ok 1) or failed(ok 0) for connect requests waiting for it
+void shell_ctl_notify(struct shell_ctl *ctl, int cid, int ok);
+
+// answers connect requests that waited for too long, called on timer ticks
+void shell_ctl_tick(struct shell_ctl *ctl, uint64_t ticks);
+
+#endif // SHELL_CTL_H
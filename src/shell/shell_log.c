@@ -0,0 +1,231 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_log.c
+ * @brief: declarations of asynchronous log writer functions
+ * @note: descriptions for the functions in shell_log.h
+*/
+
+
+#include"shell_log.h"
+
+
+// opens current log file, -1 on failure
+static int log_open_file(struct shell_log *log){
+
+	struct stat st;
+
+	int fd = open(log->cfg.path, O_CREAT | O_APPEND | O_WRONLY | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if(fd < 0){
+		fprintf(stderr, "error: opening log file failed(%d) --- %s\n", errno, strerror(errno));
+		return -1;
+	}
+
+	log->file_bytes = fstat(fd, &st) == 0 ? st.st_size : 0;
+	log->file_start = time(NULL);
+	return fd;
+}
+
+// checks if current log file has to be rotated before writing len bytes
+static int log_need_rotate(struct shell_log *log, int len){
+
+	if(log->cfg.rotate_bytes > 0 && log->file_bytes > 0 && log->file_bytes + len > log->cfg.rotate_bytes){
+		return 1;
+	}
+	if(log->cfg.rotate_sec > 0 && log->file_bytes > 0 && time(NULL) - log->file_start >= log->cfg.rotate_sec){
+		return 1;
+	}
+	return 0;
+}
+
+// renames path.n to path.n+1 and path to path.1, oldest file is overwritten
+static void log_rotate(struct shell_log *log){
+
+	char from[PATH_MAX], to[PATH_MAX];
+
+	if(log->fd != -1){
+		close(log->fd);
+	}
+
+	for(int i = LOG_KEEP - 1; i >= 1; i--){
+		snprintf(from, sizeof(from), "%s.%d", log->cfg.path, i);
+		snprintf(to, sizeof(to), "%s.%d", log->cfg.path, i + 1);
+		rename(from, to);
+	}
+	snprintf(to, sizeof(to), "%s.1", log->cfg.path);
+	if(rename(log->cfg.path, to) == -1){
+		fprintf(stderr, "error: rotating log file failed(%d) --- %s\n", errno, strerror(errno));
+	}
+
+	log->fd = log_open_file(log);
+}
+
+// writes a batch to log file and makes it durable when requested
+static void log_write_batch(struct shell_log *log, const char *buf, int len){
+
+	int done = 0;
+
+	if(log_need_rotate(log, len)){
+		log_rotate(log);
+	}
+	if(log->fd == -1){
+		return;
+	}
+
+	while(done < len){
+
+		int ret = write(log->fd, buf + done, len - done);
+		if(ret < 0){
+			if(errno == EINTR) continue;
+
+			// writer thread can not terminate the shell, batch is lost
+			fprintf(stderr, "error: writing to a log file failed(%d) --- %s\n", errno, strerror(errno));
+			return;
+		}
+		done += ret;
+	}
+
+	// one fdatasync covers every message of the batch
+	if(log->cfg.sync == LOG_SYNC_DATA && fdatasync(log->fd) == -1){
+		fprintf(stderr, "error: syncing log file failed(%d) --- %s\n", errno, strerror(errno));
+	}
+
+	log->file_bytes += len;
+	log->bytes += len;
+	log->batches++;
+}
+
+// writer thread: waits until active buffer is half full or flush interval passes
+// then swaps buffers and writes the full one while producer fills the other
+static void *log_writer(void *arg){
+
+	struct shell_log *log = arg;
+
+	pthread_mutex_lock(&log->lock);
+	while(1){
+
+		if(!log->stop && log->len < LOG_BUF_LEN / 2){
+
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			ts.tv_sec += log->cfg.flush_ms / 1000;
+			ts.tv_nsec += (log->cfg.flush_ms % 1000) * 1000000L;
+			if(ts.tv_nsec >= 1000000000L){
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&log->cond, &log->lock, &ts);
+		}
+
+		if(log->len == 0 && log->dropped == 0){
+			if(log->stop) break;
+			continue;
+		}
+
+		// swap buffers
+		char *buf = log->buf[log->active];
+		int len = log->len;
+		long dropped = log->dropped;
+
+		log->active ^= 1;
+		log->len = 0;
+		log->drops += log->dropped;
+		log->dropped = 0;
+		pthread_mutex_unlock(&log->lock);
+
+		log_write_batch(log, buf, len);
+		if(dropped > 0){
+
+			char msg[64];
+			int ret = snprintf(msg, sizeof(msg), "%ld log messages dropped\n", dropped);
+			log_write_batch(log, msg, ret);
+		}
+
+		pthread_mutex_lock(&log->lock);
+	}
+	pthread_mutex_unlock(&log->lock);
+
+	return NULL;
+}
+
+// opens log file and starts writer thread
+void shell_log_open(struct shell_log *log, const struct shell_log_cfg *cfg){
+
+	pthread_condattr_t attr;
+
+	memset(log, 0, sizeof(struct shell_log));
+	log->cfg = *cfg;
+	if(log->cfg.flush_ms <= 0){
+		log->cfg.flush_ms = LOG_FLUSH_MS;
+	}
+
+	log->fd = log_open_file(log);
+	log->buf[0] = malloc(LOG_BUF_LEN);
+	log->buf[1] = malloc(LOG_BUF_LEN);
+	if(log->fd == -1 || log->buf[0] == NULL || log->buf[1] == NULL){
+		exit(EXIT_FAILURE);
+	}
+
+	// flush interval is measured with monotonic clock
+	pthread_mutex_init(&log->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&log->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	// writer thread blocks every signal, they are handled by the shell loop
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+
+	if(pthread_create(&log->thread, NULL, log_writer, log) != 0){
+		fprintf(stderr, "error: starting log writer failed\n");
+		exit(EXIT_FAILURE);
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+// writes buffered messages, stops writer thread and closes log file
+void shell_log_close(struct shell_log *log){
+
+	pthread_mutex_lock(&log->lock);
+	log->stop = 1;
+	pthread_cond_signal(&log->cond);
+	pthread_mutex_unlock(&log->lock);
+
+	pthread_join(log->thread, NULL);
+
+	if(log->fd != -1){
+		close(log->fd);
+		log->fd = -1;
+	}
+	pthread_cond_destroy(&log->cond);
+	pthread_mutex_destroy(&log->lock);
+	free(log->buf[0]);
+	free(log->buf[1]);
+	log->buf[0] = log->buf[1] = NULL;
+}
+
+// appends a message to the log, never waits for the disk
+// when both buffers are full the message is dropped and counted
+void shell_log_write(struct shell_log *log, const char msg[]){
+
+	int len = strlen(msg);
+
+	pthread_mutex_lock(&log->lock);
+
+	if(log->len + len > LOG_BUF_LEN){
+		log->dropped++;
+	}
+	else{
+		memcpy(log->buf[log->active] + log->len, msg, len);
+		log->len += len;
+
+		// wake writer once when buffer gets half full, otherwise it wakes on flush interval
+		if(log->len >= LOG_BUF_LEN / 2 && log->len - len < LOG_BUF_LEN / 2){
+			pthread_cond_signal(&log->cond);
+		}
+	}
+
+	pthread_mutex_unlock(&log->lock);
+}
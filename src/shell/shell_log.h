@@ -0,0 +1,80 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_log.h
+ * @brief: definitions and descriptions of asynchronous log writer functions
+*/
+
+
+#ifndef SHELL_LOG_H
+#define SHELL_LOG_H
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<time.h>
+#include<limits.h>
+#include<signal.h>
+#include<pthread.h>
+#include<sys/stat.h>
+
+
+#define LOG_BUF_LEN		(1 << 20)	// bytes of one log buffer
+#define LOG_FLUSH_MS		200		// default interval of writing buffered messages
+#define LOG_ROTATE_BYTES	(8 << 20)	// default size of a log file before rotation(0 never)
+#define LOG_ROTATE_SEC		(24 * 3600)	// default age of a log file before rotation(0 never)
+#define LOG_KEEP		5		// rotated files kept as path.1 ... path.LOG_KEEP
+
+// how written messages are made durable
+enum log_sync{
+
+	LOG_SYNC_NONE,			// leave writing to disk to the kernel
+	LOG_SYNC_DATA			// fdatasync every written batch
+};
+
+// configuration of the log
+struct shell_log_cfg{
+
+	const char	*path;			// log file
+	int		flush_ms;		// interval of writing buffered messages
+	enum log_sync	sync;			// durability of written messages
+	long		rotate_bytes;		// rotate when file grows over this size, 0 never
+	long		rotate_sec;		// rotate when file gets older than this, 0 never
+};
+
+// log with a writer thread
+// producer appends messages to the active buffer, writer thread swaps buffers
+// and writes the full one in a single batch so the producer never waits for the disk
+struct shell_log{
+
+	struct shell_log_cfg	cfg;			// configuration of the log
+	pthread_t		thread;			// writer thread
+	pthread_mutex_t		lock;			// protects buffers and counters
+	pthread_cond_t		cond;			// wakes writer thread
+	char			*buf[2];		// active and written buffer
+	int			active;			// buffer producer appends to
+	int			len;			// bytes in active buffer
+	int			stop;			// writer writes what is left and exits
+	int			fd;			// current log file, used only by writer
+	long			file_bytes;		// size of current log file
+	time_t			file_start;		// time current log file was opened
+	long			dropped;		// messages dropped because buffers were full, not yet reported
+	long			drops;			// messages dropped since log was opened
+	long			bytes;			// bytes written to log files
+	long			batches;		// written batches
+};
+
+
+// opens log file and starts writer thread
+void shell_log_open(struct shell_log *log, const struct shell_log_cfg *cfg);
+
+// writes buffered messages, stops writer thread and closes log file
+void shell_log_close(struct shell_log *log);
+
+// appends a message to the log, never waits for the disk
+void shell_log_write(struct shell_log *log, const char msg[]);
+
+#endif // SHELL_LOG_H
@@ -0,0 +1,141 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_loop.c
+ * @brief: declarations of shell event loop functions
+ * @note: descriptions for the functions in shell_loop.h
+*/
+
+
+#include"shell_loop.h"
+
+// initializes event loop
+void shell_loop_init(struct shell_loop *loop){
+
+	loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if(loop->epfd == -1){
+		fprintf(stderr, "error: epoll creation failed(%d) --- %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	loop->running = 1;
+}
+
+// closes event loop
+void shell_loop_close(struct shell_loop *loop){
+
+	close(loop->epfd);
+	loop->epfd = -1;
+	loop->running = 0;
+}
+
+// starts watching events of a handlers file descriptor
+int shell_loop_add(struct shell_loop *loop, struct shell_loop_handler *h, uint32_t events){
+
+	struct epoll_event ev = {0};
+	ev.events = events;
+	ev.data.ptr = h;
+
+	if(epoll_ctl(loop->epfd, EPOLL_CTL_ADD, h->fd, &ev) == -1){
+		fprintf(stderr, "error: watching fd %d failed(%d) --- %s\n", h->fd, errno, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+// changes events watched on a handlers file descriptor
+int shell_loop_mod(struct shell_loop *loop, struct shell_loop_handler *h, uint32_t events){
+
+	struct epoll_event ev = {0};
+	ev.events = events;
+	ev.data.ptr = h;
+
+	if(epoll_ctl(loop->epfd, EPOLL_CTL_MOD, h->fd, &ev) == -1){
+		fprintf(stderr, "error: changing events of fd %d failed(%d) --- %s\n", h->fd, errno, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+// stops watching a handlers file descriptor
+void shell_loop_del(struct shell_loop *loop, struct shell_loop_handler *h){
+
+	if(epoll_ctl(loop->epfd, EPOLL_CTL_DEL, h->fd, NULL) == -1){
+		fprintf(stderr, "error: unwatching fd %d failed(%d) --- %s\n", h->fd, errno, strerror(errno));
+	}
+}
+
+// waits for events at most timeout ms(-1 forever) and calls their handlers
+int shell_loop_run_once(struct shell_loop *loop, int timeout){
+
+	struct epoll_event events[LOOP_MAX_EVENTS];
+
+	int cnt = epoll_wait(loop->epfd, events, LOOP_MAX_EVENTS, timeout);
+	if(cnt == -1){
+
+		if(errno == EINTR) return 0;
+		fprintf(stderr, "error: epoll wait failed(%d) --- %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	// every ready descriptor gets one turn, handlers limit their own work
+	// so that a flood on one descriptor does not starve the others
+	for(int i = 0; i < cnt; i++){
+
+		struct shell_loop_handler *h = events[i].data.ptr;
+		h->fn(h->fd, events[i].events, h->arg);
+	}
+	return cnt;
+}
+
+// sets file descriptor as non-blocking
+void shell_set_nonblock(int fd){
+
+	int flags = fcntl(fd, F_GETFL);
+	if(flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1){
+		fprintf(stderr, "error: setting fd %d non-blocking failed(%d) --- %s\n", fd, errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+// blocks signals and returns a signalfd that reads them
+int shell_signalfd_open(const sigset_t *mask){
+
+	if(sigprocmask(SIG_BLOCK, mask, NULL) == -1){
+		fprintf(stderr, "error: blocking signals failed(%d) --- %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	int fd = signalfd(-1, mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if(fd == -1){
+		fprintf(stderr, "error: signalfd creation failed(%d) --- %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+// returns timerfd expiring every interval ms
+int shell_timerfd_open(int interval){
+
+	struct itimerspec its = {0};
+	its.it_interval.tv_sec = interval / 1000;
+	its.it_interval.tv_nsec = (interval % 1000) * 1000000L;
+	its.it_value = its.it_interval;
+
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if(fd == -1 || timerfd_settime(fd, 0, &its, NULL) == -1){
+		fprintf(stderr, "error: timerfd creation failed(%d) --- %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+// reads amount of expirations from timerfd
+uint64_t shell_timerfd_read(int fd){
+
+	uint64_t expirations = 0;
+
+	if(read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)){
+		return 0;
+	}
+	return expirations;
+}
@@ -0,0 +1,76 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_loop.h
+ * @brief: definitions and descriptions of shell event loop functions
+*/
+
+
+#ifndef SHELL_LOOP_H
+#define SHELL_LOOP_H
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<stdint.h>
+#include<unistd.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<signal.h>
+#include<sys/epoll.h>
+#include<sys/signalfd.h>
+#include<sys/timerfd.h>
+
+
+#define LOOP_MAX_EVENTS		32	// events handled in one loop iteration
+
+// function handling events of a file descriptor
+typedef void (*shell_loop_fn)(int fd, uint32_t events, void *arg);
+
+// file descriptor watched by the event loop
+struct shell_loop_handler{
+
+	int		fd;			// watched file descriptor
+	shell_loop_fn	fn;			// function called when fd is ready
+	void		*arg;			// argument given to the function
+};
+
+// event loop structure
+struct shell_loop{
+
+	int		epfd;			// epoll instance
+	int		running;		// loop runs while set
+};
+
+
+// initializes event loop
+void shell_loop_init(struct shell_loop *loop);
+
+// closes event loop
+void shell_loop_close(struct shell_loop *loop);
+
+// starts watching events of a handlers file descriptor, -1 on failure
+int shell_loop_add(struct shell_loop *loop, struct shell_loop_handler *h, uint32_t events);
+
+// changes events watched on a handlers file descriptor, -1 on failure
+int shell_loop_mod(struct shell_loop *loop, struct shell_loop_handler *h, uint32_t events);
+
+// stops watching a handlers file descriptor
+void shell_loop_del(struct shell_loop *loop, struct shell_loop_handler *h);
+
+// waits for events at most timeout ms(-1 forever) and calls their handlers
+int shell_loop_run_once(struct shell_loop *loop, int timeout);
+
+// sets file descriptor as non-blocking
+void shell_set_nonblock(int fd);
+
+// blocks signals and returns a signalfd that reads them
+int shell_signalfd_open(const sigset_t *mask);
+
+// returns timerfd expiring every interval ms
+int shell_timerfd_open(int interval);
+
+// reads amount of expirations from timerfd
+uint64_t shell_timerfd_read(int fd);
+
+#endif // SHELL_LOOP_H
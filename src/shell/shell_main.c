@@ -7,74 +7,264 @@
 
 #include"shell.h"
 #include<time.h>
+#include<getopt.h>
 
-int g_signal_caught = -1;
+// handles data coming from clients through the common pipe
+static void on_pipe(int fd, uint32_t events, void *arg){
 
-int main(void){
+	struct shell_ctx *ctx = arg;
 
-	struct sigaction sa;
-	shell_setup_signal_handler(&sa);
+	(void)events;
+	shell_ingest(fd, ctx);
+}
 
-	int pipefd[2];		// common pipe
-	char pipefd_w[3];	// write part of the pipe as string
+// handles wakeup of a client ring
+static void on_ring(int fd, uint32_t events, void *arg){
+
+	struct shell_ring *sr = arg;
+	struct shell_ctx *ctx = sr->arg;
+
+	(void)fd;
+	(void)events;
+	shell_ingest_ring(ctx, sr);
+}
+
+// handles sigint: opens the menu, and sigchld: reaps clients
+static void on_signal(int fd, uint32_t events, void *arg){
+
+	struct shell_ctx *ctx = arg;
+	struct signalfd_siginfo si;
+
+	(void)events;
+	while(read(fd, &si, sizeof(si)) == sizeof(si)){
+
+		// if termination flag is set skip request handling
+		if(si.ssi_signo == SIGINT && ctx->flag != SHELL_TERMINATE){
+			shell_show_menu(&ctx->menu);
+		}
+		// one signal may stand for many exited clients
+		else if(si.ssi_signo == SIGCHLD){
+			shell_reap_clients(&ctx->pool);
+		}
+	}
+}
+
+// handles user input
+static void on_stdin(int fd, uint32_t events, void *arg){
 
-	struct client_info client;
-	struct client_info clients[CLIENTS_MAX_CNT];
-	memset(clients, 0, sizeof(clients));
+	struct shell_ctx *ctx = arg;
+
+	(void)events;
+	if(!shell_read_input(fd, ctx)){
+
+		// input is closed, stop watching it so the loop does not spin
+		struct shell_loop_handler h = { .fd = fd };
+		shell_loop_del(&ctx->loop, &h);
+	}
+}
 
-	struct client_list clist;
-	clist.clients = clients;
-	clist.slots = 0;
-	clist.slots_max = CLIENT_SLOTS_FULL;
-	clist.full = false;
+// handles shell timer
+static void on_timer(int fd, uint32_t events, void *arg){
 
-	int flag = 0;
+	struct shell_ctx *ctx = arg;
+
+	(void)events;
+	uint64_t ticks = shell_timerfd_read(fd);
+
+	// topics without readings close their aggregation windows too
+	shell_close_windows(ctx, time(NULL));
+	shell_rules_tick(&ctx->rules, shell_mono_ns());
+	shell_ctl_tick(&ctx->ctl, ticks);
+
+	// clients that died without reporting do not keep the shell alive
+	if(ctx->flag == SHELL_TERMINATE){
+
+		ctx->term_ticks += ticks;
+		if(ctx->term_ticks > SHELL_TERM_GRACE){
+			fprintf(stdout, "%d clients did not disconnect, terminating anyway\n", ctx->clist.cnt);
+			ctx->loop.running = 0;
+		}
+	}
+	else{
+		shell_pool_tick(&ctx->pool, ticks);
+	}
+}
+
+// prints usage of the shell
+static void shell_usage(const char *name){
+
+	fprintf(stderr, "usage: %s [-f flush_ms] [-d] [-r rotate_bytes] [-t rotate_sec] [-s store_dir] [-w idle_clients] [-a window] [-R rules] [-c socket] [-C config]\n"
+			"  -f  interval of writing log messages(default %d ms)\n"
+			"  -d  fdatasync every written batch of log messages\n"
+			"  -r  rotate log file when it grows over this size(default %d, 0 never)\n"
+			"  -t  rotate log file when it gets older than this(default %d, 0 never)\n"
+			"  -s  directory of stored readings(default %s, %s stores nothing)\n"
+			"  -w  started clients kept waiting for connects(default %d, 0 start a client per broker when needed)\n"
+			"  -a  print one summary record per topic and window(e.g. 1s, 10s, 1m) instead of every reading\n"
+			"  -R  file of alert rules, alerts are printed and written to %s\n"
+			"  -c  unix socket scripts connect, disconnect, list clients and read statistics through\n"
+			"  -C  file of brokers and topics subscribed at startup\n",
+			name, LOG_FLUSH_MS, LOG_ROTATE_BYTES, LOG_ROTATE_SEC, TSDB_DIR, TSDB_OFF, POOL_IDLE_MIN, RULES_ALERTS_PATH);
+}
+
+int main(int argc, char *argv[]){
+
+	static struct shell_ctx ctx;
+
+	int pipefd[2];		// common pipe
 
 	time_t raw_time;
 	struct tm *timeinfo;
 	char log_msg[LOG_MSG_LEN];
 
-	// create common pipe
+	struct shell_log_cfg log_cfg = { "log.txt", LOG_FLUSH_MS, LOG_SYNC_NONE, LOG_ROTATE_BYTES, LOG_ROTATE_SEC };
+	const char *store_dir = TSDB_DIR;
+	const char *rules_path = NULL;
+	const char *ctl_path = NULL;
+	const char *config_path = NULL;
+	int idle_clients = POOL_IDLE_MIN;
+	int64_t window = 0;
+	int opt;
+
+	while((opt = getopt(argc, argv, "f:dr:t:s:w:a:R:c:C:")) != -1){
+
+		switch(opt){
+
+			case 'f': log_cfg.flush_ms = atoi(optarg); break;
+			case 'd': log_cfg.sync = LOG_SYNC_DATA; break;
+			case 'r': log_cfg.rotate_bytes = atol(optarg); break;
+			case 't': log_cfg.rotate_sec = atol(optarg); break;
+			case 's': store_dir = strcmp(optarg, TSDB_OFF) == 0 ? NULL : optarg; break;
+			case 'w': idle_clients = atoi(optarg); break;
+			case 'R': rules_path = optarg; break;
+			case 'c': ctl_path = optarg; break;
+			case 'C': config_path = optarg; break;
+			case 'a':
+				if((window = shell_window_parse(optarg)) == -1){
+					fprintf(stderr, "error: window %s is not valid\n", optarg);
+					shell_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			default:
+				shell_usage(argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	shell_clist_init(&ctx.clist, CLIENTS_INIT_CNT);
+	if(shell_tsdb_open(&ctx.db, store_dir) == -1){
+		exit(EXIT_FAILURE);
+	}
+	if(shell_topics_init(&ctx.topics) == -1){
+		exit(EXIT_FAILURE);
+	}
+	shell_window_init(&ctx.window, window, time(NULL));
+	shell_rules_init(&ctx.rules, &ctx.alerts, stdout);
+	if(rules_path != NULL && shell_rules_load(&ctx.rules, rules_path, shell_mono_ns()) == -1){
+		exit(EXIT_FAILURE);
+	}
+	shell_proto_init(&ctx.reader);
+	shell_proto_assembler_init(&ctx.frags);
+	shell_loop_init(&ctx.loop);
+	shell_ctl_init(&ctx.ctl, &ctx);
+
+	// create common pipe, clients inherit only the write part
 	if(pipe(pipefd) == -1){
 
 		fprintf(stderr, "error: pipe creation failed(%d) --- %s\n", errno, strerror(errno));
 		exit(EXIT_FAILURE);
 	}
+	fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+	shell_set_nonblock(pipefd[0]);
+
 	// convert filedescriptor number into string
-	sprintf(pipefd_w, "%d", pipefd[1]);
+	sprintf(ctx.tp.pipefd, "%d", pipefd[1]);
+	ctx.tp.loop = &ctx.loop;
+	ctx.tp.ring_fn = on_ring;
+	ctx.tp.ring_arg = &ctx;
+
+	// writes to control pipes of idle clients that died fail instead of killing the shell
+	signal(SIGPIPE, SIG_IGN);
+
+	shell_log_open(&ctx.log, &log_cfg);
 
-	int log_fd = shell_log_open("log.txt");
+	// alerts have a log of their own so they are not lost among the readings
+	if(rules_path != NULL){
+		struct shell_log_cfg alerts_cfg = log_cfg;
+		alerts_cfg.path = RULES_ALERTS_PATH;
+		shell_log_open(&ctx.alerts, &alerts_cfg);
+	}
 	time(&raw_time);
 	timeinfo = localtime(&raw_time);
 	strftime(log_msg, LOG_MSG_LEN, "\nshell session started %F %T\n", timeinfo);
-	shell_log_write(log_fd, log_msg);
+	shell_log_write(&ctx.log, log_msg);
 
-	while(1){
+	// data, signals, user input and timer are all handled by one epoll loop
+	struct shell_loop_handler pipe_h  = { pipefd[0], on_pipe, &ctx };
+	struct shell_loop_handler sig_h   = { shell_setup_signal_fd(), on_signal, &ctx };
+	struct shell_loop_handler stdin_h = { STDIN_FILENO, on_stdin, &ctx };
+	struct shell_loop_handler timer_h = { shell_timerfd_open(SHELL_TICK_MS), on_timer, &ctx };
 
-		if(g_signal_caught == SIGINT){
-			
-			g_signal_caught = -1;
+	if( shell_loop_add(&ctx.loop, &pipe_h, EPOLLIN) == -1 ||
+	    shell_loop_add(&ctx.loop, &sig_h, EPOLLIN) == -1 ||
+	    shell_loop_add(&ctx.loop, &timer_h, EPOLLIN) == -1 ){
+		exit(EXIT_FAILURE);
+	}
+
+	// regular files can not be watched, the shell then runs without menu
+	if(shell_loop_add(&ctx.loop, &stdin_h, EPOLLIN) == -1){
+		fprintf(stderr, "error: user input can not be watched, menu is disabled\n");
+	}
+
+	// commands of scripts are handled by the same loop as the menu
+	if(ctl_path != NULL && shell_ctl_open(&ctx.ctl, ctl_path) == -1){
+		exit(EXIT_FAILURE);
+	}
+
+	// idle clients are started once sigchld goes to the signalfd
+	shell_pool_init(&ctx.pool, &ctx.tp, idle_clients);
+
+	// subscriptions of the config come up while the loop runs
+	if(config_path != NULL && shell_config_load(&ctx, config_path) == -1){
+		exit(EXIT_FAILURE);
+	}
+
+	while(ctx.loop.running){
+
+		shell_loop_run_once(&ctx.loop, -1);
+		shell_pool_sweep(&ctx.pool);
 
-			// if termination flag is set skip request handling
-			if(flag != SHELL_TERMINATE){
-				shell_handle_request(pipefd_w, &flag, &clist);
-			}
-		}
 		// if termination flag is set and there are no clients left terminate the shell
-		if( (flag == SHELL_TERMINATE) && (clist.slots == 0) ){
-			
-			// log to a file and close it
-			time(&raw_time);
-			timeinfo = localtime(&raw_time);
-			strftime(log_msg, LOG_MSG_LEN, "shell session ended %F %T\n", timeinfo);
-			shell_log_write(log_fd, log_msg);
-			close(log_fd);
-			break;
+		if( (ctx.flag == SHELL_TERMINATE) && (ctx.clist.cnt == 0) ){
+			ctx.loop.running = 0;
 		}
+	}
+
+	// log to a file and close it, buffered messages are written on close
+	time(&raw_time);
+	timeinfo = localtime(&raw_time);
+	strftime(log_msg, LOG_MSG_LEN, "shell session ended %F %T\n", timeinfo);
+	shell_log_write(&ctx.log, log_msg);
+	shell_log_close(&ctx.log);
+	if(rules_path != NULL){
+		shell_log_close(&ctx.alerts);
+	}
 
-		shell_manage_client(pipefd[0], log_fd, &client, &clist);
+	shell_ctl_close(&ctx.ctl);
+	shell_pool_free(&ctx.pool);
+	shell_pool_sweep(&ctx.pool);
+	while(ctx.tp.rings != NULL){
+		shell_ring_destroy(&ctx.tp, ctx.tp.rings);
 	}
+	close(sig_h.fd);
+	close(timer_h.fd);
+	shell_loop_close(&ctx.loop);
+	shell_clist_free(&ctx.clist);
+	shell_proto_assembler_free(&ctx.frags);
+	shell_tsdb_close(&ctx.db);
+	shell_topics_free(&ctx.topics);
+	shell_rules_free(&ctx.rules);
 
 	return EXIT_SUCCESS;
 }
-
@@ -0,0 +1,501 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_pool.c
+ * @brief: declarations of client spawning and idle client pool functions
+ * @note: descriptions for the functions in shell_pool.h
+*/
+
+#define _GNU_SOURCE		// pipe2
+
+#include"shell_pool.h"
+
+extern char **environ;
+
+// returns environment of shell with ring entry replacing the inherited one, NULL on failure
+static char **shell_spawn_env(char *ring_env){
+
+	int cnt = 0;
+	size_t name_len = strlen(RING_ENV);
+
+	while(environ[cnt] != NULL) cnt++;
+
+	char **envp = malloc((cnt + 2) * sizeof(char*));
+	if(envp == NULL){
+		return NULL;
+	}
+
+	int n = 0;
+	for(int i = 0; i < cnt; i++){
+		if(strncmp(environ[i], RING_ENV, name_len) == 0 && environ[i][name_len] == '=') continue;
+		envp[n++] = environ[i];
+	}
+	if(ring_env != NULL){
+		envp[n++] = ring_env;
+	}
+	envp[n] = NULL;
+
+	return envp;
+}
+
+// starts client program with args, keep_fd is inherited besides the common pipe and client ring
+pid_t shell_spawn_client(struct shell_transport *tp, char *args[], int keep_fd){
+
+	posix_spawn_file_actions_t fa;
+	posix_spawnattr_t attr;
+	sigset_t none, dfl;
+	char ring_env[64];
+	pid_t pid;
+
+	// client gets its own ring when shared memory is available, the pipe otherwise
+	struct shell_ring *sr = shell_ring_create(tp);
+
+	posix_spawn_file_actions_init(&fa);
+	posix_spawnattr_init(&attr);
+
+	// client must not inherit signals blocked for the shell signalfd or sigpipe ignored by the shell
+	sigemptyset(&none);
+	sigemptyset(&dfl);
+	sigaddset(&dfl, SIGPIPE);
+	posix_spawnattr_setsigmask(&attr, &none);
+	posix_spawnattr_setsigdefault(&attr, &dfl);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+	if(keep_fd != -1){
+		posix_spawn_file_actions_adddup2(&fa, keep_fd, keep_fd);
+	}
+	if(sr != NULL){
+		shell_ring_export(sr, &fa, ring_env, sizeof(ring_env));
+	}
+
+	char **envp = shell_spawn_env(sr != NULL ? ring_env : NULL);
+	int ret = envp != NULL ? posix_spawn(&pid, CLIENT_PATH, &fa, &attr, args, envp) : ENOMEM;
+
+	free(envp);
+	posix_spawn_file_actions_destroy(&fa);
+	posix_spawnattr_destroy(&attr);
+
+	if(ret != 0){
+		fprintf(stderr, "error: spawning client failed(%d) --- %s\n", ret, strerror(ret));
+		if(sr != NULL) shell_ring_destroy(tp, sr);
+		return -1;
+	}
+
+	// client has inherited the shared memory
+	if(sr != NULL) shell_ring_close_memfd(sr);
+
+	return pid;
+}
+
+// initializes pool keeping min idle clients and starts them
+void shell_pool_init(struct shell_pool *pool, struct shell_transport *tp, int min){
+
+	memset(pool, 0, sizeof(struct shell_pool));
+
+	if(min < 0) min = 0;
+	if(min > POOL_IDLE_MAX) min = POOL_IDLE_MAX;
+
+	pool->tp = tp;
+	pool->min = min;
+	pool->target = min;
+
+	shell_pool_refill(pool);
+}
+
+// releases connection n, its client unsubscribes and exits once control pipe is closed
+// jobs left in its backlog do not matter to a client that exits, the backlog is freed after
+// the current loop iteration because one of its events may still refer to it
+static void shell_pool_release(struct shell_pool *pool, int n){
+
+	struct pool_backlog *b = pool->conns[n].backlog;
+
+	if(b != NULL){
+		shell_loop_del(pool->tp->loop, &b->h);
+		b->pool = NULL;
+		b->next = pool->retired;
+		pool->retired = b;
+	}
+	close(pool->conns[n].ctl);
+	pool->conns[n] = pool->conns[--pool->conn_cnt];
+}
+
+// retires all idle clients and releases all connections, disables the pool
+void shell_pool_free(struct shell_pool *pool){
+
+	// client exits when its control pipe is closed
+	while(pool->cnt > 0){
+		close(pool->idle[--pool->cnt].ctl);
+	}
+	while(pool->conn_cnt > 0){
+		shell_pool_release(pool, pool->conn_cnt - 1);
+	}
+	free(pool->conns);
+	pool->conns = NULL;
+	pool->conn_cap = 0;
+	pool->min = 0;
+	pool->target = 0;
+}
+
+// starts one idle client, -1 on failure
+static int shell_pool_spawn(struct shell_pool *pool, struct pool_worker *w){
+
+	int ctl[2];
+	char ctl_arg[12];
+
+	// only the idle client may hold the read end, shell keeps the write end
+	if(pipe2(ctl, O_CLOEXEC) == -1){
+
+		fprintf(stderr, "error: control pipe creation failed(%d) --- %s\n", errno, strerror(errno));
+		return -1;
+	}
+	sprintf(ctl_arg, "%d", ctl[0]);
+
+	char *args[] = { "shell_client", WORKER_OPTION, ctl_arg, pool->tp->pipefd, NULL };
+	pid_t pid = shell_spawn_client(pool->tp, args, ctl[0]);
+
+	close(ctl[0]);
+	if(pid == -1){
+		close(ctl[1]);
+		return -1;
+	}
+
+	// shell loop must not wait for a client that does not read its jobs
+	fcntl(ctl[1], F_SETFL, O_NONBLOCK);
+
+	w->pid = pid;
+	w->ctl = ctl[1];
+
+	return 0;
+}
+
+// starts idle clients until pool holds as many as wanted
+void shell_pool_refill(struct shell_pool *pool){
+
+	while(pool->cnt < pool->target && !pool->spawn_failed){
+
+		if(shell_pool_spawn(pool, &pool->idle[pool->cnt]) == -1){
+			pool->spawn_failed = 1;
+			return;
+		}
+		pool->cnt++;
+	}
+}
+
+// finds connection to broker ip or of process pid, -1 if there is none
+static int shell_pool_find_conn(const struct shell_pool *pool, const char *ip, pid_t pid){
+
+	for(int n = 0; n < pool->conn_cnt; n++){
+
+		if(ip != NULL && strcmp(pool->conns[n].ip, ip) == 0) return n;
+		if(ip == NULL && pool->conns[n].pid == pid) return n;
+	}
+	return -1;
+}
+
+// makes new connection to broker ip from an idle client, a started one if pool is empty
+// returns its position, -1 on failure
+static int shell_pool_connect(struct shell_pool *pool, const char *ip){
+
+	struct pool_worker w;
+
+	if(pool->conn_cnt == pool->conn_cap){
+
+		int cap = pool->conn_cap ? 2 * pool->conn_cap : POOL_CONNS_INIT_CNT;
+		struct pool_conn *conns = realloc(pool->conns, cap * sizeof(struct pool_conn));
+
+		if(conns == NULL){
+			fprintf(stderr, "error: connection allocation failed\n");
+			return -1;
+		}
+		pool->conns = conns;
+		pool->conn_cap = cap;
+	}
+
+	if(pool->cnt > 0){
+		w = pool->idle[--pool->cnt];
+	}
+	else{
+		// pool ran dry: keep more clients ready for the rest of the burst
+		if(pool->min > 0){
+			pool->target = pool->target * 2 > POOL_IDLE_MAX ? POOL_IDLE_MAX : pool->target * 2;
+		}
+		if(shell_pool_spawn(pool, &w) == -1){
+			return -1;
+		}
+	}
+
+	struct pool_conn *conn = &pool->conns[pool->conn_cnt];
+
+	snprintf(conn->ip, sizeof(conn->ip), "%s", ip);
+	conn->pid = w.pid;
+	conn->ctl = w.ctl;
+	conn->refs = 0;
+	conn->backlog = NULL;
+
+	return pool->conn_cnt++;
+}
+
+// writes jobs of backlog the control pipe takes, 1 once every job is written, -1 if the client is gone
+static int shell_pool_backlog_write(struct pool_backlog *b){
+
+	while(b->off < b->cnt){
+
+		int ret = write(b->h.fd, &b->jobs[b->off], sizeof(struct proto_job));
+
+		if(ret == -1 && errno == EINTR) continue;
+		if(ret == -1 && errno == EAGAIN) return 0;
+		if(ret != (int)sizeof(struct proto_job)){
+			fprintf(stderr, "error: %d jobs for client not sent(%d) --- %s\n", b->cnt - b->off, errno, strerror(errno));
+			return -1;
+		}
+		b->off++;
+	}
+	return 1;
+}
+
+// writes backlog of a connection once its control pipe has room, backlog is freed when it is written
+static void on_pool_backlog(int fd, uint32_t events, void *arg){
+
+	struct pool_backlog *b = arg;
+	struct shell_pool *pool = b->pool;
+
+	(void)fd;
+	(void)events;
+	if(pool == NULL || shell_pool_backlog_write(b) == 0){
+		return;
+	}
+
+	// client that is gone is forgotten when it is reaped, only its jobs are dropped here
+	for(int n = 0; n < pool->conn_cnt; n++){
+
+		if(pool->conns[n].backlog == b){
+			pool->conns[n].backlog = NULL;
+			break;
+		}
+	}
+	shell_loop_del(pool->tp->loop, &b->h);
+	free(b->jobs);
+	free(b);
+}
+
+// appends job to backlog of connection n, control pipe is watched until the backlog is written
+static int shell_pool_backlog_add(struct shell_pool *pool, int n, const struct proto_job *job){
+
+	struct pool_backlog *b = pool->conns[n].backlog;
+
+	if(b == NULL){
+
+		b = calloc(1, sizeof(struct pool_backlog));
+		if(b == NULL){
+			fprintf(stderr, "error: job backlog allocation failed\n");
+			return -1;
+		}
+		b->h = (struct shell_loop_handler){ pool->conns[n].ctl, on_pool_backlog, b };
+		b->pool = pool;
+
+		if(shell_loop_add(pool->tp->loop, &b->h, EPOLLOUT) == -1){
+			free(b);
+			return -1;
+		}
+		pool->conns[n].backlog = b;
+	}
+
+	// written jobs are dropped before the array grows
+	if(b->cnt == b->cap && b->off > 0){
+		memmove(b->jobs, &b->jobs[b->off], (b->cnt - b->off) * sizeof(struct proto_job));
+		b->cnt -= b->off;
+		b->off = 0;
+	}
+	if(b->cnt == b->cap){
+
+		int cap = b->cap ? 2 * b->cap : POOL_BACKLOG_INIT_CNT;
+		struct proto_job *jobs = realloc(b->jobs, cap * sizeof(struct proto_job));
+
+		if(jobs == NULL){
+			fprintf(stderr, "error: job backlog allocation failed\n");
+			return -1;
+		}
+		b->jobs = jobs;
+		b->cap = cap;
+	}
+	b->jobs[b->cnt++] = *job;
+
+	return 0;
+}
+
+// writes job to connection n, -1 if its client is gone
+// job the control pipe has no room for waits in the backlog, jobs keep their order
+static int shell_pool_send_job(struct shell_pool *pool, int n, const struct proto_job *job){
+
+	if(pool->conns[n].backlog != NULL){
+		return shell_pool_backlog_add(pool, n, job);
+	}
+
+	int ret = write(pool->conns[n].ctl, job, sizeof(struct proto_job));
+
+	if(ret == -1 && errno == EAGAIN){
+		return shell_pool_backlog_add(pool, n, job);
+	}
+	if(ret != (int)sizeof(struct proto_job)){
+
+		fprintf(stderr, "error: job for client %d(%d) not sent(%d) --- %s\n",
+				job->cid, pool->conns[n].pid, errno, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+// subscribes topic for client id on the shared connection to broker ip
+pid_t shell_pool_subscribe(struct shell_pool *pool, int cid, const char *ip, const char *topic){
+
+	struct proto_job job;
+
+	pool->quiet_ticks = 0;
+
+	// topic was checked by the shell, its qos suffix is not sent
+	int len;
+	int qos = proto_topic_qos(topic, &len);
+
+	memset(&job, 0, sizeof(job));
+	job.op = JOB_SUB;
+	job.qos = qos > 0 ? qos : 0;
+	job.cid = cid;
+	snprintf(job.ip, sizeof(job.ip), "%s", ip);
+	snprintf(job.topic, sizeof(job.topic), "%.*s", len, topic);
+
+	// a client that died before it was reaped does not take the job, next one is tried
+	for(int tries = 0; tries <= POOL_IDLE_MAX; tries++){
+
+		int n = shell_pool_find_conn(pool, ip, 0);
+
+		if(n == -1 && (n = shell_pool_connect(pool, ip)) == -1){
+			return -1;
+		}
+		if(shell_pool_send_job(pool, n, &job) == 0){
+
+			pool->conns[n].refs++;
+			return pool->conns[n].pid;
+		}
+		if(errno != EPIPE){
+			return -1;
+		}
+		shell_pool_release(pool, n);
+	}
+	return -1;
+}
+
+// unsubscribes topic of client id from connection of process pid
+int shell_pool_unsubscribe(struct shell_pool *pool, pid_t pid, int cid){
+
+	struct proto_job job;
+	int n = shell_pool_find_conn(pool, NULL, pid);
+
+	if(n == -1){
+		return -1;
+	}
+
+	memset(&job, 0, sizeof(job));
+	job.op = JOB_UNSUB;
+	job.cid = cid;
+
+	// last topic releases the connection, client reads the job before the end of the pipe
+	shell_pool_send_job(pool, n, &job);
+	shell_pool_unref(pool, pid);
+
+	return 0;
+}
+
+// drops topic of connection of process pid that failed to subscribe
+void shell_pool_unref(struct shell_pool *pool, pid_t pid){
+
+	int n = shell_pool_find_conn(pool, NULL, pid);
+
+	if(n != -1 && --pool->conns[n].refs <= 0){
+		shell_pool_release(pool, n);
+	}
+}
+
+// frees backlogs of released connections
+void shell_pool_sweep(struct shell_pool *pool){
+
+	while(pool->retired != NULL){
+
+		struct pool_backlog *b = pool->retired;
+		pool->retired = b->next;
+		free(b->jobs);
+		free(b);
+	}
+}
+
+// shrinks pool that was not used for a while and refills it, called on timer ticks
+void shell_pool_tick(struct shell_pool *pool, uint64_t ticks){
+
+	pool->spawn_failed = 0;
+	pool->quiet_ticks += ticks;
+
+	if(pool->quiet_ticks >= POOL_SHRINK_TICKS){
+
+		pool->quiet_ticks = 0;
+		if(pool->target > pool->min) pool->target--;
+	}
+
+	while(pool->cnt > pool->target){
+		close(pool->idle[--pool->cnt].ctl);
+	}
+	shell_pool_refill(pool);
+}
+
+// forgets idle client or connection that exited or lost its broker
+int shell_pool_forget(struct shell_pool *pool, pid_t pid){
+
+	for(int i = 0; i < pool->cnt; i++){
+
+		if(pool->idle[i].pid == pid){
+
+			close(pool->idle[i].ctl);
+			pool->idle[i] = pool->idle[--pool->cnt];
+			return 1;
+		}
+	}
+
+	int n = shell_pool_find_conn(pool, NULL, pid);
+	if(n != -1){
+		shell_pool_release(pool, n);
+		return 1;
+	}
+	return 0;
+}
+
+// returns amount of shared broker connections
+int shell_pool_conn_cnt(const struct shell_pool *pool){
+
+	return pool->conn_cnt;
+}
+
+// starts timing connect request of client ids cid..cid + cnt - 1 made at start(monotonic ns)
+void shell_pool_track(struct shell_pool *pool, int cid, int cnt, int64_t start){
+
+	struct pool_pending *p = &pool->pending[pool->pending_pos];
+
+	p->cid = cid;
+	p->cnt = cnt;
+	p->left = cnt;
+	p->start = start;
+
+	pool->pending_pos = (pool->pending_pos + 1) % POOL_PENDING;
+}
+
+// returns ms from connect request of client id to now(monotonic ns), -1 if it is not timed
+double shell_pool_connect_ms(struct shell_pool *pool, int cid, int64_t now){
+
+	for(int i = 0; i < POOL_PENDING; i++){
+
+		struct pool_pending *p = &pool->pending[i];
+
+		if(p->left > 0 && cid >= p->cid && cid < p->cid + p->cnt){
+			p->left--;
+			return (now - p->start) / 1e6;
+		}
+	}
+	return -1;
+}
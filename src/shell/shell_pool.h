@@ -0,0 +1,141 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_pool.h
+ * @brief: definitions and descriptions of client spawning and idle client pool functions
+*/
+
+
+#ifndef SHELL_POOL_H
+#define SHELL_POOL_H
+
+#include"client_proto.h"
+#include"shell_ring.h"
+#include<spawn.h>
+#include<signal.h>
+#include<fcntl.h>
+
+
+// clients are started with posix_spawn and are children of the shell, which reaps them
+// pool keeps clients that are already started, linked and initialized waiting for a topic,
+// connect request hands its topic to one of them through its control pipe
+// pool grows when connects find it empty and shrinks back when no connects come
+// used clients are replaced once they subscribed or on the next tick, not while they start up
+//
+// client that got a topic stays the shared connection to that broker: later topics of the same
+// broker address are subscribed and unsubscribed on its live session through the control pipe
+// connection counts the topics it serves and is released when the last one is unsubscribed
+// jobs of a burst that do not fit the control pipe wait in a backlog written as the client reads them
+
+#define CLIENT_PATH		"../client_shell/shell_client"
+#define WORKER_OPTION		"-w"	// starts shell client as an idle pooled client
+#define POOL_IDLE_MIN		2	// idle clients kept ready by default, 0 disables the pool
+#define POOL_IDLE_MAX		32	// idle clients kept at most
+#define POOL_SHRINK_TICKS	30	// timer ticks without connects before pool shrinks by one
+#define POOL_PENDING		64	// connect requests timed at once
+#define POOL_CONNS_INIT_CNT	4	// broker connections the pool has room for at first
+#define POOL_BACKLOG_INIT_CNT	256	// jobs a backlog has room for at first
+
+// idle client waiting for a job
+struct pool_worker{
+
+	pid_t		pid;			// client process id
+	int		ctl;			// write end of its control pipe
+};
+
+// connect request of client ids cid..cid + cnt - 1 waiting for subscription
+struct pool_pending{
+
+	int		cid;			// first client id
+	int		cnt;			// amount of client ids
+	int		left;			// client ids not subscribed yet
+	int64_t		start;			// monotonic time of the request(ns)
+};
+
+// jobs a control pipe did not take yet, written once the client has read the earlier ones
+struct pool_backlog{
+
+	struct shell_loop_handler h;		// control pipe, watched while jobs are left
+	struct shell_pool	*pool;		// pool of the connection, NULL once the connection is released
+	struct pool_backlog	*next;		// next released backlog
+	struct proto_job	*jobs;		// jobs in order
+	int			cnt;		// amount of jobs
+	int			off;		// jobs written
+	int			cap;		// jobs the array has room for
+};
+
+// shared connection to a broker
+struct pool_conn{
+
+	char		ip[IP_ADDR_LEN];	// broker ip address
+	pid_t		pid;			// client process id
+	int		ctl;			// write end of its control pipe
+	int		refs;			// topics subscribed or being subscribed on it
+	struct pool_backlog *backlog;		// jobs not written yet, NULL none
+};
+
+// pool of idle clients and shared broker connections
+struct shell_pool{
+
+	struct shell_transport	*tp;			// transport given to spawned clients
+	struct pool_worker	idle[POOL_IDLE_MAX];	// idle clients
+	int			cnt;			// amount of idle clients
+	int			min;			// idle clients kept at least, 0 pool is disabled
+	int			target;			// idle clients wanted now
+	int			quiet_ticks;		// timer ticks since the last connect
+	int			spawn_failed;		// spawning failed, retried on next tick
+	struct pool_pending	pending[POOL_PENDING];	// timed connect requests
+	int			pending_pos;		// next pending entry to use
+	struct pool_conn	*conns;			// shared broker connections
+	int			conn_cnt;		// amount of connections
+	int			conn_cap;		// connections conns has room for
+	struct pool_backlog	*retired;		// backlogs of released connections, freed between loop iterations
+};
+
+
+// starts client program with args, keep_fd is inherited besides the common pipe and client ring
+// returns process id of the client, -1 on failure
+pid_t shell_spawn_client(struct shell_transport *tp, char *args[], int keep_fd);
+
+// initializes pool keeping min idle clients and starts them
+void shell_pool_init(struct shell_pool *pool, struct shell_transport *tp, int min);
+
+// retires all idle clients and releases all connections, disables the pool
+void shell_pool_free(struct shell_pool *pool);
+
+// starts idle clients until pool holds as many as wanted
+void shell_pool_refill(struct shell_pool *pool);
+
+// subscribes topic "topic[,qos:N]" for client id on the shared connection to broker ip
+// connection is made by an idle client, or a started one if pool is empty, when there is none
+// returns process id of the connection, -1 on failure
+// pool is not refilled here, spawning would delay the client on a busy or single cpu
+pid_t shell_pool_subscribe(struct shell_pool *pool, int cid, const char *ip, const char *topic);
+
+// unsubscribes topic of client id from connection of process pid
+// returns -1 if pid is not a shared connection
+int shell_pool_unsubscribe(struct shell_pool *pool, pid_t pid, int cid);
+
+// drops topic of connection of process pid that failed to subscribe
+void shell_pool_unref(struct shell_pool *pool, pid_t pid);
+
+// frees backlogs of released connections, called between loop iterations when no event refers to them
+void shell_pool_sweep(struct shell_pool *pool);
+
+// shrinks pool that was not used for a while and refills it, called on timer ticks
+void shell_pool_tick(struct shell_pool *pool, uint64_t ticks);
+
+// forgets idle client or connection that exited or lost its broker
+// returns 1 if pid was an idle client or a connection
+int shell_pool_forget(struct shell_pool *pool, pid_t pid);
+
+// returns amount of shared broker connections
+int shell_pool_conn_cnt(const struct shell_pool *pool);
+
+// starts timing connect request of client ids cid..cid + cnt - 1 made at start(monotonic ns)
+void shell_pool_track(struct shell_pool *pool, int cid, int cnt, int64_t start);
+
+// returns ms from connect request of client id to now(monotonic ns), -1 if it is not timed
+double shell_pool_connect_ms(struct shell_pool *pool, int cid, int64_t now);
+
+#endif // SHELL_POOL_H
@@ -0,0 +1,230 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_proto.c
+ * @brief: declarations of client record reader functions
+ * @note: descriptions for the functions in shell_proto.h
+*/
+
+
+#include"shell_proto.h"
+
+// initializes record reader
+void shell_proto_init(struct proto_reader *rd){
+
+	rd->len = 0;
+	rd->records = 0;
+	rd->errors = 0;
+}
+
+// handles complete records in buffer and keeps partial one, returns amount of handled records
+int shell_proto_parse(struct proto_reader *rd, proto_record_fn fn, void *arg){
+
+	int pos = 0;
+	int cnt = 0;
+
+	while(rd->len - pos >= PROTO_HDR_LEN){
+
+		struct proto_hdr hdr;
+		memcpy(&hdr, rd->buf + pos, sizeof(hdr));
+
+		// stream can not be resynchronized after a broken header, drop what was read
+		if(hdr.version != PROTO_VERSION || hdr.len < PROTO_HDR_LEN || hdr.len > PROTO_RECORD_MAX){
+
+			fprintf(stderr, "error: malformed record(version %d, length %d), dropping %d bytes\n",
+				hdr.version, hdr.len, rd->len - pos);
+			rd->errors++;
+			pos = rd->len;
+			break;
+		}
+
+		// rest of the record has not arrived yet
+		if(rd->len - pos < hdr.len) break;
+
+		fn(&hdr, rd->buf + pos + PROTO_HDR_LEN, arg);
+		pos += hdr.len;
+		cnt++;
+	}
+
+	// move partial record to the start of the buffer
+	if(pos > 0){
+		memmove(rd->buf, rd->buf + pos, rd->len - pos);
+		rd->len -= pos;
+	}
+	rd->records += cnt;
+	return cnt;
+}
+
+// reads non-blocking fd until it is drained or budget records are handled
+int shell_proto_read(int fd, struct proto_reader *rd, int budget, proto_record_fn fn, void *arg){
+
+	int handled = 0;
+
+	while(handled < budget){
+
+		int space = PROTO_READER_LEN - rd->len;
+		int ret = read(fd, rd->buf + rd->len, space);
+
+		if(ret == -1){
+
+			// fd is drained or read was interrupted
+			if(errno == EAGAIN || errno == EINTR) return handled;
+			return -1;
+		}
+		if(ret == 0){
+			return -1;
+		}
+
+		rd->len += ret;
+		handled += shell_proto_parse(rd, fn, arg);
+
+		if(ret < space) break;
+	}
+	return handled;
+}
+
+// initializes assembler of fragmented records
+void shell_proto_assembler_init(struct proto_assembler *as){
+
+	as->parts = calloc(PROTO_ASSEMBLIES_INIT, sizeof(struct proto_assembly));
+	if(as->parts == NULL){
+		fprintf(stderr, "error: assembler allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+	as->cnt = 0;
+	as->cap = PROTO_ASSEMBLIES_INIT;
+	as->dropped = 0;
+}
+
+// frees assembler and its buffers
+void shell_proto_assembler_free(struct proto_assembler *as){
+
+	for(int i = 0; i < as->cnt; i++){
+		free(as->parts[i].buf);
+	}
+	free(as->parts);
+	memset(as, 0, sizeof(struct proto_assembler));
+}
+
+// returns entry of a client, takes a free one if client has none
+static struct proto_assembly *proto_assembly_get(struct proto_assembler *as, int cid){
+
+	struct proto_assembly *free_part = NULL;
+
+	for(int i = 0; i < as->cnt; i++){
+
+		if(as->parts[i].cid == cid) return &as->parts[i];
+
+		// prefer free entry with the largest buffer
+		if(as->parts[i].cid == -1 && (free_part == NULL || as->parts[i].cap > free_part->cap)){
+			free_part = &as->parts[i];
+		}
+	}
+	if(free_part != NULL){
+		return free_part;
+	}
+
+	if(as->cnt == as->cap){
+
+		struct proto_assembly *parts = realloc(as->parts, 2 * as->cap * sizeof(struct proto_assembly));
+		if(parts == NULL){
+			fprintf(stderr, "error: assembler allocation failed\n");
+			exit(EXIT_FAILURE);
+		}
+		as->parts = parts;
+		as->cap *= 2;
+	}
+	memset(&as->parts[as->cnt], 0, sizeof(struct proto_assembly));
+	as->parts[as->cnt].cid = -1;
+	return &as->parts[as->cnt++];
+}
+
+// adds fragment to the record of its client
+// returns the record when its last fragment arrived, it stays valid until the next call, NULL otherwise
+const struct proto_assembly *shell_proto_assemble(struct proto_assembler *as, const struct proto_hdr *hdr, const char *body){
+
+	struct proto_frag fr;
+	uint32_t part = hdr->len - PROTO_HDR_LEN - PROTO_FRAG_LEN;
+
+	if(hdr->len < PROTO_HDR_LEN + PROTO_FRAG_LEN){
+		as->dropped++;
+		return NULL;
+	}
+	memcpy(&fr, body, sizeof(fr));
+
+	if( (fr.type != PROTO_DATA && fr.type != PROTO_TRACE) || fr.total > PROTO_BODY_MAX ||
+	    fr.offset > fr.total || part > fr.total - fr.offset ){
+		fprintf(stderr, "error: malformed fragment of client %d\n", hdr->cid);
+		as->dropped++;
+		return NULL;
+	}
+
+	struct proto_assembly *pa = proto_assembly_get(as, hdr->cid);
+
+	// first fragment starts a record, unfinished record of the client is lost
+	if(fr.offset == 0){
+
+		if(pa->cid == hdr->cid) as->dropped++;
+
+		if(pa->cap < fr.total){
+
+			char *buf = realloc(pa->buf, fr.total);
+			if(buf == NULL){
+				fprintf(stderr, "error: fragment buffer allocation failed\n");
+				exit(EXIT_FAILURE);
+			}
+			pa->buf = buf;
+			pa->cap = fr.total;
+		}
+		pa->cid = hdr->cid;
+		pa->type = fr.type;
+		pa->total = fr.total;
+		pa->got = 0;
+	}
+
+	// fragment that does not continue the record means one was lost
+	else if(pa->cid != hdr->cid || fr.offset != pa->got || fr.total != pa->total){
+
+		if(pa->cid == hdr->cid){
+			pa->cid = -1;
+			as->dropped++;
+		}
+		return NULL;
+	}
+
+	memcpy(pa->buf + pa->got, body + PROTO_FRAG_LEN, part);
+	pa->got += part;
+
+	if(pa->got < pa->total){
+		return NULL;
+	}
+
+	// record is complete, entry is free for the next record but keeps its buffer
+	pa->cid = -1;
+	return pa;
+}
+
+// fills client information from status record
+void shell_proto_status_info(const struct proto_hdr *hdr, const char *body, struct client_info *info){
+
+	struct proto_status st;
+	memcpy(&st, body, sizeof(st));
+
+	int ip_len = st.ip_len < IP_ADDR_LEN ? st.ip_len : IP_ADDR_LEN - 1;
+	int topic_len = st.topic_len < CLIENT_TOPIC_LEN ? st.topic_len : CLIENT_TOPIC_LEN - 1;
+
+	// lengths are checked against the record so a bad record can not read past it
+	if(PROTO_HDR_LEN + PROTO_STATUS_LEN + st.ip_len + st.topic_len > hdr->len){
+		ip_len = 0;
+		topic_len = 0;
+	}
+
+	memset(info, 0, sizeof(struct client_info));
+	info->id = hdr->cid;
+	info->pid = st.pid;
+	info->status = st.status;
+	info->slot_pos = -1;
+
+	memcpy(info->ip, body + PROTO_STATUS_LEN, ip_len);
+	memcpy(info->topic, body + PROTO_STATUS_LEN + st.ip_len, topic_len);
+}
@@ -0,0 +1,81 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_proto.h
+ * @brief: definitions and descriptions of client record reader functions
+*/
+
+
+#ifndef SHELL_PROTO_H
+#define SHELL_PROTO_H
+
+#include"client_proto.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<unistd.h>
+#include<errno.h>
+
+
+#define PROTO_READER_LEN	(16 * PROTO_RECORD_MAX)	// bytes read from pipe at once
+#define PROTO_ASSEMBLIES_INIT	8			// fragmented records put together at the same time
+
+// function handling one complete record
+typedef void (*proto_record_fn)(const struct proto_hdr *hdr, const char *body, void *arg);
+
+// reader that splits a byte stream into records
+// partial record at the end of a read stays in the buffer until the rest arrives
+struct proto_reader{
+
+	char		buf[PROTO_READER_LEN];	// received bytes
+	int		len;			// amount of bytes in buffer
+	long		records;		// records handled
+	long		errors;			// malformed records dropped
+};
+
+
+// fragmented record of one client being put back together
+// buffer stays with the entry when the record is done so the next record reuses it
+struct proto_assembly{
+
+	int32_t		cid;			// client id, -1 when entry is free
+	uint8_t		type;			// PROTO_DATA or PROTO_TRACE
+	uint32_t	total;			// length of the whole body
+	uint32_t	got;			// bytes received so far
+	char		*buf;			// body
+	uint32_t	cap;			// size of buffer
+};
+
+// records of all clients being put together, fragments of different clients may interleave
+struct proto_assembler{
+
+	struct proto_assembly	*parts;		// entries
+	int			cnt;		// entries in use or free with a buffer
+	int			cap;		// capacity of entries
+	long			dropped;	// records dropped because a fragment was missing
+};
+
+
+// initializes record reader
+void shell_proto_init(struct proto_reader *rd);
+
+// handles complete records in buffer and keeps partial one, returns amount of handled records
+int shell_proto_parse(struct proto_reader *rd, proto_record_fn fn, void *arg);
+
+// reads non-blocking fd until it is drained or budget records are handled
+// returns amount of handled records, -1 when fd is closed or read fails
+int shell_proto_read(int fd, struct proto_reader *rd, int budget, proto_record_fn fn, void *arg);
+
+// initializes assembler of fragmented records
+void shell_proto_assembler_init(struct proto_assembler *as);
+
+// frees assembler and its buffers
+void shell_proto_assembler_free(struct proto_assembler *as);
+
+// adds fragment to the record of its client
+// returns the record when its last fragment arrived, it stays valid until the next call, NULL otherwise
+const struct proto_assembly *shell_proto_assemble(struct proto_assembler *as, const struct proto_hdr *hdr, const char *body);
+
+// fills client information from status record
+void shell_proto_status_info(const struct proto_hdr *hdr, const char *body, struct client_info *info);
+
+#endif // SHELL_PROTO_H
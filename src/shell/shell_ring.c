@@ -0,0 +1,148 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_ring.c
+ * @brief: declarations of shared memory ring transport functions
+ * @note: descriptions for the functions in shell_ring.h
+*/
+
+#define _GNU_SOURCE		// memfd_create
+
+#include"shell_ring.h"
+
+// creates ring for a new client and starts watching it, NULL when pipe has to be used
+struct shell_ring *shell_ring_create(struct shell_transport *tp){
+
+#if USE_SHM_RING
+
+	struct shell_ring *sr = calloc(1, sizeof(struct shell_ring));
+	if(sr == NULL){
+		return NULL;
+	}
+	sr->memfd = -1;
+	sr->h.fd = -1;
+
+	// both fds are close-on-exec, shell_ring_export clears it only for the ring's own client
+	sr->memfd = memfd_create("shell_client_ring", MFD_CLOEXEC);
+	if(sr->memfd == -1 || ftruncate(sr->memfd, RING_MAP_LEN(RING_DATA_LEN)) == -1){
+		goto fail;
+	}
+
+	sr->ring = mmap(NULL, RING_MAP_LEN(RING_DATA_LEN), PROT_READ | PROT_WRITE, MAP_SHARED, sr->memfd, 0);
+	if(sr->ring == MAP_FAILED){
+		sr->ring = NULL;
+		goto fail;
+	}
+	ring_init(sr->ring, RING_DATA_LEN);
+
+	sr->h.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(sr->h.fd == -1){
+		goto fail;
+	}
+	sr->h.fn = tp->ring_fn;
+	sr->h.arg = sr;
+	sr->arg = tp->ring_arg;
+	shell_proto_init(&sr->rd);
+
+	if(shell_loop_add(tp->loop, &sr->h, EPOLLIN) == -1){
+		goto fail;
+	}
+
+	sr->next = tp->rings;
+	tp->rings = sr;
+	return sr;
+
+fail:
+	fprintf(stderr, "error: ring creation failed(%d) --- %s, using pipe\n", errno, strerror(errno));
+	if(sr->ring != NULL) munmap(sr->ring, RING_MAP_LEN(RING_DATA_LEN));
+	if(sr->memfd != -1) close(sr->memfd);
+	if(sr->h.fd != -1) close(sr->h.fd);
+	free(sr);
+	return NULL;
+
+#else
+
+	(void)tp;
+	return NULL;
+
+#endif // USE_SHM_RING
+}
+
+// lets a spawned client inherit its ring and writes environment entry by which the client finds it
+void shell_ring_export(struct shell_ring *sr, posix_spawn_file_actions_t *fa, char *env, size_t sz){
+
+	// dup2 onto the same fd clears close-on-exec only in the child
+	posix_spawn_file_actions_adddup2(fa, sr->memfd, sr->memfd);
+	posix_spawn_file_actions_adddup2(fa, sr->h.fd, sr->h.fd);
+
+	snprintf(env, sz, "%s=%d:%d", RING_ENV, sr->memfd, sr->h.fd);
+}
+
+// closes shared memory fd once the client process has inherited it
+void shell_ring_close_memfd(struct shell_ring *sr){
+
+	if(sr->memfd != -1){
+		close(sr->memfd);
+		sr->memfd = -1;
+	}
+}
+
+// drains at most budget records from ring, returns 1 if the ring has to be destroyed
+int shell_ring_drain(struct shell_ring *sr, int budget, proto_record_fn fn, void *arg){
+
+	struct ring *r = sr->ring;
+	struct proto_reader *rd = &sr->rd;
+	eventfd_t cnt;
+	int handled = 0;
+
+	// consume wakeup, producer does not need to wake us while we drain
+	eventfd_read(sr->h.fd, &cnt);
+	atomic_store(&r->waiting, 0);
+
+	while(1){
+
+		uint32_t len = ring_read(r, rd->buf + rd->len, PROTO_READER_LEN - rd->len);
+
+		if(len > 0){
+
+			rd->len += len;
+			handled += shell_proto_parse(rd, fn, arg);
+
+			// budget is spent: wake ourselves so the loop comes back after other events
+			if(handled >= budget){
+				eventfd_write(sr->h.fd, 1);
+				return 0;
+			}
+			continue;
+		}
+
+		// producer closed the ring after its last write, ring is destroyed once empty
+		if(atomic_load(&r->closed)){
+			if(atomic_load(&r->head) == atomic_load(&r->tail)) return 1;
+			continue;
+		}
+
+		// ring is empty: sleep unless a record arrived while preparing
+		if(ring_wait_prepare(r)){
+			return 0;
+		}
+	}
+}
+
+// stops watching a ring and frees it
+void shell_ring_destroy(struct shell_transport *tp, struct shell_ring *sr){
+
+	// unlink ring from transport
+	for(struct shell_ring **p = &tp->rings; *p != NULL; p = &(*p)->next){
+		if(*p == sr){
+			*p = sr->next;
+			break;
+		}
+	}
+
+	shell_loop_del(tp->loop, &sr->h);
+	close(sr->h.fd);
+	shell_ring_close_memfd(sr);
+	munmap(sr->ring, RING_MAP_LEN(sr->ring->size));
+	free(sr);
+}
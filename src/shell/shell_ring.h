@@ -0,0 +1,59 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_ring.h
+ * @brief: definitions and descriptions of shared memory ring transport functions
+*/
+
+
+#ifndef SHELL_RING_H
+#define SHELL_RING_H
+
+#include"client_ring.h"
+#include"shell_proto.h"
+#include"shell_loop.h"
+#include<sys/mman.h>
+#include<sys/eventfd.h>
+#include<spawn.h>
+
+
+#define USE_SHM_RING		1	// clients send records through shared memory rings(1) or the common pipe only(0)
+
+// ring of one client process as seen by the shell
+struct shell_ring{
+
+	struct ring			*ring;		// mapped shared ring
+	int				memfd;		// shared memory of the ring
+	struct shell_loop_handler	h;		// watches eventfd of the ring
+	struct proto_reader		rd;		// splits ring bytes into records
+	void				*arg;		// argument of ring handler
+	struct shell_ring		*next;		// next ring of the transport
+};
+
+// how clients send records to the shell
+struct shell_transport{
+
+	char			pipefd[12];	// write part of the common pipe as string, fallback transport
+	struct shell_loop	*loop;		// loop watching ring wakeups
+	shell_loop_fn		ring_fn;	// handler of ring wakeups
+	void			*ring_arg;	// argument of ring handler
+	struct shell_ring	*rings;		// rings of running clients
+};
+
+
+// creates ring for a new client and starts watching it, NULL when pipe has to be used
+struct shell_ring *shell_ring_create(struct shell_transport *tp);
+
+// lets a spawned client inherit its ring and writes environment entry by which the client finds it
+void shell_ring_export(struct shell_ring *sr, posix_spawn_file_actions_t *fa, char *env, size_t sz);
+
+// closes shared memory fd once the client process has inherited it
+void shell_ring_close_memfd(struct shell_ring *sr);
+
+// drains at most budget records from ring, returns 1 if the ring has to be destroyed
+int shell_ring_drain(struct shell_ring *sr, int budget, proto_record_fn fn, void *arg);
+
+// stops watching a ring and frees it
+void shell_ring_destroy(struct shell_transport *tp, struct shell_ring *sr);
+
+#endif // SHELL_RING_H
@@ -0,0 +1,460 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_rules.c
+ * @brief: declarations of alert rule engine functions
+ * @note: descriptions for the functions in shell_rules.h
+*/
+
+
+#include"shell_rules.h"
+
+static const char *s_kinds[] = { "above", "below", "rate", "stale" };
+
+// initializes empty rule engine
+void shell_rules_init(struct shell_rules *r, struct shell_log *log, FILE *out){
+
+	memset(r, 0, sizeof(struct shell_rules));
+	r->log = log;
+	r->out = out;
+}
+
+// frees rules and bindings
+void shell_rules_free(struct shell_rules *r){
+
+	while(r->binds != NULL){
+
+		struct rule_bind *b = r->binds;
+		r->binds = b->next;
+
+		free(b->refs);
+		free(b);
+	}
+	for(int i = 0; i < r->cnt; i++){
+		free(r->filters[i]);
+	}
+	free(r->rules);
+	free(r->filters);
+	free(r->wild);
+	free(r->table);
+
+	shell_rules_init(r, r->log, r->out);
+}
+
+// returns 1 if topic matches mqtt topic filter
+int shell_rules_match(const char *filter, const char *topic){
+
+	while(1){
+
+		// multi level wildcard takes the rest of the topic
+		if(*filter == '#'){
+			return 1;
+		}
+		if(*filter == '+'){
+			filter++;
+			while(*topic != '\0' && *topic != '/') topic++;
+		}
+		else{
+			while(*filter != '\0' && *filter != '/'){
+				if(*filter++ != *topic++) return 0;
+			}
+		}
+
+		if(*filter == '\0' && *topic == '\0'){
+			return 1;
+		}
+		if(*filter == '/' && *topic == '/'){
+			filter++;
+			topic++;
+			continue;
+		}
+
+		// "a/#" matches its parent "a" too
+		return *topic == '\0' && strcmp(filter, "/#") == 0;
+	}
+}
+
+// checks that wildcards of filter take whole segments and '#' is the last one
+static int rules_filter_valid(const char *filter){
+
+	for(const char *c = filter; *c != '\0'; c++){
+
+		if(*c != '+' && *c != '#') continue;
+		if(c != filter && c[-1] != '/') return 0;
+		if(*c == '+' && c[1] != '\0' && c[1] != '/') return 0;
+		if(*c == '#' && c[1] != '\0') return 0;
+	}
+	return 1;
+}
+
+// cuts comment off line, it starts with a word beginning with "//", so filter "a//b" is kept whole
+static void rules_strip_comment(char *line){
+
+	for(char *c = strstr(line, "//"); c != NULL; c = strstr(c + 1, "//")){
+
+		if(c == line || c[-1] == ' ' || c[-1] == '\t'){
+			*c = '\0';
+			return;
+		}
+	}
+}
+
+// compiles one rule line, 1 if a rule was added, 0 for an empty line, -1 if it is not valid
+int shell_rules_add(struct shell_rules *r, const char *line, uint32_t src){
+
+	char buf[RULES_LINE_LEN];
+	char filter[RULES_LINE_LEN];
+	char kind[16];
+	double limit, hyst = 0;
+	int k;
+
+	snprintf(buf, sizeof(buf), "%s", line);
+	rules_strip_comment(buf);
+
+	int n = sscanf(buf, "%383s %15s %lf %lf", filter, kind, &limit, &hyst);
+	if(n <= 0){
+		return 0;
+	}
+	if(n < 3 || !isfinite(limit) || !isfinite(hyst) || hyst < 0 || !rules_filter_valid(filter)){
+		return -1;
+	}
+	for(k = 0; k <= RULE_STALE; k++){
+		if(strcmp(kind, s_kinds[k]) == 0) break;
+	}
+	if(k > RULE_STALE || ((k == RULE_RATE || k == RULE_STALE) && limit <= 0)){
+		return -1;
+	}
+
+	// arrays grow together, wildcard rules are never more than all rules
+	if(r->cnt == r->cap){
+
+		int cap = r->cap ? 2 * r->cap : RULES_BIND_INIT;
+		struct rule *rules = realloc(r->rules, cap * sizeof(struct rule));
+		if(rules != NULL) r->rules = rules;
+		char **filters = realloc(r->filters, cap * sizeof(char*));
+		if(filters != NULL) r->filters = filters;
+		int *wild = realloc(r->wild, cap * sizeof(int));
+		if(wild != NULL) r->wild = wild;
+
+		if(rules == NULL || filters == NULL || wild == NULL){
+			fprintf(stderr, "error: rule allocation failed\n");
+			return -1;
+		}
+		r->cap = cap;
+	}
+
+	struct rule *ru = &r->rules[r->cnt];
+
+	memset(ru, 0, sizeof(struct rule));
+	ru->kind = k;
+	ru->src = src;
+	ru->on = k == RULE_STALE ? limit * 1e9 : limit;
+	ru->off = k == RULE_BELOW ? limit + hyst : limit - hyst;
+
+	r->filters[r->cnt] = strdup(filter);
+	if(r->filters[r->cnt] == NULL){
+		fprintf(stderr, "error: rule allocation failed\n");
+		return -1;
+	}
+	if(strpbrk(filter, "+#") != NULL){
+		r->wild[r->wild_cnt++] = r->cnt;
+	}
+	r->cnt++;
+
+	return 1;
+}
+
+// finds entry of topic in table of bindings, or the empty entry where it belongs
+static struct rule_bind **rules_slot(struct rule_bind **table, int sz, const char *topic, uint32_t hash){
+
+	uint32_t mask = sz - 1;
+	uint32_t i = hash & mask;
+
+	while(table[i] != NULL){
+
+		if(table[i]->hash == hash && strcmp(table[i]->topic, topic) == 0) break;
+		i = (i + 1) & mask;
+	}
+	return &table[i];
+}
+
+// binds rule to topic of binding, -1 on failure
+static int rules_bind_ref(struct shell_rules *r, struct rule_bind *b, int rule){
+
+	struct rule_ref *refs = realloc(b->refs, (b->cnt + 1) * sizeof(struct rule_ref));
+
+	if(refs == NULL){
+		return -1;
+	}
+	b->refs = refs;
+	b->refs[b->cnt].rule = rule;
+	b->refs[b->cnt].active = 0;
+	b->cnt++;
+
+	if(r->rules[rule].kind == RULE_RATE) b->rate = 1;
+	if(r->rules[rule].kind == RULE_STALE) b->stale = 1;
+
+	return 0;
+}
+
+// finds binding of topic, adds one without rules if there is none, NULL on failure
+static struct rule_bind *rules_bind_get(struct shell_rules *r, const char *topic, int64_t now, int *added){
+
+	uint32_t hash = hash_fnv1a_str(topic);
+
+	*added = 0;
+
+	// table grows when it gets half full
+	if(2 * (r->bind_cnt + 1) > r->bind_sz){
+
+		int sz = r->bind_sz ? 2 * r->bind_sz : RULES_BIND_INIT;
+		struct rule_bind **table = calloc(sz, sizeof(struct rule_bind*));
+
+		if(table == NULL){
+			return NULL;
+		}
+		for(int i = 0; i < r->bind_sz; i++){
+			if(r->table[i] != NULL) *rules_slot(table, sz, r->table[i]->topic, r->table[i]->hash) = r->table[i];
+		}
+		free(r->table);
+		r->table = table;
+		r->bind_sz = sz;
+	}
+
+	struct rule_bind **slot = rules_slot(r->table, r->bind_sz, topic, hash);
+	if(*slot != NULL){
+		return *slot;
+	}
+
+	int len = strlen(topic);
+	struct rule_bind *b = malloc(sizeof(struct rule_bind) + len + 1);
+	if(b == NULL){
+		return NULL;
+	}
+	memset(b, 0, sizeof(struct rule_bind));
+	b->hash = hash;
+	b->last_ns = now;
+	memcpy(b->topic, topic, len + 1);
+
+	b->next = r->binds;
+	r->binds = b;
+	r->bind_cnt++;
+	*slot = b;
+	*added = 1;
+
+	return b;
+}
+
+// binds wildcard rules matching topic of binding, -1 on failure
+static int rules_bind_wild(struct shell_rules *r, struct rule_bind *b){
+
+	for(int i = 0; i < r->wild_cnt; i++){
+
+		if(shell_rules_match(r->filters[r->wild[i]], b->topic) && rules_bind_ref(r, b, r->wild[i]) == -1){
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// binds topics of exact rules and wildcard rules matching them
+int shell_rules_compile(struct shell_rules *r, int64_t now){
+
+	int added;
+
+	for(int i = 0; i < r->cnt; i++){
+
+		if(strpbrk(r->filters[i], "+#") != NULL) continue;
+
+		struct rule_bind *b = rules_bind_get(r, r->filters[i], now, &added);
+		if(b == NULL || rules_bind_ref(r, b, i) == -1){
+			fprintf(stderr, "error: rule allocation failed\n");
+			return -1;
+		}
+	}
+
+	// only topics of exact rules are known yet, wildcard rules are bound to the others on their first reading
+	for(struct rule_bind *b = r->binds; b != NULL; b = b->next){
+
+		if(rules_bind_wild(r, b) == -1){
+			fprintf(stderr, "error: rule allocation failed\n");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// compiles rules of file at path
+int shell_rules_load(struct shell_rules *r, const char *path, int64_t now){
+
+	char line[RULES_LINE_LEN];
+	uint32_t src = 0;
+
+	FILE *f = fopen(path, "r");
+	if(f == NULL){
+		fprintf(stderr, "error: rules file %s can not be opened(%d) --- %s\n", path, errno, strerror(errno));
+		return -1;
+	}
+
+	while(fgets(line, sizeof(line), f) != NULL){
+
+		src++;
+		if(shell_rules_add(r, line, src) == -1){
+
+			line[strcspn(line, "\n")] = '\0';
+			fprintf(stderr, "error: rule on line %u of %s is not valid: %s\n", src, path, line);
+			fclose(f);
+			return -1;
+		}
+	}
+	fclose(f);
+
+	if(shell_rules_compile(r, now) == -1){
+		return -1;
+	}
+	return r->cnt;
+}
+
+// returns binding of concrete topic, made on its first reading at now
+struct rule_bind *shell_rules_bind(struct shell_rules *r, const char *topic, int64_t now){
+
+	int added;
+	struct rule_bind *b = rules_bind_get(r, topic, now, &added);
+
+	// binding of an exact rule already has its wildcard rules
+	// when memory runs out binding keeps the rules bound so far
+	if(b != NULL && added){
+		rules_bind_wild(r, b);
+	}
+	return b;
+}
+
+// writes alert of rule bound by ref to topic of binding, on tells if it fired or cleared
+static void rules_alert(struct shell_rules *r, const struct rule_bind *b, struct rule_ref *ref, int on, double value){
+
+	const struct rule *ru = &r->rules[ref->rule];
+	char line[RULES_LINE_LEN];
+	char stamp[32];
+	struct tm tm;
+	time_t t = time(NULL);
+
+	ref->active = on;
+	if(on) r->fired++;
+	else r->cleared++;
+
+	if(r->log == NULL && r->out == NULL){
+		return;
+	}
+
+	static const char *s_measured[] = { "value %g", "value %g", "rate %g/s", "silent for %.0f s" };
+	char measured[48];
+
+	snprintf(measured, sizeof(measured), s_measured[ru->kind], value);
+	strftime(stamp, sizeof(stamp), "%F %T", localtime_r(&t, &tm));
+	snprintf(line, sizeof(line), "%s %s %s: %s %g (rule %u %s), %s\n", stamp, on ? "ALERT" : "CLEAR", b->topic,
+			s_kinds[ru->kind], ru->kind == RULE_STALE ? ru->on / 1e9 : ru->on, ru->src, r->filters[ref->rule], measured);
+
+	if(r->log != NULL) shell_log_write(r->log, line);
+	if(r->out != NULL) fprintf(r->out, "%s", line);
+}
+
+// checks reading of topic against its rules, returns amount of alerts fired
+int shell_rules_eval(struct shell_rules *r, struct rule_bind **bind, const char *topic, double value, int64_t now){
+
+	struct rule_bind *b = *bind;
+	double rate = 0;
+	int have_rate = 0;
+	int fired = 0;
+
+	if(b == NULL){
+		if((b = shell_rules_bind(r, topic, now)) == NULL) return 0;
+		*bind = b;
+	}
+	if(b->cnt == 0){
+		return 0;
+	}
+
+	// readings come in batches, rate is measured over at least RULES_RATE_NS so it is not noise
+	if(b->rate){
+
+		if(b->ref_ns == 0){
+			b->ref = value;
+			b->ref_ns = now;
+		}
+		else if(now - b->ref_ns >= RULES_RATE_NS){
+			rate = fabs(value - b->ref) * 1e9 / (now - b->ref_ns);
+			have_rate = 1;
+			b->ref = value;
+			b->ref_ns = now;
+		}
+	}
+	b->last_ns = now;
+
+	for(int i = 0; i < b->cnt; i++){
+
+		struct rule_ref *ref = &b->refs[i];
+		const struct rule *ru = &r->rules[ref->rule];
+
+		switch(ru->kind){
+
+			case RULE_ABOVE:
+				if(!ref->active && value > ru->on){
+					rules_alert(r, b, ref, 1, value);
+					fired++;
+				}
+				else if(ref->active && value < ru->off){
+					rules_alert(r, b, ref, 0, value);
+				}
+				break;
+
+			case RULE_BELOW:
+				if(!ref->active && value < ru->on){
+					rules_alert(r, b, ref, 1, value);
+					fired++;
+				}
+				else if(ref->active && value > ru->off){
+					rules_alert(r, b, ref, 0, value);
+				}
+				break;
+
+			case RULE_RATE:
+				if(!have_rate) break;
+				if(!ref->active && rate > ru->on){
+					rules_alert(r, b, ref, 1, rate);
+					fired++;
+				}
+				else if(ref->active && rate < ru->off){
+					rules_alert(r, b, ref, 0, rate);
+				}
+				break;
+
+			case RULE_STALE:
+				if(ref->active) rules_alert(r, b, ref, 0, 0);
+				break;
+		}
+	}
+	return fired;
+}
+
+// fires alerts of topics that sent no reading for too long
+int shell_rules_tick(struct shell_rules *r, int64_t now){
+
+	int fired = 0;
+
+	for(struct rule_bind *b = r->binds; b != NULL; b = b->next){
+
+		if(!b->stale) continue;
+
+		for(int i = 0; i < b->cnt; i++){
+
+			struct rule_ref *ref = &b->refs[i];
+			const struct rule *ru = &r->rules[ref->rule];
+
+			if(ru->kind == RULE_STALE && !ref->active && now - b->last_ns > ru->on){
+				rules_alert(r, b, ref, 1, (now - b->last_ns) / 1e9);
+				fired++;
+			}
+		}
+	}
+	return fired;
+}
@@ -0,0 +1,130 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_rules.h
+ * @brief: definitions and descriptions of alert rule engine functions
+*/
+
+
+#ifndef SHELL_RULES_H
+#define SHELL_RULES_H
+
+#include"shell_log.h"
+#include"client_hash.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include<time.h>
+
+
+// rules are read once from a file, one rule per line, a word starting with "//" begins a comment:
+//   <topic or filter>  above <value> [hysteresis]	value went over the limit
+//   <topic or filter>  below <value> [hysteresis]	value went under the limit
+//   <topic or filter>  rate  <per second> [hysteresis]	value changes faster than this
+//   <topic or filter>  stale <seconds>			topic sent no reading for this long
+// alert fires once when its condition starts and clears when the value is back past the
+// limit by the hysteresis, a stale topic clears with its next reading
+//
+// every concrete topic is bound once to the rules that match it, the binding is kept by the
+// statistics of the topic, so a reading costs its bound rules and no lookup
+// rules are compiled into a flat array of limits, their text is kept apart and only read for alerts
+
+#define RULES_LINE_LEN		384		// line of the rule file and alert message
+#define RULES_BIND_INIT		64		// bindings the table has room for at first
+#define RULES_RATE_NS		100000000LL	// shortest span a rate of change is measured over
+#define RULES_ALERTS_PATH	"alerts.txt"	// log of alerts
+
+enum rule_kind{
+
+	RULE_ABOVE,			// value over limit
+	RULE_BELOW,			// value under limit
+	RULE_RATE,			// rate of change over limit
+	RULE_STALE			// no reading for limit ns
+};
+
+// compiled rule
+struct rule{
+
+	uint8_t		kind;			// enum rule_kind
+	uint8_t		pad[3];
+	uint32_t	src;			// line of the rule in its file
+	double		on;			// limit that fires the alert
+	double		off;			// limit that clears it
+};
+
+// rule bound to a concrete topic and whether its alert is on
+struct rule_ref{
+
+	uint32_t	rule;			// position in array of compiled rules
+	uint32_t	active;			// alert is on
+};
+
+// rules of one concrete topic
+struct rule_bind{
+
+	struct rule_bind *next;			// next binding, every binding is listed
+	uint32_t	hash;			// hash of the topic
+	int		cnt;			// amount of bound rules
+	int		rate;			// some bound rule watches the rate of change
+	int		stale;			// some bound rule watches for silence
+	double		ref;			// value rate of change is measured from
+	int64_t		ref_ns;			// monotonic time of ref, 0 none yet
+	int64_t		last_ns;		// monotonic time of the last reading
+	struct rule_ref	*refs;			// bound rules
+	char		topic[];		// concrete topic
+};
+
+// rule engine
+struct shell_rules{
+
+	struct rule		*rules;			// compiled rules
+	char			**filters;		// topic or filter of every rule
+	int			cnt;			// amount of rules
+	int			cap;			// rules the arrays have room for
+	int			*wild;			// rules with a wildcard filter
+	int			wild_cnt;		// amount of them
+	struct rule_bind	**table;		// open addressing table of bindings by topic
+	int			bind_cnt;		// amount of bindings
+	int			bind_sz;		// size of table, power of two
+	struct rule_bind	*binds;			// every binding
+	struct shell_log	*log;			// log of alerts, NULL none
+	FILE			*out;			// alerts are printed here too, NULL none
+	long			fired;			// alerts fired
+	long			cleared;		// alerts cleared
+};
+
+
+// initializes empty rule engine, alerts go to log and out when they are not NULL
+void shell_rules_init(struct shell_rules *r, struct shell_log *log, FILE *out);
+
+// compiles rules of file at path, topics of exact rules are bound at now(monotonic ns)
+// returns amount of rules, -1 on failure
+int shell_rules_load(struct shell_rules *r, const char *path, int64_t now);
+
+// compiles one rule line, src is its line number
+// returns 1 if rule was added, 0 for an empty or comment line, -1 if it is not valid
+int shell_rules_add(struct shell_rules *r, const char *line, uint32_t src);
+
+// binds topics of exact rules and wildcard rules matching them, called once after rules are added
+// their staleness is measured from now(monotonic ns)
+int shell_rules_compile(struct shell_rules *r, int64_t now);
+
+// frees rules and bindings
+void shell_rules_free(struct shell_rules *r);
+
+// returns binding of concrete topic, made on its first reading at now(monotonic ns), NULL if memory runs out
+struct rule_bind *shell_rules_bind(struct shell_rules *r, const char *topic, int64_t now);
+
+// checks reading of topic bound by bind at now(monotonic ns) against its rules
+// *bind is bound on the first reading, returns amount of alerts fired
+int shell_rules_eval(struct shell_rules *r, struct rule_bind **bind, const char *topic, double value, int64_t now);
+
+// fires alerts of topics that sent no reading for too long, called on timer ticks
+int shell_rules_tick(struct shell_rules *r, int64_t now);
+
+// returns 1 if topic matches mqtt topic filter
+int shell_rules_match(const char *filter, const char *topic);
+
+#endif // SHELL_RULES_H
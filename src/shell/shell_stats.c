@@ -0,0 +1,207 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_stats.c
+ * @brief: declarations of streaming statistics functions
+ * @note: descriptions for the functions in shell_stats.h
+*/
+
+
+#include"shell_stats.h"
+#include<stdlib.h>
+
+static const double s_quantiles[STATS_QUANTILES] = { 0.50, 0.95, 0.99 };
+
+
+// sorts up to five values(insertion sort)
+static void p2_sort(double *v, int cnt){
+
+	for(int i = 1; i < cnt; i++){
+
+		double x = v[i];
+		int j = i - 1;
+
+		while(j >= 0 && v[j] > x){
+			v[j + 1] = v[j];
+			j--;
+		}
+		v[j + 1] = x;
+	}
+}
+
+// initializes p-square estimator of quantile p(0..1)
+void p2_init(struct p2_quantile *pq, double p){
+
+	memset(pq, 0, sizeof(struct p2_quantile));
+	pq->p = p;
+
+	pq->dn[0] = 0;
+	pq->dn[1] = p / 2;
+	pq->dn[2] = p;
+	pq->dn[3] = (1 + p) / 2;
+	pq->dn[4] = 1;
+}
+
+// adds observation to p-square estimator
+void p2_add(struct p2_quantile *pq, double x){
+
+	double p = pq->p;
+	int k;
+
+	// first five observations become the markers
+	if(pq->cnt < 5){
+
+		pq->q[pq->cnt++] = x;
+		if(pq->cnt == 5){
+
+			p2_sort(pq->q, 5);
+			for(int i = 0; i < 5; i++){
+				pq->n[i] = i + 1;
+			}
+			pq->np[0] = 1;
+			pq->np[1] = 1 + 2 * p;
+			pq->np[2] = 1 + 4 * p;
+			pq->np[3] = 3 + 2 * p;
+			pq->np[4] = 5;
+		}
+		return;
+	}
+
+	// find cell of the observation, extremes move the end markers
+	if(x < pq->q[0]){
+		pq->q[0] = x;
+		k = 0;
+	}
+	else if(x >= pq->q[4]){
+		pq->q[4] = x;
+		k = 3;
+	}
+	else{
+		for(k = 0; k < 3 && x >= pq->q[k + 1]; k++);
+	}
+
+	for(int i = k + 1; i < 5; i++){
+		pq->n[i]++;
+	}
+	for(int i = 0; i < 5; i++){
+		pq->np[i] += pq->dn[i];
+	}
+	pq->cnt++;
+
+	// adjust middle markers that are off their desired position
+	for(int i = 1; i < 4; i++){
+
+		double d = pq->np[i] - pq->n[i];
+
+		if( (d >= 1 && pq->n[i + 1] - pq->n[i] > 1) || (d <= -1 && pq->n[i - 1] - pq->n[i] < -1) ){
+
+			double s = d >= 0 ? 1 : -1;
+			double *q = pq->q, *n = pq->n;
+
+			// piecewise parabolic prediction
+			double qp = q[i] + s / (n[i + 1] - n[i - 1]) *
+				( (n[i] - n[i - 1] + s) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+				  (n[i + 1] - n[i] - s) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]) );
+
+			// fall back to linear prediction when parabola leaves the neighbours
+			if(qp <= q[i - 1] || qp >= q[i + 1]){
+				int j = i + (int)s;
+				qp = q[i] + s * (q[j] - q[i]) / (n[j] - n[i]);
+			}
+
+			q[i] = qp;
+			n[i] += s;
+		}
+	}
+}
+
+// returns current estimate of the quantile
+double p2_value(const struct p2_quantile *pq){
+
+	if(pq->cnt == 0){
+		return NAN;
+	}
+
+	// with few observations the exact quantile is taken
+	if(pq->cnt < 5){
+
+		double v[5];
+		memcpy(v, pq->q, pq->cnt * sizeof(double));
+		p2_sort(v, pq->cnt);
+		return v[(int)(pq->p * (pq->cnt - 1) + 0.5)];
+	}
+	return pq->q[2];
+}
+
+// initializes statistics of a topic
+void shell_stats_init(struct topic_stats *st){
+
+	memset(st, 0, sizeof(struct topic_stats));
+	for(int i = 0; i < STATS_QUANTILES; i++){
+		p2_init(&st->quant[i], s_quantiles[i]);
+	}
+}
+
+// frees trace statistics of a topic
+void shell_stats_free(struct topic_stats *st){
+
+	free(st->trace);
+	st->trace = NULL;
+}
+
+// updates statistics with a reading received at now(monotonic ns)
+void shell_stats_update(struct topic_stats *st, double value, int64_t now){
+
+	// welford's running mean and variance
+	st->count++;
+	double delta = value - st->mean;
+	st->mean += delta / st->count;
+	st->m2 += delta * (value - st->mean);
+
+	if(st->count == 1 || value < st->min) st->min = value;
+	if(st->count == 1 || value > st->max) st->max = value;
+	shell_window_add(&st->agg, value);
+
+	// rate is measured over windows of STATS_RATE_NS
+	if(st->win_start == 0){
+		st->win_start = now;
+	}
+	else if(now - st->win_start >= STATS_RATE_NS){
+		st->rate = st->win_count * 1e9 / (now - st->win_start);
+		st->win_start = now;
+		st->win_count = 0;
+	}
+	st->win_count++;
+
+	for(int i = 0; i < STATS_QUANTILES; i++){
+		p2_add(&st->quant[i], value);
+	}
+}
+
+// returns variance of readings
+double shell_stats_variance(const struct topic_stats *st){
+
+	return st->count > 1 ? st->m2 / (st->count - 1) : 0;
+}
+
+// prints heading of statistics columns
+void shell_stats_print_head(FILE *out){
+
+	fprintf(out, "COUNT	RATE	MIN	MAX	MEAN	VAR	P50	P95	P99	TEXT");
+}
+
+// prints statistics columns of a topic at now(monotonic ns)
+void shell_stats_print(FILE *out, const struct topic_stats *st, int64_t now){
+
+	if(st->count == 0){
+		fprintf(out, "0	0	-	-	-	-	-	-	-	%ld", st->text);
+		return;
+	}
+
+	// topic that went quiet has no rate even if its last window was busy
+	double rate = now - st->win_start >= 2 * STATS_RATE_NS ? 0 : st->rate;
+
+	fprintf(out, "%ld	%.1f	%g	%g	%.3g	%.3g	%.3g	%.3g	%.3g	%ld",
+		st->count, rate, st->min, st->max, st->mean, shell_stats_variance(st),
+		p2_value(&st->quant[0]), p2_value(&st->quant[1]), p2_value(&st->quant[2]), st->text);
+}
@@ -0,0 +1,87 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_stats.h
+ * @brief: definitions and descriptions of streaming statistics functions
+*/
+
+
+#ifndef SHELL_STATS_H
+#define SHELL_STATS_H
+
+#include<stdio.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include"shell_window.h"
+
+
+// statistics are updated with every reading in constant time and memory
+// moments use welford's algorithm, percentiles use p-square estimators(jain & chlamtac)
+
+#define STATS_QUANTILES		3		// p50, p95, p99
+#define STATS_RATE_NS		1000000000LL	// window of rate measurement
+
+struct topic_trace;				// latencies of traced readings, see shell_trace.h
+struct rule_bind;				// alert rules of a topic, see shell_rules.h
+
+// p-square estimator of one quantile, keeps five markers
+struct p2_quantile{
+
+	double		p;			// estimated quantile
+	double		q[5];			// marker heights
+	double		n[5];			// actual marker positions
+	double		np[5];			// desired marker positions
+	double		dn[5];			// increments of desired positions
+	long		cnt;			// amount of observations
+};
+
+// statistics of readings of one topic
+struct topic_stats{
+
+	long			count;			// amount of readings
+	double			mean;			// running mean
+	double			m2;			// sum of squared differences from mean
+	double			min;			// smallest reading
+	double			max;			// largest reading
+	int64_t			win_start;		// start of current rate window(ns)
+	long			win_count;		// readings in current rate window
+	double			rate;			// readings per second in last window
+	struct p2_quantile	quant[STATS_QUANTILES];	// p50, p95, p99
+	long			text;			// readings that are not numbers
+	struct topic_trace	*trace;			// NULL until a traced reading arrives
+	struct topic_window	agg;			// readings of current aggregation window
+	struct rule_bind	*rules;			// alert rules of the topic, NULL until its first reading
+	int64_t			last_ns;		// time of the last reading(ns)
+	int64_t			lost_ns;		// connection of the topic was lost at(ns), 0 once readings resumed
+};
+
+
+// initializes p-square estimator of quantile p(0..1)
+void p2_init(struct p2_quantile *pq, double p);
+
+// adds observation to p-square estimator
+void p2_add(struct p2_quantile *pq, double x);
+
+// returns current estimate of the quantile
+double p2_value(const struct p2_quantile *pq);
+
+// initializes statistics of a topic
+void shell_stats_init(struct topic_stats *st);
+
+// frees trace statistics of a topic
+void shell_stats_free(struct topic_stats *st);
+
+// updates statistics with a reading received at now(monotonic ns)
+void shell_stats_update(struct topic_stats *st, double value, int64_t now);
+
+// returns variance of readings
+double shell_stats_variance(const struct topic_stats *st);
+
+// prints heading of statistics columns
+void shell_stats_print_head(FILE *out);
+
+// prints statistics columns of a topic at now(monotonic ns)
+void shell_stats_print(FILE *out, const struct topic_stats *st, int64_t now);
+
+#endif // SHELL_STATS_H
@@ -0,0 +1,300 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_topic.c
+ * @brief: declarations of topic trie functions
+ * @note: descriptions for the functions in shell_topic.h
+*/
+
+
+#include"shell_topic.h"
+
+// allocates node of a segment, NULL on failure
+static struct topic_node *topic_node_new(struct topic_node *parent, const char *seg, int len, uint32_t hash){
+
+	struct topic_node *node = malloc(sizeof(struct topic_node) + len);
+
+	if(node == NULL){
+		return NULL;
+	}
+	node->parent = parent;
+	node->kids = NULL;
+	node->kid_cnt = 0;
+	node->kid_sz = 0;
+	node->hash = hash;
+	node->seg_len = len;
+	node->state = NULL;
+	memcpy(node->seg, seg, len);
+
+	return node;
+}
+
+// frees node and every node below it
+static void topic_node_free(struct topic_node *node){
+
+	for(uint32_t i = 0; i < node->kid_sz; i++){
+		if(node->kids[i].node != NULL) topic_node_free(node->kids[i].node);
+	}
+	free(node->kids);
+	free(node);
+}
+
+// finds position of child of segment in table of node, -1 if there is none
+static int topic_kid_pos(const struct topic_node *node, const char *seg, int len, uint32_t hash){
+
+	if(node->kid_cnt == 0){
+		return -1;
+	}
+
+	uint32_t mask = node->kid_sz - 1;
+
+	for(uint32_t i = hash & mask; node->kids[i].node != NULL; i = (i + 1) & mask){
+
+		if(node->kids[i].hash != hash) continue;
+
+		const struct topic_node *kid = node->kids[i].node;
+		if(kid->seg_len == (uint32_t)len && memcmp(kid->seg, seg, len) == 0){
+			return i;
+		}
+	}
+	return -1;
+}
+
+// puts child into table of node that has room for it
+static void topic_kid_put(struct topic_node *node, struct topic_node *kid){
+
+	uint32_t mask = node->kid_sz - 1;
+	uint32_t i = kid->hash & mask;
+
+	while(node->kids[i].node != NULL){
+		i = (i + 1) & mask;
+	}
+	node->kids[i].hash = kid->hash;
+	node->kids[i].node = kid;
+}
+
+// adds child to node, table grows when it gets half full, -1 on failure
+static int topic_kid_add(struct topic_node *node, struct topic_node *kid){
+
+	if(2 * (node->kid_cnt + 1) > node->kid_sz){
+
+		uint32_t old_sz = node->kid_sz;
+		struct topic_kid *old = node->kids;
+		uint32_t sz = old_sz ? 2 * old_sz : TOPIC_KIDS_INIT;
+
+		node->kids = calloc(sz, sizeof(struct topic_kid));
+		if(node->kids == NULL){
+			node->kids = old;
+			return -1;
+		}
+		node->kid_sz = sz;
+
+		for(uint32_t i = 0; i < old_sz; i++){
+			if(old[i].node != NULL) topic_kid_put(node, old[i].node);
+		}
+		free(old);
+	}
+
+	topic_kid_put(node, kid);
+	node->kid_cnt++;
+
+	return 0;
+}
+
+// removes child at position i from table of node, following entries are shifted back
+// so probe sequences stay unbroken without marking removed entries
+static void topic_kid_remove(struct topic_node *node, uint32_t i){
+
+	uint32_t mask = node->kid_sz - 1;
+	uint32_t j = i;
+
+	node->kids[i].node = NULL;
+	node->kid_cnt--;
+
+	while(1){
+
+		j = (j + 1) & mask;
+		if(node->kids[j].node == NULL) break;
+
+		// entry moves to the hole if its home position is not between the hole and itself
+		uint32_t home = node->kids[j].hash & mask;
+		if( ((j - home) & mask) >= ((j - i) & mask) ){
+
+			node->kids[i] = node->kids[j];
+			node->kids[j].node = NULL;
+			i = j;
+		}
+	}
+}
+
+// walks segments of topic from the root, missing nodes are added when add is set
+// returns node of the last segment, NULL if it is missing or memory runs out
+static struct topic_node *topic_walk(struct shell_topics *t, const char *topic, int len, int add){
+
+	struct topic_node *node = t->root;
+	int start = 0;
+
+	// empty segments count too: "a//b" and "/a" are topics of their own
+	for(int i = 0; i <= len; i++){
+
+		if(i < len && topic[i] != '/') continue;
+
+		const char *seg = topic + start;
+		int seg_len = i - start;
+		uint32_t hash = hash_fnv1a(seg, seg_len);
+		int pos = topic_kid_pos(node, seg, seg_len, hash);
+
+		start = i + 1;
+
+		if(pos != -1){
+			node = node->kids[pos].node;
+			continue;
+		}
+		if(!add){
+			return NULL;
+		}
+
+		struct topic_node *kid = topic_node_new(node, seg, seg_len, hash);
+		if(kid == NULL || topic_kid_add(node, kid) == -1){
+			free(kid);
+			return NULL;
+		}
+		t->nodes++;
+		node = kid;
+	}
+	return node;
+}
+
+// frees nodes that lead to no state anymore, starting from node up towards the root
+static void topic_prune(struct shell_topics *t, struct topic_node *node){
+
+	while(node->parent != NULL && node->kid_cnt == 0 && node->state == NULL){
+
+		struct topic_node *parent = node->parent;
+
+		topic_kid_remove(parent, topic_kid_pos(parent, node->seg, node->seg_len, node->hash));
+		free(node->kids);
+		free(node);
+		t->nodes--;
+
+		node = parent;
+	}
+}
+
+// initializes empty trie
+int shell_topics_init(struct shell_topics *t){
+
+	memset(t, 0, sizeof(struct shell_topics));
+
+	t->root = topic_node_new(NULL, "", 0, 0);
+	if(t->root == NULL){
+		fprintf(stderr, "error: topic trie allocation failed\n");
+		return -1;
+	}
+	return 0;
+}
+
+// frees every node and state of the trie
+void shell_topics_free(struct shell_topics *t){
+
+	while(t->states != NULL){
+
+		struct topic_state *ts = t->states;
+		t->states = ts->next;
+
+		shell_stats_free(&ts->stats);
+		free(ts);
+	}
+	if(t->root != NULL){
+		topic_node_free(t->root);
+	}
+	memset(t, 0, sizeof(struct shell_topics));
+}
+
+// finds state of concrete topic of len bytes
+struct topic_state *shell_topics_find(struct shell_topics *t, const char *topic, int len){
+
+	struct topic_node *node = topic_walk(t, topic, len, 0);
+
+	return node != NULL ? node->state : NULL;
+}
+
+// finds state of concrete topic of len bytes, creates it for client id on its first reading
+struct topic_state *shell_topics_get(struct shell_topics *t, const char *topic, int len, int cid){
+
+	struct topic_node *node = topic_walk(t, topic, len, 1);
+
+	if(node == NULL){
+		return NULL;
+	}
+	if(node->state != NULL){
+		return node->state;
+	}
+
+	struct topic_state *ts = malloc(sizeof(struct topic_state) + len + 1);
+	if(ts == NULL){
+		topic_prune(t, node);
+		return NULL;
+	}
+
+	ts->node = node;
+	ts->cid = cid;
+	shell_stats_init(&ts->stats);
+	memcpy(ts->topic, topic, len);
+	ts->topic[len] = '\0';
+
+	ts->next = t->states;
+	t->states = ts;
+	t->cnt++;
+	node->state = ts;
+
+	return ts;
+}
+
+// drops states of client ids that are no longer in the client list
+void shell_topics_sweep(struct shell_topics *t, struct client_list *clist){
+
+	struct topic_state **pp = &t->states;
+
+	while(*pp != NULL){
+
+		struct topic_state *ts = *pp;
+
+		if(shell_clist_find_id(clist, ts->cid) != -1){
+			pp = &ts->next;
+			continue;
+		}
+
+		*pp = ts->next;
+		ts->node->state = NULL;
+		topic_prune(t, ts->node);
+		shell_stats_free(&ts->stats);
+		free(ts);
+		t->cnt--;
+	}
+}
+
+// prints statistics of concrete topics at now(monotonic ns), at most TOPICS_SHOW_MAX of them
+void shell_topics_print(struct shell_topics *t, FILE *out, int64_t now){
+
+	int shown = 0;
+
+	if(t->cnt == 0){
+		return;
+	}
+
+	fprintf(out, "topics of wildcard subscriptions(%ld):\n", t->cnt);
+	fprintf(out, "CID	TOPIC	");
+	shell_stats_print_head(out);
+	fprintf(out, "\n");
+
+	for(struct topic_state *ts = t->states; ts != NULL && shown < TOPICS_SHOW_MAX; ts = ts->next, shown++){
+
+		fprintf(out, "%d	%s	", ts->cid, ts->topic);
+		shell_stats_print(out, &ts->stats, now);
+		fprintf(out, "\n");
+	}
+	if(t->cnt > shown){
+		fprintf(out, "... %ld more topics\n", t->cnt - shown);
+	}
+}
@@ -0,0 +1,91 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_topic.h
+ * @brief: definitions and descriptions of topic trie functions
+*/
+
+
+#ifndef SHELL_TOPIC_H
+#define SHELL_TOPIC_H
+
+#include"shell_stats.h"
+#include"shell_clist.h"
+#include"client_hash.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+
+// one wildcard subscription delivers readings of many concrete topics
+// every concrete topic gets its own state, created when its first reading arrives
+// topics are kept in a trie of their '/' separated segments, children of a node are found
+// through a small open addressing table hashed by segment, so a lookup costs one probe per level
+// state belongs to the client id that delivered its first reading and is dropped with it
+
+#define TOPIC_KIDS_INIT		4	// children a node has room for at first
+#define TOPICS_SHOW_MAX		20	// concrete topics listed at most, newest first
+
+struct topic_state;
+struct topic_node;
+
+// entry of the table of children, hash is kept beside the child so probing does not load it
+struct topic_kid{
+
+	uint32_t		hash;			// hash of the segment of the child
+	struct topic_node	*node;			// child, NULL if the entry is empty
+};
+
+// node of the trie, one segment of a topic
+struct topic_node{
+
+	struct topic_node	*parent;		// NULL for the root
+	struct topic_kid	*kids;			// table of children, NULL when there are none
+	uint32_t		kid_cnt;		// amount of children
+	uint32_t		kid_sz;			// size of table of children, power of two
+	uint32_t		hash;			// hash of the segment
+	uint32_t		seg_len;		// length of the segment
+	struct topic_state	*state;			// state of the topic ending here, NULL if there is none
+	char			seg[];			// segment, not terminated
+};
+
+// state of one concrete topic
+struct topic_state{
+
+	struct topic_node	*node;			// last segment of the topic
+	struct topic_state	*next;			// next state, newest state is the first one
+	int			cid;			// client id that delivers the topic
+	struct topic_stats	stats;			// statistics of readings of the topic
+	char			topic[];		// concrete topic
+};
+
+// concrete topics of wildcard subscriptions
+struct shell_topics{
+
+	struct topic_node	*root;			// root of the trie, has no segment
+	struct topic_state	*states;		// every state, newest first
+	long			cnt;			// amount of states
+	long			nodes;			// amount of nodes besides the root
+};
+
+
+// initializes empty trie, -1 on failure
+int shell_topics_init(struct shell_topics *t);
+
+// frees every node and state of the trie
+void shell_topics_free(struct shell_topics *t);
+
+// finds state of concrete topic of len bytes, NULL if it has none
+struct topic_state *shell_topics_find(struct shell_topics *t, const char *topic, int len);
+
+// finds state of concrete topic of len bytes, creates it for client id on its first reading
+// returns NULL if memory runs out
+struct topic_state *shell_topics_get(struct shell_topics *t, const char *topic, int len, int cid);
+
+// drops states of client ids that are no longer in the client list
+void shell_topics_sweep(struct shell_topics *t, struct client_list *clist);
+
+// prints statistics of concrete topics at now(monotonic ns), at most TOPICS_SHOW_MAX of them
+void shell_topics_print(struct shell_topics *t, FILE *out, int64_t now);
+
+#endif // SHELL_TOPIC_H
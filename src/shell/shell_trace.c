@@ -0,0 +1,171 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_trace.c
+ * @brief: declarations of latency tracing functions
+ * @note: descriptions for the functions in shell_trace.h
+*/
+
+
+#include"shell_trace.h"
+
+static const char *s_hop_names[TRACE_HOPS] = { "pipe", "queue", "broker", "ingest", "total" };
+
+// stamps that start and end each hop, shell stamp is TRACE_STAMPS
+static const int s_hop_from[TRACE_HOPS] = { TRACE_SENSOR, TRACE_READ, TRACE_PUBLISH, TRACE_RECEIVE, TRACE_SENSOR };
+static const int s_hop_to[TRACE_HOPS] = { TRACE_READ, TRACE_PUBLISH, TRACE_RECEIVE, TRACE_STAMPS, TRACE_STAMPS };
+
+
+// returns position of most significant bit of a non-zero value
+static int hist_msb(uint64_t v){
+
+#if USE_BUILTIN
+	return 63 - __builtin_clzll(v);
+#else
+	int e = 0;
+	while(v >>= 1) e++;
+	return e;
+#endif // USE_BUILTIN
+}
+
+// returns bucket of a latency
+int hist_bucket(int64_t v){
+
+	if(v < HIST_SUB){
+		return v < 0 ? 0 : (int)v;
+	}
+
+	int e = hist_msb(v);
+	if(e > HIST_MAX_EXP){
+		return HIST_BUCKETS - 1;
+	}
+
+	// range of 2^e is split by the HIST_SUB_BITS bits below the top bit
+	int shift = e - HIST_SUB_BITS;
+	return HIST_SUB + shift * HIST_SUB + (int)((v >> shift) - HIST_SUB);
+}
+
+// returns highest latency that falls into bucket
+int64_t hist_bucket_high(int b){
+
+	if(b < HIST_SUB){
+		return b;
+	}
+
+	int shift = (b - HIST_SUB) / HIST_SUB;
+	int64_t sub = (b - HIST_SUB) % HIST_SUB + HIST_SUB;
+
+	return ((sub + 1) << shift) - 1;
+}
+
+// adds latency to histogram
+void hist_add(struct latency_hist *h, int64_t v){
+
+	if(v < 0) v = 0;
+
+	h->counts[hist_bucket(v)]++;
+	h->total++;
+	if(v > h->max) h->max = v;
+}
+
+// returns latency below which p(0..1) of latencies fall, rounded up to its bucket
+int64_t hist_percentile(const struct latency_hist *h, double p){
+
+	if(h->total == 0){
+		return 0;
+	}
+
+	long rank = (long)(p * h->total + 0.5);
+	long seen = 0;
+
+	if(rank < 1) rank = 1;
+
+	for(int b = 0; b < HIST_BUCKETS; b++){
+
+		seen += h->counts[b];
+		if(seen >= rank){
+			int64_t high = hist_bucket_high(b);
+			return high < h->max ? high : h->max;
+		}
+	}
+	return h->max;
+}
+
+// allocates zeroed trace statistics
+struct topic_trace *shell_trace_new(void){
+
+	struct topic_trace *tt = calloc(1, sizeof(struct topic_trace));
+
+	if(tt == NULL){
+		fprintf(stderr, "error: trace allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+	return tt;
+}
+
+// adds latencies and counters of src to dst
+void shell_trace_merge(struct topic_trace *dst, const struct topic_trace *src){
+
+	for(int h = 0; h < TRACE_HOPS; h++){
+
+		for(int b = 0; b < HIST_BUCKETS; b++){
+			dst->hops[h].counts[b] += src->hops[h].counts[b];
+		}
+		dst->hops[h].total += src->hops[h].total;
+		if(src->hops[h].max > dst->hops[h].max) dst->hops[h].max = src->hops[h].max;
+	}
+	dst->received += src->received;
+	dst->lost += src->lost;
+	dst->reordered += src->reordered;
+	dst->restarts += src->restarts;
+}
+
+// adds traced reading that reached the shell at now(monotonic ns)
+void shell_trace_update(struct topic_trace *tt, const struct client_trace *trace, int64_t now){
+
+	uint32_t seq = trace->seq;
+
+	// sequence numbers are compared as a distance so they may wrap
+	if(tt->received == 0 || seq == tt->next_seq){
+		tt->next_seq = seq + 1;
+	}
+	else if(seq == 0){
+		tt->restarts++;
+		tt->next_seq = 1;
+	}
+	else if((int32_t)(seq - tt->next_seq) > 0){
+		tt->lost += seq - tt->next_seq;
+		tt->next_seq = seq + 1;
+	}
+	else{
+		// late reading was counted lost when the later one arrived
+		tt->reordered++;
+		if(tt->lost > 0) tt->lost--;
+	}
+	tt->received++;
+
+	for(int h = 0; h < TRACE_HOPS; h++){
+
+		int64_t from = trace->ts[s_hop_from[h]];
+		int64_t to = s_hop_to[h] == TRACE_STAMPS ? now : trace->ts[s_hop_to[h]];
+
+		hist_add(&tt->hops[h], to - from);
+	}
+}
+
+// prints trace statistics of a topic, latencies in microseconds
+void shell_trace_print(FILE *out, const char *topic, const struct topic_trace *tt){
+
+	fprintf(out, "%s: received %ld  lost %ld  reordered %ld  restarts %ld\n",
+		topic, tt->received, tt->lost, tt->reordered, tt->restarts);
+	fprintf(out, "	HOP	P50	P90	P99	P99.9	MAX\n");
+
+	for(int h = 0; h < TRACE_HOPS; h++){
+
+		const struct latency_hist *hist = &tt->hops[h];
+
+		fprintf(out, "	%s	%.1f	%.1f	%.1f	%.1f	%.1f\n", s_hop_names[h],
+			hist_percentile(hist, 0.50) / 1e3, hist_percentile(hist, 0.90) / 1e3,
+			hist_percentile(hist, 0.99) / 1e3, hist_percentile(hist, 0.999) / 1e3, hist->max / 1e3);
+	}
+}
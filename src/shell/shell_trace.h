@@ -0,0 +1,86 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_trace.h
+ * @brief: definitions and descriptions of latency tracing functions
+*/
+
+
+#ifndef SHELL_TRACE_H
+#define SHELL_TRACE_H
+
+#include"client_info.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+
+
+#ifndef USE_BUILTIN
+#define USE_BUILTIN		1	// use gcc builtin function
+#endif
+
+// latencies are kept in log-linear(hdr) histograms: every power of two range is split
+// into HIST_SUB linear buckets, so a bucket is at most 1/HIST_SUB of its value wide
+
+#define HIST_SUB_BITS		4
+#define HIST_SUB		(1 << HIST_SUB_BITS)	// linear buckets in a power of two range
+#define HIST_MAX_EXP		39			// ranges up to 2^40 ns(~18 min), larger values go to the last bucket
+#define HIST_BUCKETS		(HIST_SUB + (HIST_MAX_EXP - HIST_SUB_BITS + 1) * HIST_SUB)
+
+// hops of a traced reading, last one is the whole way
+enum trace_hop{
+
+	HOP_PIPE,			// sensor to sensor client through the pipe
+	HOP_QUEUE,			// sensor client queue to mosquitto_publish
+	HOP_BROKER,			// mosquitto_publish through the broker to the shell client
+	HOP_INGEST,			// shell client to the shell
+	HOP_TOTAL,			// sensor to the shell
+	TRACE_HOPS
+};
+
+// histogram of latencies(ns)
+struct latency_hist{
+
+	uint32_t	counts[HIST_BUCKETS];	// latencies in each bucket
+	long		total;			// amount of latencies
+	int64_t		max;			// largest latency
+};
+
+// trace statistics of one topic
+struct topic_trace{
+
+	struct latency_hist	hops[TRACE_HOPS];	// latencies of every hop
+	long			received;		// traced readings received
+	long			lost;			// sequence numbers that never arrived
+	long			reordered;		// readings that arrived after a later one
+	long			restarts;		// sequence started over from 0
+	uint32_t		next_seq;		// sequence number expected next
+};
+
+
+// returns bucket of a latency
+int hist_bucket(int64_t v);
+
+// returns highest latency that falls into bucket
+int64_t hist_bucket_high(int b);
+
+// adds latency to histogram
+void hist_add(struct latency_hist *h, int64_t v);
+
+// returns latency below which p(0..1) of latencies fall, rounded up to its bucket
+int64_t hist_percentile(const struct latency_hist *h, double p);
+
+// allocates zeroed trace statistics
+struct topic_trace *shell_trace_new(void);
+
+// adds latencies and counters of src to dst
+void shell_trace_merge(struct topic_trace *dst, const struct topic_trace *src);
+
+// adds traced reading that reached the shell at now(monotonic ns)
+void shell_trace_update(struct topic_trace *tt, const struct client_trace *trace, int64_t now);
+
+// prints trace statistics of a topic, latencies in microseconds
+void shell_trace_print(FILE *out, const char *topic, const struct topic_trace *tt);
+
+#endif // SHELL_TRACE_H
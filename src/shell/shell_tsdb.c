@@ -0,0 +1,390 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_tsdb.c
+ * @brief: declarations of time-series store functions
+ * @note: descriptions for the functions in shell_tsdb.h
+*/
+
+
+#include"shell_tsdb.h"
+
+
+// builds path of a segment file, characters not safe in file names are written as %XX
+static void tsdb_seg_path(struct shell_tsdb *db, const char *topic, int seg, char *path, size_t sz){
+
+	char name[3 * CLIENT_TOPIC_LEN + 1];
+	int len = 0;
+
+	for(const char *c = topic; *c; c++){
+
+		if( (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '_' || *c == '-' ){
+			name[len++] = *c;
+		}
+		else{
+			len += sprintf(name + len, "%%%02X", (unsigned char)*c);
+		}
+	}
+	name[len] = '\0';
+
+	snprintf(path, sz, "%s/%s.%d.seg", db->dir, name, seg);
+}
+
+// maps segment file, creates it when create is set, NULL on failure
+static struct tsdb_seg_hdr *tsdb_map_seg(const char *path, int create){
+
+	struct stat st;
+	struct tsdb_seg_hdr *hdr;
+
+	int fd = open(path, (create ? O_RDWR | O_CREAT : O_RDONLY) | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if(fd < 0){
+		return NULL;
+	}
+
+	// new segment is a sparse file, pages get allocated as records are appended
+	if(fstat(fd, &st) == -1 || (create && st.st_size == 0 && ftruncate(fd, TSDB_SEG_LEN) == -1)){
+		close(fd);
+		return NULL;
+	}
+	if(st.st_size != 0 && st.st_size < (off_t)TSDB_SEG_LEN){
+		fprintf(stderr, "error: segment %s is truncated\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	hdr = mmap(NULL, TSDB_SEG_LEN, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(hdr == MAP_FAILED){
+		return NULL;
+	}
+
+	if(create && hdr->magic == 0){
+		hdr->rec_size = sizeof(struct tsdb_rec);
+		hdr->count = 0;
+		hdr->magic = TSDB_MAGIC;
+	}
+
+	if(hdr->magic != TSDB_MAGIC || hdr->rec_size != sizeof(struct tsdb_rec) || hdr->count > TSDB_SEG_RECORDS){
+		fprintf(stderr, "error: segment %s is not valid\n", path);
+		munmap(hdr, TSDB_SEG_LEN);
+		return NULL;
+	}
+	return hdr;
+}
+
+// finds number of the last existing segment of a topic, -1 if topic has none
+static int tsdb_last_seg(struct shell_tsdb *db, const char *topic){
+
+	char path[PATH_MAX];
+	struct stat st;
+	int seg = -1;
+
+	do{
+		tsdb_seg_path(db, topic, ++seg, path, sizeof(path));
+	}while(stat(path, &st) == 0);
+
+	return seg - 1;
+}
+
+// maps segment of series for appending, moves on to the next segment if it is not usable
+static int tsdb_series_map(struct shell_tsdb *db, struct tsdb_series *s){
+
+	char path[PATH_MAX];
+	int seg = s->seg;
+
+	for(int tries = 0; tries < 2; tries++, s->seg++){
+
+		tsdb_seg_path(db, s->topic, s->seg, path, sizeof(path));
+		s->hdr = tsdb_map_seg(path, 1);
+		if(s->hdr != NULL){
+			s->recs = (struct tsdb_rec*)(s->hdr + 1);
+			return 0;
+		}
+	}
+	fprintf(stderr, "error: opening segment %s failed(%d) --- %s\n", path, errno, strerror(errno));
+	s->seg = seg;
+	return -1;
+}
+
+// removes mapped series n from the recently appended list
+static void tsdb_lru_unlink(struct shell_tsdb *db, int n){
+
+	struct tsdb_series *s = &db->series[n];
+
+	if(s->prev != -1) db->series[s->prev].next = s->next;
+	else db->lru_head = s->next;
+	if(s->next != -1) db->series[s->next].prev = s->prev;
+	else db->lru_tail = s->prev;
+	s->prev = s->next = -1;
+}
+
+// puts mapped series n first in the recently appended list
+static void tsdb_lru_push(struct shell_tsdb *db, int n){
+
+	struct tsdb_series *s = &db->series[n];
+
+	s->prev = -1;
+	s->next = db->lru_head;
+	if(db->lru_head != -1) db->series[db->lru_head].prev = n;
+	else db->lru_tail = n;
+	db->lru_head = n;
+}
+
+// unmaps last segment of series n
+static void tsdb_series_unmap(struct shell_tsdb *db, int n){
+
+	struct tsdb_series *s = &db->series[n];
+
+	munmap(s->hdr, TSDB_SEG_LEN);
+	s->hdr = NULL;
+	s->recs = NULL;
+	tsdb_lru_unlink(db, n);
+	db->mapped--;
+}
+
+// maps last segment of series n for an append at ts, unmaps the least recently appended series when
+// TSDB_MAPPED_MAX are mapped, -1 on failure or while a failed series waits for its retry
+static int tsdb_series_load(struct shell_tsdb *db, int n, int64_t ts){
+
+	struct tsdb_series *s = &db->series[n];
+
+	if(ts < s->retry_ts){
+		return -1;
+	}
+	if(db->mapped == TSDB_MAPPED_MAX){
+		tsdb_series_unmap(db, db->lru_tail);
+	}
+
+	if(tsdb_series_map(db, s) == -1){
+		s->retry_ts = ts + (int64_t)TSDB_RETRY_SEC * 1000000000;
+		return -1;
+	}
+	s->retry_ts = TSDB_NO_TIME;
+	tsdb_lru_push(db, n);
+	db->mapped++;
+	return 0;
+}
+
+// finds opened series of a topic, -1 if not opened
+static int tsdb_find(struct shell_tsdb *db, const char *topic){
+
+	unsigned int mask = db->index_sz - 1;
+	unsigned int i = hash_fnv1a_str(topic) & mask;
+
+	while(db->index[i] != -1){
+
+		if(strcmp(db->series[db->index[i]].topic, topic) == 0){
+			return db->index[i];
+		}
+		i = (i + 1) & mask;
+	}
+	return -1;
+}
+
+// places series to the index
+static void tsdb_index_place(struct shell_tsdb *db, int n){
+
+	unsigned int mask = db->index_sz - 1;
+	unsigned int i = hash_fnv1a_str(db->series[n].topic) & mask;
+
+	while(db->index[i] != -1){
+		i = (i + 1) & mask;
+	}
+	db->index[i] = n;
+}
+
+// adds series of a topic continuing its last segment, it is mapped when appended to, -1 on failure
+static int tsdb_series_open(struct shell_tsdb *db, const char *topic){
+
+	if(strlen(topic) >= CLIENT_TOPIC_LEN){
+		return -1;
+	}
+
+	// grow series array and index together, index stays at most half full
+	if(db->cnt == db->cap){
+
+		int cap = 2 * db->cap;
+		struct tsdb_series *series = realloc(db->series, cap * sizeof(struct tsdb_series));
+		int *index = malloc(2 * cap * sizeof(int));
+
+		if(series == NULL || index == NULL){
+			fprintf(stderr, "error: time-series store allocation failed\n");
+			free(index);
+			if(series != NULL) db->series = series;
+			return -1;
+		}
+
+		free(db->index);
+		db->series = series;
+		db->cap = cap;
+		db->index = index;
+		db->index_sz = 2 * cap;
+		memset(db->index, -1, db->index_sz * sizeof(int));
+		for(int n = 0; n < db->cnt; n++){
+			tsdb_index_place(db, n);
+		}
+	}
+
+	struct tsdb_series *s = &db->series[db->cnt];
+	int seg = tsdb_last_seg(db, topic);
+
+	memset(s, 0, sizeof(struct tsdb_series));
+	strcpy(s->topic, topic);
+	s->seg = seg < 0 ? 0 : seg;
+	s->prev = s->next = -1;
+	s->retry_ts = TSDB_NO_TIME;
+
+	tsdb_index_place(db, db->cnt);
+	return db->cnt++;
+}
+
+// opens store in directory, series are opened when first used, -1 on failure
+int shell_tsdb_open(struct shell_tsdb *db, const char *dir){
+
+	memset(db, 0, sizeof(struct shell_tsdb));
+	db->lru_head = db->lru_tail = -1;
+
+	if(dir == NULL){
+		db->off = 1;
+		return 0;
+	}
+
+	if(mkdir(dir, S_IRWXU) == -1 && errno != EEXIST){
+		fprintf(stderr, "error: creating store directory %s failed(%d) --- %s\n", dir, errno, strerror(errno));
+		return -1;
+	}
+	snprintf(db->dir, sizeof(db->dir), "%s", dir);
+
+	db->cap = TSDB_SERIES_INIT;
+	db->index_sz = 2 * TSDB_SERIES_INIT;
+	db->series = malloc(db->cap * sizeof(struct tsdb_series));
+	db->index = malloc(db->index_sz * sizeof(int));
+	if(db->series == NULL || db->index == NULL){
+		fprintf(stderr, "error: time-series store allocation failed\n");
+		free(db->series);
+		free(db->index);
+		return -1;
+	}
+	memset(db->index, -1, db->index_sz * sizeof(int));
+
+	return 0;
+}
+
+// unmaps every series and frees the store
+void shell_tsdb_close(struct shell_tsdb *db){
+
+	while(db->lru_head != -1){
+		tsdb_series_unmap(db, db->lru_head);
+	}
+	free(db->series);
+	free(db->index);
+	db->series = NULL;
+	db->index = NULL;
+	db->cnt = db->cap = 0;
+}
+
+// appends reading of topic to the store, -1 on failure
+int shell_tsdb_append(struct shell_tsdb *db, const char *topic, int64_t ts, double value){
+
+	if(db->off){
+		return 0;
+	}
+
+	int n = tsdb_find(db, topic);
+	if(n == -1 && (n = tsdb_series_open(db, topic)) == -1){
+		return -1;
+	}
+
+	struct tsdb_series *s = &db->series[n];
+
+	// last segment is full: continue in the next one
+	if(s->hdr != NULL && s->hdr->count == TSDB_SEG_RECORDS){
+		tsdb_series_unmap(db, n);
+		s->seg++;
+	}
+	if(s->hdr == NULL){
+		if(tsdb_series_load(db, n, ts) == -1) return -1;
+	}
+	else if(db->lru_head != n){
+		tsdb_lru_unlink(db, n);
+		tsdb_lru_push(db, n);
+	}
+
+	struct tsdb_seg_hdr *hdr = s->hdr;
+	struct tsdb_rec *rec = &s->recs[hdr->count];
+
+	rec->ts = ts;
+	rec->value = value;
+	if(hdr->count == 0){
+		hdr->first_ts = ts;
+	}
+	hdr->last_ts = ts;
+
+	// count is raised last so a crash never exposes a half written record
+	__atomic_store_n(&hdr->count, hdr->count + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+// finds first record of segment with ts >= from, records are in append(time) order
+static uint64_t tsdb_lower_bound(const struct tsdb_rec *recs, uint64_t cnt, int64_t from){
+
+	uint64_t lo = 0, hi = cnt;
+
+	while(lo < hi){
+
+		uint64_t mid = lo + (hi - lo) / 2;
+		if(recs[mid].ts < from) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+// calls fn for every record of topic with from <= ts <= to in append order, returns their amount
+long shell_tsdb_query(struct shell_tsdb *db, const char *topic, int64_t from, int64_t to, tsdb_query_fn fn, void *arg){
+
+	char path[PATH_MAX];
+	long found = 0;
+
+	if(db->off){
+		return 0;
+	}
+
+	int n = tsdb_find(db, topic);
+	int last = n != -1 ? db->series[n].seg : tsdb_last_seg(db, topic);
+
+	if(to == TSDB_NO_TIME){
+		to = INT64_MAX;
+	}
+
+	for(int seg = 0; seg <= last; seg++){
+
+		// last segment of an opened series is already mapped
+		int mapped = n != -1 && seg == db->series[n].seg && db->series[n].hdr != NULL;
+		struct tsdb_seg_hdr *hdr;
+
+		if(mapped){
+			hdr = db->series[n].hdr;
+		}
+		else{
+			tsdb_seg_path(db, topic, seg, path, sizeof(path));
+			if( (hdr = tsdb_map_seg(path, 0)) == NULL ) continue;
+		}
+
+		uint64_t cnt = __atomic_load_n(&hdr->count, __ATOMIC_ACQUIRE);
+		const struct tsdb_rec *recs = (const struct tsdb_rec*)(hdr + 1);
+
+		// skip segments outside of range without touching their records
+		if(cnt > 0 && hdr->last_ts >= from && hdr->first_ts <= to){
+
+			for(uint64_t i = tsdb_lower_bound(recs, cnt, from); i < cnt && recs[i].ts <= to; i++){
+				fn(&recs[i], arg);
+				found++;
+			}
+		}
+
+		if(!mapped){
+			munmap(hdr, TSDB_SEG_LEN);
+		}
+	}
+	return found;
+}
@@ -0,0 +1,107 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_tsdb.h
+ * @brief: definitions and descriptions of time-series store functions
+*/
+
+
+#ifndef SHELL_TSDB_H
+#define SHELL_TSDB_H
+
+#include"client_info.h"
+#include"client_hash.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<stdint.h>
+#include<unistd.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<limits.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+
+// every topic has its own series of segment files dir/<topic>.<n>.seg
+// a segment is a header followed by fixed-size records that are appended through mmap
+// header holds the amount of records so reopening a segment needs no scanning
+// at most TSDB_MAPPED_MAX series keep their last segment mapped, the least recently appended one is
+// unmapped when another series needs its segment, a series that fails to open is retried after TSDB_RETRY_SEC
+
+#define TSDB_DIR		"tsdb"		// default directory of the store
+#define TSDB_OFF		"off"		// store directory that turns the store off
+#define TSDB_MAGIC		0x31425354	// "TSB1"
+#define TSDB_SEG_RECORDS	(1 << 20)	// records in one segment file
+#define TSDB_SERIES_INIT	16		// initial amount of series
+#define TSDB_NO_TIME		INT64_MIN	// open end of query range
+#define TSDB_MAPPED_MAX		4096		// series with a mapped segment, stays far below vm.max_map_count
+#define TSDB_RETRY_SEC		10		// wait before a series that failed to open is opened again
+
+// record of one reading
+struct tsdb_rec{
+
+	int64_t		ts;			// receive time in nanoseconds since epoch
+	double		value;			// reading
+};
+
+// header of a segment file
+struct tsdb_seg_hdr{
+
+	uint32_t	magic;			// TSDB_MAGIC
+	uint32_t	rec_size;		// size of a record
+	uint64_t	count;			// amount of appended records
+	int64_t		first_ts;		// time of first record
+	int64_t		last_ts;		// time of last record
+	char		pad[32];		// header takes 64 bytes
+};
+
+#define TSDB_SEG_LEN	(sizeof(struct tsdb_seg_hdr) + TSDB_SEG_RECORDS * sizeof(struct tsdb_rec))
+
+// series of one topic, only its last segment is mapped
+struct tsdb_series{
+
+	char			topic[CLIENT_TOPIC_LEN];	// topic of the series
+	int			seg;				// number of last segment
+	struct tsdb_seg_hdr	*hdr;				// mapped last segment, NULL if not mapped
+	struct tsdb_rec		*recs;				// records of last segment
+	int			prev;				// more recently appended mapped series, -1 none
+	int			next;				// less recently appended mapped series, -1 none
+	int64_t			retry_ts;			// failed series is not opened before, TSDB_NO_TIME
+};
+
+// time-series store
+struct shell_tsdb{
+
+	char			dir[PATH_MAX / 2];	// directory of segment files
+	struct tsdb_series	*series;		// opened series
+	int			cnt;			// amount of opened series
+	int			cap;			// capacity of series array
+	int			*index;			// hash index from topic to series, -1 empty
+	int			index_sz;		// amount of index entries, power of two
+	int			mapped;			// series with a mapped segment
+	int			lru_head;		// most recently appended mapped series, -1 none
+	int			lru_tail;		// least recently appended mapped series, -1 none
+	int			off;			// store is turned off, nothing is stored
+};
+
+// function called for every record of a query
+typedef void (*tsdb_query_fn)(const struct tsdb_rec *rec, void *arg);
+
+
+// opens store in directory, series are opened when first used, -1 on failure
+// directory NULL turns the store off
+int shell_tsdb_open(struct shell_tsdb *db, const char *dir);
+
+// unmaps every series and frees the store
+void shell_tsdb_close(struct shell_tsdb *db);
+
+// appends reading of topic to the store, -1 on failure
+// failed series is not opened again until ts passed its retry time, then -1 is returned without a message
+int shell_tsdb_append(struct shell_tsdb *db, const char *topic, int64_t ts, double value);
+
+// calls fn for every record of topic with from <= ts <= to in append order, returns their amount
+// TSDB_NO_TIME leaves the end of range open
+long shell_tsdb_query(struct shell_tsdb *db, const char *topic, int64_t from, int64_t to, tsdb_query_fn fn, void *arg);
+
+#endif // SHELL_TSDB_H
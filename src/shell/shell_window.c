@@ -0,0 +1,84 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_window.c
+ * @brief: declarations of tumbling window aggregation functions
+ * @note: descriptions for the functions in shell_window.h
+*/
+
+
+#include"shell_window.h"
+
+// parses window length "N", "Ns", "Nm" or "Nh" into seconds
+int64_t shell_window_parse(const char *arg){
+
+	char *end;
+	long n = strtol(arg, &end, 10);
+
+	if(end == arg || n <= 0){
+		return -1;
+	}
+	if(*end == '\0' || strcmp(end, "s") == 0) return n;
+	if(strcmp(end, "m") == 0) return n * 60;
+	if(strcmp(end, "h") == 0) return n * 3600;
+
+	return -1;
+}
+
+// initializes window clock with length of len seconds at real time now(seconds since epoch)
+void shell_window_init(struct shell_window *w, int64_t len, int64_t now){
+
+	w->len = len;
+	w->index = len > 0 ? now / len : 0;
+	w->ended = w->index - 1;
+	w->closed = 0;
+}
+
+// moves window clock to real time now, 1 if current window ended
+int shell_window_roll(struct shell_window *w, int64_t now){
+
+	if(w->len == 0 || now / w->len <= w->index){
+		return 0;
+	}
+
+	// windows passed while the shell was stopped have no readings, only the one with readings is closed
+	w->ended = w->index;
+	w->index = now / w->len;
+	w->closed++;
+
+	return 1;
+}
+
+// returns end of the window closed last(seconds since epoch)
+int64_t shell_window_end(const struct shell_window *w){
+
+	return (w->ended + 1) * w->len;
+}
+
+// writes summary record of topic for window ending at end into line, window of the topic is emptied
+int shell_window_record(struct topic_window *tw, const char *topic, int64_t end, int64_t len, char *line, int sz){
+
+	char stamp[32];
+	time_t t = (time_t)end;
+	struct tm tm;
+	int n;
+
+	strftime(stamp, sizeof(stamp), "%F %T", localtime_r(&t, &tm));
+
+	// idle topic has no min, max or mean, only the value it had last
+	if(tw->count == 0){
+		n = snprintf(line, sz, "%s %llds %s: count 0 min - max - mean - last ", stamp, (long long)len, topic);
+	}
+	else{
+		n = snprintf(line, sz, "%s %llds %s: count %ld min %g max %g mean %g last ", stamp, (long long)len, topic,
+				tw->count, tw->min, tw->max, tw->sum / tw->count);
+	}
+	if(n < sz){
+		n += tw->have_last ? snprintf(line + n, sz - n, "%g\n", tw->last) : snprintf(line + n, sz - n, "-\n");
+	}
+
+	tw->count = 0;
+	tw->sum = 0;
+
+	return n < sz ? n : sz - 1;
+}
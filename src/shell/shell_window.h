@@ -0,0 +1,79 @@
+
+/*
+ * @author: Pavel Dounaev (dounpav)
+ * @file: shell_window.h
+ * @brief: definitions and descriptions of tumbling window aggregation functions
+*/
+
+
+#ifndef SHELL_WINDOW_H
+#define SHELL_WINDOW_H
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<time.h>
+
+
+// in aggregation mode readings are not printed one by one, every topic gets one summary record
+// per window instead: count, min, max, mean and last value
+// windows follow each other without gaps and are aligned to the wall clock, a 10 s window
+// ends at :00, :10, :20 ...
+// window is closed by the shell timer, so topics without readings still get their record,
+// or by the first reading of the next window when it comes before the timer
+
+#define WINDOW_LINE_LEN		320	// summary record of one topic
+
+// readings of one topic in the current window
+struct topic_window{
+
+	long		count;			// readings in window
+	double		min;			// smallest reading
+	double		max;			// largest reading
+	double		sum;			// sum of readings
+	double		last;			// last reading, kept across windows
+	int		have_last;		// topic has had a reading
+};
+
+// window clock of the shell
+struct shell_window{
+
+	int64_t		len;			// window length in seconds, 0 aggregation is off
+	int64_t		index;			// current window, seconds since epoch / len
+	int64_t		ended;			// window closed last
+	long		closed;			// windows closed so far
+};
+
+
+// parses window length "N", "Ns", "Nm" or "Nh" into seconds, -1 if it is not valid
+int64_t shell_window_parse(const char *arg);
+
+// initializes window clock with length of len seconds at real time now(seconds since epoch)
+void shell_window_init(struct shell_window *w, int64_t len, int64_t now);
+
+// moves window clock to real time now(seconds since epoch)
+// returns 1 if current window ended and has to be closed, 0 otherwise
+// clock stepping backwards keeps the current window, it ends when the clock passes its end again
+int shell_window_roll(struct shell_window *w, int64_t now);
+
+// returns end of the window closed last(seconds since epoch)
+int64_t shell_window_end(const struct shell_window *w);
+
+// adds reading to window of a topic
+static inline void shell_window_add(struct topic_window *tw, double value){
+
+	if(tw->count == 0 || value < tw->min) tw->min = value;
+	if(tw->count == 0 || value > tw->max) tw->max = value;
+	tw->count++;
+	tw->sum += value;
+	tw->last = value;
+	tw->have_last = 1;
+}
+
+// writes summary record of topic for window ending at end(seconds since epoch) into line of sz bytes
+// window of the topic is emptied, its last value stays
+// returns length of the record
+int shell_window_record(struct topic_window *tw, const char *topic, int64_t end, int64_t len, char *line, int sz);
+
+#endif // SHELL_WINDOW_H